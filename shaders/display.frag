@@ -0,0 +1,30 @@
+#version 420
+
+out vec4 color;
+in vec2 uv;
+
+uniform layout(binding=3, rgba8ui) readonly uimage2D uFractalTexture;
+// the resolution the fractal was rendered at. can be lower than the window resolution.
+uniform int uWidth;
+uniform int uHeight;
+
+vec4 csample(ivec2 i) {
+  i = ivec2(clamp(i.x, 0, uWidth-1), clamp(i.y, 0, uHeight-1));
+  return vec4(imageLoad(uFractalTexture, i));
+}
+
+void main() {
+  // image load/store does no filtering, so to upscale the texture to the window
+  // we do bilinear filtering by hand, from the four nearest texels.
+  // When the texture has the same resolution as the window, p is exactly on a texel,
+  // so this is just a plain imageLoad.
+  vec2 p = vec2(float(uWidth) * uv.x, float(uHeight) * uv.y) - 0.5;
+  ivec2 i = ivec2(floor(p));
+  vec2 f = p - vec2(i);
+  vec4 s = mix(
+    mix(csample(i + ivec2(0, 0)), csample(i + ivec2(1, 0)), f.x),
+    mix(csample(i + ivec2(0, 1)), csample(i + ivec2(1, 1)), f.x), f.y);
+
+  // RGBA8UI is in range [0,255], so scale down. 
+  color = (1.0 / 255.0) * s;
+}
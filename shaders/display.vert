@@ -0,0 +1,16 @@
+#version 420
+
+//
+// This shader displays the texture to the screen.
+//
+
+out vec2 uv;
+
+// From the vertex shader, we output vertices that form a big triangle that covers the screen. 
+const vec2 verts[3] = vec2[](vec2(-1, -1), vec2(3, -1), vec2(-1, 3));
+const vec2 uvs[3] = vec2[](vec2(0, 0), vec2(2, 0), vec2(0, 2));
+
+void main() {
+  uv = uvs[gl_VertexID];
+  gl_Position =  vec4( verts[gl_VertexID] , 0.0, 1.0);
+}
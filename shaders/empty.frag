@@ -0,0 +1,5 @@
+#version 420
+
+// The passes that only use the vertex shader, to launch one thread per pixel,
+// don't rasterize anything, so they use this empty fragment shader.
+void main() {}
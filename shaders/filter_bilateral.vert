@@ -0,0 +1,46 @@
+#version 420
+
+//
+// Bilateral filter. Like a gaussian blur, except that the weight of a neighbour also falls off
+// with how different its color is from the center pixel. So it smooths flat regions, but keeps
+// the edges sharp. It is not separable, so it is done in a single pass.
+//
+
+#include "pixel_order.glsl"
+
+uniform int uWidth;
+uniform int uHeight;
+#ifndef RADIUS
+#define RADIUS 3
+#endif
+uniform float uSigma;      // spatial falloff, in pixels.
+uniform float uRangeSigma; // color falloff, in [0,255] units.
+uniform layout(binding=0, rgba8ui) readonly uimage2D uInput;
+uniform layout(binding=2, rgba8ui) writeonly uimage2D uOutput;
+
+vec4 csample(ivec2 i) {
+  i = ivec2(clamp(i.x, 0, uWidth-1), clamp(i.y, 0, uHeight-1));
+  return vec4(imageLoad(uInput, i));
+}
+
+void main() {
+  ivec2 i = PixelFromId(gl_VertexID, uWidth);
+  if (i.x >= uWidth || i.y >= uHeight) {
+    return; // the padding, see pixel_order.glsl.
+  }
+
+  vec4 center = csample(i);
+  vec4 sum = vec4(0.0);
+  float weightSum = 0.0;
+  for (int y = -RADIUS; y <= RADIUS; y++) {
+    for (int x = -RADIUS; x <= RADIUS; x++) {
+      vec4 s = csample(i + ivec2(x, y));
+      vec3 d = s.rgb - center.rgb;
+      float w = exp(-float(x * x + y * y) / (2.0 * uSigma * uSigma) - dot(d, d) / (2.0 * uRangeSigma * uRangeSigma));
+      sum += w * s;
+      weightSum += w;
+    }
+  }
+
+  imageStore(uOutput, i, uvec4(sum / weightSum + 0.5));
+}
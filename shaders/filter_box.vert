@@ -0,0 +1,38 @@
+#version 420
+
+//
+// Box filter blur, as a separable filter. It is run twice, once horizontally and once
+// vertically, so that a filter of radius R costs 2*(2R+1) loads per pixel, instead of (2R+1)^2.
+// Like the fractal shader, it is launched with one vertex for every pixel.
+//
+
+#include "pixel_order.glsl"
+
+uniform int uWidth;
+uniform int uHeight;
+uniform ivec2 uDirection; // (1,0) for the horizontal pass, and (0,1) for the vertical pass.
+#ifndef RADIUS
+#define RADIUS 8 // set by the filter library, as a constant, so that the loop is unrolled.
+#endif
+uniform layout(binding=0, rgba8ui) readonly uimage2D uInput;
+uniform layout(binding=2, rgba8ui) writeonly uimage2D uOutput;
+
+// sample with clamping from the texture. 
+vec4 csample(ivec2 i) {
+  i = ivec2(clamp(i.x, 0, uWidth-1), clamp(i.y, 0, uHeight-1));
+  return vec4(imageLoad(uInput, i));
+}
+
+void main() {
+  ivec2 i = PixelFromId(gl_VertexID, uWidth);
+  if (i.x >= uWidth || i.y >= uHeight) {
+    return; // the padding, see pixel_order.glsl.
+  }
+
+  vec4 sum = vec4(0.0);
+  for (int k = -RADIUS; k <= RADIUS; k++)
+    sum += csample(i + k * uDirection);
+
+  // round, instead of truncating, so that the two passes don't darken the image.
+  imageStore(uOutput, i, uvec4(sum / float(2 * RADIUS + 1) + 0.5));
+}
@@ -0,0 +1,41 @@
+#version 420
+
+//
+// Gaussian blur, as a separable filter. Run once horizontally and once vertically.
+// The weights are normalized by their sum, so that the filter doesn't change the brightness
+// of the image, even when the radius cuts off the tails of the gaussian.
+//
+
+#include "pixel_order.glsl"
+
+uniform int uWidth;
+uniform int uHeight;
+uniform ivec2 uDirection; // (1,0) for the horizontal pass, and (0,1) for the vertical pass.
+#ifndef RADIUS
+#define RADIUS 3
+#endif
+uniform float uSigma;
+uniform layout(binding=0, rgba8ui) readonly uimage2D uInput;
+uniform layout(binding=2, rgba8ui) writeonly uimage2D uOutput;
+
+vec4 csample(ivec2 i) {
+  i = ivec2(clamp(i.x, 0, uWidth-1), clamp(i.y, 0, uHeight-1));
+  return vec4(imageLoad(uInput, i));
+}
+
+void main() {
+  ivec2 i = PixelFromId(gl_VertexID, uWidth);
+  if (i.x >= uWidth || i.y >= uHeight) {
+    return; // the padding, see pixel_order.glsl.
+  }
+
+  vec4 sum = vec4(0.0);
+  float weightSum = 0.0;
+  for (int k = -RADIUS; k <= RADIUS; k++) {
+    float w = exp(-float(k * k) / (2.0 * uSigma * uSigma));
+    sum += w * csample(i + k * uDirection);
+    weightSum += w;
+  }
+
+  imageStore(uOutput, i, uvec4(sum / weightSum + 0.5));
+}
@@ -0,0 +1,45 @@
+#version 420
+
+//
+// Median filter over a 3x3 neighbourhood, computed separately for every channel.
+//
+// The median is found with a selection network: a fixed sequence of min/max operations,
+// without any branches, so that all threads execute the same instructions.
+// The network is Batcher's merge-exchange sorting network for 9 elements, with all
+// the operations removed that don't affect the middle element. That leaves 36 min/max.
+// We work on integers, so the result is exact.
+//
+
+#include "pixel_order.glsl"
+
+uniform int uWidth;
+uniform int uHeight;
+uniform layout(binding=0, rgba8ui) readonly uimage2D uInput;
+uniform layout(binding=2, rgba8ui) writeonly uimage2D uOutput;
+
+uvec4 csample(ivec2 i) {
+  i = ivec2(clamp(i.x, 0, uWidth-1), clamp(i.y, 0, uHeight-1));
+  return imageLoad(uInput, i);
+}
+
+// S sorts two elements, MN only keeps the smaller in a, and MX only keeps the larger in b.
+#define S(a, b) { uvec4 t = min(p[a], p[b]); p[b] = max(p[a], p[b]); p[a] = t; }
+#define MN(a, b) { p[a] = min(p[a], p[b]); }
+#define MX(a, b) { p[b] = max(p[a], p[b]); }
+
+void main() {
+  ivec2 i = PixelFromId(gl_VertexID, uWidth);
+  if (i.x >= uWidth || i.y >= uHeight) {
+    return; // the padding, see pixel_order.glsl.
+  }
+
+  uvec4 p[9];
+  for (int y = 0; y < 3; y++)
+    for (int x = 0; x < 3; x++)
+      p[y * 3 + x] = csample(i + ivec2(x - 1, y - 1));
+
+  S(0,8) S(0,4) S(1,5) S(2,6) S(3,7) S(4,8) S(0,2) S(1,3) S(4,6) S(5,7) S(2,8) S(2,4) S(3,5)
+  S(6,8) MX(0,1) MX(2,3) MN(4,5) MN(6,7) MN(1,8) MX(1,4) MN(3,6) MX(3,4)
+
+  imageStore(uOutput, i, p[4]);
+}
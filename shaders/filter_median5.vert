@@ -0,0 +1,54 @@
+#version 420
+
+//
+// Median filter over a 5x5 neighbourhood, computed separately for every channel.
+//
+// The median is found with a selection network: a fixed sequence of min/max operations,
+// without any branches, so that all threads execute the same instructions.
+// The network is Batcher's merge-exchange sorting network for 25 elements, with all
+// the operations removed that don't affect the middle element. That leaves 202 min/max.
+// We work on integers, so the result is exact.
+//
+
+#include "pixel_order.glsl"
+
+uniform int uWidth;
+uniform int uHeight;
+uniform layout(binding=0, rgba8ui) readonly uimage2D uInput;
+uniform layout(binding=2, rgba8ui) writeonly uimage2D uOutput;
+
+uvec4 csample(ivec2 i) {
+  i = ivec2(clamp(i.x, 0, uWidth-1), clamp(i.y, 0, uHeight-1));
+  return imageLoad(uInput, i);
+}
+
+// S sorts two elements, MN only keeps the smaller in a, and MX only keeps the larger in b.
+#define S(a, b) { uvec4 t = min(p[a], p[b]); p[b] = max(p[a], p[b]); p[a] = t; }
+#define MN(a, b) { p[a] = min(p[a], p[b]); }
+#define MX(a, b) { p[b] = max(p[a], p[b]); }
+
+void main() {
+  ivec2 i = PixelFromId(gl_VertexID, uWidth);
+  if (i.x >= uWidth || i.y >= uHeight) {
+    return; // the padding, see pixel_order.glsl.
+  }
+
+  uvec4 p[25];
+  for (int y = 0; y < 5; y++)
+    for (int x = 0; x < 5; x++)
+      p[y * 5 + x] = csample(i + ivec2(x - 2, y - 2));
+
+  S(0,16) S(1,17) S(2,18) S(3,19) S(4,20) S(5,21) S(6,22) S(7,23) S(8,24) S(0,8) S(1,9) S(2,10)
+  S(3,11) S(4,12) S(5,13) S(6,14) S(7,15) S(16,24) S(8,16) S(9,17) S(10,18) S(11,19) S(12,20)
+  S(13,21) S(14,22) S(15,23) S(0,4) S(1,5) S(2,6) S(3,7) S(8,12) S(9,13) S(10,14) S(11,15)
+  S(16,20) S(17,21) S(18,22) S(19,23) S(4,16) S(5,17) S(6,18) S(7,19) S(12,24) S(4,8) S(5,9)
+  S(6,10) S(7,11) S(12,16) S(13,17) S(14,18) S(15,19) S(20,24) S(0,2) S(1,3) S(4,6) S(5,7)
+  S(8,10) S(9,11) S(12,14) S(13,15) S(16,18) S(17,19) S(20,22) S(21,23) S(2,16) S(3,17) S(6,20)
+  S(7,21) S(10,24) S(2,8) S(3,9) S(6,12) S(7,13) S(10,16) S(11,17) S(14,20) S(15,21) S(18,24)
+  S(2,4) S(3,5) S(6,8) S(7,9) S(10,12) S(11,13) S(14,16) S(15,17) S(18,20) S(19,21) S(22,24)
+  MX(0,1) MX(2,3) MX(4,5) MX(6,7) MX(8,9) MX(10,11) MN(12,13) MN(14,15) MN(16,17) MN(18,19)
+  MN(20,21) MN(22,23) MX(1,16) MX(3,18) MN(5,20) MN(7,22) MN(9,24) MX(5,12) MX(7,14) MN(9,16)
+  MN(11,18) MX(9,12) MN(11,14) MX(11,12)
+
+  imageStore(uOutput, i, p[12]);
+}
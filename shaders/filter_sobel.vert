@@ -0,0 +1,40 @@
+#version 420
+
+//
+// Sobel edge detection. Outputs the magnitude of the gradient of the luminance, as a gray image.
+//
+
+#include "pixel_order.glsl"
+
+uniform int uWidth;
+uniform int uHeight;
+uniform float uScale; // the gradient magnitude is multiplied by this.
+uniform layout(binding=0, rgba8ui) readonly uimage2D uInput;
+uniform layout(binding=2, rgba8ui) writeonly uimage2D uOutput;
+
+float luminance(ivec2 i) {
+  i = ivec2(clamp(i.x, 0, uWidth-1), clamp(i.y, 0, uHeight-1));
+  return dot(vec3(imageLoad(uInput, i).rgb), vec3(0.299, 0.587, 0.114));
+}
+
+void main() {
+  ivec2 i = PixelFromId(gl_VertexID, uWidth);
+  if (i.x >= uWidth || i.y >= uHeight) {
+    return; // the padding, see pixel_order.glsl.
+  }
+
+  float tl = luminance(i + ivec2(-1, -1));
+  float t  = luminance(i + ivec2( 0, -1));
+  float tr = luminance(i + ivec2( 1, -1));
+  float l  = luminance(i + ivec2(-1,  0));
+  float r  = luminance(i + ivec2( 1,  0));
+  float bl = luminance(i + ivec2(-1,  1));
+  float b  = luminance(i + ivec2( 0,  1));
+  float br = luminance(i + ivec2( 1,  1));
+
+  float gx = (tr + 2.0 * r + br) - (tl + 2.0 * l + bl);
+  float gy = (bl + 2.0 * b + br) - (tl + 2.0 * t + tr);
+  float magnitude = clamp(uScale * sqrt(gx * gx + gy * gy), 0.0, 255.0);
+
+  imageStore(uOutput, i, uvec4(uvec3(magnitude + 0.5), 255));
+}
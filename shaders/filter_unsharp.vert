@@ -0,0 +1,46 @@
+#version 420
+
+//
+// Unsharp mask: sharpens the image, by adding the difference between the image and a blurred
+// copy of it. The blur is a separable gaussian: the horizontal half is done by filter_gaussian.vert
+// in the pass before this one, and this shader does the vertical half, and then the sharpening.
+//
+
+#include "pixel_order.glsl"
+
+uniform int uWidth;
+uniform int uHeight;
+#ifndef RADIUS
+#define RADIUS 3
+#endif
+uniform float uSigma;
+uniform float uAmount; // how much of the difference to add.
+uniform layout(binding=0, rgba8ui) readonly uimage2D uInput;    // horizontally blurred image.
+uniform layout(binding=1, rgba8ui) readonly uimage2D uOriginal; // the image we sharpen.
+uniform layout(binding=2, rgba8ui) writeonly uimage2D uOutput;
+
+vec4 csample(ivec2 i) {
+  i = ivec2(clamp(i.x, 0, uWidth-1), clamp(i.y, 0, uHeight-1));
+  return vec4(imageLoad(uInput, i));
+}
+
+void main() {
+  ivec2 i = PixelFromId(gl_VertexID, uWidth);
+  if (i.x >= uWidth || i.y >= uHeight) {
+    return; // the padding, see pixel_order.glsl.
+  }
+
+  vec4 sum = vec4(0.0);
+  float weightSum = 0.0;
+  for (int k = -RADIUS; k <= RADIUS; k++) {
+    float w = exp(-float(k * k) / (2.0 * uSigma * uSigma));
+    sum += w * csample(i + ivec2(0, k));
+    weightSum += w;
+  }
+  vec4 blurred = sum / weightSum;
+
+  vec4 original = vec4(imageLoad(uOriginal, i));
+  vec4 sharpened = original + uAmount * (original - blurred);
+
+  imageStore(uOutput, i, uvec4(clamp(sharpened, 0.0, 255.0) + 0.5));
+}
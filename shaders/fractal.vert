@@ -0,0 +1,388 @@
+#version 420
+
+//
+// This shader renders the Mandelbrot set, or one of its relatives, to the texture. 
+// It is launched with glDrawArrays(GL_POINTS, 0, N), one vertex for every pixel.
+//
+// Which fractal we render is decided when the shader is compiled: the program is built
+// once for every variant, with #defines for FORMULA, POWER and M inserted right after
+// the #version line (see fractal_variant.h). So the inner loop never branches on them.
+// Without any #defines, we get the original Mandelbrot set.
+//
+// With ITERATION_IMAGE defined, we also write the number of iterations of every pixel to
+// uIterationTexture, for the iteration statistics, see iteration_stats.h.
+//
+// With PERSISTENT_THREADS defined, we launch a fixed number of threads, that pull the pixels
+// from a queue, instead of one thread per pixel. See the end of main().
+//
+// With MARIANI_SILVER defined, the pass first finds the iterations on the borders of tiles, and
+// fills every tile whose border has a single iteration count with that count, without iterating
+// its inside. See the Mariani-Silver section below.
+//
+// Where the view is symmetric about the real axis, the pass computes just a band of the rows, and the
+// mirror pass, mirror.vert, copies the rest from their mirror images. The band starts at uFirstRow, and
+// is uHeight rows high, so that to everything below, but StartPixel() and StorePixel(), it is the image.
+//
+
+#define FORMULA_MANDELBROT 0
+#define FORMULA_JULIA 1
+#define FORMULA_BURNING_SHIP 2
+
+#ifndef FORMULA
+#define FORMULA FORMULA_MANDELBROT
+#endif
+#ifndef POWER
+#define POWER 2
+#endif
+#ifndef M
+#define M 128 // the number of iterations.
+#endif
+
+#include "pixel_order.glsl"
+
+uniform int uWidth;
+uniform int uHeight;
+uniform int uFirstRow;
+// the render farm renders the image in tiles, see render_farm.h. Then we are only a part, at uOrigin,
+// of an image of uImageSize. Otherwise uOrigin is 0, and uImageSize is uWidth x uHeight.
+uniform ivec2 uOrigin;
+uniform ivec2 uImageSize;
+uniform vec2 uCenter;
+uniform float uScale;
+uniform vec2 uJitter; // where inside the pixel we sample this frame.
+uniform vec2 uJuliaC; // the constant of the Julia set.
+uniform int uSampleCount; // number of samples in the history. 0 means start over.
+uniform layout(binding=3, rgba8ui) writeonly uimage2D uFractalTexture;
+uniform layout(binding=4, rgba32f) image2D uHistoryTexture;
+#ifdef ITERATION_IMAGE
+uniform layout(binding=5, r32ui) writeonly uimage2D uIterationTexture;
+#endif
+#ifdef PERSISTENT_THREADS
+uniform int uWorkItemSize; // the number of pixels a thread takes from the queue at a time.
+uniform int uMaxSteps; // a thread takes no more work than it can finish in this many iterations of its loop.
+// the queue: the first pixel that hasn't been handed out yet. Set to 0 before every frame.
+uniform layout(binding=6, r32ui) uimage2D uWorkCounter;
+#endif
+
+// z^POWER. POWER is a constant, so the loop is unrolled.
+vec2 cpow(vec2 z) {
+  vec2 r = z;
+  for (int k = 1; k < POWER; k++)
+    r = vec2(r.x*z.x - r.y*z.y, r.x*z.y + r.y*z.x);
+  return r;
+}
+
+// One iteration of the formula.
+vec2 Step(vec2 z, vec2 c) {
+#if FORMULA == FORMULA_BURNING_SHIP
+  z = abs(z);
+#endif
+#if POWER == 2
+  return vec2(z.x*z.x - z.y*z.y, 2.*z.x*z.y) + c;
+#else
+  return cpow(z) + c;
+#endif
+}
+
+// The z and c that the iteration of pixel i starts from.
+void StartPixel(ivec2 i, out vec2 z, out vec2 c) {
+  vec2 uv = (vec2(i + uOrigin + ivec2(0, uFirstRow)) + uJitter) * vec2(1.0 / float(uImageSize.x), 1.0 / float(uImageSize.y));
+  vec2 p = uCenter +  (uv - 0.5)*uScale;
+#if FORMULA == FORMULA_JULIA
+  z = p; c = uJuliaC;
+#else
+  z = vec2(0.0); c = p;
+#endif
+}
+
+// The number of iterations it takes pixel i to escape, at most M.
+float Iterations(ivec2 i) {
+  vec2 z, c;
+  StartPixel(i, z, c);
+  float n = 0.0;
+  for (int k = 0; k<M; k++)
+  {
+    z = Step(z, c);
+    if (dot(z, z) > 2) break;
+
+    n++;
+  }
+  return n;
+}
+
+// Colors pixel i by the number of iterations n it took to escape, and writes it.
+void StorePixel(ivec2 i, float n) {
+  i.y += uFirstRow;
+  vec3 bla = vec3(0,0,0.0);
+  vec3 blu = vec3(0,0,0.8);
+  vec4 color;
+  if( n >= 0 && n <= M/2-1 ) { color = vec4( mix( vec3(0.2, 0.1, 0.4), blu, n / float(M/2-1) ), 1.0) ;  }
+  if( n >= M/2 && n <= M ) { color = vec4( mix( blu, bla, float(n - M/2 ) / float(M/2) ), 1.0) ;  }
+
+  // Accumulate the sample into the history, which holds the average of all the
+  // previous samples of this pixel. Every invocation only touches its own pixel, 
+  // so we can safely read and write the history in the same pass.
+  // Once we have MAX_HISTORY_SAMPLES samples, this becomes a running average.
+  if (uSampleCount > 0) {
+    vec4 history = imageLoad(uHistoryTexture, i);
+    color = mix(history, color, 1.0 / float(uSampleCount + 1));
+  }
+  imageStore(uHistoryTexture, i, color);
+
+  // Now we write the computed color to the texture.
+  // Note that we must use integer texture coordinates for image load/store. 
+  // Also, texture format is RGBA8UI, so we convert the color channels to  
+  // unsigned byte. So convert from range [0,1] to range [0,255].
+  imageStore(uFractalTexture, i , uvec4(color * 255.0f));
+
+#ifdef ITERATION_IMAGE
+  imageStore(uIterationTexture, i, uvec4(uint(n)));
+#endif
+}
+
+#ifdef MARIANI_SILVER
+//
+// Mariani-Silver subdivision. The Mandelbrot set is connected, and so are the regions inside each
+// band of iteration counts. So if the whole border of a rectangle has the same count, the inside
+// has it too, unless the rectangle holds all of the set, see TileStatus(). In a typical view, large tiles in the
+// middle of the set, and far out in the exterior, never need to be iterated on the inside.
+//
+// The image is covered with tiles of TILE_SIZE pixels, and those are split in four, TILE_LEVELS
+// times. The border passes, one per level, with BORDER_PASS defined, compute the pixels on the
+// borders of the tiles of their level. Below the first level, they only do that for the tiles whose
+// parent tile was mixed: its border had more than one count. After every border pass, a classify
+// pass, with CLASSIFY_PASS defined, writes the count of the uniform tiles to the smallest tiles inside
+// them. And, but on the last level, it appends the mixed tiles to a list, and counts the threads the
+// next border pass needs in a glDrawArraysIndirect() command. So the border passes launch no threads
+// for the tiles that were filled. The final pass then gives every pixel that count, or
+// iterates it, if even its smallest tile was mixed.
+//
+// That only holds for the Mandelbrot and Multibrot sets, so the demo uses it just for those.
+// The tiles at the edges of the image have no border on the outside, so they are always mixed.
+//
+#ifndef TILE_SIZE
+#define TILE_SIZE 128
+#endif
+#ifndef TILE_LEVELS
+#define TILE_LEVELS 4
+#endif
+#define TILE_SKIPPED 0 // its parent tile was uniform, so nothing was computed.
+#define TILE_UNIFORM 1
+#define TILE_MIXED 2
+
+uniform int uLevel; // the level of the border or classify pass, 0 for the largest tiles.
+// the iterations of the pixels on the borders, as the border passes find them.
+uniform layout(binding=1, r32ui) uimage2D uTileIterations;
+// two texels for every tile, the tiles of every level below those of the level above: the max of
+// the iterations on the border of the tile, and the max of ~iterations, which is ~min. Or 0, when
+// nothing was computed. Set to 0 before every frame.
+uniform layout(binding=7, r32ui) uimage2D uTileStates;
+// for every level but the first, two glDrawArraysIndirect() commands of 4 uints, for the border and
+// the classify pass, with the thread count first. Then, for every level but the first, the list of
+// the mixed tiles of the level above, as x | y << 16. Must match MarianiSilverPasses() in gl_renderer.cpp.
+uniform layout(binding=0, r32ui) uimageBuffer uTileLists;
+// for every tile of the last level: the count + 1 of the largest uniform tile around it, or 0 if
+// there is none. Set to 0 before every frame.
+uniform layout(binding=2, r32ui) uimage2D uTileFills;
+
+int TileSize(int level) {
+  return TILE_SIZE >> level;
+}
+
+ivec2 TileCount(int level) {
+  return (ivec2(uWidth, uHeight) + TileSize(level) - 1) / TileSize(level);
+}
+
+// The first of the two texels of a tile in uTileStates. Must match GetTileStateHeight() in gl_renderer.cpp.
+ivec2 TileStateCoord(int level, ivec2 tile) {
+  int row = 0;
+  for (int k = 0; k < level; k++) {
+    row += TileCount(k).y;
+  }
+  return ivec2(2 * tile.x, row + tile.y);
+}
+
+// TILE_SKIPPED, TILE_UNIFORM, with the count in n, or TILE_MIXED.
+int TileStatus(int level, ivec2 tile, out uint n) {
+  ivec2 s = TileStateCoord(level, tile);
+  n = imageLoad(uTileStates, s).x;
+  uint notMin = imageLoad(uTileStates, s + ivec2(1, 0)).x;
+  if (notMin == 0u) {
+    return TILE_SKIPPED;
+  }
+  ivec2 end = (tile + 1) * TileSize(level);
+  bool inside = end.x <= uWidth && end.y <= uHeight;
+  // when the view is zoomed out far enough, a tile can hold all of the set, and then its border says
+  // nothing about its inside. The set always holds c = 0, so a tile that doesn't can't hold all of it.
+  vec2 z, first, last;
+  StartPixel(tile * TileSize(level), z, first);
+  StartPixel(min(end, ivec2(uWidth, uHeight)) - 1, z, last);
+  bool holdsOrigin = all(lessThanEqual(min(first, last), vec2(0.0))) && all(greaterThanEqual(max(first, last), vec2(0.0)));
+  return n == ~notMin && inside && !holdsOrigin ? TILE_UNIFORM : TILE_MIXED;
+}
+
+int BorderCommand(int level) {
+  return 8 * (level - 1);
+}
+
+int ClassifyCommand(int level) {
+  return 8 * (level - 1) + 4;
+}
+
+int TileListStart(int level) {
+  int start = 8 * (TILE_LEVELS - 1);
+  for (int k = 0; k < level - 1; k++) {
+    start += TileCount(k).x * TileCount(k).y;
+  }
+  return start;
+}
+
+// The tile of thread 'id' of a pass on 'level' that launches 'threadsPerTile' threads per tile. Below
+// the first level, there are four child tiles for every mixed tile in the list. Outside the tile count
+// for the children of tiles at the edge.
+ivec2 TileFromThread(int level, int id, int threadsPerTile) {
+  int index = id / threadsPerTile;
+  if (level == 0) {
+    return ivec2(index % TileCount(0).x, index / TileCount(0).x);
+  }
+  uint parent = imageLoad(uTileLists, TileListStart(level) + index / 4).x;
+  int child = index % 4;
+  return 2 * ivec2(parent & 0xFFFFu, parent >> 16) + ivec2(child & 1, child >> 1);
+}
+
+bool OnTileBorder(ivec2 i, int size) {
+  ivec2 p = i % size;
+  return any(equal(p, ivec2(0))) || any(equal(p, ivec2(size - 1)));
+}
+#endif
+
+void main() {
+#if defined(MARIANI_SILVER) && defined(BORDER_PASS)
+  // 4 * size threads per tile, one for every pixel on each of its edges. The corners are computed
+  // twice, which doesn't matter, since nothing is accumulated here.
+  int size = TileSize(uLevel);
+  ivec2 tile = TileFromThread(uLevel, gl_VertexID, 4 * size);
+  if (any(greaterThanEqual(tile, TileCount(uLevel)))) {
+    return;
+  }
+  int edge = (gl_VertexID % (4 * size)) / size;
+  int t = gl_VertexID % size;
+  ivec2 offset = edge == 0 ? ivec2(t, 0) : edge == 1 ? ivec2(t, size - 1) : edge == 2 ? ivec2(0, t) : ivec2(size - 1, t);
+  ivec2 i = tile * size + offset;
+  if (i.x >= uWidth || i.y >= uHeight) {
+    return;
+  }
+  // a pixel on the border of the parent tile was computed by the pass before.
+  uint n;
+  if (uLevel > 0 && OnTileBorder(i, 2 * size)) {
+    n = imageLoad(uTileIterations, i).x;
+  } else {
+    n = uint(Iterations(i));
+    imageStore(uTileIterations, i, uvec4(n));
+  }
+  ivec2 s = TileStateCoord(uLevel, tile);
+  imageAtomicMax(uTileStates, s, n);
+  imageAtomicMax(uTileStates, s + ivec2(1, 0), ~n);
+#elif defined(MARIANI_SILVER) && defined(CLASSIFY_PASS)
+  // one thread per tile.
+  ivec2 tile = TileFromThread(uLevel, gl_VertexID, 1);
+  if (any(greaterThanEqual(tile, TileCount(uLevel)))) {
+    return;
+  }
+  uint n;
+  int status = TileStatus(uLevel, tile, n);
+  if (status == TILE_UNIFORM) {
+    int smallest = 1 << (TILE_LEVELS - 1 - uLevel); // smallest tiles per side.
+    for (int y = 0; y < smallest; y++) {
+      for (int x = 0; x < smallest; x++) {
+        imageStore(uTileFills, tile * smallest + ivec2(x, y), uvec4(n + 1u));
+      }
+    }
+  }
+  if (status != TILE_MIXED || uLevel == TILE_LEVELS - 1) {
+    return;
+  }
+  int threadsPerParent = 4 * 4 * TileSize(uLevel + 1);
+  int slot = int(imageAtomicAdd(uTileLists, BorderCommand(uLevel + 1), uint(threadsPerParent))) / threadsPerParent;
+  imageAtomicAdd(uTileLists, ClassifyCommand(uLevel + 1), 4u);
+  imageStore(uTileLists, TileListStart(uLevel + 1) + slot, uvec4(uint(tile.x) | (uint(tile.y) << 16)));
+#elif defined(MARIANI_SILVER)
+  // the final pass: one thread per pixel, like below.
+  ivec2 i = PixelFromId(gl_VertexID, uWidth);
+  if (i.x >= uWidth || i.y >= uHeight) {
+    return; // the padding, see pixel_order.glsl.
+  }
+  uint fill = imageLoad(uTileFills, i / TileSize(TILE_LEVELS - 1)).x;
+  float n;
+  if (fill != 0u) {
+    n = float(fill - 1u);
+  } else if (OnTileBorder(i, TileSize(TILE_LEVELS - 1))) {
+    n = float(imageLoad(uTileIterations, i).x);
+  } else {
+    n = Iterations(i);
+  }
+  StorePixel(i, n);
+#elif !defined(PERSISTENT_THREADS)
+  // first vertex will have id 0, the second 1, and so on. And the final one has id N-1,
+  // if the shader was launched with 
+  // glDrawArrays(GL_POINTS, 0, N);
+
+  // And we convert this vertex id to 2D. Row by row, unless PIXEL_ORDER says otherwise:
+  ivec2 i = PixelFromId(gl_VertexID, uWidth);
+  if (i.x >= uWidth || i.y >= uHeight) {
+    return; // the padding, see pixel_order.glsl.
+  }
+
+  // the fractal rendering code is in Iterations(), above.
+  StorePixel(i, Iterations(i));
+#else
+  // Persistent threads. Some pixels escape after a few iterations, and others take all M,
+  // but the lanes of a SIMD group run in lockstep. With one thread per pixel, the lanes whose
+  // pixels escaped early idle until the slowest pixel of the group is done.
+  //
+  // So instead, every thread takes uWorkItemSize pixels at a time from the queue, and moves on
+  // to its next pixel as soon as the current one escapes, without waiting for the others. The
+  // lanes only idle at the very end of the frame, when the queue is empty. We launch just
+  // enough threads to fill the GPU, and they keep pulling work until the frame is done.
+  //
+  // Some drivers stop a loop that runs for too long, so that a shader can't hang the machine,
+  // llvmpipe after 65535 iterations. So a thread only takes another work item when it can
+  // still finish it within uMaxSteps iterations. The CPU launches enough threads for all the
+  // items, even if every thread gets as few as that allows.
+  // The queue hands out thread ids, in the order of PIXEL_ORDER, including the padding.
+  int pixelCount = PixelThreadCount(uWidth, uHeight);
+  int pixel = int(imageAtomicAdd(uWorkCounter, ivec2(0), uint(uWorkItemSize)));
+  int itemEnd = pixel + uWorkItemSize;
+
+  ivec2 i = PixelFromId(pixel, uWidth);
+  vec2 z, c;
+  StartPixel(i, z, c);
+  float n = 0.0;
+  int steps = 0;
+  while (pixel < pixelCount) {
+    // one iteration of the loop above, and when it would have ended, the next pixel.
+    z = Step(z, c);
+    steps++;
+    bool escaped = dot(z, z) > 2;
+    if (!escaped) {
+      n++;
+    }
+    if (escaped || n >= float(M)) {
+      if (i.x < uWidth && i.y < uHeight) {
+        StorePixel(i, n);
+      }
+      pixel++;
+      if (pixel == itemEnd) {
+        if (steps + uWorkItemSize * M > uMaxSteps) {
+          break;
+        }
+        pixel = int(imageAtomicAdd(uWorkCounter, ivec2(0), uint(uWorkItemSize)));
+        itemEnd = pixel + uWorkItemSize;
+      }
+      i = PixelFromId(pixel, uWidth);
+      StartPixel(i, z, c);
+      n = 0.0;
+    }
+  }
+#endif
+}
@@ -0,0 +1,126 @@
+#version 420
+
+// The kernel of image_access_bench. Like the passes of the demo, it launches one thread per
+// point with glDrawArrays(GL_POINTS), and every thread touches one element of the data.
+// The benchmark inserts these after the #version line:
+//
+// METHOD, how the data is accessed:
+#define METHOD_IMAGE_RGBA8UI 0 // imageLoad()/imageStore(), on an RGBA8UI image, like the demo.
+#define METHOD_IMAGE_RGBA8 1   // the same, on an RGBA8 image, which converts to and from floats.
+#define METHOD_IMAGE_R32UI 2   // the same, on an R32UI image.
+#define METHOD_TEXEL_FETCH 3   // texelFetch(), on an RGBA8UI texture. Can only read.
+#define METHOD_SSBO 4          // an array of uint, in a shader storage buffer.
+// PATTERN, the order in which the threads visit the elements:
+#define PATTERN_LINEAR 0 // row by row.
+#define PATTERN_TILED 1  // 8x8 tiles, row by row, and row by row inside a tile.
+#define PATTERN_RANDOM 2 // a pseudo-random permutation.
+// OP, what a thread does with its element:
+#define OP_READ 0
+#define OP_WRITE 1
+#define OP_READ_MODIFY_WRITE 2
+#define OP_LATENCY 3 // follows a chain of uChainLength elements, where every element holds the next.
+
+#if METHOD == METHOD_SSBO
+#extension GL_ARB_shader_storage_buffer_object : require
+#endif
+
+uniform int uLog2Width; // the data is a 2D image of (1 << uLog2Width) x uHeight elements.
+uniform int uHeight;
+uniform int uChainLength;
+uniform int uThreadCount;
+uniform int uProbe; // the thread whose read goes to uSink, so that the benchmark can check it.
+
+#if METHOD == METHOD_IMAGE_RGBA8UI
+layout(binding = 0, rgba8ui) uniform uimage2D uData;
+#elif METHOD == METHOD_IMAGE_RGBA8
+layout(binding = 0, rgba8) uniform image2D uData;
+#elif METHOD == METHOD_IMAGE_R32UI
+layout(binding = 0, r32ui) uniform uimage2D uData;
+#elif METHOD == METHOD_TEXEL_FETCH
+layout(binding = 0) uniform usampler2D uData;
+#else
+layout(std430, binding = 0) buffer Data {
+  uint uData[];
+};
+#endif
+// the reads have to go somewhere, or the compiler removes them. So they are compared with a
+// value that never occurs, and written here when it does. And by thread uProbe, always.
+layout(binding = 1, r32ui) uniform writeonly uimage2D uSink;
+
+ivec2 Coord(int e) {
+  return ivec2(e & ((1 << uLog2Width) - 1), e >> uLog2Width);
+}
+
+// Every element is a uint. In the 8 bit formats, it is spread over the four channels, lowest byte first.
+uint Load(int e) {
+#if METHOD == METHOD_IMAGE_RGBA8UI
+  uvec4 v = imageLoad(uData, Coord(e));
+#elif METHOD == METHOD_IMAGE_RGBA8
+  uvec4 v = uvec4(imageLoad(uData, Coord(e)) * 255.0 + 0.5);
+#elif METHOD == METHOD_TEXEL_FETCH
+  uvec4 v = texelFetch(uData, Coord(e), 0);
+#endif
+#if METHOD == METHOD_IMAGE_R32UI
+  return imageLoad(uData, Coord(e)).x;
+#elif METHOD == METHOD_SSBO
+  return uData[e];
+#else
+  return v.x | (v.y << 8) | (v.z << 16) | (v.w << 24);
+#endif
+}
+
+#if METHOD != METHOD_TEXEL_FETCH
+void Store(int e, uint x) {
+  uvec4 v = uvec4(x & 0xFFu, (x >> 8) & 0xFFu, (x >> 16) & 0xFFu, x >> 24);
+#if METHOD == METHOD_IMAGE_RGBA8UI
+  imageStore(uData, Coord(e), v);
+#elif METHOD == METHOD_IMAGE_RGBA8
+  imageStore(uData, Coord(e), vec4(v) / 255.0);
+#elif METHOD == METHOD_IMAGE_R32UI
+  imageStore(uData, Coord(e), uvec4(x));
+#else
+  uData[e] = x;
+#endif
+}
+#endif
+
+// The k-th element in the order of PATTERN. Must match Element() in image_access_bench.cpp.
+int Element(int k) {
+#if PATTERN == PATTERN_LINEAR
+  return k;
+#elif PATTERN == PATTERN_TILED
+  int tilesPerRow = (1 << uLog2Width) / 8;
+  int tile = k / 64;
+  int inside = k % 64;
+  ivec2 p = ivec2((tile % tilesPerRow) * 8 + inside % 8, (tile / tilesPerRow) * 8 + inside / 8);
+  return (p.y << uLog2Width) + p.x;
+#else
+  // multiplying by an odd number is a permutation modulo a power of two.
+  return int((uint(k) * 2654435761u) & uint((1 << uLog2Width) * uHeight - 1));
+#endif
+}
+
+void main() {
+  int id = gl_VertexID;
+
+#if OP == OP_READ
+  uint v = Load(Element(id));
+  if (v == 0xFFFFFFFFu || id == uProbe) {
+    imageStore(uSink, ivec2(0), uvec4(v));
+  }
+#elif OP == OP_WRITE
+  Store(Element(id), uint(id));
+#elif OP == OP_READ_MODIFY_WRITE
+  int e = Element(id);
+  Store(e, Load(e) + 1u);
+#else
+  // the threads start evenly spread over the chain, and every load needs the result of the one before.
+  int e = Element(id * (((1 << uLog2Width) * uHeight) / uThreadCount));
+  for (int i = 0; i < uChainLength; i++) {
+    e = int(Load(e));
+  }
+  if (e == -1) {
+    imageStore(uSink, ivec2(0), uvec4(e));
+  }
+#endif
+}
@@ -0,0 +1,46 @@
+#version 420
+
+//
+// Reduces the iteration counts of the fractal pass to statistics per group of pixels: the mean,
+// the max and the min number of iterations in the group. One thread per group, launched with
+// glDrawArrays(GL_POINTS, 0, N) like the other passes.
+//
+// The size of the group is set as a constant, see iteration_stats.h: 8x8 tiles, and runs of 32
+// pixels in a row, which is roughly how the fractal pass is split into SIMD groups now.
+//
+
+#ifndef GROUP_WIDTH
+#define GROUP_WIDTH 8
+#endif
+#ifndef GROUP_HEIGHT
+#define GROUP_HEIGHT 8
+#endif
+
+uniform int uWidth;
+uniform int uHeight;
+uniform layout(binding=0, r32ui) readonly uimage2D uIterations;
+// mean, max, min, and the number of pixels in the group, which is smaller at the edges.
+uniform layout(binding=2, rgba32f) writeonly image2D uStats;
+
+void main() {
+  int groupsPerRow = (uWidth + GROUP_WIDTH - 1) / GROUP_WIDTH;
+  ivec2 g = ivec2(gl_VertexID % groupsPerRow, gl_VertexID / groupsPerRow);
+  ivec2 begin = g * ivec2(GROUP_WIDTH, GROUP_HEIGHT);
+  ivec2 end = min(begin + ivec2(GROUP_WIDTH, GROUP_HEIGHT), ivec2(uWidth, uHeight));
+
+  // at most MAX_STATS_ITERATIONS, 2^26, times 64 pixels, so the sum fits in a uint. The mean is
+  // only rounded once, when it is converted to a float at the end.
+  uint sum = 0u;
+  uint maxN = 0u;
+  uint minN = 0xFFFFFFFFu;
+  for (int y = begin.y; y < end.y; y++) {
+    for (int x = begin.x; x < end.x; x++) {
+      uint n = imageLoad(uIterations, ivec2(x, y)).x;
+      sum += n;
+      maxN = max(maxN, n);
+      minN = min(minN, n);
+    }
+  }
+  float count = float((end.x - begin.x) * (end.y - begin.y));
+  imageStore(uStats, g, vec4(float(sum) / count, float(maxN), float(minN), count));
+}
@@ -0,0 +1,42 @@
+#version 420
+
+//
+// The Mandelbrot set is symmetric about the real axis: the orbit of the conjugate of c is the
+// conjugate of the orbit of c, so it escapes after just as many iterations. When the view straddles
+// the axis, and the rows of the image line up with their mirror images, the fractal pass only
+// computes the rows on one side, and this pass copies them to the other: row y is row uRowSum - y.
+//
+// It copies everything the fractal pass writes for a pixel: the color, the history, and, with
+// ITERATION_IMAGE defined, the iterations. One thread for every PIXELS_PER_THREAD pixels of the rows
+// from uFirstRow on. The copy itself is cheap, so one thread per pixel would mostly cost the launch.
+//
+
+#define PIXELS_PER_THREAD 8 // must match MIRROR_PIXELS_PER_THREAD in gl_renderer.cpp.
+
+uniform int uWidth;
+uniform int uFirstRow;
+uniform int uRowSum;
+uniform layout(binding=3, rgba8ui) uimage2D uFractalTexture;
+uniform layout(binding=4, rgba32f) image2D uHistoryTexture;
+#ifdef ITERATION_IMAGE
+uniform layout(binding=5, r32ui) uimage2D uIterationTexture;
+#endif
+
+void main() {
+  int runsPerRow = (uWidth + PIXELS_PER_THREAD - 1) / PIXELS_PER_THREAD;
+  int y = uFirstRow + gl_VertexID / runsPerRow;
+  int x0 = (gl_VertexID % runsPerRow) * PIXELS_PER_THREAD;
+  for (int k = 0; k < PIXELS_PER_THREAD; k++) {
+    ivec2 i = ivec2(x0 + k, y);
+    if (i.x >= uWidth) {
+      break;
+    }
+    ivec2 mirror = ivec2(i.x, uRowSum - y);
+
+    imageStore(uFractalTexture, i, imageLoad(uFractalTexture, mirror));
+    imageStore(uHistoryTexture, i, imageLoad(uHistoryTexture, mirror));
+#ifdef ITERATION_IMAGE
+    imageStore(uIterationTexture, i, imageLoad(uIterationTexture, mirror));
+#endif
+  }
+}
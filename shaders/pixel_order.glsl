@@ -0,0 +1,90 @@
+//
+// Which pixel a thread renders, in the shaders that launch one thread per pixel with
+// glDrawArrays(GL_POINTS, 0, N). Included by those shaders.
+//
+// The threads of a SIMD group, and the groups that run at the same time, get consecutive ids.
+// Row by row, those are the pixels of one or two rows, so a filter that reads the pixels around
+// its own shares few of the texels it reads with its neighbours. The other orders visit the image
+// in small square blocks, so consecutive ids are also close in 2D.
+//
+// PIXEL_ORDER is set by the demo, see pixel_order.h:
+#define PIXEL_ORDER_ROWS 0    // row by row, the original order.
+#define PIXEL_ORDER_TILES 1   // 8x8 tiles, row by row, and row by row inside a tile.
+#define PIXEL_ORDER_MORTON 2  // 32x32 blocks, row by row, and along a Z-order curve inside a block.
+#define PIXEL_ORDER_HILBERT 3 // 32x32 blocks, row by row, and along a Hilbert curve inside a block.
+
+#ifndef PIXEL_ORDER
+#define PIXEL_ORDER PIXEL_ORDER_ROWS
+#endif
+
+#if PIXEL_ORDER == PIXEL_ORDER_TILES
+#define PIXEL_BLOCK_BITS 3
+#else
+#define PIXEL_BLOCK_BITS 5
+#endif
+#define PIXEL_BLOCK_SIZE (1 << PIXEL_BLOCK_BITS)
+
+// The number of threads to launch for a width x height image. Except row by row, the image is
+// padded to whole blocks, and the threads of the padding must do nothing. Must match
+// GetPixelThreadCount() in pixel_order.cpp.
+int PixelThreadCount(int width, int height) {
+#if PIXEL_ORDER == PIXEL_ORDER_ROWS
+  return width * height;
+#else
+  int blocksX = (width + PIXEL_BLOCK_SIZE - 1) / PIXEL_BLOCK_SIZE;
+  int blocksY = (height + PIXEL_BLOCK_SIZE - 1) / PIXEL_BLOCK_SIZE;
+  return blocksX * blocksY * PIXEL_BLOCK_SIZE * PIXEL_BLOCK_SIZE;
+#endif
+}
+
+// Every other bit of v, starting with the lowest, packed together.
+int CompactBits(int v) {
+  v &= 0x55555555;
+  v = (v | (v >> 1)) & 0x33333333;
+  v = (v | (v >> 2)) & 0x0F0F0F0F;
+  v = (v | (v >> 4)) & 0x00FF00FF;
+  return (v | (v >> 8)) & 0x0000FFFF;
+}
+
+// The d-th pixel along a Hilbert curve through a PIXEL_BLOCK_SIZE x PIXEL_BLOCK_SIZE block.
+// The size is a constant, so the loop is unrolled. That matters in the persistent fractal pass, which
+// calls this in its main loop: llvmpipe counts the iterations of every loop against the same limit,
+// see fractal.vert, and only unrolls loops with a counter that goes up by a constant.
+ivec2 HilbertToXY(int d) {
+  ivec2 p = ivec2(0);
+  for (int level = 0; level < PIXEL_BLOCK_BITS; level++) {
+    int s = 1 << level;
+    int rx = 1 & (d / 2);
+    int ry = 1 & (d ^ rx);
+    // rotate the quadrant, so that the curve connects to the one before.
+    if (ry == 0) {
+      if (rx == 1) {
+        p = s - 1 - p;
+      }
+      p = p.yx;
+    }
+    p += s * ivec2(rx, ry);
+    d /= 4;
+  }
+  return p;
+}
+
+// The pixel of thread 'id', in an image that is 'width' wide. Outside the image for the threads
+// of the padding.
+ivec2 PixelFromId(int id, int width) {
+#if PIXEL_ORDER == PIXEL_ORDER_ROWS
+  return ivec2(id % width, id / width);
+#else
+  int blocksX = (width + PIXEL_BLOCK_SIZE - 1) / PIXEL_BLOCK_SIZE;
+  int block = id / (PIXEL_BLOCK_SIZE * PIXEL_BLOCK_SIZE);
+  int d = id % (PIXEL_BLOCK_SIZE * PIXEL_BLOCK_SIZE);
+#if PIXEL_ORDER == PIXEL_ORDER_TILES
+  ivec2 inside = ivec2(d % PIXEL_BLOCK_SIZE, d / PIXEL_BLOCK_SIZE);
+#elif PIXEL_ORDER == PIXEL_ORDER_MORTON
+  ivec2 inside = ivec2(CompactBits(d), CompactBits(d >> 1));
+#else
+  ivec2 inside = HilbertToXY(d);
+#endif
+  return ivec2(block % blocksX, block / blocksX) * PIXEL_BLOCK_SIZE + inside;
+#endif
+}
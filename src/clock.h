@@ -0,0 +1,10 @@
+#pragma once
+
+#include <chrono>
+
+// Seconds since the first call, like glfwGetTime(), so that they still fit in a float. On a clock
+// that never jumps, so that the time between two calls is never negative.
+inline double GetSeconds() {
+    static const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
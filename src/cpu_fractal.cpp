@@ -0,0 +1,401 @@
+#include "cpu_fractal.h"
+#include "fixed_point.h"
+#include "parallel_for.h"
+#include "shader_math.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+// z^POWER, by repeated multiplication. POWER is a constant, so the loop is unrolled.
+template <int POWER>
+static inline void ComplexPower(float x, float y, float* rx, float* ry) {
+    float ax = x, ay = y;
+    for (int k = 1; k < POWER; k++) {
+        float t = ax * x - ay * y;
+        ay = ax * y + ay * x;
+        ax = t;
+    }
+    *rx = ax;
+    *ry = ay;
+}
+
+// The number of iterations before z escapes, like 'n' in the shader.
+template <FractalFormula FORMULA, int POWER>
+static inline int Iterate(float px, float py, int iterations) {
+    float zx, zy, cx, cy;
+    if (FORMULA == FORMULA_JULIA) {
+        zx = px;
+        zy = py;
+        cx = JULIA_C_X;
+        cy = JULIA_C_Y;
+    } else {
+        zx = 0.0f;
+        zy = 0.0f;
+        cx = px;
+        cy = py;
+    }
+
+    int n = 0;
+    for (int i = 0; i < iterations; i++) {
+        if (FORMULA == FORMULA_BURNING_SHIP) {
+            zx = fabsf(zx);
+            zy = fabsf(zy);
+        }
+        ComplexPower<POWER>(zx, zy, &zx, &zy);
+        zx += cx;
+        zy += cy;
+        if (zx * zx + zy * zy > 2.0f) break;
+
+        n++;
+    }
+    return n;
+}
+
+// the colors of fractal.vert, RGBA in [0,1].
+static void FractalColor(int n, int m, float* color) {
+    const float bla[3] = { 0.0f, 0.0f, 0.0f };
+    const float blu[3] = { 0.0f, 0.0f, 0.8f };
+    const float purple[3] = { 0.2f, 0.1f, 0.4f };
+    for (int c = 0; c < 3; c++) {
+        if (n <= m / 2 - 1) {
+            color[c] = Mix(purple[c], blu[c], (float)n / (float)(m / 2 - 1));
+        } else {
+            color[c] = Mix(blu[c], bla[c], (float)(n - m / 2) / (float)(m / 2));
+        }
+    }
+    color[3] = 1.0f;
+}
+
+static void Colorize(int n, int m, unsigned char* out) {
+    float color[4];
+    FractalColor(n, m, color);
+    for (int c = 0; c < 4; c++) {
+        out[c] = (unsigned char)(color[c] * 255.0f);
+    }
+}
+
+template <FractalFormula FORMULA, int POWER>
+static void RenderRows(const FractalVariant& variant, const CpuFractalView& view, CpuImage* image, int y0, int y1) {
+    float invWidth = 1.0f / (float)image->width;
+    float invHeight = 1.0f / (float)image->height;
+    for (int y = y0; y < y1; y++) {
+        for (int x = 0; x < image->width; x++) {
+            float u = ((float)x + view.jitterX) * invWidth;
+            float v = ((float)y + view.jitterY) * invHeight;
+            float px = view.centerX + (u - 0.5f) * view.scale;
+            float py = view.centerY + (v - 0.5f) * view.scale;
+            Colorize(Iterate<FORMULA, POWER>(px, py, variant.iterations), variant.iterations, image->At(x, y));
+        }
+    }
+}
+
+typedef void (*RenderRowsFunc)(const FractalVariant&, const CpuFractalView&, CpuImage*, int, int);
+
+template <FractalFormula FORMULA>
+static RenderRowsFunc GetRenderRows(int power) {
+    switch (power) {
+    case 2: return RenderRows<FORMULA, 2>;
+    case 3: return RenderRows<FORMULA, 3>;
+    case 4: return RenderRows<FORMULA, 4>;
+    case 5: return RenderRows<FORMULA, 5>;
+    case 6: return RenderRows<FORMULA, 6>;
+    case 7: return RenderRows<FORMULA, 7>;
+    case 8: return RenderRows<FORMULA, 8>;
+    }
+    printf("Power %d is not supported, it must be between %d and %d\n", power, MIN_FRACTAL_POWER, MAX_FRACTAL_POWER);
+    exit(1);
+}
+
+static RenderRowsFunc GetRenderRows(const FractalVariant& variant) {
+    switch (variant.formula) {
+    case FORMULA_JULIA: return GetRenderRows<FORMULA_JULIA>(variant.power);
+    case FORMULA_BURNING_SHIP: return GetRenderRows<FORMULA_BURNING_SHIP>(variant.power);
+    default: return GetRenderRows<FORMULA_MANDELBROT>(variant.power);
+    }
+}
+
+void RenderFractalCpu(const FractalVariant& variant, const CpuFractalView& view, CpuImage* image) {
+    RenderRowsFunc renderRows = GetRenderRows(variant);
+
+    int threadCount = std::max(1, (int)std::thread::hardware_concurrency());
+    std::vector<std::thread> threads;
+    for (int t = 0; t < threadCount; t++) {
+        int y0 = image->height * t / threadCount;
+        int y1 = image->height * (t + 1) / threadCount;
+        threads.push_back(std::thread(renderRows, std::cref(variant), std::cref(view), image, y0, y1));
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+}
+
+//
+// The fractal pass of the CPU backend.
+//
+
+// StorePixel() of fractal.vert, for every pixel, with the history.
+template <FractalFormula FORMULA, int POWER>
+static void FractalPassKernels(const FractalVariant& variant, const CpuFractalView& view, int sampleCount,
+    Image2D<FormatRgba8ui>* fractal, Image2D<FormatRgba32f>* history) {
+    int width = fractal->GetWidth();
+    float invWidth = 1.0f / (float)width;
+    float invHeight = 1.0f / (float)fractal->GetHeight();
+    float weight = 1.0f / (float)(sampleCount + 1);
+    ParallelFor(width * fractal->GetHeight(), [&](int id) {
+        int x = id % width;
+        int y = id / width;
+        float u = ((float)x + view.jitterX) * invWidth;
+        float v = ((float)y + view.jitterY) * invHeight;
+        float px = view.centerX + (u - 0.5f) * view.scale;
+        float py = view.centerY + (v - 0.5f) * view.scale;
+        int n = Iterate<FORMULA, POWER>(px, py, variant.iterations);
+
+        Vec4 color;
+        FractalColor(n, variant.iterations, color.v);
+        if (sampleCount > 0) {
+            Vec4 h = history->Load(x, y);
+            for (int c = 0; c < 4; c++) {
+                color.v[c] = Mix(h.v[c], color.v[c], weight);
+            }
+        }
+        history->Store(x, y, color);
+
+        UVec4 out;
+        for (int c = 0; c < 4; c++) {
+            out.v[c] = (uint32_t)(color.v[c] * 255.0f);
+        }
+        fractal->Store(x, y, out);
+    });
+}
+
+typedef void (*FractalPassFunc)(const FractalVariant&, const CpuFractalView&, int, Image2D<FormatRgba8ui>*, Image2D<FormatRgba32f>*);
+
+template <FractalFormula FORMULA>
+static FractalPassFunc GetFractalPass(int power) {
+    switch (power) {
+    case 2: return FractalPassKernels<FORMULA, 2>;
+    case 3: return FractalPassKernels<FORMULA, 3>;
+    case 4: return FractalPassKernels<FORMULA, 4>;
+    case 5: return FractalPassKernels<FORMULA, 5>;
+    case 6: return FractalPassKernels<FORMULA, 6>;
+    case 7: return FractalPassKernels<FORMULA, 7>;
+    case 8: return FractalPassKernels<FORMULA, 8>;
+    }
+    printf("Power %d is not supported, it must be between %d and %d\n", power, MIN_FRACTAL_POWER, MAX_FRACTAL_POWER);
+    exit(1);
+}
+
+void FractalPassCpu(const FractalVariant& variant, const CpuFractalView& view, int sampleCount,
+    Image2D<FormatRgba8ui>* fractal, Image2D<FormatRgba32f>* history) {
+    FractalPassFunc pass;
+    switch (variant.formula) {
+    case FORMULA_JULIA: pass = GetFractalPass<FORMULA_JULIA>(variant.power); break;
+    case FORMULA_BURNING_SHIP: pass = GetFractalPass<FORMULA_BURNING_SHIP>(variant.power); break;
+    default: pass = GetFractalPass<FORMULA_MANDELBROT>(variant.power); break;
+    }
+    pass(variant, view, sampleCount, fractal, history);
+}
+
+//
+// The fixed-point renderer, for deep zooms.
+//
+
+// The number of pixels a thread iterates at once. A step of the escape time loop is a chain of
+// multiplications that wait for each other, but the steps of different pixels are independent.
+const int FIXED_LANES = 4;
+// how far from 0 the view may reach, so that the escape time loop stays within the FIXED_INTEGER_BITS.
+const double FIXED_VIEW_LIMIT = 4.0;
+
+// z^POWER, like ComplexPower(), in fixed point.
+template <int POWER, int LIMBS>
+static inline void ComplexPowerFixed(const Fixed<LIMBS>& x, const Fixed<LIMBS>& y, Fixed<LIMBS>* rx, Fixed<LIMBS>* ry) {
+    Fixed<LIMBS> ax = x, ay = y;
+    for (int k = 1; k < POWER; k++) {
+        Fixed<LIMBS> t = FixedSubtract(FixedMultiply(ax, x), FixedMultiply(ay, y));
+        ay = FixedAdd(FixedMultiply(ax, y), FixedMultiply(ay, x));
+        ax = t;
+    }
+    *rx = ax;
+    *ry = ay;
+}
+
+// Either part of z beyond 2. Then |z|^2 > 2, so z has escaped, and we must not square it, since that
+// may not fit in the FIXED_INTEGER_BITS.
+template <int LIMBS>
+static inline bool OutsideTwo(const Fixed<LIMBS>& x, const Fixed<LIMBS>& y, const Fixed<LIMBS>& two) {
+    return FixedGreater(FixedAbs(x), two) || FixedGreater(FixedAbs(y), two);
+}
+
+// The iterations of 'laneCount' pixels, like Iterate(), one step of each in turn.
+//
+// Within the view limit, the Mandelbrot formula starts from z = 0, and z stays within |z|^2 <= 2
+// until it escapes, so z^8 + c stays far within the FIXED_INTEGER_BITS. The Julia formula starts from
+// z = p, which may be further out. But with the small constant of the demo, a z with a part beyond 2
+// escapes in its first step, so those pixels take 0 iterations, just like in Iterate().
+template <FractalFormula FORMULA, int POWER, int LIMBS>
+static void IterateFixed(const Fixed<LIMBS>* px, const Fixed<LIMBS>* py, int laneCount, int iterations, int* n) {
+    const Fixed<LIMBS> two = FixedFromDouble<LIMBS>(2.0);
+    Fixed<LIMBS> zx[FIXED_LANES], zy[FIXED_LANES], cx[FIXED_LANES], cy[FIXED_LANES];
+    // the squares of z, for the next step of power 2, from the escape test of the last one.
+    Fixed<LIMBS> zxx[FIXED_LANES], zyy[FIXED_LANES];
+    bool active[FIXED_LANES];
+    int activeCount = 0;
+    for (int l = 0; l < FIXED_LANES; l++) {
+        n[l] = 0;
+        active[l] = l < laneCount;
+        if (!active[l]) {
+            continue;
+        }
+        if (FORMULA == FORMULA_JULIA) {
+            zx[l] = px[l];
+            zy[l] = py[l];
+            cx[l] = FixedFromDouble<LIMBS>(JULIA_C_X);
+            cy[l] = FixedFromDouble<LIMBS>(JULIA_C_Y);
+            active[l] = !OutsideTwo(zx[l], zy[l], two);
+        } else {
+            zx[l] = FixedFromDouble<LIMBS>(0.0);
+            zy[l] = zx[l];
+            cx[l] = px[l];
+            cy[l] = py[l];
+        }
+        if (active[l]) {
+            zxx[l] = FixedMultiply(zx[l], zx[l]);
+            zyy[l] = FixedMultiply(zy[l], zy[l]);
+            activeCount++;
+        }
+    }
+
+    for (int i = 0; i < iterations && activeCount > 0; i++) {
+        for (int l = 0; l < FIXED_LANES; l++) {
+            if (!active[l]) {
+                continue;
+            }
+            Fixed<LIMBS> x = zx[l], y = zy[l];
+            if (FORMULA == FORMULA_BURNING_SHIP) {
+                x = FixedAbs(x);
+                y = FixedAbs(y);
+            }
+            if (POWER == 2) {
+                // x^2 - y^2, and 2xy, with the squares we already have.
+                Fixed<LIMBS> xy = FixedMultiply(x, y);
+                x = FixedSubtract(zxx[l], zyy[l]);
+                y = FixedAdd(xy, xy);
+            } else {
+                ComplexPowerFixed<POWER>(x, y, &x, &y);
+            }
+            x = FixedAdd(x, cx[l]);
+            y = FixedAdd(y, cy[l]);
+            zx[l] = x;
+            zy[l] = y;
+
+            bool escaped = OutsideTwo(x, y, two);
+            if (!escaped) {
+                zxx[l] = FixedMultiply(x, x);
+                zyy[l] = FixedMultiply(y, y);
+                escaped = FixedGreater(FixedAdd(zxx[l], zyy[l]), two);
+            }
+            if (escaped) {
+                active[l] = false;
+                activeCount--;
+            } else {
+                n[l]++;
+            }
+        }
+    }
+}
+
+// Rows firstRow, firstRow + rowStep, and so on. The cost of a row of a deep zoom varies a lot, so the
+// threads take every threadCount-th row, instead of a block of rows each.
+template <FractalFormula FORMULA, int POWER, int LIMBS>
+static void RenderRowsFixed(const FractalVariant& variant, const Fixed<LIMBS>& centerX, const Fixed<LIMBS>& centerY, double scale,
+    CpuImage* image, int firstRow, int rowStep) {
+    Fixed<LIMBS> px[FIXED_LANES], py[FIXED_LANES];
+    int n[FIXED_LANES];
+    for (int y = firstRow; y < image->height; y += rowStep) {
+        // like RenderRows(). The offset from the center is at most the scale, so a double holds it
+        // with plenty of bits to spare, at any zoom.
+        Fixed<LIMBS> rowY = FixedAdd(centerY, FixedFromDouble<LIMBS>(((double)y / (double)image->height - 0.5) * scale));
+        for (int x0 = 0; x0 < image->width; x0 += FIXED_LANES) {
+            int laneCount = std::min(FIXED_LANES, image->width - x0);
+            for (int l = 0; l < laneCount; l++) {
+                px[l] = FixedAdd(centerX, FixedFromDouble<LIMBS>(((double)(x0 + l) / (double)image->width - 0.5) * scale));
+                py[l] = rowY;
+            }
+            IterateFixed<FORMULA, POWER, LIMBS>(px, py, laneCount, variant.iterations, n);
+            for (int l = 0; l < laneCount; l++) {
+                Colorize(n[l], variant.iterations, image->At(x0 + l, y));
+            }
+        }
+    }
+}
+
+template <FractalFormula FORMULA, int LIMBS>
+static void RenderFormulaFixed(const FractalVariant& variant, const Fixed<LIMBS>& centerX, const Fixed<LIMBS>& centerY, double scale, CpuImage* image) {
+    typedef void (*RenderRowsFixedFunc)(const FractalVariant&, const Fixed<LIMBS>&, const Fixed<LIMBS>&, double, CpuImage*, int, int);
+    RenderRowsFixedFunc renderRows = NULL;
+    switch (variant.power) {
+    case 2: renderRows = RenderRowsFixed<FORMULA, 2, LIMBS>; break;
+    case 3: renderRows = RenderRowsFixed<FORMULA, 3, LIMBS>; break;
+    case 4: renderRows = RenderRowsFixed<FORMULA, 4, LIMBS>; break;
+    case 5: renderRows = RenderRowsFixed<FORMULA, 5, LIMBS>; break;
+    case 6: renderRows = RenderRowsFixed<FORMULA, 6, LIMBS>; break;
+    case 7: renderRows = RenderRowsFixed<FORMULA, 7, LIMBS>; break;
+    case 8: renderRows = RenderRowsFixed<FORMULA, 8, LIMBS>; break;
+    default:
+        printf("Power %d is not supported, it must be between %d and %d\n", variant.power, MIN_FRACTAL_POWER, MAX_FRACTAL_POWER);
+        exit(1);
+    }
+
+    int threadCount = std::max(1, (int)std::thread::hardware_concurrency());
+    std::vector<std::thread> threads;
+    for (int t = 0; t < threadCount; t++) {
+        threads.push_back(std::thread(renderRows, std::cref(variant), std::cref(centerX), std::cref(centerY), scale, image, t, threadCount));
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+}
+
+template <int LIMBS>
+static bool RenderFixed(const FractalVariant& variant, const CpuDeepView& view, CpuImage* image, std::string* error) {
+    Fixed<LIMBS> centerX, centerY;
+    if (!ParseFixed(view.centerX, &centerX) || !ParseFixed(view.centerY, &centerY)) {
+        *error = "the center must be two decimal numbers, like -0.743643887037158704752191506114774";
+        return false;
+    }
+    double reach = 0.5 * view.scale;
+    if (!(view.scale > 0.0) || fabs(atof(view.centerX.c_str())) + reach > FIXED_VIEW_LIMIT || fabs(atof(view.centerY.c_str())) + reach > FIXED_VIEW_LIMIT) {
+        *error = "the view must lie within -4 to 4 on both axes";
+        return false;
+    }
+    // closer than the last bit, neighbouring pixels would get the same c, which is what fixed point
+    // is for to begin with.
+    double spacing = view.scale / (double)std::max(image->width, image->height);
+    if (spacing < ldexp(1.0, -Fixed<LIMBS>::FRACTION_BITS)) {
+        if (LIMBS < 4 && spacing >= ldexp(1.0, -Fixed<4>::FRACTION_BITS)) {
+            *error = "the pixels are closer together than 128 bits resolve, it needs --fixed-bits 256";
+        } else {
+            *error = "the pixels are closer together than even 256 bits resolve";
+        }
+        return false;
+    }
+    switch (variant.formula) {
+    case FORMULA_JULIA: RenderFormulaFixed<FORMULA_JULIA>(variant, centerX, centerY, view.scale, image); break;
+    case FORMULA_BURNING_SHIP: RenderFormulaFixed<FORMULA_BURNING_SHIP>(variant, centerX, centerY, view.scale, image); break;
+    default: RenderFormulaFixed<FORMULA_MANDELBROT>(variant, centerX, centerY, view.scale, image); break;
+    }
+    return true;
+}
+
+bool RenderFractalFixedPoint(const FractalVariant& variant, const CpuDeepView& view, int bits, CpuImage* image, std::string* error) {
+    switch (bits) {
+    case 128: return RenderFixed<2>(variant, view, image, error);
+    case 256: return RenderFixed<4>(variant, view, image, error);
+    }
+    *error = "the fixed-point renderer has 128 or 256 bits";
+    return false;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "cpu_image.h"
+#include "fractal_variant.h"
+#include "image2d.h"
+
+#include <string>
+
+//
+// Renders the fractal on the CPU, with the same math and the same colors as fractal.vert.
+//
+// Like the shader variants, the inner loop is specialized for every formula and power, here with
+// templates. The variant is dispatched once per image, so the loop over the iterations has no
+// branches on the formula, and the complex power is unrolled.
+//
+// The image is split in rows over all the CPU cores.
+//
+
+struct CpuFractalView {
+    float centerX, centerY;
+    float scale;
+    float jitterX, jitterY; // where inside the pixel we sample, like uJitter.
+};
+
+void RenderFractalCpu(const FractalVariant& variant, const CpuFractalView& view, CpuImage* image);
+
+// The fractal pass of the CPU backend, see cpu_renderer.h: what fractal.vert does, one thread per pixel,
+// run with ParallelFor(). Adds a sample of every pixel, at the jitter of the view, to the history, that
+// holds 'sampleCount' samples already, or none, and writes the average to 'fractal'. The images must be
+// of the same size.
+void FractalPassCpu(const FractalVariant& variant, const CpuFractalView& view, int sampleCount,
+    Image2D<FormatRgba8ui>* fractal, Image2D<FormatRgba32f>* history);
+
+// A view of a deep zoom. The center is a pair of decimal numbers, with as many digits as the zoom
+// needs, since a float, or even a double, can't hold it.
+struct CpuDeepView {
+    std::string centerX, centerY;
+    double scale;
+};
+
+// Renders like RenderFractalCpu(), without jitter, in fixed point of 'bits' bits, 128 or 256, see
+// fixed_point.h. That stays sharp far beyond the zoom where float, or double, falls apart in blocks,
+// at a fraction of the speed. Every thread iterates several pixels of a row at once, so that the
+// multiplications of one pixel run while those of another wait for their results. The view must lie
+// within -4 to 4 on both axes, and its pixels must be at least the last bit apart. Returns false, with
+// 'error' set, if it doesn't, or can't be parsed.
+bool RenderFractalFixedPoint(const FractalVariant& variant, const CpuDeepView& view, int bits, CpuImage* image, std::string* error);
@@ -0,0 +1,104 @@
+#include "cpu_image.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+
+const unsigned char* CpuImage::ClampedAt(int x, int y) const {
+    x = std::max(0, std::min(x, width - 1));
+    y = std::max(0, std::min(y, height - 1));
+    return &pixels[((size_t)y * width + x) * 4];
+}
+
+bool CpuImage::WritePpm(const std::string& path) const {
+    FILE* f = fopen(path.c_str(), "wb");
+    if (!f) {
+        return false;
+    }
+    fprintf(f, "P6\n%d %d\n255\n", width, height);
+    std::vector<unsigned char> row(width * 3);
+    for (int y = height - 1; y >= 0; y--) {
+        for (int x = 0; x < width; x++) {
+            const unsigned char* p = &pixels[((size_t)y * width + x) * 4];
+            row[x * 3 + 0] = p[0];
+            row[x * 3 + 1] = p[1];
+            row[x * 3 + 2] = p[2];
+        }
+        fwrite(&row[0], 1, row.size(), f);
+    }
+    bool ok = ferror(f) == 0;
+    fclose(f);
+    return ok;
+}
+
+bool CpuImage::ReadPpm(const std::string& path) {
+    FILE* f = fopen(path.c_str(), "rb");
+    if (!f) {
+        return false;
+    }
+    int w = 0, h = 0, maxValue = 0;
+    // a single whitespace character ends the header, and then the pixels start.
+    if (fscanf(f, "P6 %d %d %d", &w, &h, &maxValue) != 3 || w <= 0 || h <= 0 || maxValue != 255 || fgetc(f) == EOF) {
+        fclose(f);
+        return false;
+    }
+    Resize(w, h);
+    std::vector<unsigned char> row(w * 3);
+    bool ok = true;
+    for (int y = height - 1; y >= 0 && ok; y--) {
+        ok = fread(&row[0], 1, row.size(), f) == row.size();
+        for (int x = 0; x < width; x++) {
+            unsigned char* p = At(x, y);
+            p[0] = row[x * 3 + 0];
+            p[1] = row[x * 3 + 1];
+            p[2] = row[x * 3 + 2];
+            p[3] = 255;
+        }
+    }
+    fclose(f);
+    return ok;
+}
+
+ImageDiff CompareImages(const CpuImage& image, const CpuImage& reference, const int tolerance[4], CpuImage* diffImage) {
+    ImageDiff diff;
+    if (diffImage) {
+        diffImage->Resize(reference.width, reference.height);
+    }
+    if (image.width != reference.width || image.height != reference.height) {
+        diff.sameSize = false;
+        diff.pixelsOff = std::max(image.width * image.height, reference.width * reference.height);
+        for (int c = 0; c < 4; c++) {
+            diff.maxDiff[c] = 255;
+        }
+        if (diffImage) {
+            for (size_t i = 0; i < diffImage->pixels.size(); i += 4) {
+                diffImage->pixels[i] = 255;
+                diffImage->pixels[i + 3] = 255;
+            }
+        }
+        return diff;
+    }
+    for (size_t i = 0; i < reference.pixels.size(); i += 4) {
+        int worst = 0; // how far over the tolerance the worst channel is.
+        for (int c = 0; c < 4; c++) {
+            int d = abs((int)image.pixels[i + c] - (int)reference.pixels[i + c]);
+            diff.maxDiff[c] = std::max(diff.maxDiff[c], d);
+            worst = std::max(worst, d - tolerance[c]);
+        }
+        diff.pixelsOff += worst > 0;
+
+        if (diffImage) {
+            unsigned char* out = &diffImage->pixels[i];
+            if (worst > 0) {
+                out[0] = (unsigned char)std::min(255, 128 + worst);
+                out[1] = 0;
+                out[2] = 0;
+            } else {
+                const unsigned char* p = &reference.pixels[i];
+                out[0] = out[1] = out[2] = (unsigned char)((p[0] + p[1] + p[2]) / 9);
+            }
+            out[3] = 255;
+        }
+    }
+    return diff;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// An RGBA8 image in CPU memory, in the same layout as the RGBA8UI textures of the demo.
+struct CpuImage {
+    int width = 0;
+    int height = 0;
+    std::vector<unsigned char> pixels; // RGBA, row by row, starting with the row at y = 0.
+
+    void Resize(int w, int h) { width = w; height = h; pixels.assign((size_t)w * h * 4, 0); }
+    unsigned char* At(int x, int y) { return &pixels[((size_t)y * width + x) * 4]; }
+    // with clamp to edge, just like csample() in the shaders.
+    const unsigned char* ClampedAt(int x, int y) const;
+
+    // Writes the image as a binary PPM, without the alpha channel. The row at y = 0 is
+    // written last, so the file looks like the screen. Returns false if the file couldn't be written.
+    bool WritePpm(const std::string& path) const;
+    // Reads a binary PPM, with 255 as the maximum, like WritePpm() writes. Alpha is set to 255.
+    // Returns false if the file couldn't be read, or isn't such a PPM.
+    bool ReadPpm(const std::string& path);
+};
+
+// How two images differ.
+struct ImageDiff {
+    int maxDiff[4] = { 0, 0, 0, 0 }; // the largest difference, per channel.
+    int pixelsOff = 0;               // pixels with a channel that differs by more than the tolerance.
+    // images of different sizes aren't compared at all. Then every pixel counts as off, by 255.
+    bool sameSize = true;
+};
+
+// Compares 'image' with 'reference', with a tolerance per channel, RGBA. If 'diffImage' isn't NULL,
+// it is set to a picture of the differences: the reference, dimmed to gray, with the pixels that
+// are off in red, brighter the more they are off.
+ImageDiff CompareImages(const CpuImage& image, const CpuImage& reference, const int tolerance[4], CpuImage* diffImage);
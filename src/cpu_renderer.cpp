@@ -0,0 +1,169 @@
+#include "cpu_renderer.h"
+#include "clock.h"
+#include "cpu_fractal.h"
+#include "parallel_for.h"
+#include "shader_math.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <thread>
+
+static const char* PASS_NAMES[] = { "fractal", "box.h", "box.v", "display" };
+
+void CpuRenderer::Init(const CpuRendererConfig& config_) {
+    config = config_;
+    fractalImage.Resize(config.renderWidth, config.renderHeight);
+    historyImage.Resize(config.renderWidth, config.renderHeight);
+    tempImage.Resize(config.renderWidth, config.renderHeight);
+    blurredImage.Resize(config.renderWidth, config.renderHeight);
+    frame.Resize(config.width, config.height);
+    for (int pass = 0; pass < PASS_COUNT; pass++) {
+        passMs[pass] = 0.0f;
+    }
+    lastPrintTime = GetSeconds();
+}
+
+void CpuRenderer::SetFractalVariant(const FractalVariant& variant) {
+    if (!(variant == config.variant)) {
+        config.variant = variant;
+        historySampleCount = 0;
+    }
+}
+
+// filter_box.vert: the sum of the 2 * radius + 1 pixels along the direction, with clamp to edge.
+void CpuRenderer::BoxPass(const Image2D<FormatRgba8ui>& input, Image2D<FormatRgba8ui>* output, int directionX, int directionY) {
+    int width = input.GetWidth();
+    int height = input.GetHeight();
+    int radius = config.blurRadius;
+    ParallelFor(width * height, [&](int id) {
+        int x = id % width;
+        int y = id / width;
+        float sum[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+        for (int k = -radius; k <= radius; k++) {
+            UVec4 s = input.LoadClamped(x + k * directionX, y + k * directionY);
+            for (int c = 0; c < 4; c++) {
+                sum[c] += (float)s.v[c];
+            }
+        }
+        // round, instead of truncating, so that the two passes don't darken the image.
+        UVec4 out;
+        for (int c = 0; c < 4; c++) {
+            out.v[c] = (uint32_t)(sum[c] / (float)(2 * radius + 1) + 0.5f);
+        }
+        output->Store(x, y, out);
+    });
+}
+
+// display.frag, for every pixel of the frame: the filtered fractal, scaled up with bilinear filtering.
+void CpuRenderer::DisplayPass() {
+    int width = blurredImage.GetWidth();
+    int height = blurredImage.GetHeight();
+    ParallelFor(frame.width * frame.height, [&](int id) {
+        int fx = id % frame.width;
+        int fy = id / frame.width;
+        // the uv of the fragment, at the center of the pixel.
+        float u = ((float)fx + 0.5f) / (float)frame.width;
+        float v = ((float)fy + 0.5f) / (float)frame.height;
+        float px = (float)width * u - 0.5f;
+        float py = (float)height * v - 0.5f;
+        int ix = (int)floorf(px);
+        int iy = (int)floorf(py);
+        float tx = px - (float)ix;
+        float ty = py - (float)iy;
+
+        UVec4 s[4];
+        for (int k = 0; k < 4; k++) {
+            s[k] = blurredImage.LoadClamped(ix + (k & 1), iy + (k >> 1));
+        }
+        unsigned char* out = frame.At(fx, fy);
+        for (int c = 0; c < 4; c++) {
+            float bottom = Mix((float)s[0].v[c], (float)s[1].v[c], tx);
+            float top = Mix((float)s[2].v[c], (float)s[3].v[c], tx);
+            float color = (1.0f / 255.0f) * Mix(bottom, top, ty);
+            // the framebuffer is RGBA8, which rounds to the nearest of its 256 steps.
+            out[c] = (unsigned char)(std::min(std::max(color, 0.0f), 1.0f) * 255.0f + 0.5f);
+        }
+    });
+}
+
+bool CpuRenderer::RenderFrame(const FrameParams& params) {
+    SetFractalVariant(params.variant);
+    // when the view changes, we must throw away the accumulated samples, like the GL backend does.
+    const View& view = params.view;
+    if (!(view == historyView)) {
+        historySampleCount = 0;
+        historyView = view;
+    }
+    CpuFractalView fractalView = { view.centerX, view.centerY, view.scale,
+        Halton(historySampleCount, 2), Halton(historySampleCount, 3) };
+
+    double times[PASS_COUNT + 1];
+    times[0] = GetSeconds();
+    {
+        TraceZone zone("cpu fractal");
+        FractalPassCpu(config.variant, fractalView, historySampleCount, &fractalImage, &historyImage);
+    }
+    times[1] = GetSeconds();
+    {
+        TraceZone zone("cpu box.h");
+        BoxPass(fractalImage, &tempImage, 1, 0);
+    }
+    times[2] = GetSeconds();
+    {
+        TraceZone zone("cpu box.v");
+        BoxPass(tempImage, &blurredImage, 0, 1);
+    }
+    times[3] = GetSeconds();
+    {
+        TraceZone zone("cpu display");
+        DisplayPass();
+    }
+    times[4] = GetSeconds();
+    hasFrame = true;
+
+    historySampleCount = std::min(historySampleCount + 1, MAX_HISTORY_SAMPLES);
+
+    for (int pass = 0; pass < PASS_COUNT; pass++) {
+        passMs[pass] = (float)((times[pass + 1] - times[pass]) * 1000.0);
+    }
+    // the timings of the last frame, once a second, like the other backends.
+    if (times[PASS_COUNT] - lastPrintTime >= 1.0) {
+        printf("cpu %.2f ms (", (times[PASS_COUNT] - times[0]) * 1000.0);
+        for (int pass = 0; pass < PASS_COUNT; pass++) {
+            printf("%s%s %.2f", pass == 0 ? "" : ", ", PASS_NAMES[pass], passMs[pass]);
+        }
+        printf("), render resolution %dx%d, %d threads\n", config.renderWidth, config.renderHeight,
+            std::max(1, (int)std::thread::hardware_concurrency()));
+        lastPrintTime = times[PASS_COUNT];
+    }
+    return true;
+}
+
+bool CpuRenderer::ReadLastFrame(CpuImage* image) {
+    if (!hasFrame) {
+        return false;
+    }
+    *image = frame;
+    return true;
+}
+
+bool CpuRenderer::ReadFilteredImage(CpuImage* image) const {
+    if (!hasFrame) {
+        return false;
+    }
+    ReadImage(blurredImage, image);
+    return true;
+}
+
+bool CpuRenderer::ReadFractalImage(CpuImage* image) const {
+    if (!hasFrame) {
+        return false;
+    }
+    ReadImage(fractalImage, image);
+    return true;
+}
+
+void CpuRenderer::Destroy() {
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "renderer.h"
+#include "fractal_variant.h"
+#include "image2d.h"
+
+struct CpuRendererConfig {
+    int width = 0; // the size of the frames, like the window.
+    int height = 0;
+    // the size the fractal and the filter are rendered at. The display pass scales it up to width x height.
+    int renderWidth = 0;
+    int renderHeight = 0;
+    FractalVariant variant;
+    int blurRadius = 8; // the radius of the box filter, the only filter we have.
+};
+
+//
+// The passes of the GL backend, gl_renderer.h, as C++ kernels: the fractal pass, the two passes of the box
+// filter, and the display pass. Every kernel is the shader of its pass, line by line, on Image2D
+// images, see image2d.h, launched with ParallelFor(), see parallel_for.h, where the GL version
+// launches the shader with glDrawArrays(GL_POINTS, 0, N). ParallelFor() returns once all the threads
+// are done, so that is the memory barrier between the passes.
+//
+// That needs no GL context, and no GPU, so it runs where the demo can't open a window, like
+// the Vulkan backend with --headless. The frames can only be seen with ReadLastFrame().
+//
+// The kernels do the same float math as the shaders, and store to RGBA8UI like the GL, so the images
+// are the same as with the GL, but where llvmpipe rounds differently, see --check-cpu-backend.
+// The history accumulates the samples of a view that stands still, like the GL version does.
+//
+class CpuRenderer : public Renderer {
+public:
+    void Init(const CpuRendererConfig& config);
+
+    // Starts the accumulation over, if the variant changed. RenderFrame() calls it with the variant
+    // of the frame, there is nothing to build.
+    void SetFractalVariant(const FractalVariant& variant);
+
+    const char* GetName() const override { return "CPU"; }
+    bool RenderFrame(const FrameParams& params) override;
+    const FractalVariant& GetRenderedVariant() const override { return config.variant; }
+    bool ReadLastFrame(CpuImage* image) override;
+    void Destroy() override;
+
+    // The output of the filter, at the render resolution, of the last frame. That is what
+    // GlRenderer::RenderStill() reads back from the GL. Returns false if there is no frame yet.
+    bool ReadFilteredImage(CpuImage* image) const;
+    // Like ReadFilteredImage(), the output of the fractal pass.
+    bool ReadFractalImage(CpuImage* image) const;
+
+private:
+    enum Pass {
+        PASS_FRACTAL,
+        PASS_BOX_H,
+        PASS_BOX_V,
+        PASS_DISPLAY,
+        PASS_COUNT
+    };
+
+    void BoxPass(const Image2D<FormatRgba8ui>& input, Image2D<FormatRgba8ui>* output, int directionX, int directionY);
+    void DisplayPass();
+
+    CpuRendererConfig config;
+    Image2D<FormatRgba8ui> fractalImage;
+    Image2D<FormatRgba32f> historyImage;
+    Image2D<FormatRgba8ui> tempImage; // between the horizontal and the vertical filter pass.
+    Image2D<FormatRgba8ui> blurredImage;
+    CpuImage frame; // what the display pass wrote, like the back buffer.
+    bool hasFrame = false;
+
+    int historySampleCount = 0;
+    View historyView;
+
+    float passMs[PASS_COUNT];
+    double lastPrintTime = 0.0;
+};
@@ -0,0 +1,53 @@
+#include "dynamic_resolution.h"
+
+#include <algorithm>
+#include <cmath>
+
+void DynamicResolution::Init(const DynamicResolutionConfig& config_) {
+    config = config_;
+    config.minScale = std::min(config.minScale, config.maxScale);
+    scale = config.maxScale;
+    overBudgetFrames = 0;
+    underBudgetFrames = 0;
+}
+
+float DynamicResolution::Quantize(float s) const {
+    s = std::floor(s / config.step + 0.5f) * config.step;
+    return std::max(config.minScale, std::min(config.maxScale, s));
+}
+
+float DynamicResolution::Update(float gpuMs) {
+    if (gpuMs <= 0.0f) {
+        return scale;
+    }
+
+    float load = gpuMs / config.budgetMs;
+
+    overBudgetFrames = load > config.scaleDownThreshold ? overBudgetFrames + 1 : 0;
+    underBudgetFrames = load < config.scaleUpThreshold ? underBudgetFrames + 1 : 0;
+
+    if (overBudgetFrames >= config.settleFrames) {
+        // The cost of the fractal and blur passes is proportional to the number of pixels,
+        // that is, to the square of the scale. So we can directly estimate which scale brings
+        // us back into the middle of the band, instead of crawling there one step at a time.
+        float target = 0.5f * (config.scaleDownThreshold + config.scaleUpThreshold);
+        float newScale = Quantize(scale * std::sqrt(target / load));
+        if (newScale >= scale) {
+            newScale = Quantize(scale - config.step);
+        }
+        scale = newScale;
+        overBudgetFrames = 0;
+    } else if (underBudgetFrames >= config.settleFrames) {
+        // but going up, we are careful and only take one step, since overshooting causes a
+        // visible hitch.
+        scale = Quantize(scale + config.step);
+        underBudgetFrames = 0;
+    }
+
+    return scale;
+}
+
+void DynamicResolution::GetRenderSize(int windowWidth, int windowHeight, int* width, int* height) const {
+    *width = std::max(1, (int)(windowWidth * scale + 0.5f));
+    *height = std::max(1, (int)(windowHeight * scale + 0.5f));
+}
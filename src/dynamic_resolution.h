@@ -0,0 +1,45 @@
+#pragma once
+
+//
+// Picks the internal render resolution of the fractal and blur passes from the measured
+// GPU frame time, so that we hit our frame rate even on slow GPUs.
+//
+// The resolution is expressed as a scale factor of the window size, and is kept within
+// [minScale, maxScale]. To avoid oscillating between two resolutions every other frame, the
+// controller uses hysteresis: it only lowers the resolution when the GPU time stays above
+// 'scaleDownThreshold' of the budget, and only raises it when the GPU time stays below
+// 'scaleUpThreshold' of the budget. In between these two thresholds, nothing happens.
+// And the GPU time must stay outside the band for 'settleFrames' consecutive frames.
+//
+struct DynamicResolutionConfig {
+    float minScale = 0.5f;
+    float maxScale = 1.0f;
+
+    float budgetMs = 1000.0f / 60.0f; // GPU time we can afford per frame.
+    float scaleDownThreshold = 0.90f;
+    float scaleUpThreshold = 0.65f;
+    int settleFrames = 12; // should be larger than the latency of the GPU timings.
+
+    float step = 0.05f; // the scale is always a multiple of this, so it doesn't drift.
+};
+
+class DynamicResolution {
+public:
+    void Init(const DynamicResolutionConfig& config);
+
+    // Feed the GPU time of the latest frame we have timings for. Returns the new scale.
+    float Update(float gpuMs);
+
+    float GetScale() const { return scale; }
+
+    // the render size for a given window size, at the current scale. Never smaller than 1x1.
+    void GetRenderSize(int windowWidth, int windowHeight, int* width, int* height) const;
+
+private:
+    float Quantize(float s) const;
+
+    DynamicResolutionConfig config;
+    float scale = 1.0f;
+    int overBudgetFrames = 0;
+    int underBudgetFrames = 0;
+};
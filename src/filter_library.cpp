@@ -0,0 +1,536 @@
+#include "filter_library.h"
+#include "gl_util.h"
+#include "gl_state.h"
+#include "gl_textures.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+
+//
+// The CPU reference implementations. They do the same math as the shaders, in the same order,
+// in single precision float, so they only differ from the GPU by rounding.
+//
+
+static unsigned char RoundToByte(float v) {
+    return (unsigned char)std::max(0.0f, std::min(v + 0.5f, 255.0f));
+}
+
+static int IntParam(const FilterParams& params, const char* name) {
+    return (int)params.at(name);
+}
+
+// one direction of a separable filter with the given weights, for k = -radius..radius.
+static void SeparablePass(const CpuImage& in, CpuImage* out, int dx, int dy, const std::vector<float>& weights) {
+    int radius = (int)weights.size() / 2;
+    float weightSum = 0.0f;
+    for (float w : weights) {
+        weightSum += w;
+    }
+
+    out->Resize(in.width, in.height);
+    for (int y = 0; y < in.height; y++) {
+        for (int x = 0; x < in.width; x++) {
+            float sum[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+            for (int k = -radius; k <= radius; k++) {
+                const unsigned char* s = in.ClampedAt(x + k * dx, y + k * dy);
+                for (int c = 0; c < 4; c++) {
+                    sum[c] += weights[k + radius] * (float)s[c];
+                }
+            }
+            for (int c = 0; c < 4; c++) {
+                out->At(x, y)[c] = RoundToByte(sum[c] / weightSum);
+            }
+        }
+    }
+}
+
+static std::vector<float> GaussianWeights(int radius, float sigma) {
+    std::vector<float> weights;
+    for (int k = -radius; k <= radius; k++) {
+        weights.push_back(expf(-(float)(k * k) / (2.0f * sigma * sigma)));
+    }
+    return weights;
+}
+
+static void BoxReference(const CpuImage& in, CpuImage* out, const FilterParams& params) {
+    std::vector<float> weights(2 * IntParam(params, "radius") + 1, 1.0f);
+    CpuImage tmp;
+    SeparablePass(in, &tmp, 1, 0, weights);
+    SeparablePass(tmp, out, 0, 1, weights);
+}
+
+static void GaussianReference(const CpuImage& in, CpuImage* out, const FilterParams& params) {
+    std::vector<float> weights = GaussianWeights(IntParam(params, "radius"), params.at("sigma"));
+    CpuImage tmp;
+    SeparablePass(in, &tmp, 1, 0, weights);
+    SeparablePass(tmp, out, 0, 1, weights);
+}
+
+static void BilateralReference(const CpuImage& in, CpuImage* out, const FilterParams& params) {
+    int radius = IntParam(params, "radius");
+    float sigma = params.at("sigma");
+    float rangeSigma = params.at("rangeSigma");
+
+    out->Resize(in.width, in.height);
+    for (int y = 0; y < in.height; y++) {
+        for (int x = 0; x < in.width; x++) {
+            const unsigned char* center = in.ClampedAt(x, y);
+            float sum[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+            float weightSum = 0.0f;
+            for (int j = -radius; j <= radius; j++) {
+                for (int i = -radius; i <= radius; i++) {
+                    const unsigned char* s = in.ClampedAt(x + i, y + j);
+                    float d2 = 0.0f;
+                    for (int c = 0; c < 3; c++) {
+                        float d = (float)s[c] - (float)center[c];
+                        d2 += d * d;
+                    }
+                    float w = expf(-(float)(i * i + j * j) / (2.0f * sigma * sigma) - d2 / (2.0f * rangeSigma * rangeSigma));
+                    for (int c = 0; c < 4; c++) {
+                        sum[c] += w * (float)s[c];
+                    }
+                    weightSum += w;
+                }
+            }
+            for (int c = 0; c < 4; c++) {
+                out->At(x, y)[c] = RoundToByte(sum[c] / weightSum);
+            }
+        }
+    }
+}
+
+static void MedianReference(const CpuImage& in, CpuImage* out, int radius) {
+    std::vector<unsigned char> values;
+    out->Resize(in.width, in.height);
+    for (int y = 0; y < in.height; y++) {
+        for (int x = 0; x < in.width; x++) {
+            for (int c = 0; c < 4; c++) {
+                values.clear();
+                for (int j = -radius; j <= radius; j++) {
+                    for (int i = -radius; i <= radius; i++) {
+                        values.push_back(in.ClampedAt(x + i, y + j)[c]);
+                    }
+                }
+                std::nth_element(values.begin(), values.begin() + values.size() / 2, values.end());
+                out->At(x, y)[c] = values[values.size() / 2];
+            }
+        }
+    }
+}
+
+static void Median3Reference(const CpuImage& in, CpuImage* out, const FilterParams&) {
+    MedianReference(in, out, 1);
+}
+
+static void Median5Reference(const CpuImage& in, CpuImage* out, const FilterParams&) {
+    MedianReference(in, out, 2);
+}
+
+static void UnsharpReference(const CpuImage& in, CpuImage* out, const FilterParams& params) {
+    int radius = IntParam(params, "radius");
+    float amount = params.at("amount");
+    std::vector<float> weights = GaussianWeights(radius, params.at("sigma"));
+    float weightSum = 0.0f;
+    for (float w : weights) {
+        weightSum += w;
+    }
+
+    // the horizontal blur is stored with 8 bits, just like on the GPU. 
+    CpuImage blurredH;
+    SeparablePass(in, &blurredH, 1, 0, weights);
+
+    out->Resize(in.width, in.height);
+    for (int y = 0; y < in.height; y++) {
+        for (int x = 0; x < in.width; x++) {
+            float sum[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+            for (int k = -radius; k <= radius; k++) {
+                const unsigned char* s = blurredH.ClampedAt(x, y + k);
+                for (int c = 0; c < 4; c++) {
+                    sum[c] += weights[k + radius] * (float)s[c];
+                }
+            }
+            const unsigned char* original = in.ClampedAt(x, y);
+            for (int c = 0; c < 4; c++) {
+                float blurred = sum[c] / weightSum;
+                out->At(x, y)[c] = RoundToByte((float)original[c] + amount * ((float)original[c] - blurred));
+            }
+        }
+    }
+}
+
+static void SobelReference(const CpuImage& in, CpuImage* out, const FilterParams& params) {
+    float scale = params.at("scale");
+    auto luminance = [&](int x, int y) {
+        const unsigned char* s = in.ClampedAt(x, y);
+        return 0.299f * (float)s[0] + 0.587f * (float)s[1] + 0.114f * (float)s[2];
+    };
+
+    out->Resize(in.width, in.height);
+    for (int y = 0; y < in.height; y++) {
+        for (int x = 0; x < in.width; x++) {
+            float tl = luminance(x - 1, y - 1), t = luminance(x, y - 1), tr = luminance(x + 1, y - 1);
+            float l = luminance(x - 1, y), r = luminance(x + 1, y);
+            float bl = luminance(x - 1, y + 1), b = luminance(x, y + 1), br = luminance(x + 1, y + 1);
+
+            float gx = (tr + 2.0f * r + br) - (tl + 2.0f * l + bl);
+            float gy = (bl + 2.0f * b + br) - (tl + 2.0f * t + tr);
+            unsigned char m = RoundToByte(std::min(scale * sqrtf(gx * gx + gy * gy), 255.0f));
+
+            unsigned char* o = out->At(x, y);
+            o[0] = o[1] = o[2] = m;
+            o[3] = 255;
+        }
+    }
+}
+
+//
+// The registry of all filters.
+//
+const std::vector<FilterDef>& FilterLibrary::GetFilters() {
+    static std::vector<FilterDef> filters;
+    if (!filters.empty()) {
+        return filters;
+    }
+
+    FilterDef box = { "box", "box blur, as two separable passes",
+        { { "radius", 8.0f, true, 0.0f, 32.0f } },
+        { { "h", "filter_box.vert", 1, 0, false }, { "v", "filter_box.vert", 0, 1, false } },
+        0, BoxReference };
+    FilterDef gaussian = { "gaussian", "gaussian blur, as two separable passes",
+        { { "radius", 6.0f, true, 0.0f, 32.0f }, { "sigma", 2.0f, false, 0.1f, 100.0f } },
+        { { "h", "filter_gaussian.vert", 1, 0, false }, { "v", "filter_gaussian.vert", 0, 1, false } },
+        0, GaussianReference };
+    FilterDef bilateral = { "bilateral", "edge-preserving blur",
+        { { "radius", 3.0f, true, 0.0f, 8.0f }, { "sigma", 2.0f, false, 0.1f, 100.0f }, { "rangeSigma", 25.0f, false, 0.1f, 1000.0f } },
+        { { "", "filter_bilateral.vert", 0, 0, false } },
+        0, BilateralReference };
+    FilterDef median3 = { "median3", "3x3 median, with a selection network",
+        {},
+        { { "", "filter_median3.vert", 0, 0, false } },
+        1, Median3Reference };
+    FilterDef median5 = { "median5", "5x5 median, with a selection network",
+        {},
+        { { "", "filter_median5.vert", 0, 0, false } },
+        2, Median5Reference };
+    FilterDef unsharp = { "unsharp", "unsharp mask sharpening",
+        { { "radius", 3.0f, true, 0.0f, 32.0f }, { "sigma", 1.5f, false, 0.1f, 100.0f }, { "amount", 1.0f, false, 0.0f, 10.0f } },
+        { { "blur", "filter_gaussian.vert", 1, 0, false }, { "sharpen", "filter_unsharp.vert", 0, 1, true } },
+        0, UnsharpReference };
+    FilterDef sobel = { "sobel", "edge detection, outputs the gradient magnitude",
+        { { "scale", 1.0f, false, 0.0f, 100.0f } },
+        { { "", "filter_sobel.vert", 0, 0, false } },
+        1, SobelReference };
+
+    filters.push_back(box);
+    filters.push_back(gaussian);
+    filters.push_back(bilateral);
+    filters.push_back(median3);
+    filters.push_back(median5);
+    filters.push_back(unsharp);
+    filters.push_back(sobel);
+    return filters;
+}
+
+const FilterDef* FilterLibrary::FindFilter(const std::string& name) {
+    for (const FilterDef& def : GetFilters()) {
+        if (name == def.name) {
+            return &def;
+        }
+    }
+    return NULL;
+}
+
+void FilterLibrary::PrintFilters() {
+    printf("filters:\n");
+    for (const FilterDef& def : GetFilters()) {
+        printf("  %-10s %s", def.name, def.description);
+        for (size_t i = 0; i < def.params.size(); i++) {
+            const FilterParam& param = def.params[i];
+            printf("%s%s=%g [%g, %g]", i == 0 ? " (" : ", ", param.name, param.defaultValue, param.minValue, param.maxValue);
+        }
+        printf("%s\n", def.params.empty() ? "" : ")");
+    }
+}
+
+static std::vector<std::string> Split(const std::string& s, char separator) {
+    std::vector<std::string> parts;
+    std::stringstream ss(s);
+    std::string part;
+    while (std::getline(ss, part, separator)) {
+        parts.push_back(part);
+    }
+    return parts;
+}
+
+bool FilterLibrary::ParseChain(const std::string& spec, std::vector<FilterInstance>* chain, std::string* error) {
+    chain->clear();
+
+    for (const std::string& filterSpec : Split(spec, ',')) {
+        std::vector<std::string> parts = Split(filterSpec, ':');
+        if (parts.empty() || parts[0].empty()) {
+            *error = "empty filter in '" + spec + "'";
+            return false;
+        }
+
+        const FilterDef* def = FindFilter(parts[0]);
+        if (!def) {
+            *error = "unknown filter '" + parts[0] + "'";
+            return false;
+        }
+        FilterInstance instance = GetDefaultInstance(*def);
+
+        for (size_t i = 1; i < parts.size(); i++) {
+            size_t eq = parts[i].find('=');
+            std::string name = parts[i].substr(0, eq);
+            if (eq == std::string::npos || instance.params.count(name) == 0) {
+                *error = "filter '" + parts[0] + "' has no parameter '" + name + "'";
+                return false;
+            }
+            const char* text = parts[i].c_str() + eq + 1;
+            char* end = NULL;
+            float value = strtof(text, &end);
+            for (const FilterParam& param : def->params) {
+                if (name != param.name) {
+                    continue;
+                }
+                // written so that NaN fails too.
+                if (end == text || *end != '\0' || !(value >= param.minValue && value <= param.maxValue)) {
+                    char range[64];
+                    snprintf(range, sizeof(range), "from %g to %g", param.minValue, param.maxValue);
+                    *error = "parameter '" + name + "' of filter '" + parts[0] + "' must be a number " + range;
+                    return false;
+                }
+                if (param.isConstant && value != floorf(value)) {
+                    *error = "parameter '" + name + "' of filter '" + parts[0] + "' must be an integer";
+                    return false;
+                }
+            }
+            instance.params[name] = value;
+        }
+
+        chain->push_back(instance);
+    }
+
+    if (chain->empty()) {
+        *error = "the filter chain is empty";
+        return false;
+    }
+    return true;
+}
+
+FilterInstance FilterLibrary::GetDefaultInstance(const FilterDef& def) {
+    FilterInstance instance;
+    instance.def = &def;
+    for (const FilterParam& param : def.params) {
+        instance.params[param.name] = param.defaultValue;
+    }
+    return instance;
+}
+
+int FilterLibrary::GetReach(const std::vector<FilterInstance>& chain) {
+    int reach = 0;
+    for (const FilterInstance& f : chain) {
+        FilterParams::const_iterator radius = f.params.find("radius");
+        reach += f.def->reach + (radius != f.params.end() ? (int)radius->second : 0);
+    }
+    return reach;
+}
+
+void FilterLibrary::RunCpu(const std::vector<FilterInstance>& chain, const CpuImage& in, CpuImage* out) {
+    CpuImage current = in;
+    for (const FilterInstance& instance : chain) {
+        instance.def->cpuReference(current, out, instance.params);
+        current = *out;
+    }
+    *out = current;
+}
+
+void FilterLibrary::Init(ShaderPermutations* permutations_) {
+    permutations = permutations_;
+}
+
+void FilterLibrary::SetPixelOrder(PixelOrder order) {
+    pixelOrder = order;
+}
+
+GLuint FilterLibrary::GetProgram(const FilterDef& def, const FilterStage& stage, const FilterParams& params) {
+    ShaderConstants constants;
+    for (const FilterParam& param : def.params) {
+        if (param.isConstant) {
+            std::string name = param.name;
+            std::transform(name.begin(), name.end(), name.begin(), ::toupper);
+            constants[name] = (int)params.at(param.name);
+        }
+    }
+    constants["PIXEL_ORDER"] = pixelOrder;
+    return permutations->Get(stage.vsFile, "empty.frag", constants);
+}
+
+bool FilterLibrary::IsReady(const std::vector<FilterInstance>& chain) {
+    // ask for all of them, so that they are all compiled at the same time.
+    bool ready = true;
+    for (const FilterInstance& instance : chain) {
+        for (const FilterStage& stage : instance.def->stages) {
+            ready = GetProgram(*instance.def, stage, instance.params) != 0 && ready;
+        }
+    }
+    return ready;
+}
+
+void FilterLibrary::RunStage(const FilterDef& def, const FilterStage& stage, const FilterParams& params, GLuint input,
+    GLuint original, GLuint output, int width, int height) {
+    // like the fractal pass, the filters don't write to the framebuffer.
+    glState.DepthMask(false);
+    glState.ColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+
+    glState.BindImageTexture(0, input, 0, GL_FALSE, 0, GL_READ_ONLY, GL_RGBA8UI);
+    if (stage.readsOriginal) {
+        glState.BindImageTexture(1, original, 0, GL_FALSE, 0, GL_READ_ONLY, GL_RGBA8UI);
+    }
+    glState.BindImageTexture(2, output, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA8UI);
+
+    GLuint shader = GetProgram(def, stage, params);
+    glState.UseProgram(shader);
+    GL_C((glUniform1i(glGetUniformLocation(shader, "uWidth"), width)));
+    GL_C((glUniform1i(glGetUniformLocation(shader, "uHeight"), height)));
+    GL_C((glUniform2i(glGetUniformLocation(shader, "uDirection"), stage.directionX, stage.directionY)));
+    for (const FilterParam& param : def.params) {
+        std::string uniformName = std::string("u") + param.name;
+        uniformName[1] = (char)toupper(uniformName[1]);
+        GLint location;
+        GL_C(location = glGetUniformLocation(shader, uniformName.c_str()));
+        if (param.isConstant || location == -1) {
+            continue; // not every stage of a filter uses every parameter.
+        }
+        GL_C(glUniform1f(location, params.at(param.name)));
+    }
+
+    GL_C(glDrawArrays(GL_POINTS, 0, GetPixelThreadCount(pixelOrder, width, height)));
+}
+
+void FilterLibrary::AddToGraph(RenderGraph* graph, const std::vector<FilterInstance>& chain, ImageHandle input,
+    ImageHandle output, const ImageDesc& desc, const int* width, const int* height) {
+    ImageHandle current = input;
+
+    for (size_t f = 0; f < chain.size(); f++) {
+        const FilterInstance& instance = chain[f];
+        ImageHandle original = current;
+
+        for (size_t s = 0; s < instance.def->stages.size(); s++) {
+            const FilterStage* stage = &instance.def->stages[s];
+            bool last = f + 1 == chain.size() && s + 1 == instance.def->stages.size();
+
+            std::string name = instance.def->name;
+            if (stage->name[0] != '\0') {
+                name += std::string(".") + stage->name;
+            }
+
+            // the images between the passes only live for a moment, so they are transient, and
+            // the graph can ping-pong between two textures for the whole chain.
+            ImageHandle target = last ? output : graph->CreateImage(name, desc);
+
+            const FilterDef* def = instance.def;
+            FilterParams params = instance.params;
+            ImageHandle in = current;
+            RenderGraph::Pass& pass = graph->AddPass(name, [this, graph, def, stage, params, in, original, target, width, height]() {
+                RunStage(*def, *stage, params, graph->GetTexture(in), graph->GetTexture(original),
+                    graph->GetTexture(target), *width, *height);
+            });
+            pass.Read(in, ACCESS_IMAGE_LOAD).Write(target, ACCESS_IMAGE_STORE);
+            if (stage->readsOriginal) {
+                // declaring this read also keeps the graph from aliasing the original with the stages in between.
+                pass.Read(original, ACCESS_IMAGE_LOAD);
+            }
+
+            current = target;
+        }
+    }
+}
+
+// A test image with a bit of everything the filters care about: smooth gradients, hard edges, and
+// salt and pepper noise.
+static void MakeTestImage(int width, int height, CpuImage* image) {
+    image->Resize(width, height);
+    unsigned int rng = 12345;
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            unsigned char* p = image->At(x, y);
+            p[0] = (unsigned char)(255 * x / width);
+            p[1] = (unsigned char)(255 * y / height);
+            p[2] = ((x / 16 + y / 16) % 2) ? 200 : 40;
+            p[3] = 255;
+
+            int dx = x - width / 2, dy = y - height / 2;
+            if (dx * dx + dy * dy < (height / 4) * (height / 4)) {
+                p[0] = 255 - p[0];
+                p[2] = 120;
+            }
+
+            rng = rng * 1664525u + 1013904223u;
+            if ((rng >> 24) < 8) {
+                p[0] = p[1] = p[2] = (rng >> 16) & 1 ? 255 : 0;
+            }
+        }
+    }
+}
+
+bool FilterLibrary::Check(int width, int height) {
+    CpuImage input;
+    MakeTestImage(width, height, &input);
+
+    GLuint textures[2];
+    for (int i = 0; i < 2; i++) {
+        textures[i] = CreateTexture2D(GL_RGBA8UI, width, height, "filter check");
+    }
+    UploadTexture2D(textures[0], width, height, GL_RGBA_INTEGER, GL_UNSIGNED_BYTE, &input.pixels[0]);
+
+    printf("checking the filters against the CPU reference, on a %dx%d image:\n", width, height);
+    printf("  %-10s %8s %12s %10s\n", "filter", "max diff", "pixels off", "");
+
+    bool allPassed = true;
+    for (const FilterDef& def : GetFilters()) {
+        std::vector<FilterInstance> chain(1, GetDefaultInstance(def));
+
+        RenderGraph graph;
+        ImageHandle in = graph.ImportImage("input", GL_RGBA8UI);
+        ImageHandle out = graph.ImportImage("output", GL_RGBA8UI);
+        graph.SetImportedTexture(in, textures[0]);
+        graph.SetImportedTexture(out, textures[1]);
+        ImageDesc desc = { GL_RGBA8UI, width, height };
+        AddToGraph(&graph, chain, in, out, desc, &width, &height);
+        graph.Compile();
+        graph.Execute();
+
+        CpuImage gpu;
+        gpu.Resize(width, height);
+        GL_C(glMemoryBarrier(GL_TEXTURE_UPDATE_BARRIER_BIT));
+        ReadTexture2D(textures[1], GL_RGBA_INTEGER, GL_UNSIGNED_BYTE, (int)gpu.pixels.size(), &gpu.pixels[0]);
+        graph.Destroy();
+
+        CpuImage cpu;
+        RunCpu(chain, input, &cpu);
+
+        int maxDiff = 0;
+        int pixelsOff = 0;
+        for (size_t i = 0; i < cpu.pixels.size(); i += 4) {
+            int pixelDiff = 0;
+            for (int c = 0; c < 4; c++) {
+                pixelDiff = std::max(pixelDiff, abs((int)gpu.pixels[i + c] - (int)cpu.pixels[i + c]));
+            }
+            maxDiff = std::max(maxDiff, pixelDiff);
+            pixelsOff += pixelDiff > 0;
+        }
+
+        // every pass rounds to 8 bits, and exp() is not exact on the GPU, so allow an error of one
+        // per pass.
+        bool passed = maxDiff <= (int)def.stages.size();
+        allPassed = allPassed && passed;
+        printf("  %-10s %8d %12d %10s\n", def.name, maxDiff, pixelsOff, passed ? "ok" : "FAILED");
+    }
+
+    DeleteTextures2D(2, textures);
+    return allPassed;
+}
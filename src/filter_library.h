@@ -0,0 +1,108 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "cpu_image.h"
+#include "pixel_order.h"
+#include "render_graph.h"
+#include "shader_permutations.h"
+
+//
+// A library of image filters, that can be chained at runtime, like "gaussian:sigma=3,sobel".
+//
+// Every filter has a GPU implementation, made of one or more passes that use image load/store,
+// and a CPU reference implementation, that does the same math in plain C++. The reference
+// implementations are slow, but simple, and we use them to check the GPU implementations.
+//
+// All filters read and write RGBA8UI images, and clamp to the edge of the image.
+//
+
+typedef std::map<std::string, float> FilterParams;
+
+struct FilterParam {
+    // the shader uniform is named "u" + the name, with the first letter upper case. Or, for
+    // constants, the #define is named like the name in upper case.
+    const char* name;
+    float defaultValue;
+    // an integer that is compiled into the shader, like the radius, which is the bound of the loops.
+    // Every value gets its own program, see shader_permutations.h.
+    bool isConstant;
+    // the values ParseChain() accepts. A sigma is divided by, so it can't be 0. A constant radius is
+    // unrolled, 2 * radius + 1 times in the separable filters, and squared in the bilateral one.
+    float minValue, maxValue;
+};
+
+// One pass of a filter on the GPU. 
+struct FilterStage {
+    const char* name;
+    const char* vsFile;
+    int directionX, directionY; // uDirection, for separable filters.
+    bool readsOriginal; // also reads the input of the filter, at binding 1, and not just the previous stage.
+};
+
+struct FilterDef {
+    const char* name;
+    const char* description;
+    std::vector<FilterParam> params;
+    std::vector<FilterStage> stages;
+    // how far from a pixel the filter reads, on top of its radius parameter, if it has one.
+    int reach;
+    void (*cpuReference)(const CpuImage& in, CpuImage* out, const FilterParams& params);
+};
+
+// A filter in a chain, with the values of its parameters.
+struct FilterInstance {
+    const FilterDef* def;
+    FilterParams params;
+};
+
+class FilterLibrary {
+public:
+    static const std::vector<FilterDef>& GetFilters();
+    static const FilterDef* FindFilter(const std::string& name);
+    static void PrintFilters();
+
+    // Parses a chain like "gaussian:sigma=3:radius=9,sobel". Filters are separated by commas, and
+    // parameters by colons. Parameters that are left out get their default value.
+    static bool ParseChain(const std::string& spec, std::vector<FilterInstance>* chain, std::string* error);
+
+    // A filter with its default parameters.
+    static FilterInstance GetDefaultInstance(const FilterDef& def);
+
+    // How far from a pixel the chain reads, in pixels. A pixel of the output only depends on the input
+    // pixels this close to it, so a tile can be filtered on its own, with a border this wide around it.
+    static int GetReach(const std::vector<FilterInstance>& chain);
+
+    // Runs a chain with the CPU reference implementations.
+    static void RunCpu(const std::vector<FilterInstance>& chain, const CpuImage& in, CpuImage* out);
+
+    void Init(ShaderPermutations* permutations);
+    // The order the passes visit the pixels in, see pixel_order.h. Row by row by default. The
+    // programs for the new order are compiled the next time IsReady() is asked.
+    void SetPixelOrder(PixelOrder order);
+    // true once the programs for all the filters of the chain, with their constants, have been compiled.
+    // If they haven't been, this starts compiling them.
+    bool IsReady(const std::vector<FilterInstance>& chain);
+
+    // Adds the passes of a chain to a render graph. The chain reads 'input', and writes 'output', and the
+    // images in between are transient images like 'desc'. The passes run over width x height pixels, 
+    // which are read when the passes execute, so they can change from frame to frame.
+    void AddToGraph(RenderGraph* graph, const std::vector<FilterInstance>& chain, ImageHandle input,
+        ImageHandle output, const ImageDesc& desc, const int* width, const int* height);
+
+    // Runs every filter, with its default parameters, on a test image, both on the GPU and on the CPU,
+    // and prints how much they differ. Returns false if any filter differs by more than rounding.
+    bool Check(int width, int height);
+
+private:
+    void RunStage(const FilterDef& def, const FilterStage& stage, const FilterParams& params, GLuint input,
+        GLuint original, GLuint output, int width, int height);
+    GLuint GetProgram(const FilterDef& def, const FilterStage& stage, const FilterParams& params);
+
+    ShaderPermutations* permutations = NULL;
+    PixelOrder pixelOrder = PIXEL_ORDER_ROWS;
+};
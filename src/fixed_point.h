@@ -0,0 +1,225 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__BMI2__) || defined(__ADX__)
+#include <immintrin.h>
+#endif
+
+//
+// Signed fixed-point numbers of LIMBS 64-bit limbs, for rendering deep zooms on the CPU, see
+// RenderFractalFixedPoint() in cpu_fractal.h.
+//
+// A float has a mantissa of 24 bits, and a double one of 53. Once the pixels of a view are closer
+// together than that resolves, neighbouring pixels get the same c, and the image falls apart in
+// blocks. In fixed point, every bit below the point is significant, wherever we zoom in. The number
+// is LIMBS * 64 bits of two's complement, FIXED_INTEGER_BITS of them, the sign included, before the
+// point. So two limbs resolve 2^-112, and four 2^-240.
+//
+// The limbs are multiplied with mulx, and added with adcx, when the compiler may use them, with
+// -mbmi2 and -madx (see FIXED_POINT_BMI2 in CMakeLists.txt). Otherwise with unsigned __int128, or
+// _umul128 and _addcarry_u64 on MSVC, which become mul and adc.
+//
+
+const int FIXED_INTEGER_BITS = 16; // enough for z^8 of the escape time loop, see cpu_fractal.cpp.
+
+template <int LIMBS>
+struct Fixed {
+    static const int FRACTION_BITS = 64 * LIMBS - FIXED_INTEGER_BITS;
+    uint64_t limb[LIMBS]; // the least significant first.
+};
+
+// a * b, as the low half, and the high half in 'hi'.
+inline uint64_t MultiplyWide(uint64_t a, uint64_t b, uint64_t* hi) {
+#if defined(__BMI2__)
+    unsigned long long h;
+    uint64_t lo = _mulx_u64(a, b, &h);
+    *hi = h;
+    return lo;
+#elif defined(_MSC_VER)
+    return _umul128(a, b, hi);
+#else
+    unsigned __int128 p = (unsigned __int128)a * b;
+    *hi = (uint64_t)(p >> 64);
+    return (uint64_t)p;
+#endif
+}
+
+// a + b + carry, as the sum, and the carry out.
+inline unsigned char AddWithCarry(unsigned char carry, uint64_t a, uint64_t b, uint64_t* sum) {
+#if defined(__ADX__)
+    unsigned long long s;
+    carry = _addcarryx_u64(carry, a, b, &s);
+    *sum = s;
+    return carry;
+#elif defined(_MSC_VER)
+    return _addcarry_u64(carry, a, b, sum);
+#else
+    unsigned __int128 s = (unsigned __int128)a + b + carry;
+    *sum = (uint64_t)s;
+    return (unsigned char)(s >> 64);
+#endif
+}
+
+template <int LIMBS>
+inline Fixed<LIMBS> FixedAdd(const Fixed<LIMBS>& a, const Fixed<LIMBS>& b) {
+    Fixed<LIMBS> r;
+    unsigned char carry = 0;
+    for (int i = 0; i < LIMBS; i++) {
+        carry = AddWithCarry(carry, a.limb[i], b.limb[i], &r.limb[i]);
+    }
+    return r;
+}
+
+template <int LIMBS>
+inline Fixed<LIMBS> FixedNegate(const Fixed<LIMBS>& a) {
+    Fixed<LIMBS> r;
+    unsigned char carry = 1;
+    for (int i = 0; i < LIMBS; i++) {
+        carry = AddWithCarry(carry, ~a.limb[i], 0, &r.limb[i]);
+    }
+    return r;
+}
+
+template <int LIMBS>
+inline Fixed<LIMBS> FixedSubtract(const Fixed<LIMBS>& a, const Fixed<LIMBS>& b) {
+    // a + ~b + 1.
+    Fixed<LIMBS> r;
+    unsigned char carry = 1;
+    for (int i = 0; i < LIMBS; i++) {
+        carry = AddWithCarry(carry, a.limb[i], ~b.limb[i], &r.limb[i]);
+    }
+    return r;
+}
+
+template <int LIMBS>
+inline bool FixedIsNegative(const Fixed<LIMBS>& a) {
+    return (a.limb[LIMBS - 1] >> 63) != 0;
+}
+
+template <int LIMBS>
+inline Fixed<LIMBS> FixedAbs(const Fixed<LIMBS>& a) {
+    return FixedIsNegative(a) ? FixedNegate(a) : a;
+}
+
+// a * b, rounded towards zero.
+template <int LIMBS>
+inline Fixed<LIMBS> FixedMultiply(const Fixed<LIMBS>& a, const Fixed<LIMBS>& b) {
+    bool negative = FixedIsNegative(a) != FixedIsNegative(b);
+    Fixed<LIMBS> ua = FixedAbs(a), ub = FixedAbs(b);
+
+    // the whole product, row by row. A product of two limbs, plus two more limbs, the one it is added
+    // to and the carry, still fits in 128 bits, so the carry into the next limb fits in one.
+    uint64_t product[2 * LIMBS];
+    for (int i = 0; i < 2 * LIMBS; i++) {
+        product[i] = 0;
+    }
+    for (int i = 0; i < LIMBS; i++) {
+        uint64_t carry = 0;
+        for (int j = 0; j < LIMBS; j++) {
+            uint64_t hi;
+            uint64_t lo = MultiplyWide(ua.limb[i], ub.limb[j], &hi);
+            unsigned char c1 = AddWithCarry(0, product[i + j], lo, &product[i + j]);
+            unsigned char c2 = AddWithCarry(0, product[i + j], carry, &product[i + j]);
+            carry = hi + c1 + c2;
+        }
+        product[i + LIMBS] = carry;
+    }
+
+    // the product has 2 * FRACTION_BITS bits after the point, so we drop the lowest FRACTION_BITS.
+    // That is LIMBS - 1 limbs, and 64 - FIXED_INTEGER_BITS bits of the next.
+    const int shift = 64 - FIXED_INTEGER_BITS;
+    Fixed<LIMBS> r;
+    for (int i = 0; i < LIMBS; i++) {
+        r.limb[i] = (product[LIMBS - 1 + i] >> shift) | (product[LIMBS + i] << (64 - shift));
+    }
+    return negative ? FixedNegate(r) : r;
+}
+
+// a > b.
+template <int LIMBS>
+inline bool FixedGreater(const Fixed<LIMBS>& a, const Fixed<LIMBS>& b) {
+    if (a.limb[LIMBS - 1] != b.limb[LIMBS - 1]) {
+        return (int64_t)a.limb[LIMBS - 1] > (int64_t)b.limb[LIMBS - 1];
+    }
+    for (int i = LIMBS - 2; i >= 0; i--) {
+        if (a.limb[i] != b.limb[i]) {
+            return a.limb[i] > b.limb[i];
+        }
+    }
+    return false;
+}
+
+// v, rounded towards zero to the bits we have. v must be within the FIXED_INTEGER_BITS.
+template <int LIMBS>
+inline Fixed<LIMBS> FixedFromDouble(double v) {
+    Fixed<LIMBS> r;
+    for (int i = 0; i < LIMBS; i++) {
+        r.limb[i] = 0;
+    }
+    if (v == 0.0) {
+        return r;
+    }
+    // |v| = mantissa * 2^(exponent - 53), with all 53 bits of the mantissa.
+    int exponent;
+    double m = frexp(fabs(v), &exponent);
+    uint64_t mantissa = (uint64_t)ldexp(m, 53);
+    int shift = exponent - 53 + Fixed<LIMBS>::FRACTION_BITS; // where the lowest bit of the mantissa goes.
+    for (int bit = 0; bit < 53; bit++) {
+        int at = shift + bit;
+        if (((mantissa >> bit) & 1) != 0 && at >= 0 && at < 64 * LIMBS) {
+            r.limb[at / 64] |= (uint64_t)1 << (at % 64);
+        }
+    }
+    return v < 0.0 ? FixedNegate(r) : r;
+}
+
+// The value of a decimal number like "-0.743643887037158704752191506114774", with any number of
+// digits. Returns false if it isn't one, or if it doesn't fit in the FIXED_INTEGER_BITS.
+template <int LIMBS>
+inline bool ParseFixed(const std::string& text, Fixed<LIMBS>* value) {
+    size_t i = 0;
+    bool negative = false;
+    if (i < text.size() && (text[i] == '-' || text[i] == '+')) {
+        negative = text[i] == '-';
+        i++;
+    }
+    size_t point = text.find('.', i);
+    std::string integerDigits = text.substr(i, point == std::string::npos ? std::string::npos : point - i);
+    std::string fractionDigits = point == std::string::npos ? "" : text.substr(point + 1);
+    if (integerDigits.empty() && fractionDigits.empty()) {
+        return false;
+    }
+    if (integerDigits.find_first_not_of("0123456789") != std::string::npos ||
+        fractionDigits.find_first_not_of("0123456789") != std::string::npos) {
+        return false;
+    }
+
+    // the fraction, from its last digit to its first: f = (f + digit) / 10. Dividing by 10 goes
+    // through the number 32 bits at a time, so that the remainder and the next bits fit in 64.
+    Fixed<LIMBS> f = FixedFromDouble<LIMBS>(0.0);
+    for (size_t d = fractionDigits.size(); d-- > 0;) {
+        f = FixedAdd(f, FixedFromDouble<LIMBS>((double)(fractionDigits[d] - '0')));
+        uint64_t remainder = 0;
+        for (int limb = LIMBS - 1; limb >= 0; limb--) {
+            uint64_t high = (remainder << 32) | (f.limb[limb] >> 32);
+            remainder = high % 10;
+            uint64_t low = (remainder << 32) | (f.limb[limb] & 0xFFFFFFFFu);
+            remainder = low % 10;
+            f.limb[limb] = ((high / 10) << 32) | (low / 10);
+        }
+    }
+
+    double integer = integerDigits.empty() ? 0.0 : atof(integerDigits.c_str());
+    if (integer >= ldexp(1.0, FIXED_INTEGER_BITS - 1)) {
+        return false;
+    }
+    Fixed<LIMBS> r = FixedAdd(FixedFromDouble<LIMBS>(integer), f);
+    *value = negative ? FixedNegate(r) : r;
+    return true;
+}
@@ -0,0 +1,205 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "fixed_point.h"
+
+//
+// Checks the arithmetic of fixed_point.h against a plain reference, that works on 32-bit digits, so
+// that every carry fits in a uint64_t without any intrinsics. It adds, subtracts, multiplies and
+// compares random numbers, and numbers made of the limbs where carries go wrong: all ones, only the
+// top bit, and so on.
+//
+// fixed_point.h multiplies and adds with mulx and adcx when it is compiled with -mbmi2 and -madx, and
+// with unsigned __int128 otherwise. So CMakeLists.txt builds this check both ways, as
+// fixed_point_check and fixed_point_check_bmi2, and CTest runs both.
+//
+
+// CTest skips a test that returns this, see SKIP_RETURN_CODE in CMakeLists.txt.
+const int EXIT_SKIPPED = 77;
+
+int iterations = 100000;
+uint64_t randomState = 0x9E3779B97F4A7C15ull;
+
+// xorshift64*, so that every run checks the same numbers.
+uint64_t Random() {
+    randomState ^= randomState >> 12;
+    randomState ^= randomState << 25;
+    randomState ^= randomState >> 27;
+    return randomState * 0x2545F4914F6CDD1Dull;
+}
+
+// a random limb, often one of those where carries start or stop.
+uint64_t RandomLimb() {
+    static const uint64_t EDGES[] = {
+        0, 1, ~0ull, ~0ull - 1, 0x8000000000000000ull, 0x7FFFFFFFFFFFFFFFull, 0xFFFFFFFF00000000ull, 0x00000000FFFFFFFFull
+    };
+    uint64_t r = Random();
+    return (r & 3) == 0 ? Random() : EDGES[(r >> 2) % (sizeof(EDGES) / sizeof(EDGES[0]))];
+}
+
+// The reference: a number of 2 * LIMBS digits of 32 bits, the least significant first.
+typedef std::vector<uint32_t> Digits;
+
+template <int LIMBS>
+Digits ToDigits(const Fixed<LIMBS>& a) {
+    Digits d(2 * LIMBS);
+    for (int i = 0; i < LIMBS; i++) {
+        d[2 * i] = (uint32_t)a.limb[i];
+        d[2 * i + 1] = (uint32_t)(a.limb[i] >> 32);
+    }
+    return d;
+}
+
+Digits DigitsAdd(const Digits& a, const Digits& b) {
+    Digits r(a.size());
+    uint64_t carry = 0;
+    for (size_t i = 0; i < a.size(); i++) {
+        uint64_t s = (uint64_t)a[i] + b[i] + carry;
+        r[i] = (uint32_t)s;
+        carry = s >> 32;
+    }
+    return r;
+}
+
+Digits DigitsSubtract(const Digits& a, const Digits& b) {
+    Digits r(a.size());
+    uint64_t borrow = 0;
+    for (size_t i = 0; i < a.size(); i++) {
+        uint64_t d = (uint64_t)a[i] - b[i] - borrow;
+        r[i] = (uint32_t)d;
+        borrow = (d >> 32) != 0 ? 1 : 0;
+    }
+    return r;
+}
+
+bool DigitsNegative(const Digits& a) {
+    return (a.back() >> 31) != 0;
+}
+
+Digits DigitsNegate(const Digits& a) {
+    return DigitsSubtract(Digits(a.size(), 0), a);
+}
+
+// a * b, rounded towards zero, with 'fractionBits' bits after the point.
+Digits DigitsMultiply(const Digits& a, const Digits& b, int fractionBits) {
+    bool negative = DigitsNegative(a) != DigitsNegative(b);
+    Digits ua = DigitsNegative(a) ? DigitsNegate(a) : a;
+    Digits ub = DigitsNegative(b) ? DigitsNegate(b) : b;
+
+    // 32 x 32 bits, plus a digit, plus the carry, fits in 64 bits.
+    size_t n = a.size();
+    Digits product(2 * n, 0);
+    for (size_t i = 0; i < n; i++) {
+        uint64_t carry = 0;
+        for (size_t j = 0; j < n; j++) {
+            uint64_t p = (uint64_t)ua[i] * ub[j] + product[i + j] + carry;
+            product[i + j] = (uint32_t)p;
+            carry = p >> 32;
+        }
+        product[i + n] = (uint32_t)carry;
+    }
+
+    // drop the lowest fractionBits bits, one bit at a time.
+    Digits r(n, 0);
+    for (size_t bit = 0; bit < 32 * n; bit++) {
+        size_t from = bit + (size_t)fractionBits;
+        if (from < 64 * n && ((product[from / 32] >> (from % 32)) & 1) != 0) {
+            r[bit / 32] |= 1u << (bit % 32);
+        }
+    }
+    return negative ? DigitsNegate(r) : r;
+}
+
+bool DigitsGreater(const Digits& a, const Digits& b) {
+    if (DigitsNegative(a) != DigitsNegative(b)) {
+        return DigitsNegative(b);
+    }
+    for (size_t i = a.size(); i-- > 0;) {
+        if (a[i] != b[i]) {
+            return a[i] > b[i];
+        }
+    }
+    return false;
+}
+
+template <int LIMBS>
+void PrintFixed(const char* name, const Fixed<LIMBS>& a) {
+    printf("  %s =", name);
+    for (int i = LIMBS - 1; i >= 0; i--) {
+        printf(" %016llx", (unsigned long long)a.limb[i]);
+    }
+    printf("\n");
+}
+
+template <int LIMBS>
+bool Check(const char* op, const Fixed<LIMBS>& a, const Fixed<LIMBS>& b, const Fixed<LIMBS>& result, const Digits& expected) {
+    if (ToDigits(result) == expected) {
+        return true;
+    }
+    printf("%d bits: %s is wrong\n", 64 * LIMBS, op);
+    PrintFixed("a", a);
+    PrintFixed("b", b);
+    PrintFixed("result", result);
+    Fixed<LIMBS> e;
+    for (int i = 0; i < LIMBS; i++) {
+        e.limb[i] = expected[2 * i] | ((uint64_t)expected[2 * i + 1] << 32);
+    }
+    PrintFixed("expected", e);
+    return false;
+}
+
+template <int LIMBS>
+bool CheckLimbs() {
+    for (int k = 0; k < iterations; k++) {
+        Fixed<LIMBS> a, b;
+        for (int i = 0; i < LIMBS; i++) {
+            a.limb[i] = RandomLimb();
+            b.limb[i] = RandomLimb();
+        }
+        Digits da = ToDigits(a), db = ToDigits(b);
+        if (!Check("a + b", a, b, FixedAdd(a, b), DigitsAdd(da, db)) ||
+            !Check("a - b", a, b, FixedSubtract(a, b), DigitsSubtract(da, db)) ||
+            !Check("-a", a, b, FixedNegate(a), DigitsNegate(da)) ||
+            !Check("a * b", a, b, FixedMultiply(a, b), DigitsMultiply(da, db, Fixed<LIMBS>::FRACTION_BITS))) {
+            return false;
+        }
+        if (FixedGreater(a, b) != DigitsGreater(da, db)) {
+            printf("%d bits: a > b is wrong\n", 64 * LIMBS);
+            PrintFixed("a", a);
+            PrintFixed("b", b);
+            return false;
+        }
+    }
+    printf("%d bits: %d additions, subtractions, negations, multiplications and comparisons are right\n", 64 * LIMBS, iterations);
+    return true;
+}
+
+int main(int argc, char** argv) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) {
+            iterations = atoi(argv[++i]);
+        } else {
+            printf("usage: fixed_point_check [--iterations N]\n");
+            exit(strcmp(argv[i], "--help") == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+        }
+    }
+
+#if (defined(__BMI2__) || defined(__ADX__)) && !defined(_MSC_VER)
+    __builtin_cpu_init();
+    if (!__builtin_cpu_supports("bmi2") || !__builtin_cpu_supports("adx")) {
+        printf("this CPU has no mulx or adcx, so the check that uses them is skipped\n");
+        return EXIT_SKIPPED;
+    }
+    printf("multiplying with mulx, adding with adcx\n");
+#elif defined(_MSC_VER)
+    printf("multiplying with _umul128, adding with _addcarry_u64\n");
+#else
+    printf("multiplying and adding with unsigned __int128\n");
+#endif
+
+    bool passed = CheckLimbs<2>() && CheckLimbs<4>();
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
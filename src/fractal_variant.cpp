@@ -0,0 +1,55 @@
+#include "fractal_variant.h"
+
+#include <cstdio>
+
+static const char* FORMULA_NAMES[FORMULA_COUNT] = { "mandelbrot", "julia", "burning-ship" };
+
+const char* GetFormulaName(FractalFormula formula) {
+    return FORMULA_NAMES[formula];
+}
+
+bool ParseFormula(const std::string& name, FractalFormula* formula) {
+    if (name == "multibrot") {
+        *formula = FORMULA_MANDELBROT;
+        return true;
+    }
+    for (int f = 0; f < FORMULA_COUNT; f++) {
+        if (name == FORMULA_NAMES[f]) {
+            *formula = (FractalFormula)f;
+            return true;
+        }
+    }
+    return false;
+}
+
+std::map<std::string, int> FractalVariant::GetConstants() const {
+    std::map<std::string, int> constants;
+    constants["FORMULA"] = (int)formula;
+    constants["POWER"] = power;
+    constants["M"] = iterations;
+    return constants;
+}
+
+std::string FractalVariant::GetName() const {
+    char buffer[128];
+    snprintf(buffer, sizeof(buffer), "%s^%d M=%d", GetFormulaName(formula), power, iterations);
+    return buffer;
+}
+
+void FractalVariant::GetCenter(float* x, float* y) const {
+    switch (formula) {
+    case FORMULA_JULIA:
+        *x = 0.0f;
+        *y = 0.0f;
+        break;
+    case FORMULA_BURNING_SHIP:
+        *x = -1.755f;
+        *y = -0.03f;
+        break;
+    default:
+        // the higher powers are symmetric around 0, and the original view is only nice for power 2.
+        *x = power == 2 ? -.745f : 0.0f;
+        *y = power == 2 ? .186f : 0.0f;
+        break;
+    }
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <map>
+#include <string>
+
+//
+// The fractal shader comes in many variants: one for every formula, power and iteration count.
+//
+// Instead of branching on those at runtime, in the innermost loop of the shader, each variant
+// is compiled as its own program, with the choices baked in as #defines (see shader_permutations.h,
+// which compiles them when they are first used). That way the compiler
+// sees constants, unrolls the complex power, and removes the code of the other formulas.
+// The CPU renderer, in cpu_fractal.h, does the same with templates.
+//
+
+// Must match the FORMULA_* defines in fractal.vert.
+enum FractalFormula {
+    FORMULA_MANDELBROT = 0,   // z = z^p + c, with z starting at 0. p > 2 gives the Multibrot sets.
+    FORMULA_JULIA = 1,        // z = z^p + k, with z starting at the pixel, and k constant.
+    FORMULA_BURNING_SHIP = 2, // z = (|Re z| + i|Im z|)^p + c.
+    FORMULA_COUNT
+};
+
+const int MIN_FRACTAL_POWER = 2;
+const int MAX_FRACTAL_POWER = 8;
+
+// the constant k of the Julia set.
+const float JULIA_C_X = -0.8f;
+const float JULIA_C_Y = 0.156f;
+
+struct FractalVariant {
+    FractalFormula formula = FORMULA_MANDELBROT;
+    int power = 2;
+    int iterations = 128; // M in the shader.
+
+    // The constants for the shader, FORMULA, POWER and M, as ShaderConstants.
+    std::map<std::string, int> GetConstants() const;
+    // Like "mandelbrot^2 M=128".
+    std::string GetName() const;
+    // Where the formula is interesting to look at.
+    void GetCenter(float* x, float* y) const;
+
+    bool operator==(const FractalVariant& o) const { return formula == o.formula && power == o.power && iterations == o.iterations; }
+};
+
+const char* GetFormulaName(FractalFormula formula);
+// Also accepts "multibrot", which is the Mandelbrot formula with a power above 2.
+// Returns false if there is no such formula.
+bool ParseFormula(const std::string& name, FractalFormula* formula);
@@ -0,0 +1,67 @@
+#include "frame_ring.h"
+#include "gl_util.h"
+
+#include <algorithm>
+#include <chrono>
+
+void FrameRing::Init(int count_) {
+    count = std::max(1, std::min(count_, (int)MAX_FRAMES_IN_FLIGHT));
+    slot = 0;
+    frame = 0;
+    waitMs = 0.0;
+    for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        fences[i] = 0;
+    }
+}
+
+void FrameRing::Destroy() {
+    for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        if (fences[i]) {
+            GL_C(glDeleteSync(fences[i]));
+            fences[i] = 0;
+        }
+    }
+}
+
+int FrameRing::BeginFrame() {
+    slot = (int)(frame % count);
+
+    GLsync fence = fences[slot];
+    if (fence) {
+        auto start = std::chrono::steady_clock::now();
+
+        // the first wait flushes the command stream, otherwise the fence might never be 
+        // submitted to the GPU, and we would wait forever. 
+        GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+        for (;;) {
+            GLenum result;
+            GL_C(result = glClientWaitSync(fence, flags, 1000 * 1000 * 1000));
+            if (result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED) {
+                break;
+            }
+            if (result == GL_WAIT_FAILED) {
+                printf("glClientWaitSync failed\n");
+                exit(1);
+            }
+            flags = 0; // GL_TIMEOUT_EXPIRED. keep waiting.
+        }
+
+        GL_C(glDeleteSync(fence));
+        fences[slot] = 0;
+
+        waitMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    return slot;
+}
+
+void FrameRing::EndFrame() {
+    GL_C(fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0));
+    frame++;
+}
+
+float FrameRing::TakeWaitMs() {
+    float ms = (float)waitMs;
+    waitMs = 0.0;
+    return ms;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <glad/glad.h>
+
+//
+// Lets the CPU work on several frames at once, without ever touching a resource the GPU is still using.
+//
+// Every resource that a frame writes, and that a later frame would otherwise have to wait for,
+// gets one copy per frame in flight, and frame N uses copy N % count. After submitting a frame,
+// we insert a fence into the GL command stream. And before we reuse a copy, 'count' frames later,
+// we wait on the fence of the frame that last used it. So the CPU can run up to 'count' frames ahead
+// of the GPU, but never further, and the GPU never has to wait for the previous frame to release
+// a resource.
+//
+class FrameRing {
+public:
+    static const int MAX_FRAMES_IN_FLIGHT = 3;
+
+    void Init(int count);
+    void Destroy();
+
+    // waits until the resources of the next slot are free, and returns that slot.
+    int BeginFrame();
+    // call after the last GL command of the frame has been submitted.
+    void EndFrame();
+
+    int GetCount() const { return count; }
+    int GetSlot() const { return slot; }
+
+    // total time the CPU spent waiting on fences since the last call, in milliseconds.
+    float TakeWaitMs();
+
+private:
+    int count = 1;
+    int slot = 0;
+    long long frame = 0;
+    GLsync fences[MAX_FRAMES_IN_FLIGHT] = {};
+    double waitMs = 0.0;
+};
@@ -0,0 +1,906 @@
+#include "gl_renderer.h"
+#include "clock.h"
+#include "gl_util.h"
+#include "gl_state.h"
+#include "gl_textures.h"
+#include "gpu_memory.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+const char* SCHEDULE_NAMES[SCHEDULE_COUNT] = { "one thread per pixel", "persistent threads", "Mariani-Silver" };
+
+// the programs with compile-time constants, like the fractal variants, and the filter radii.
+static const int MAX_SHADER_PERMUTATIONS = 32;
+
+// Some drivers stop loops that run too long, llvmpipe after 65535 iterations. So a persistent thread
+// doesn't take more work than it can finish in this many iterations, see fractal.vert.
+static const int PERSISTENT_MAX_STEPS = 60000;
+// Mariani-Silver: tiles of this many pixels, split in four this many times.
+static const int MARIANI_SILVER_TILE_SIZE = 128;
+static const int MARIANI_SILVER_LEVELS = 4;
+// how far, in pixels, the mirror image of a row may be from another row.
+static const float MIRROR_MAX_ROW_ERROR = 0.01f;
+static const int MIRROR_PIXELS_PER_THREAD = 8; // must match PIXELS_PER_THREAD in mirror.vert.
+
+// The rows of the Mariani-Silver tile states, for an image that is 'height' high: the rows of tiles
+// of every level, one level below the other. Must match TileStateCoord() in fractal.vert.
+static int GetTileStateHeight(int height) {
+    int rows = 0;
+    for (int level = 0; level < MARIANI_SILVER_LEVELS; level++) {
+        int size = MARIANI_SILVER_TILE_SIZE >> level;
+        rows += (height + size - 1) / size;
+    }
+    return rows;
+}
+
+bool GlRenderer::Init(const GlRendererConfig& config_) {
+    TraceZone zone("GlRenderer::Init");
+    config = config_;
+    if (!glfwInit()) {
+        printf("Could not initialize GLFW.\n");
+        return false;
+    }
+
+    // the hints of another backend, like GLFW_NO_API for Vulkan, must not stick.
+    glfwDefaultWindowHints();
+    glfwWindowHint(GLFW_RESIZABLE, GL_FALSE);
+    // we need opengl 4.2 for image load store.
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 2);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+
+    glfwWindowHint(GLFW_VISIBLE, config.visible ? GL_TRUE : GL_FALSE);
+    window = glfwCreateWindow(config.width, config.height, "Image Load Store Demo", NULL, NULL);
+    glfwWindowHint(GLFW_VISIBLE, GL_TRUE);
+    if (!window) {
+        printf("Could not create a window with an OpenGL 4.2 context.\n");
+        return false;
+    }
+    glfwMakeContextCurrent(window);
+    glState.Invalidate();
+    gpuMemory.SetContext(window);
+
+    // load GLAD.
+    gladLoadGLLoader((GLADloadproc)glfwGetProcAddress);
+    // and the GL 4.5 texture functions, if we have them.
+    InitTextureFunctions(config.directStateAccessEnabled);
+    printf("creating textures with %s\n", HasDirectStateAccess() ? "direct state access" : "glBindTexture, without direct state access");
+
+    // Bind and create VAO, otherwise, we can't do anything in OpenGL.
+    glGenVertexArrays(1, &vao);
+    glBindVertexArray(vao);
+
+    glfwGetFramebufferSize(window, &fbWidth, &fbHeight);
+
+    // we render at a lower resolution when the GPU can't keep up, but the texture is created
+    // at the largest resolution we will ever use, so that we never have to reallocate it.
+    dynamicResolution.Init(config.dynamicResolution);
+    int texWidth, texHeight;
+    dynamicResolution.GetRenderSize(fbWidth, fbHeight, &texWidth, &texHeight);
+    renderWidth = textureWidth = texWidth;
+    renderHeight = textureHeight = texHeight;
+
+    // the accumulation buffer needs more precision than 8 bits per channel,
+    // otherwise the average of many samples would be just as banded as a single sample.
+    historyTexture = CreateTexture2D(GL_RGBA32F, texWidth, texHeight, "history");
+
+    //
+    // create for image load/store usage.
+    // While the GPU is still displaying the texture of one frame, we can already render
+    // the next frame into another texture. So we create one texture per frame in flight.
+    //
+    frameRing.Init(config.framesInFlight);
+    for (int i = 0; i < frameRing.GetCount(); i++) {
+        // We must appearently use glTexStorage2D (or glTextureStorage2D) to set texture format, when using
+        // image load/store. The traditional 'glTexImage2D' absolutely won't work for some reason.
+        // We specify GL_RGBA8UI, so we get RGBA, with every channel an unsigned byte.
+        // so every color fits in an unsigned byte.
+        frameTextures[i] = CreateTexture2D(GL_RGBA8UI, texWidth, texHeight, "frame ring");
+    }
+
+    if (config.iterationStatsEnabled) {
+        iterationStats.Init(&shaderPermutations, texWidth, texHeight);
+    }
+    workCounterTexture = CreateTexture2D(GL_R32UI, 1, 1, "work queue");
+    tileIterationTexture = CreateTexture2D(GL_R32UI, texWidth, texHeight, "mariani-silver");
+    int smallestTile = MARIANI_SILVER_TILE_SIZE >> (MARIANI_SILVER_LEVELS - 1);
+    int tileStateHeight = GetTileStateHeight(texHeight);
+    tileStateTexture = CreateTexture2D(GL_R32UI, 2 * ((texWidth + smallestTile - 1) / smallestTile), tileStateHeight, "mariani-silver");
+    tileFillTexture = CreateTexture2D(GL_R32UI, (texWidth + smallestTile - 1) / smallestTile, (texHeight + smallestTile - 1) / smallestTile, "mariani-silver");
+    tileZeros.assign((size_t)2 * ((texWidth + smallestTile - 1) / smallestTile) * tileStateHeight, 0);
+    // the lists hold at most every tile of the levels but the last.
+    size_t tileListSize = 8 * (MARIANI_SILVER_LEVELS - 1);
+    for (int level = 0; level < MARIANI_SILVER_LEVELS - 1; level++) {
+        int size = MARIANI_SILVER_TILE_SIZE >> level;
+        tileListSize += (size_t)((texWidth + size - 1) / size) * ((texHeight + size - 1) / size);
+    }
+    GL_C(glGenBuffers(1, &tileListBuffer));
+    GL_C(glBindBuffer(GL_TEXTURE_BUFFER, tileListBuffer));
+    GL_C(glBufferData(GL_TEXTURE_BUFFER, (GLsizeiptr)(tileListSize * sizeof(GLuint)), NULL, GL_DYNAMIC_COPY));
+    GL_C(glBindBuffer(GL_TEXTURE_BUFFER, 0));
+    gpuMemory.AddBuffer(tileListBuffer, "mariani-silver", tileListSize * sizeof(GLuint));
+    GL_C(glGenTextures(1, &tileListTexture));
+    GL_C(glBindTexture(GL_TEXTURE_BUFFER, tileListTexture));
+    GL_C(glTexBuffer(GL_TEXTURE_BUFFER, GL_R32UI, tileListBuffer));
+    GL_C(glBindTexture(GL_TEXTURE_BUFFER, 0));
+
+    InitRenderGraph(texWidth, texHeight);
+    InitShaders();
+    timingCountdown = config.timingInterval;
+    return true;
+}
+
+// Several renderers can take turns on one thread, but the GL state cache only knows one context, and
+// gpuMemory must know whose names it is given.
+void GlRenderer::MakeCurrent() {
+    if (glfwGetCurrentContext() != window) {
+        glfwMakeContextCurrent(window);
+        glState.Invalidate();
+    }
+    gpuMemory.SetContext(window);
+}
+
+//
+// The passes of a frame. They are run by the render graph, which makes sure that they run in the
+// right order, with the right barriers in between. See InitRenderGraph().
+//
+
+// The uniforms of fractal.vert, for the frame being rendered.
+void GlRenderer::SetFractalUniforms(GLuint shader) {
+    glState.UseProgram(shader);
+    GL_C((glUniform2f(glGetUniformLocation(shader, "uCenter"), frameView.centerX, frameView.centerY)));
+    GL_C((glUniform1f(glGetUniformLocation(shader, "uScale"), frameView.scale)));
+    GL_C((glUniform2f(glGetUniformLocation(shader, "uJitter"), frameJitterX, frameJitterY)));
+    GL_C((glUniform2f(glGetUniformLocation(shader, "uJuliaC"), JULIA_C_X, JULIA_C_Y)));
+    GL_C((glUniform1i(glGetUniformLocation(shader, "uSampleCount"), historySampleCount)));
+    GL_C((glUniform1i(glGetUniformLocation(shader, "uWidth"), renderWidth)));
+    GL_C((glUniform1i(glGetUniformLocation(shader, "uHeight"), fractalRowCount)));
+    GL_C((glUniform1i(glGetUniformLocation(shader, "uFirstRow"), fractalFirstRow)));
+    GL_C((glUniform2i(glGetUniformLocation(shader, "uOrigin"), regionOriginX, regionOriginY)));
+    GL_C((glUniform2i(glGetUniformLocation(shader, "uImageSize"), imageWidth ? imageWidth : renderWidth, imageHeight ? imageHeight : renderHeight)));
+}
+
+// The first part of the fractal pass with Mariani-Silver: for every level of tiles, a pass that computes
+// the borders of the tiles, and one that lists the mixed tiles, whose children the next level looks at,
+// see fractal.vert. The final pass, with fractalShader, then fills in the pixels. The tile textures are
+// only used by the fractal pass, so the graph doesn't know about them.
+void GlRenderer::MarianiSilverPasses() {
+    // clear the states and the fills. The last frame's passes may still be reading them.
+    int smallestTile = MARIANI_SILVER_TILE_SIZE >> (MARIANI_SILVER_LEVELS - 1);
+    int smallestTilesX = (renderWidth + smallestTile - 1) / smallestTile;
+    GL_C(glMemoryBarrier(GL_TEXTURE_UPDATE_BARRIER_BIT));
+    UploadTexture2D(tileStateTexture, 2 * smallestTilesX, GetTileStateHeight(fractalRowCount), GL_RED_INTEGER, GL_UNSIGNED_INT, &tileZeros[0]);
+    UploadTexture2D(tileFillTexture, smallestTilesX, (fractalRowCount + smallestTile - 1) / smallestTile, GL_RED_INTEGER, GL_UNSIGNED_INT, &tileZeros[0]);
+    glState.BindImageTexture(1, tileIterationTexture, 0, GL_FALSE, 0, GL_READ_WRITE, GL_R32UI);
+    glState.BindImageTexture(2, tileFillTexture, 0, GL_FALSE, 0, GL_READ_WRITE, GL_R32UI);
+    glState.BindImageTexture(7, tileStateTexture, 0, GL_FALSE, 0, GL_READ_WRITE, GL_R32UI);
+
+    // the commands start out with no threads, and one instance. The lists are only read as far as the
+    // commands go, so they need no clearing.
+    std::vector<GLuint> commands(8 * (MARIANI_SILVER_LEVELS - 1), 0);
+    for (size_t c = 0; c < commands.size(); c += 4) {
+        commands[c + 1] = 1;
+    }
+    GL_C(glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT));
+    GL_C(glBindBuffer(GL_COPY_WRITE_BUFFER, tileListBuffer));
+    GL_C(glBufferSubData(GL_COPY_WRITE_BUFFER, 0, (GLsizeiptr)(commands.size() * sizeof(GLuint)), &commands[0]));
+    GL_C(glBindBuffer(GL_COPY_WRITE_BUFFER, 0));
+    glState.BindImageTexture(0, tileListTexture, 0, GL_FALSE, 0, GL_READ_WRITE, GL_R32UI);
+    GL_C(glBindBuffer(GL_DRAW_INDIRECT_BUFFER, tileListBuffer));
+
+    // the first level covers the whole band of rows.
+    int tileCount = ((renderWidth + MARIANI_SILVER_TILE_SIZE - 1) / MARIANI_SILVER_TILE_SIZE) *
+        ((fractalRowCount + MARIANI_SILVER_TILE_SIZE - 1) / MARIANI_SILVER_TILE_SIZE);
+    for (int level = 0; level < MARIANI_SILVER_LEVELS; level++) {
+        int size = MARIANI_SILVER_TILE_SIZE >> level;
+        SetFractalUniforms(fractalBorderShader);
+        GL_C((glUniform1i(glGetUniformLocation(fractalBorderShader, "uLevel"), level)));
+        if (level == 0) {
+            GL_C(glDrawArrays(GL_POINTS, 0, tileCount * 4 * size)); // a thread for every pixel on the edges of every tile.
+        } else {
+            GL_C(glDrawArraysIndirect(GL_POINTS, (const void*)(sizeof(GLuint) * 8 * (level - 1))));
+        }
+        // the next pass reads the states and the iterations this one wrote.
+        GL_C(glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT));
+
+        SetFractalUniforms(fractalClassifyShader);
+        GL_C((glUniform1i(glGetUniformLocation(fractalClassifyShader, "uLevel"), level)));
+        if (level == 0) {
+            GL_C(glDrawArrays(GL_POINTS, 0, tileCount)); // a thread for every tile.
+        } else {
+            GL_C(glDrawArraysIndirect(GL_POINTS, (const void*)(sizeof(GLuint) * (8 * (level - 1) + 4))));
+        }
+        // the next border pass is launched with the command this one wrote, and reads its list. And the
+        // final pass reads the fills.
+        GL_C(glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_COMMAND_BARRIER_BIT));
+    }
+    GL_C(glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0));
+}
+
+// The fractal pass with persistent threads, with 'shader', fractalShader, in use.
+void GlRenderer::PersistentThreadsPass(GLuint shader) {
+    // empty the queue. The last frame's threads took from it with image atomics, so we must wait for
+    // them before we overwrite it. The queue is only used by this pass, so the graph doesn't know about it.
+    const GLuint zero = 0;
+    GL_C(glMemoryBarrier(GL_TEXTURE_UPDATE_BARRIER_BIT));
+    UploadTexture2D(workCounterTexture, 1, 1, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+    glState.BindImageTexture(6, workCounterTexture, 0, GL_FALSE, 0, GL_READ_WRITE, GL_R32UI);
+
+    // a work item must fit in a thread, even if all its pixels take every iteration. And however few
+    // items the threads get, there must be enough threads for all of them. GetFractalSchedule() keeps
+    // the variants with more iterations than that away from this pass, so every thread gets an item.
+    int iterations = renderedVariant.iterations;
+    int itemSize = std::max(1, std::min(config.workItemSize, PERSISTENT_MAX_STEPS / iterations));
+    int itemCount = (GetPixelThreadCount(config.pixelOrder, renderWidth, fractalRowCount) + itemSize - 1) / itemSize;
+    int fewestItemsPerThread = std::max(1, PERSISTENT_MAX_STEPS / (itemSize * iterations));
+    int threadCount = std::max(config.persistentThreadCount, (itemCount + fewestItemsPerThread - 1) / fewestItemsPerThread);
+    GL_C((glUniform1i(glGetUniformLocation(shader, "uWorkItemSize"), itemSize)));
+    GL_C((glUniform1i(glGetUniformLocation(shader, "uMaxSteps"), PERSISTENT_MAX_STEPS)));
+    GL_C(glDrawArrays(GL_POINTS, 0, std::min(threadCount, itemCount)));
+}
+
+// The program of the mirror pass, or 0 if it hasn't been compiled yet.
+GLuint GlRenderer::GetMirrorShader() {
+    ShaderConstants constants;
+    if (config.iterationStatsEnabled) {
+        constants["ITERATION_IMAGE"] = 1;
+    }
+    return shaderPermutations.Get("mirror.vert", "empty.frag", constants);
+}
+
+// Decides which rows the fractal pass computes this frame, and which it copies from their mirror image.
+//
+// The Mandelbrot and Multibrot sets are symmetric about the real axis. Pixel y samples the imaginary
+// part centerY + ((y + originY + jitterY) / imageHeight - 0.5) * scale, so rows y and y' are mirror
+// images when y + y' is imageHeight * (1 - 2 * centerY / scale) - 2 * (originY + jitterY). That must be
+// a whole number, which it is for every view centered on the axis, at any scale. And we only mirror the
+// first sample of a view: the history of a pixel must be the mirror image of the history of the other,
+// which it isn't if earlier samples were computed. The first sample has no jitter, so neither does the sum.
+void GlRenderer::FindMirrorRows() {
+    fractalFirstRow = 0;
+    fractalRowCount = renderHeight;
+    mirrorFirstRow = 0;
+    mirrorRowCount = 0;
+    mirrorRowSum = 0;
+    if (!config.mirrorEnabled || renderedVariant.formula != FORMULA_MANDELBROT || historySampleCount != 0 || !GetMirrorShader()) {
+        return;
+    }
+    int imageRows = imageHeight ? imageHeight : renderHeight;
+    double sum = imageRows * (1.0 - 2.0 * (double)frameView.centerY / (double)frameView.scale) - 2.0 * regionOriginY;
+    // far from the image, the axis is of no use, and the sum may not fit in an int.
+    if (fabs(sum - floor(sum + 0.5)) > MIRROR_MAX_ROW_ERROR || fabs(sum) > 4.0 * renderHeight) {
+        return;
+    }
+    int rowSum = (int)floor(sum + 0.5);
+
+    // the axis is at row rowSum / 2. We compute the side with the most rows, including the row on the
+    // axis, if there is one, and copy the rows of the other side that have a mirror image in the image.
+    if (rowSum <= renderHeight - 1) {
+        // the rows below the axis.
+        mirrorFirstRow = 0;
+        mirrorRowCount = std::max(0, (rowSum + 1) / 2);
+        fractalFirstRow = mirrorRowCount;
+        fractalRowCount = renderHeight - mirrorRowCount;
+    } else {
+        // the rows above the axis.
+        mirrorFirstRow = rowSum / 2 + 1;
+        mirrorRowCount = std::max(0, renderHeight - mirrorFirstRow);
+        fractalRowCount = renderHeight - mirrorRowCount;
+    }
+    mirrorRowSum = rowSum;
+}
+
+// After the fractal pass has computed the band of rows, copies the rows of FindMirrorRows() from their
+// mirror images in the band.
+void GlRenderer::MirrorPass() {
+    if (mirrorRowCount == 0) {
+        return;
+    }
+    // we read what the fractal pass wrote.
+    GL_C(glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT));
+    glState.BindImageTexture(3, renderGraph.GetTexture(fractalImage), 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA8UI);
+    if (config.iterationStatsEnabled) {
+        glState.BindImageTexture(5, renderGraph.GetTexture(iterationImage), 0, GL_FALSE, 0, GL_READ_WRITE, GL_R32UI);
+    }
+
+    GLuint shader = GetMirrorShader();
+    glState.UseProgram(shader);
+    GL_C((glUniform1i(glGetUniformLocation(shader, "uWidth"), renderWidth)));
+    GL_C((glUniform1i(glGetUniformLocation(shader, "uFirstRow"), mirrorFirstRow)));
+    GL_C((glUniform1i(glGetUniformLocation(shader, "uRowSum"), mirrorRowSum)));
+    int threadsPerRow = (renderWidth + MIRROR_PIXELS_PER_THREAD - 1) / MIRROR_PIXELS_PER_THREAD;
+    GL_C(glDrawArrays(GL_POINTS, 0, threadsPerRow * mirrorRowCount));
+}
+
+// Pass 1: Render a fractal to the texture.
+// We are using attribute-less rendering to do this.
+// This means that we call
+// glDrawArrays(GL_POINTS, 0, N)
+// without actually sending any vertices.
+// The effect of this is that the vertex shader is launched N times.
+// So basically, we launch N threads on the GPU by doing this.
+// An alternative would be to use a compute shader, but that means we have to use
+// OpenGL 4.3. With attribute-less rendering we can get away with using only 4.2!
+//
+// And note that the fragment shader is just kept empty, and all the computations
+// are done in the vertex shader.
+//
+// Note that the fractal and filter passes run at the render resolution, which may be lower
+// than the window resolution, if the GPU is too slow. See UpdateRenderResolution().
+void GlRenderer::FractalPass() {
+    // we will only be writing to textures in the next two passes, and not to the screen framebuffer,
+    // so turn of color write and depth write for good measure.
+    glState.DepthMask(false);
+    glState.ColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+
+    // bind our texture to binding point 3. This means we can access it in our shaders using
+    // "layout(binding=3)"
+    glState.BindImageTexture(3, renderGraph.GetTexture(fractalImage), 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA8UI);
+    glState.BindImageTexture(4, renderGraph.GetTexture(historyImage), 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA32F);
+    if (config.iterationStatsEnabled) {
+        glState.BindImageTexture(5, renderGraph.GetTexture(iterationImage), 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32UI);
+    }
+
+    FindMirrorRows();
+    if (renderedSchedule == SCHEDULE_MARIANI_SILVER) {
+        MarianiSilverPasses();
+    }
+
+    GLuint shader = fractalShader;
+    SetFractalUniforms(shader);
+
+    if (renderedSchedule == SCHEDULE_PERSISTENT_THREADS) {
+        PersistentThreadsPass(shader);
+    } else {
+        // launch one thread for each pixel, and, unless we go row by row, for the padding, see pixel_order.h.
+        GL_C(glDrawArrays(GL_POINTS, 0, GetPixelThreadCount(config.pixelOrder, renderWidth, fractalRowCount)));
+    }
+    MirrorPass();
+}
+
+// Pass 2: Run the filter chain on the texture, by default a box filter blur.
+// The filters also use attribute-less rendering, and are added to the graph by the filter library.
+// Each filter reads from one texture, and writes the result to another. If it filtered
+// in place, some threads would read pixels that other threads have already filtered.
+
+// Pass 3: Finally, we display the filtered fractal texture.
+// So we do a fullscreen pass where we sample from the texture for every fragment.
+// If we rendered at a lower resolution, this pass also upscales to the window resolution.
+void GlRenderer::DisplayPass() {
+    // setup rendering to screen. re-enable color write and depth write.
+    glState.Viewport(0, 0, fbWidth, fbHeight);
+    glState.ClearColor(0.0f, 0.0f, 0.3f, 1.0f);
+    GL_C(glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT));
+    glState.DepthMask(true);
+    glState.ColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+
+    glState.BindImageTexture(3, renderGraph.GetTexture(blurredImage), 0, GL_FALSE, 0, GL_READ_ONLY, GL_RGBA8UI);
+
+    GLuint shader = displayShader;
+    glState.UseProgram(shader);
+    GL_C((glUniform1i(glGetUniformLocation(shader, "uWidth"), renderWidth)));
+    GL_C((glUniform1i(glGetUniformLocation(shader, "uHeight"), renderHeight)));
+    // we draw one big triangle that covers the screen. And the vertices are stored
+    // in the vertex shader, so we don't send any vertices. so no VBO.
+    GL_C(glDrawArrays(GL_TRIANGLES, 0, 3));
+}
+
+//
+// Declare the passes, and the images they use. To add a pass, write a method for it,
+// and add it here, with the images it reads and writes.
+//
+void GlRenderer::InitRenderGraph(int texWidth, int texHeight) {
+    // the fractal only lives until it has been filtered, so the graph can allocate it.
+    ImageDesc desc;
+    desc.format = GL_RGBA8UI;
+    desc.width = texWidth;
+    desc.height = texHeight;
+    fractalImage = renderGraph.CreateImage("fractal", desc);
+
+    // but the history lives across frames, the filtered image must stay around until it has
+    // been displayed, and the screen is the screen. So those are created outside the graph.
+    historyImage = renderGraph.ImportImage("history", GL_RGBA32F);
+    blurredImage = renderGraph.ImportImage("blurred", GL_RGBA8UI);
+    backbufferImage = renderGraph.ImportImage("backbuffer", GL_RGBA8);
+    renderGraph.SetImportedTexture(historyImage, historyTexture);
+    renderGraph.SetImportedTexture(backbufferImage, 0);
+
+    // the iterations are read back long after the frame, so they live outside the graph too.
+    if (config.iterationStatsEnabled) {
+        iterationImage = renderGraph.ImportImage("iterations", GL_R32UI);
+        renderGraph.SetImportedTexture(iterationImage, iterationStats.GetIterationTexture());
+    }
+
+    RenderGraph::Pass& fractalPass = renderGraph.AddPass("fractal", [this]() { FractalPass(); })
+        .Write(fractalImage, ACCESS_IMAGE_STORE)
+        .ReadWrite(historyImage, ACCESS_IMAGE_LOAD_STORE);
+    if (config.iterationStatsEnabled) {
+        fractalPass.Write(iterationImage, ACCESS_IMAGE_STORE);
+        iterationStats.AddToGraph(&renderGraph, iterationImage, &renderWidth, &renderHeight);
+    }
+    // the images between the filters are transient, just like the fractal.
+    filterLibrary.AddToGraph(&renderGraph, config.filterChain, fractalImage, blurredImage, desc, &renderWidth, &renderHeight);
+    renderGraph.AddPass("display", [this]() { DisplayPass(); })
+        .Read(blurredImage, ACCESS_IMAGE_LOAD)
+        .Write(backbufferImage, ACCESS_FRAMEBUFFER);
+
+    renderGraph.Compile();
+
+    gpuTimer.Init(renderGraph.GetPassCount());
+    for (int pass = 0; pass < renderGraph.GetPassCount(); pass++) {
+        gpuTimer.SetPassName(pass, renderGraph.GetPassName(pass));
+    }
+    renderGraph.SetTimer(&gpuTimer);
+}
+
+// The schedule the fractal pass uses for a variant. Mariani-Silver needs a connected set, and a
+// persistent thread must be able to finish a pixel within PERSISTENT_MAX_STEPS.
+FractalSchedule GlRenderer::GetFractalSchedule(const FractalVariant& variant) const {
+    if (config.schedule == SCHEDULE_MARIANI_SILVER && variant.formula != FORMULA_MANDELBROT) {
+        return SCHEDULE_PER_PIXEL;
+    }
+    if (config.schedule == SCHEDULE_PERSISTENT_THREADS && variant.iterations > PERSISTENT_MAX_STEPS) {
+        return SCHEDULE_PER_PIXEL;
+    }
+    return config.schedule;
+}
+
+void GlRenderer::SetPixelOrder(PixelOrder order) {
+    config.pixelOrder = order;
+    filterLibrary.SetPixelOrder(order);
+}
+
+// The constants of fractal.vert for a variant. The border passes of Mariani-Silver are a program of their own.
+ShaderConstants GlRenderer::GetFractalConstants(const FractalVariant& variant, FractalSchedule schedule, const char* marianiSilverPass) const {
+    ShaderConstants constants = variant.GetConstants();
+    if (config.iterationStatsEnabled) {
+        constants["ITERATION_IMAGE"] = 1;
+    }
+    if (schedule == SCHEDULE_PERSISTENT_THREADS) {
+        constants["PERSISTENT_THREADS"] = 1;
+    }
+    if (schedule == SCHEDULE_MARIANI_SILVER) {
+        constants["MARIANI_SILVER"] = 1;
+        constants["TILE_SIZE"] = MARIANI_SILVER_TILE_SIZE;
+        constants["TILE_LEVELS"] = MARIANI_SILVER_LEVELS;
+        if (marianiSilverPass) {
+            constants[marianiSilverPass] = 1; // BORDER_PASS or CLASSIFY_PASS.
+        }
+    }
+    constants["PIXEL_ORDER"] = config.pixelOrder;
+    return constants;
+}
+
+// The programs of the fractal pass for a variant, or false if they haven't been compiled yet.
+bool GlRenderer::GetFractalShaders(const FractalVariant& variant, FractalSchedule schedule, GLuint* shader, GLuint* borderShader, GLuint* classifyShader) {
+    *shader = shaderPermutations.Get("fractal.vert", "empty.frag", GetFractalConstants(variant, schedule));
+    *borderShader = 0;
+    *classifyShader = 0;
+    if (schedule == SCHEDULE_MARIANI_SILVER) {
+        *borderShader = shaderPermutations.Get("fractal.vert", "empty.frag", GetFractalConstants(variant, schedule, "BORDER_PASS"));
+        *classifyShader = shaderPermutations.Get("fractal.vert", "empty.frag", GetFractalConstants(variant, schedule, "CLASSIFY_PASS"));
+        return *shader != 0 && *borderShader != 0 && *classifyShader != 0;
+    }
+    return *shader != 0;
+}
+
+// Use the program of the wanted variant. Returns true if the program changed,
+// because the variant changed, or because the program was reloaded.
+bool GlRenderer::UpdateFractalShader() {
+    GLuint shader, borderShader, classifyShader;
+    FractalSchedule schedule = GetFractalSchedule(wantedVariant);
+    if (GetFractalShaders(wantedVariant, schedule, &shader, &borderShader, &classifyShader)) {
+        renderedVariant = wantedVariant;
+        renderedSchedule = schedule;
+    } else if (!(renderedVariant == wantedVariant) || renderedSchedule != schedule) {
+        if (!GetFractalShaders(renderedVariant, renderedSchedule, &shader, &borderShader, &classifyShader)) {
+            shader = 0;
+        }
+    } else {
+        shader = 0;
+    }
+    bool changed = shader != fractalShader || borderShader != fractalBorderShader || classifyShader != fractalClassifyShader;
+    fractalShader = shader;
+    fractalBorderShader = borderShader;
+    fractalClassifyShader = classifyShader;
+    return changed;
+}
+
+//
+// The shaders are in config.shaderDirectory. They are compiled on a background thread,
+// and reloaded whenever you edit them, so you can play with them while the demo runs.
+//
+// fractal.vert renders the fractal to the texture. It is built into one program for every
+// formula, power and iteration count, when that variant is first used.
+// the filter_*.vert shaders filter the texture, see filter_library.h. They also get a program
+// for every radius.
+// display.vert and display.frag display the texture to the screen.
+//
+// The linked programs are saved in the shader cache, so the next run starts faster.
+//
+// The Vulkan backend has its own shaders, in shaders/vulkan, see vulkan_renderer.h.
+//
+void GlRenderer::InitShaders() {
+    shaderReloader.Init(window, config.shaderDirectory);
+    if (config.shaderCacheEnabled && programBinaryCache.Init(config.shaderCacheDirectory)) {
+        shaderReloader.SetBinaryCache(&programBinaryCache);
+    }
+    shaderPermutations.Init(&shaderReloader, MAX_SHADER_PERMUTATIONS);
+    filterLibrary.Init(&shaderPermutations);
+    filterLibrary.SetPixelOrder(config.pixelOrder);
+    displayProgram = shaderReloader.AddProgram("display.vert", "display.frag");
+    shaderReloader.Start();
+}
+
+// swap in the shaders that have been (re)compiled since the last frame.
+void GlRenderer::UpdateShaders() {
+    if (shaderReloader.Update()) {
+        displayShader = shaderReloader.GetProgram(displayProgram);
+        historySampleCount = 0; // the old samples were made with the old shader.
+    }
+    if (UpdateFractalShader()) {
+        historySampleCount = 0;
+    }
+}
+
+// true once every program of a frame is there, the fractal of renderedVariant, the display, and the filters.
+// ask for the filter programs even if the others aren't ready, so that they are compiled at the same time.
+bool GlRenderer::ShadersReady() {
+    bool filtersReady = filterLibrary.IsReady(config.filterChain);
+    bool statsReady = !config.iterationStatsEnabled || iterationStats.IsReady();
+    bool mirrorReady = !config.mirrorEnabled || GetMirrorShader() != 0;
+    return fractalShader && displayShader && filtersReady && statsReady && mirrorReady;
+}
+
+void GlRenderer::WaitForShaders(const FractalVariant& variant) {
+    MakeCurrent();
+    wantedVariant = variant;
+    UpdateShaders();
+    while (!ShadersReady() || !(renderedVariant == wantedVariant) || renderedSchedule != GetFractalSchedule(wantedVariant)) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        UpdateShaders();
+    }
+}
+
+bool GlRenderer::Render(const View& view) {
+    // the shaders are compiled in the background. Until they are all ready, we just clear the screen.
+    if (!ShadersReady()) {
+        glState.Viewport(0, 0, fbWidth, fbHeight);
+        glState.ClearColor(0.0f, 0.0f, 0.3f, 1.0f);
+        GL_C(glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT));
+        return false;
+    }
+
+    // wait until the GPU is done with the texture we are about to overwrite.
+    // Normally it finished long ago, so this doesn't wait at all.
+    int slot = frameRing.BeginFrame();
+    renderGraph.SetImportedTexture(blurredImage, frameTextures[slot]);
+
+    gpuTimer.BeginFrame();
+
+    // when anything that changes the image changes, we must throw away the accumulated samples.
+    frameView = view;
+    if (!(frameView == historyView) || renderWidth != historyWidth || renderHeight != historyHeight) {
+        historySampleCount = 0;
+        historyView = frameView;
+        historyWidth = renderWidth;
+        historyHeight = renderHeight;
+    }
+    // a new sample position inside the pixel for every frame. The first sample after a reset
+    // is at the pixel corner, just like without accumulation.
+    frameJitterX = Halton(historySampleCount, 2);
+    frameJitterY = Halton(historySampleCount, 3);
+
+    renderGraph.Execute();
+
+    historySampleCount = historySampleCount < MAX_HISTORY_SAMPLES ? historySampleCount + 1 : MAX_HISTORY_SAMPLES;
+
+    gpuTimer.EndFrame();
+    frameRing.EndFrame();
+
+    // the graph, once, along with the timings.
+    if (!printedGraph && config.timingInterval > 0) {
+        renderGraph.Print();
+        printedGraph = true;
+    }
+    return true;
+}
+
+//
+// Let the dynamic resolution controller pick the render resolution of the next frame,
+// from the latest GPU timings. Also prints the timings every config.timingInterval frames.
+//
+void GlRenderer::UpdateRenderResolution() {
+    if (gpuTimer.GetResultCount() == lastResultCount) {
+        return; // no new timings since last time.
+    }
+    lastResultCount = gpuTimer.GetResultCount();
+
+    if (config.dynamicResolutionEnabled) {
+        dynamicResolution.Update(gpuTimer.GetTotalMs());
+        dynamicResolution.GetRenderSize(fbWidth, fbHeight, &renderWidth, &renderHeight);
+    }
+
+    if (config.timingInterval > 0 && --timingCountdown <= 0) {
+        timingCountdown = config.timingInterval;
+        printf("gpu %.2f ms (", gpuTimer.GetTotalMs());
+        for (int pass = 0; pass < renderGraph.GetPassCount(); pass++) {
+            printf("%s%s %.2f", pass == 0 ? "" : ", ", renderGraph.GetPassName(pass).c_str(), gpuTimer.GetPassMs(pass));
+        }
+        printf("), render resolution %dx%d (scale %.2f), cpu waited %.2f ms for %d frames in flight, %d of %d state changes elided\n",
+            renderWidth, renderHeight, dynamicResolution.GetScale(), frameRing.TakeWaitMs(), frameRing.GetCount(),
+            glState.GetElidedCount(), glState.GetCallCount());
+
+        // the fractal pass should run the vertex shader once per pixel, or once per persistent thread, and nothing else.
+        if (gpuTimer.HasStatistics()) {
+            printf("shader invocations, vertex/fragment/compute (");
+            for (int pass = 0; pass < renderGraph.GetPassCount(); pass++) {
+                printf("%s%s %llu/%llu/%llu", pass == 0 ? "" : ", ", renderGraph.GetPassName(pass).c_str(),
+                    (unsigned long long)gpuTimer.GetPassStatistic(pass, GpuTimer::STATISTIC_VERTEX_SHADER),
+                    (unsigned long long)gpuTimer.GetPassStatistic(pass, GpuTimer::STATISTIC_FRAGMENT_SHADER),
+                    (unsigned long long)gpuTimer.GetPassStatistic(pass, GpuTimer::STATISTIC_COMPUTE_SHADER));
+            }
+            printf("), %d pixels at the render resolution\n", renderWidth * renderHeight);
+        }
+
+        // this reads back the statistics, so it waits for the GPU, but only once in a while.
+        if (config.iterationStatsEnabled) {
+            IterationSummary summary;
+            iterationStats.Summarize(historyWidth, historyHeight, &summary);
+            printf("iterations: mean %.1f, max %d, SIMD lane efficiency %.0f%% in 8x8 tiles, %.0f%% in 32x1 rows\n",
+                summary.meanIterations, summary.maxIterations, 100.0 * summary.laneEfficiency[GROUP_8X8],
+                100.0 * summary.laneEfficiency[GROUP_32X1]);
+        }
+    }
+}
+
+bool GlRenderer::RenderFrame(const FrameParams& params) {
+    MakeCurrent();
+    if (config.waitForShaders) {
+        WaitForShaders(params.variant);
+    } else {
+        wantedVariant = params.variant;
+        UpdateShaders();
+    }
+
+    bool rendered = Render(params.view);
+    glState.EndFrame();
+    hasFrame = hasFrame || rendered;
+
+    {
+        TraceZone zone("glfwSwapBuffers");
+        glfwSwapBuffers(window);
+    }
+
+    UpdateRenderResolution();
+    shaderPermutations.Update();
+    return rendered;
+}
+
+bool GlRenderer::ReadLastFrame(CpuImage* image) {
+    return BeginReadLastFrame() && FinishReadLastFrame(image);
+}
+
+bool GlRenderer::BeginReadLastFrame() {
+    if (!hasFrame) {
+        return false;
+    }
+    MakeCurrent();
+    size_t size = (size_t)fbWidth * fbHeight * 4;
+    if (!readbackBuffer) {
+        GL_C(glGenBuffers(1, &readbackBuffer));
+        GL_C(glBindBuffer(GL_PIXEL_PACK_BUFFER, readbackBuffer));
+        GL_C(glBufferData(GL_PIXEL_PACK_BUFFER, (GLsizeiptr)size, NULL, GL_STREAM_READ));
+        gpuMemory.AddBuffer(readbackBuffer, "readback", size);
+    }
+    if (readbackFence) {
+        GL_C(glDeleteSync(readbackFence));
+    }
+
+    // the back buffer is undefined after the swap, so we display the last frame once more, and read that.
+    // With a pack buffer bound, glReadPixels() only starts the copy, and returns.
+    DisplayPass();
+    GL_C(glBindBuffer(GL_PIXEL_PACK_BUFFER, readbackBuffer));
+    GL_C(glPixelStorei(GL_PACK_ALIGNMENT, 1));
+    GL_C(glReadPixels(0, 0, fbWidth, fbHeight, GL_RGBA, GL_UNSIGNED_BYTE, (void*)0));
+    GL_C(glBindBuffer(GL_PIXEL_PACK_BUFFER, 0));
+    readbackFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    // so that the GPU starts on it, even if no one asks for it before the next frame.
+    GL_C(glFlush());
+    return true;
+}
+
+bool GlRenderer::IsReadLastFrameDone() {
+    if (!readbackFence) {
+        return true;
+    }
+    MakeCurrent();
+    GLint status = GL_UNSIGNALED;
+    GL_C(glGetSynciv(readbackFence, GL_SYNC_STATUS, 1, NULL, &status));
+    return status == GL_SIGNALED;
+}
+
+bool GlRenderer::FinishReadLastFrame(CpuImage* image) {
+    if (!readbackFence) {
+        return false;
+    }
+    MakeCurrent();
+    GLenum result = glClientWaitSync(readbackFence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+    while (result == GL_TIMEOUT_EXPIRED) {
+        result = glClientWaitSync(readbackFence, 0, 1000000000);
+    }
+    GL_C(glDeleteSync(readbackFence));
+    readbackFence = 0;
+    if (result == GL_WAIT_FAILED) {
+        return false;
+    }
+
+    image->Resize(fbWidth, fbHeight);
+    GL_C(glBindBuffer(GL_PIXEL_PACK_BUFFER, readbackBuffer));
+    const void* pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, (GLsizeiptr)image->pixels.size(), GL_MAP_READ_BIT);
+    if (pixels) {
+        memcpy(&image->pixels[0], pixels, image->pixels.size());
+        GL_C(glUnmapBuffer(GL_PIXEL_PACK_BUFFER));
+    }
+    GL_C(glBindBuffer(GL_PIXEL_PACK_BUFFER, 0));
+    return pixels != NULL;
+}
+
+// The frame of RenderStill() and the benchmarks: the first sample of the view, with the shaders of the variant.
+void GlRenderer::BeginStill(const FrameParams& params) {
+    WaitForShaders(params.variant);
+    frameView = params.view;
+    frameJitterX = 0.0f;
+    frameJitterY = 0.0f;
+    historySampleCount = 0;
+}
+
+void GlRenderer::RenderStill(const FrameParams& params, CpuImage* image) {
+    BeginStill(params);
+    renderGraph.SetImportedTexture(blurredImage, frameTextures[0]);
+    gpuTimer.BeginFrame();
+    renderGraph.Execute();
+    gpuTimer.EndFrame();
+    glState.EndFrame();
+    ReadStill(frameTextures[0], image);
+}
+
+void GlRenderer::RenderFractalStill(const FrameParams& params, CpuImage* image) {
+    BeginStill(params);
+    FractalPass();
+    ReadStill(renderGraph.GetTexture(fractalImage), image);
+}
+
+// Reads the still back from 'texture'. The textures are as large as the largest render resolution,
+// so the still is only their bottom left corner.
+void GlRenderer::ReadStill(GLuint texture, CpuImage* image) {
+    std::vector<unsigned char> pixels((size_t)textureWidth * textureHeight * 4);
+    GL_C(glMemoryBarrier(GL_TEXTURE_UPDATE_BARRIER_BIT));
+    ReadTexture2D(texture, GL_RGBA_INTEGER, GL_UNSIGNED_BYTE, (int)pixels.size(), &pixels[0]);
+    image->Resize(renderWidth, renderHeight);
+    for (int y = 0; y < renderHeight; y++) {
+        memcpy(image->At(0, y), &pixels[(size_t)y * textureWidth * 4], (size_t)renderWidth * 4);
+    }
+}
+
+void GlRenderer::SetRegion(int imageWidth_, int imageHeight_, int originX, int originY, int width, int height) {
+    imageWidth = imageWidth_;
+    imageHeight = imageHeight_;
+    regionOriginX = originX;
+    regionOriginY = originY;
+    renderWidth = width;
+    renderHeight = height;
+}
+
+// The fastest of TIMING_RUNS runs of 'run', in milliseconds. 'prepare' is called before every
+// run, and isn't timed. Timed with a GL_TIME_ELAPSED query, or, once that has said less than half of
+// the time from before the draw to after glFinish(), with the clock of the CPU. llvmpipe, for one, runs
+// vertex shaders outside its queries, but not fragment shaders, so a frame with the display pass gets
+// a time that is too short, but not short enough to tell. Hence we stop trusting the query for good.
+double GlRenderer::TimeGpuWork(const std::function<void()>& prepare, const std::function<void()>& run) {
+    // the passes of the graph would start queries of their own.
+    renderGraph.SetTimer(NULL);
+    GLuint query;
+    GL_C(glGenQueries(1, &query));
+    // the fastest run by either clock, since a later run may be the one that shows the query misses work.
+    double bestQueryMs = 1e30, bestCpuMs = 1e30;
+    // the first run is a warmup.
+    for (int i = 0; i <= TIMING_RUNS; i++) {
+        prepare();
+        GL_C(glFinish());
+        double begin = GetSeconds();
+        GL_C(glBeginQuery(GL_TIME_ELAPSED, query));
+        run();
+        GL_C(glEndQuery(GL_TIME_ELAPSED));
+        GLuint64 ns = 0;
+        GL_C(glGetQueryObjectui64v(query, GL_QUERY_RESULT, &ns));
+        GL_C(glFinish());
+        double cpuMs = (GetSeconds() - begin) * 1000.0;
+        queryMissesWork = queryMissesWork || (double)ns * 1e-6 < 0.5 * cpuMs;
+        if (i > 0) {
+            bestQueryMs = std::min(bestQueryMs, (double)ns * 1e-6);
+            bestCpuMs = std::min(bestCpuMs, cpuMs);
+        }
+    }
+    GL_C(glDeleteQueries(1, &query));
+    renderGraph.SetTimer(&gpuTimer);
+    return queryMissesWork ? bestCpuMs : bestQueryMs;
+}
+
+double GlRenderer::TimeFractalPass(const FrameParams& params, CpuImage* image) {
+    BeginStill(params);
+    double best = TimeGpuWork([this, image]() {
+        // start from black, so that pixels the pass doesn't write show up as different. The upload
+        // must wait for the image stores of the previous run, which the barrier makes it do.
+        image->Resize(renderWidth, renderHeight);
+        GL_C(glMemoryBarrier(GL_TEXTURE_UPDATE_BARRIER_BIT));
+        UploadTexture2D(renderGraph.GetTexture(fractalImage), renderWidth, renderHeight, GL_RGBA_INTEGER, GL_UNSIGNED_BYTE, &image->pixels[0]);
+    }, [this]() { FractalPass(); });
+
+    ReadStill(renderGraph.GetTexture(fractalImage), image);
+    return best;
+}
+
+double GlRenderer::TimeFrame(const FrameParams& params, CpuImage* image) {
+    BeginStill(params);
+    renderGraph.SetImportedTexture(blurredImage, frameTextures[0]);
+    double best = TimeGpuWork([this]() { historySampleCount = 0; }, [this]() { renderGraph.Execute(); });
+    ReadStill(frameTextures[0], image);
+    return best;
+}
+
+bool GlRenderer::WriteHeatmaps(const std::string& prefix) {
+    if (!config.iterationStatsEnabled || !hasFrame) {
+        return false;
+    }
+    MakeCurrent();
+    // the last frame was rendered at historyWidth x historyHeight, and renderWidth may have changed since.
+    return iterationStats.WriteHeatmaps(prefix, historyWidth, historyHeight, renderedVariant.iterations);
+}
+
+void GlRenderer::Destroy() {
+    if (!window) {
+        return;
+    }
+    MakeCurrent();
+    shaderReloader.Destroy();
+    if (programBinaryCache.IsEnabled()) {
+        printf("shader cache: %d programs loaded, %d compiled\n", programBinaryCache.GetHits(), programBinaryCache.GetMisses());
+    }
+
+    // the context takes everything with it, but the memory we counted must go too.
+    renderGraph.Destroy();
+    gpuTimer.Destroy();
+    frameRing.Destroy();
+    if (config.iterationStatsEnabled) {
+        iterationStats.Destroy();
+    }
+    DeleteTextures2D(frameRing.GetCount(), frameTextures);
+    GLuint textures[] = { historyTexture, workCounterTexture, tileIterationTexture, tileStateTexture, tileFillTexture };
+    DeleteTextures2D(5, textures);
+    glState.DeleteTextures(1, &tileListTexture);
+    gpuMemory.RemoveBuffer(tileListBuffer);
+    GL_C(glDeleteBuffers(1, &tileListBuffer));
+    if (readbackBuffer) {
+        gpuMemory.RemoveBuffer(readbackBuffer);
+        GL_C(glDeleteBuffers(1, &readbackBuffer));
+        readbackBuffer = 0;
+    }
+    if (readbackFence) {
+        GL_C(glDeleteSync(readbackFence));
+        readbackFence = 0;
+    }
+    GL_C(glDeleteVertexArrays(1, &vao));
+
+    glfwDestroyWindow(window);
+    window = NULL;
+    // the next context starts with the defaults, whatever the cache says.
+    glState.Invalidate();
+}
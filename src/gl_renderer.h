@@ -0,0 +1,230 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "renderer.h"
+#include "fractal_variant.h"
+#include "pixel_order.h"
+#include "shader_reloader.h"
+#include "shader_permutations.h"
+#include "program_binary_cache.h"
+#include "render_graph.h"
+#include "filter_library.h"
+#include "gpu_timer.h"
+#include "dynamic_resolution.h"
+#include "frame_ring.h"
+#include "iteration_stats.h"
+
+// How the fractal pass spreads the pixels over the threads.
+enum FractalSchedule {
+    SCHEDULE_PER_PIXEL,
+    // instead of a thread per pixel, the fractal pass launches persistentThreadCount threads, that
+    // take workItemSize pixels at a time from a queue, until the frame is done. That keeps the SIMD
+    // lanes busy when some pixels take far more iterations than others, see fractal.vert.
+    SCHEDULE_PERSISTENT_THREADS,
+    // first the borders of tiles, and then only the inside of the tiles whose border has more than one
+    // iteration count, see fractal.vert. Only for the Mandelbrot formula, the others get a thread per pixel.
+    SCHEDULE_MARIANI_SILVER,
+    SCHEDULE_COUNT
+};
+extern const char* SCHEDULE_NAMES[SCHEDULE_COUNT];
+
+struct GlRendererConfig {
+    int width = 0; // the size of the window, and of the frames.
+    int height = 0;
+    // an offscreen renderer gets a hidden window, just for its GL context. Its frames can only be
+    // seen with ReadLastFrame().
+    bool visible = true;
+    std::string shaderDirectory = "shaders";
+    std::string shaderCacheDirectory = ".shader_cache";
+    bool shaderCacheEnabled = true;
+    bool directStateAccessEnabled = true; // use GL 4.5 direct state access for textures, if we have it.
+    // the filters between the fractal and the screen, see filter_library.h. There must be at least one,
+    // since the last one writes the image that the display pass shows.
+    std::vector<FilterInstance> filterChain;
+    DynamicResolutionConfig dynamicResolution;
+    bool dynamicResolutionEnabled = true;
+    int framesInFlight = 2; // 1 to FrameRing::MAX_FRAMES_IN_FLIGHT.
+    FractalSchedule schedule = SCHEDULE_PER_PIXEL;
+    int persistentThreadCount = 65536;
+    int workItemSize = 32;
+    bool mirrorEnabled = true; // see FindMirrorRows().
+    PixelOrder pixelOrder = PIXEL_ORDER_ROWS; // see pixel_order.h.
+    bool iterationStatsEnabled = false; // see iteration_stats.h, also for the most iterations it counts.
+    // the shaders are compiled in the background, and while the variant of a frame is compiling,
+    // RenderFrame() renders the last variant that was ready, like the demo does when you press F.
+    // With this, it waits for the variant instead, so every frame is of the variant it was given.
+    bool waitForShaders = false;
+    int timingInterval = 60; // print the GPU timings every this many frames. 0 never prints them.
+};
+
+//
+// The OpenGL backend, the one the demo is about: the fractal pass, the filter chain, and the display
+// pass, run by a render graph, see InitRenderGraph(). Everything it needs lives in the renderer,
+// so several of them can run in one process, like in a service that renders for many clients.
+//
+// Every renderer has a window of its own, for its GL context, and makes it current when it is called.
+// So all the calls must come from one thread, the one GLFW runs on. Init() initializes GLFW, if it
+// isn't yet, and it stays initialized: glfwTerminate() is for when all the renderers are gone.
+// The GL functions are loaded once, so the renderers of a process must all be on the same driver.
+//
+class GlRenderer : public Renderer {
+public:
+    static const int TIMING_RUNS = 5; // of TimeFractalPass() and TimeFrame().
+
+    // Creates the window, and the textures, and starts compiling the shaders. Returns false, and
+    // prints why, if there is no GL 4.2 context.
+    bool Init(const GlRendererConfig& config);
+
+    const char* GetName() const override { return "OpenGL"; }
+    bool RenderFrame(const FrameParams& params) override;
+    bool ReadLastFrame(CpuImage* image) override;
+    bool BeginReadLastFrame() override;
+    bool IsReadLastFrameDone() override;
+    bool FinishReadLastFrame(CpuImage* image) override;
+    const FractalVariant& GetRenderedVariant() const override { return renderedVariant; }
+    void Destroy() override;
+
+    GLFWwindow* GetWindow() const { return window; }
+    FilterLibrary* GetFilterLibrary() { return &filterLibrary; }
+
+    // The schedule of the fractal pass. The one a variant really gets, since Mariani-Silver needs
+    // a connected set, and persistent threads a limit on the iterations, is GetFractalSchedule().
+    FractalSchedule GetSchedule() const { return config.schedule; }
+    void SetSchedule(FractalSchedule schedule) { config.schedule = schedule; }
+    FractalSchedule GetFractalSchedule(const FractalVariant& variant) const;
+    void SetPixelOrder(PixelOrder order);
+
+    // Waits until the programs of 'variant' and the filter chain are compiled.
+    void WaitForShaders(const FractalVariant& variant);
+
+    //
+    // For the modes that render a few images, and check or time them, instead of running the demo.
+    // These render the fractal and the filters once, of params.view, at the render resolution,
+    // without displaying it. One sample per pixel, at the corner, like the first frame of the
+    // animation, so that it can be compared with the CPU. They wait for the shaders and for the GPU.
+    //
+
+    // Reads back the filtered frame, renderWidth x renderHeight, the bottom left corner of its texture.
+    void RenderStill(const FrameParams& params, CpuImage* image);
+    // Like RenderStill(), but only the fractal pass, before any filtering.
+    void RenderFractalStill(const FrameParams& params, CpuImage* image);
+    // Renders only a region of a larger image from now on: the one that is 'width' x 'height', at
+    // (originX, originY) in an image of imageWidth x imageHeight. It must fit in the window.
+    void SetRegion(int imageWidth, int imageHeight, int originX, int originY, int width, int height);
+    // The fastest of TIMING_RUNS runs of the fractal pass, in milliseconds, and its pixels.
+    double TimeFractalPass(const FrameParams& params, CpuImage* image);
+    // Like RenderStill(), the fastest of TIMING_RUNS runs of the whole frame, the display pass too.
+    double TimeFrame(const FrameParams& params, CpuImage* image);
+
+    // Writes the heatmaps of the iterations of the last frame, see IterationStats::WriteHeatmaps().
+    // Returns false if there is no frame, or they couldn't be written.
+    bool WriteHeatmaps(const std::string& prefix);
+
+private:
+    void MakeCurrent();
+    void InitRenderGraph(int texWidth, int texHeight);
+    void InitShaders();
+    void UpdateShaders();
+    ShaderConstants GetFractalConstants(const FractalVariant& variant, FractalSchedule schedule, const char* marianiSilverPass = NULL) const;
+    bool GetFractalShaders(const FractalVariant& variant, FractalSchedule schedule, GLuint* shader, GLuint* borderShader, GLuint* classifyShader);
+    bool UpdateFractalShader();
+    bool ShadersReady();
+
+    void SetFractalUniforms(GLuint shader);
+    void MarianiSilverPasses();
+    void PersistentThreadsPass(GLuint shader);
+    GLuint GetMirrorShader();
+    void FindMirrorRows();
+    void MirrorPass();
+    void FractalPass();
+    void DisplayPass();
+
+    bool Render(const View& view);
+    void BeginStill(const FrameParams& params);
+    double TimeGpuWork(const std::function<void()>& prepare, const std::function<void()>& run);
+    void ReadStill(GLuint texture, CpuImage* image);
+    void UpdateRenderResolution();
+
+    GlRendererConfig config;
+    GLFWwindow* window = NULL;
+    GLuint vao = 0;
+    int fbWidth = 0, fbHeight = 0; // frame buffer dimensions.
+    int renderWidth = 0, renderHeight = 0; // the resolution we render the fractal at. at most fbWidth*maxScale x fbHeight*maxScale.
+    int textureWidth = 0, textureHeight = 0; // of the frame textures, fbWidth*maxScale x fbHeight*maxScale.
+
+    GLuint displayShader = 0;
+    GLuint fractalShader = 0;
+    ShaderReloader shaderReloader;
+    int displayProgram = 0; // ids of the programs in shaderReloader.
+    ShaderPermutations shaderPermutations; // the programs with compile-time constants, like the fractal variants.
+    ProgramBinaryCache programBinaryCache;
+    // the variant of the frames we are asked for, and the variant of fractalShader. While a new
+    // variant is being compiled, we keep rendering the old one.
+    FractalVariant wantedVariant;
+    FractalVariant renderedVariant;
+    FractalSchedule renderedSchedule = SCHEDULE_PER_PIXEL; // like renderedVariant.
+
+    GLuint workCounterTexture = 0; // the queue of the persistent threads, a single R32UI texel.
+    GLuint fractalBorderShader = 0, fractalClassifyShader = 0; // the other passes of Mariani-Silver, for renderedVariant.
+    GLuint tileIterationTexture = 0; // R32UI, the iterations of the pixels on the borders of the tiles.
+    GLuint tileStateTexture = 0; // R32UI, the range of the iterations on the border of every tile.
+    GLuint tileFillTexture = 0; // R32UI, the count every tile of the last level is filled with.
+    std::vector<GLuint> tileZeros; // to clear tileStateTexture and tileFillTexture with.
+    // the indirect draw commands of the border and classify passes, followed by the lists of mixed tiles,
+    // and a R32UI buffer texture of it, so that the shaders can write it.
+    GLuint tileListBuffer = 0, tileListTexture = 0;
+
+    // Where the view straddles the real axis, and the rows line up with their mirror images, the fractal
+    // pass computes only the band of rows from fractalFirstRow, fractalRowCount high, and the mirror pass
+    // copies the others, mirrorRowCount rows from mirrorFirstRow, where row y is row mirrorRowSum - y.
+    // See FindMirrorRows().
+    int fractalFirstRow = 0, fractalRowCount = 0;
+    int mirrorFirstRow = 0, mirrorRowCount = 0, mirrorRowSum = 0;
+
+    // we will be writing and loading from these textures with image/load feature.
+    // They hold the blurred fractal, until it has been displayed.
+    // There is one texture for every frame in flight, see frameRing.
+    GLuint frameTextures[FrameRing::MAX_FRAMES_IN_FLIGHT] = {};
+    GLuint historyTexture = 0; // float accumulation of all the jittered fractal samples of the current view.
+
+    // with SetRegion(), the region we render is at this position, in an image of this size.
+    int regionOriginX = 0, regionOriginY = 0;
+    int imageWidth = 0, imageHeight = 0; // 0 means the image is just the region we render.
+
+    // Temporal accumulation: every frame we sample the fractal at a different position inside
+    // each pixel, and average the samples of all the frames that saw the same view. So when
+    // the view stands still, we get the quality of many samples per pixel, while paying for only
+    // one sample per frame. See MAX_HISTORY_SAMPLES and Halton() in renderer.h.
+    int historySampleCount = 0; // how many samples are accumulated in historyTexture.
+    View historyView;
+    int historyWidth = 0, historyHeight = 0;
+
+    GpuTimer gpuTimer; // times every pass of the render graph.
+    DynamicResolution dynamicResolution;
+    FrameRing frameRing;
+    int lastResultCount = 0; // of gpuTimer, when UpdateRenderResolution() last looked.
+    int timingCountdown = 0;
+    bool queryMissesWork = false; // see TimeGpuWork().
+
+    RenderGraph renderGraph;
+    ImageHandle fractalImage = 0, historyImage = 0, blurredImage = 0, backbufferImage = 0;
+    View frameView; // the view, and the sample position inside the pixels, of the frame being rendered.
+    float frameJitterX = 0.0f, frameJitterY = 0.0f;
+    bool printedGraph = false;
+
+    FilterLibrary filterLibrary;
+    IterationStats iterationStats;
+    ImageHandle iterationImage = 0;
+
+    bool hasFrame = false;
+    // BeginReadLastFrame() reads the back buffer into this pixel pack buffer, and FinishReadLastFrame()
+    // maps it, once the fence says the GPU is done.
+    GLuint readbackBuffer = 0;
+    GLsync readbackFence = 0;
+};
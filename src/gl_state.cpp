@@ -0,0 +1,126 @@
+#include "gl_state.h"
+#include "gl_util.h"
+
+GlStateCache glState;
+
+bool GlStateCache::Elide(bool same) {
+    calls++;
+    if (same) {
+        elided++;
+    }
+    return same;
+}
+
+void GlStateCache::DepthMask(GLboolean flag) {
+    if (Elide(depthMaskValid && depthMask == flag)) {
+        return;
+    }
+    GL_C(glDepthMask(flag));
+    depthMask = flag;
+    depthMaskValid = true;
+}
+
+void GlStateCache::ColorMask(GLboolean red, GLboolean green, GLboolean blue, GLboolean alpha) {
+    if (Elide(colorMaskValid && colorMask[0] == red && colorMask[1] == green && colorMask[2] == blue && colorMask[3] == alpha)) {
+        return;
+    }
+    GL_C(glColorMask(red, green, blue, alpha));
+    colorMask[0] = red;
+    colorMask[1] = green;
+    colorMask[2] = blue;
+    colorMask[3] = alpha;
+    colorMaskValid = true;
+}
+
+void GlStateCache::Viewport(GLint x, GLint y, GLsizei width, GLsizei height) {
+    if (Elide(viewportValid && viewport[0] == x && viewport[1] == y && viewport[2] == width && viewport[3] == height)) {
+        return;
+    }
+    GL_C(glViewport(x, y, width, height));
+    viewport[0] = x;
+    viewport[1] = y;
+    viewport[2] = width;
+    viewport[3] = height;
+    viewportValid = true;
+}
+
+void GlStateCache::ClearColor(GLfloat red, GLfloat green, GLfloat blue, GLfloat alpha) {
+    if (Elide(clearColorValid && clearColor[0] == red && clearColor[1] == green && clearColor[2] == blue && clearColor[3] == alpha)) {
+        return;
+    }
+    GL_C(glClearColor(red, green, blue, alpha));
+    clearColor[0] = red;
+    clearColor[1] = green;
+    clearColor[2] = blue;
+    clearColor[3] = alpha;
+    clearColorValid = true;
+}
+
+void GlStateCache::UseProgram(GLuint program_) {
+    if (Elide(programValid && program == program_)) {
+        return;
+    }
+    GL_C(glUseProgram(program_));
+    program = program_;
+    programValid = true;
+}
+
+void GlStateCache::BindImageTexture(GLuint unit, GLuint texture, GLint level, GLboolean layered, GLint layer, GLenum access, GLenum format) {
+    if (unit >= (GLuint)IMAGE_UNIT_COUNT) {
+        calls++;
+        GL_C(glBindImageTexture(unit, texture, level, layered, layer, access, format));
+        return;
+    }
+
+    ImageBinding& b = imageBindings[unit];
+    if (Elide(imageBindingValid[unit] && b.texture == texture && b.level == level && b.layered == layered &&
+        b.layer == layer && b.access == access && b.format == format)) {
+        return;
+    }
+    GL_C(glBindImageTexture(unit, texture, level, layered, layer, access, format));
+    b.texture = texture;
+    b.level = level;
+    b.layered = layered;
+    b.layer = layer;
+    b.access = access;
+    b.format = format;
+    imageBindingValid[unit] = true;
+}
+
+void GlStateCache::DeleteProgram(GLuint program_) {
+    GL_C(glDeleteProgram(program_));
+    // a new program may get the same name, and must be bound again.
+    if (programValid && program == program_) {
+        programValid = false;
+    }
+}
+
+void GlStateCache::DeleteTextures(GLsizei n, const GLuint* textures) {
+    GL_C(glDeleteTextures(n, textures));
+    // deleting a texture unbinds it from the image units.
+    for (GLsizei i = 0; i < n; i++) {
+        for (int unit = 0; unit < IMAGE_UNIT_COUNT; unit++) {
+            if (imageBindingValid[unit] && imageBindings[unit].texture == textures[i]) {
+                imageBindingValid[unit] = false;
+            }
+        }
+    }
+}
+
+void GlStateCache::Invalidate() {
+    depthMaskValid = false;
+    colorMaskValid = false;
+    viewportValid = false;
+    clearColorValid = false;
+    programValid = false;
+    for (int unit = 0; unit < IMAGE_UNIT_COUNT; unit++) {
+        imageBindingValid[unit] = false;
+    }
+}
+
+void GlStateCache::EndFrame() {
+    lastCalls = calls;
+    lastElided = elided;
+    calls = 0;
+    elided = 0;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <glad/glad.h>
+
+//
+// A cache of the GL state that the passes set, so that we only call GL when the state actually changes.
+//
+// Every pass sets all the state it needs, because it can't know what the pass before it left behind,
+// and most of those calls don't change anything. A redundant call is cheap, but not free: the driver
+// still validates it, and may mark the state dirty. With many passes, that adds up.
+//
+// The cache only knows about the state that goes through it, for the main context. So everything
+// that changes this state must go through it, including deleting programs and textures, which
+// unbinds them. Call Invalidate() if something else might have changed the state.
+//
+class GlStateCache {
+public:
+    void DepthMask(GLboolean flag);
+    void ColorMask(GLboolean red, GLboolean green, GLboolean blue, GLboolean alpha);
+    void Viewport(GLint x, GLint y, GLsizei width, GLsizei height);
+    void ClearColor(GLfloat red, GLfloat green, GLfloat blue, GLfloat alpha);
+    void UseProgram(GLuint program);
+    void BindImageTexture(GLuint unit, GLuint texture, GLint level, GLboolean layered, GLint layer, GLenum access, GLenum format);
+
+    void DeleteProgram(GLuint program);
+    void DeleteTextures(GLsizei n, const GLuint* textures);
+
+    // Forget everything, so that the next call of every kind goes to GL.
+    void Invalidate();
+
+    // Call at the end of every frame. The counts are for the last finished frame.
+    void EndFrame();
+    int GetCallCount() const { return lastCalls; }
+    int GetElidedCount() const { return lastElided; }
+
+private:
+    // returns true if the call can be skipped, and counts it.
+    bool Elide(bool same);
+
+    // GL_MAX_IMAGE_UNITS is at least 8. Units beyond that are not cached.
+    static const int IMAGE_UNIT_COUNT = 8;
+    struct ImageBinding {
+        GLuint texture;
+        GLint level;
+        GLboolean layered;
+        GLint layer;
+        GLenum access;
+        GLenum format;
+    };
+
+    bool depthMaskValid = false;
+    GLboolean depthMask;
+    bool colorMaskValid = false;
+    GLboolean colorMask[4];
+    bool viewportValid = false;
+    GLint viewport[4];
+    bool clearColorValid = false;
+    GLfloat clearColor[4];
+    bool programValid = false;
+    GLuint program;
+    bool imageBindingValid[IMAGE_UNIT_COUNT] = {};
+    ImageBinding imageBindings[IMAGE_UNIT_COUNT];
+
+    int calls = 0;
+    int elided = 0;
+    int lastCalls = 0;
+    int lastElided = 0;
+};
+
+// the state of the main context.
+extern GlStateCache glState;
@@ -0,0 +1,113 @@
+#include "gl_textures.h"
+#include "gl_util.h"
+#include "gl_state.h"
+#include "gpu_memory.h"
+
+#include <GLFW/glfw3.h>
+
+typedef void (APIENTRYP PFNGLCREATETEXTURESPROC_)(GLenum target, GLsizei n, GLuint* textures);
+typedef void (APIENTRYP PFNGLTEXTURESTORAGE2DPROC_)(GLuint texture, GLsizei levels, GLenum internalformat, GLsizei width, GLsizei height);
+typedef void (APIENTRYP PFNGLTEXTURESUBIMAGE2DPROC_)(GLuint texture, GLint level, GLint xoffset, GLint yoffset,
+    GLsizei width, GLsizei height, GLenum format, GLenum type, const void* pixels);
+typedef void (APIENTRYP PFNGLGETTEXTUREIMAGEPROC_)(GLuint texture, GLint level, GLenum format, GLenum type,
+    GLsizei bufSize, void* pixels);
+
+static PFNGLCREATETEXTURESPROC_ createTextures = NULL;
+static PFNGLTEXTURESTORAGE2DPROC_ textureStorage2D = NULL;
+static PFNGLTEXTURESUBIMAGE2DPROC_ textureSubImage2D = NULL;
+static PFNGLGETTEXTUREIMAGEPROC_ getTextureImage = NULL;
+
+void InitTextureFunctions(bool allowDsa) {
+    createTextures = NULL;
+    if (!allowDsa) {
+        return;
+    }
+
+    if (!HasGlFeature(45, "GL_ARB_direct_state_access")) {
+        return;
+    }
+
+    textureStorage2D = (PFNGLTEXTURESTORAGE2DPROC_)glfwGetProcAddress("glTextureStorage2D");
+    textureSubImage2D = (PFNGLTEXTURESUBIMAGE2DPROC_)glfwGetProcAddress("glTextureSubImage2D");
+    getTextureImage = (PFNGLGETTEXTUREIMAGEPROC_)glfwGetProcAddress("glGetTextureImage");
+    createTextures = (PFNGLCREATETEXTURESPROC_)glfwGetProcAddress("glCreateTextures");
+    if (!textureStorage2D || !textureSubImage2D || !getTextureImage) {
+        createTextures = NULL;
+    }
+}
+
+bool HasDirectStateAccess() {
+    return createTextures != NULL;
+}
+
+GLuint CreateTexture2D(GLenum format, int width, int height, const char* category) {
+    GLuint texture;
+    if (HasDirectStateAccess()) {
+        GL_C(createTextures(GL_TEXTURE_2D, 1, &texture));
+        GL_C(textureStorage2D(texture, 1, format, width, height));
+    } else {
+        GL_C(glGenTextures(1, &texture));
+        GL_C(glBindTexture(GL_TEXTURE_2D, texture));
+        GL_C(glTexStorage2D(GL_TEXTURE_2D, 1, format, width, height));
+        GL_C(glBindTexture(GL_TEXTURE_2D, 0));
+    }
+    gpuMemory.AddTexture(texture, category, format, width, height);
+    return texture;
+}
+
+void DeleteTextures2D(int n, const GLuint* textures) {
+    for (int i = 0; i < n; i++) {
+        gpuMemory.RemoveTexture(textures[i]);
+    }
+    glState.DeleteTextures(n, textures);
+}
+
+void UploadTexture2D(GLuint texture, int width, int height, GLenum format, GLenum type, const void* pixels) {
+    if (HasDirectStateAccess()) {
+        GL_C(textureSubImage2D(texture, 0, 0, 0, width, height, format, type, pixels));
+    } else {
+        GL_C(glBindTexture(GL_TEXTURE_2D, texture));
+        GL_C(glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, format, type, pixels));
+        GL_C(glBindTexture(GL_TEXTURE_2D, 0));
+    }
+}
+
+// The bytes of a pixel in 'format' and 'type', for the formats and types we read back.
+static int GetPixelSize(GLenum format, GLenum type) {
+    int components = 4;
+    if (format == GL_RED || format == GL_RED_INTEGER) {
+        components = 1;
+    } else if (format == GL_RG || format == GL_RG_INTEGER) {
+        components = 2;
+    } else if (format == GL_RGB || format == GL_RGB_INTEGER) {
+        components = 3;
+    }
+    if (type == GL_UNSIGNED_BYTE || type == GL_BYTE) {
+        return components;
+    } else if (type == GL_UNSIGNED_SHORT || type == GL_SHORT || type == GL_HALF_FLOAT) {
+        return components * 2;
+    }
+    return components * 4;
+}
+
+void ReadTexture2D(GLuint texture, GLenum format, GLenum type, int size, void* pixels) {
+    if (HasDirectStateAccess()) {
+        // fails with GL_INVALID_OPERATION if the texture doesn't fit in 'size'.
+        GL_C(getTextureImage(texture, 0, format, type, size, pixels));
+    } else {
+        // glGetTexImage() has no size, so we check that the texture fits ourselves, rows padded to
+        // GL_PACK_ALIGNMENT, like it writes them.
+        GL_C(glBindTexture(GL_TEXTURE_2D, texture));
+        GLint width = 0, height = 0, alignment = 4;
+        GL_C(glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width));
+        GL_C(glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height));
+        GL_C(glGetIntegerv(GL_PACK_ALIGNMENT, &alignment));
+        size_t rowSize = ((size_t)width * GetPixelSize(format, type) + alignment - 1) / alignment * alignment;
+        if (rowSize * height > (size_t)size) {
+            printf("Can't read back a %dx%d texture into %d bytes.\n", width, height, size);
+            exit(EXIT_FAILURE);
+        }
+        GL_C(glGetTexImage(GL_TEXTURE_2D, 0, format, type, pixels));
+        GL_C(glBindTexture(GL_TEXTURE_2D, 0));
+    }
+}
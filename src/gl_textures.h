@@ -0,0 +1,28 @@
+#pragma once
+
+#include <glad/glad.h>
+
+//
+// Creating, uploading and reading back 2D textures.
+//
+// With GL 4.5, or ARB_direct_state_access, we use direct state access: the texture is created
+// and edited by its name, with glCreateTextures() and glTextureStorage2D(), and we never have to
+// bind it. Otherwise, we fall back to binding it to GL_TEXTURE_2D, editing it, and unbinding it.
+//
+// Our loader only has the GL 4.2 functions, so we load the DSA functions ourselves.
+//
+
+// Call once, with the context current. With 'allowDsa' false, we always use the 4.2 path.
+void InitTextureFunctions(bool allowDsa);
+bool HasDirectStateAccess();
+
+// A texture with storage for one mip level, in 'format', like GL_RGBA8UI. It is counted in gpuMemory,
+// under 'category', see gpu_memory.h.
+GLuint CreateTexture2D(GLenum format, int width, int height, const char* category);
+// Deletes textures made with CreateTexture2D().
+void DeleteTextures2D(int n, const GLuint* textures);
+// Replaces the width x height corner of the texture at (0, 0), which may be all of it. 'format' and
+// 'type' describe 'pixels', like for glTexSubImage2D().
+void UploadTexture2D(GLuint texture, int width, int height, GLenum format, GLenum type, const void* pixels);
+// Reads back the whole texture into 'pixels', which holds 'size' bytes. Exits if it doesn't fit.
+void ReadTexture2D(GLuint texture, GLenum format, GLenum type, int size, void* pixels);
@@ -0,0 +1,181 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+//
+// Begin Utility functions
+//
+
+inline void CheckOpenGLError(const char* stmt, const char* fname, int line)
+{
+    GLenum err = glGetError();
+    //  const GLubyte* sError = gluErrorString(err);
+
+    if (err != GL_NO_ERROR){
+        printf("OpenGL error %08x, at %s:%i - for %s.\n", err, fname, line, stmt);
+        exit(1);
+    }
+}
+
+// GL Check Macro. Will terminate the program if a GL error is detected. 
+#define GL_C(stmt) do {					\
+	stmt;						\
+	CheckOpenGLError(#stmt, __FILE__, __LINE__);	\
+    } while (0)
+
+inline bool HasExtension(const char* name) {
+    GLint count = 0;
+    GL_C(glGetIntegerv(GL_NUM_EXTENSIONS, &count));
+    for (GLint i = 0; i < count; i++) {
+        if (strcmp((const char*)glGetStringi(GL_EXTENSIONS, i), name) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// true if the context is at least 'version', like 45 for 4.5, which has 'extension' in core, or has the extension.
+// We ask for a 4.2 context, but most drivers give us the newest version they have.
+inline bool HasGlFeature(int version, const char* extension) {
+    GLint major = 0, minor = 0;
+    GL_C(glGetIntegerv(GL_MAJOR_VERSION, &major));
+    GL_C(glGetIntegerv(GL_MINOR_VERSION, &minor));
+    return major * 10 + minor >= version || HasExtension(extension);
+}
+
+inline char* GetShaderLogInfo(GLuint shader) {
+    GLint len;
+    GLsizei actualLen;
+
+    GL_C(glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &len));
+    char* infoLog = new char[len];
+
+    GL_C(glGetShaderInfoLog(shader, len, &actualLen, infoLog));
+
+    return  infoLog;
+}
+
+inline std::string GetProgramLogInfo(GLuint program) {
+    GLint len = 0;
+    GL_C(glGetProgramiv(program, GL_INFO_LOG_LENGTH, &len));
+    if (len <= 0) {
+        return std::string();
+    }
+
+    std::string infoLog(len, '\0');
+    GLsizei actualLen = 0;
+    GL_C(glGetProgramInfoLog(program, len, &actualLen, &infoLog[0]));
+    infoLog.resize(actualLen);
+
+    return infoLog;
+}
+
+/*
+Compile a shader. Unlike CreateShaderFromString, this doesn't terminate the program when
+the shader has errors. Instead it returns 0, and writes the compile log to 'log'.
+This is what we want when we reload shaders while the program is running.
+*/
+inline GLuint TryCreateShaderFromString(const std::string& shaderSource, const GLenum shaderType, std::string* log) {
+    GLuint shader;
+
+    GL_C(shader = glCreateShader(shaderType));
+    const char *c_str = shaderSource.c_str();
+    GL_C(glShaderSource(shader, 1, &c_str, NULL));
+    GL_C(glCompileShader(shader));
+
+    GLint compileStatus;
+    GL_C(glGetShaderiv(shader, GL_COMPILE_STATUS, &compileStatus));
+
+    if (compileStatus != GL_TRUE) {
+        char* infoLog = GetShaderLogInfo(shader);
+        *log = infoLog;
+        delete[] infoLog;
+
+        GL_C(glDeleteShader(shader));
+        return 0;
+    }
+
+    return shader;
+}
+
+inline GLuint CreateShaderFromString(const std::string& shaderSource, const GLenum shaderType) {
+    std::string log;
+    GLuint shader = TryCreateShaderFromString(shaderSource, shaderType, &log);
+
+    if (shader == 0) {
+        printf("Could not compile shader\n\n%s \n\n%s\n", shaderSource.c_str(), log.c_str());
+        exit(1);
+    }
+
+    return shader;
+}
+
+/*
+Link a program with only vertex and fragment shader. Returns 0 and writes the errors to 'log'
+if any of the shaders doesn't compile, or the program doesn't link.
+*/
+// With 'retrievable', the driver keeps the binary of the program around, for glGetProgramBinary().
+inline GLuint TryLoadNormalShader(const std::string& vsSource, const std::string& fsShader, std::string* log, bool retrievable = false) {
+    // Create the shaders
+    GLuint vs = TryCreateShaderFromString(vsSource, GL_VERTEX_SHADER, log);
+    if (vs == 0) {
+        *log = "vertex shader: " + *log;
+        return 0;
+    }
+    GLuint fs = TryCreateShaderFromString(fsShader, GL_FRAGMENT_SHADER, log);
+    if (fs == 0) {
+        *log = "fragment shader: " + *log;
+        GL_C(glDeleteShader(vs));
+        return 0;
+    }
+
+    // Link the program
+    GLuint shader = glCreateProgram();
+    glAttachShader(shader, vs);
+    glAttachShader(shader, fs);
+    if (retrievable) {
+        glProgramParameteri(shader, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+    glLinkProgram(shader);
+
+    GLint Result;
+    glGetProgramiv(shader, GL_LINK_STATUS, &Result);
+
+    glDetachShader(shader, vs);
+    glDetachShader(shader, fs);
+
+    glDeleteShader(vs);
+    glDeleteShader(fs);
+
+    if (Result == GL_FALSE) {
+        *log = "link: " + GetProgramLogInfo(shader);
+        glDeleteProgram(shader);
+        return 0;
+    }
+
+    return shader;
+}
+
+/*
+Load shader with only vertex and fragment shader.
+*/
+inline GLuint LoadNormalShader(const std::string& vsSource, const std::string& fsShader){
+    std::string log;
+    GLuint shader = TryLoadNormalShader(vsSource, fsShader, &log);
+
+    if (shader == 0) {
+        printf("Could not load shader \n\n%s\n", log.c_str());
+        exit(1);
+    }
+
+    return shader;
+}
+
+//
+// End Utility functions
+//
@@ -0,0 +1,137 @@
+#include "gpu_memory.h"
+#include "gl_util.h"
+
+GpuMemory gpuMemory;
+
+// GL_NVX_gpu_memory_info and GL_ATI_meminfo. Our loader doesn't have them. All sizes are in KB.
+#define GL_GPU_MEMORY_INFO_DEDICATED_VIDMEM_NVX         0x9047
+#define GL_GPU_MEMORY_INFO_TOTAL_AVAILABLE_MEMORY_NVX   0x9048
+#define GL_GPU_MEMORY_INFO_CURRENT_AVAILABLE_VIDMEM_NVX 0x9049
+#define GL_GPU_MEMORY_INFO_EVICTION_COUNT_NVX           0x904A
+#define GL_GPU_MEMORY_INFO_EVICTED_MEMORY_NVX           0x904B
+#define GL_TEXTURE_FREE_MEMORY_ATI                      0x87FC
+
+// only the formats the demo uses. Others are counted as 4 bytes, with a warning.
+static int GetBytesPerTexel(GLenum format, const char** name) {
+    switch (format) {
+    case GL_RGBA8UI: *name = "GL_RGBA8UI"; return 4;
+    case GL_RGBA8: *name = "GL_RGBA8"; return 4;
+    case GL_R32UI: *name = "GL_R32UI"; return 4;
+    case GL_R32F: *name = "GL_R32F"; return 4;
+    case GL_RGBA16F: *name = "GL_RGBA16F"; return 8;
+    case GL_RGBA32F: *name = "GL_RGBA32F"; return 16;
+    }
+    printf("GpuMemory: unknown texture format 0x%x, counted as 4 bytes per texel\n", format);
+    *name = "unknown format";
+    return 4;
+}
+
+static double ToMb(size_t bytes) {
+    return (double)bytes / (1024.0 * 1024.0);
+}
+
+void GpuMemory::AddTexture(GLuint texture, const char* category, GLenum format, int width, int height) {
+    const char* formatName;
+    int texelBytes = GetBytesPerTexel(format, &formatName);
+    Allocation a;
+    a.category = category;
+    a.description = std::string(formatName) + " " + std::to_string(width) + "x" + std::to_string(height);
+    a.bytes = (size_t)width * height * texelBytes;
+    textures[Key(currentContext, texture)] = a;
+    Add(a, 1, 0);
+}
+
+void GpuMemory::RemoveTexture(GLuint texture) {
+    std::map<Key, Allocation>::iterator it = textures.find(Key(currentContext, texture));
+    if (it != textures.end()) {
+        Remove(it->second, 1, 0);
+        textures.erase(it);
+    }
+}
+
+void GpuMemory::AddBuffer(GLuint buffer, const char* category, size_t size) {
+    Allocation a;
+    a.category = category;
+    a.description = "buffer " + std::to_string(size) + " bytes";
+    a.bytes = size;
+    buffers[Key(currentContext, buffer)] = a;
+    Add(a, 0, 1);
+}
+
+void GpuMemory::RemoveBuffer(GLuint buffer) {
+    std::map<Key, Allocation>::iterator it = buffers.find(Key(currentContext, buffer));
+    if (it != buffers.end()) {
+        Remove(it->second, 0, 1);
+        buffers.erase(it);
+    }
+}
+
+void GpuMemory::AddQueries(const char* category, int count) {
+    categories[category].queryCount += count;
+}
+
+void GpuMemory::RemoveQueries(const char* category, int count) {
+    categories[category].queryCount -= count;
+}
+
+void GpuMemory::Add(const Allocation& allocation, int textureCount, int bufferCount) {
+    Category& c = categories[allocation.category];
+    c.textureCount += textureCount;
+    c.bufferCount += bufferCount;
+    c.bytes += allocation.bytes;
+}
+
+void GpuMemory::Remove(const Allocation& allocation, int textureCount, int bufferCount) {
+    Category& c = categories[allocation.category];
+    c.textureCount -= textureCount;
+    c.bufferCount -= bufferCount;
+    c.bytes -= allocation.bytes;
+}
+
+size_t GpuMemory::GetTotalBytes() const {
+    size_t total = 0;
+    for (const std::pair<const std::string, Category>& c : categories) {
+        total += c.second.bytes;
+    }
+    return total;
+}
+
+void GpuMemory::Print() const {
+    printf("GPU memory: %.2f MB allocated by the demo\n", ToMb(GetTotalBytes()));
+    for (const std::pair<const std::string, Category>& c : categories) {
+        if (c.second.textureCount == 0 && c.second.bufferCount == 0 && c.second.queryCount == 0) {
+            continue;
+        }
+        printf("  %-20s %8.2f MB, %d texture(s), %d buffer(s), %d quer%s\n", c.first.c_str(), ToMb(c.second.bytes),
+            c.second.textureCount, c.second.bufferCount, c.second.queryCount, c.second.queryCount == 1 ? "y" : "ies");
+        for (const std::pair<const Key, Allocation>& t : textures) {
+            if (t.second.category == c.first) {
+                printf("    texture %-4u %-24s %8.2f MB\n", t.first.second, t.second.description.c_str(), ToMb(t.second.bytes));
+            }
+        }
+        for (const std::pair<const Key, Allocation>& b : buffers) {
+            if (b.second.category == c.first) {
+                printf("    buffer %-5u %-24s %8.2f MB\n", b.first.second, b.second.description.c_str(), ToMb(b.second.bytes));
+            }
+        }
+    }
+
+    if (HasExtension("GL_NVX_gpu_memory_info")) {
+        GLint dedicated = 0, total = 0, available = 0, evictions = 0, evicted = 0;
+        GL_C(glGetIntegerv(GL_GPU_MEMORY_INFO_DEDICATED_VIDMEM_NVX, &dedicated));
+        GL_C(glGetIntegerv(GL_GPU_MEMORY_INFO_TOTAL_AVAILABLE_MEMORY_NVX, &total));
+        GL_C(glGetIntegerv(GL_GPU_MEMORY_INFO_CURRENT_AVAILABLE_VIDMEM_NVX, &available));
+        GL_C(glGetIntegerv(GL_GPU_MEMORY_INFO_EVICTION_COUNT_NVX, &evictions));
+        GL_C(glGetIntegerv(GL_GPU_MEMORY_INFO_EVICTED_MEMORY_NVX, &evicted));
+        printf("  driver: %.0f MB of %.0f MB video memory free (%.0f MB dedicated), %d evictions of %.0f MB\n",
+            available / 1024.0, total / 1024.0, dedicated / 1024.0, evictions, evicted / 1024.0);
+    } else if (HasExtension("GL_ATI_meminfo")) {
+        // the total free, the largest free block, and the same for the memory shared with the CPU.
+        GLint info[4] = { 0, 0, 0, 0 };
+        GL_C(glGetIntegerv(GL_TEXTURE_FREE_MEMORY_ATI, info));
+        printf("  driver: %.0f MB free for textures (largest block %.0f MB), %.0f MB free in shared memory\n",
+            info[0] / 1024.0, info[1] / 1024.0, info[2] / 1024.0);
+    } else {
+        printf("  the driver doesn't say how much memory is free\n");
+    }
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <map>
+#include <string>
+
+//
+// Keeps count of the GPU memory the demo allocates: every texture, buffer and query, with its size
+// and format, under a category, like "history" or "frame ring". That tells us how much memory a
+// setting costs, like more frames in flight, or a larger tile for the render farm, before we run it
+// on a machine that doesn't have much.
+//
+// The sizes are what the formats need, not what the driver really allocates, which may be more,
+// for alignment and compression. Queries are only counted, since GL doesn't say how large they are.
+//
+// On NVIDIA (GL_NVX_gpu_memory_info) and AMD (GL_ATI_meminfo), Print() also shows how much memory
+// the driver says is free.
+//
+// GL names are only unique within a context, and a program may render with several, like one
+// GlRenderer per window. So the textures and buffers are kept under the context that was current when
+// they were added, which whoever makes a context current must pass to SetContext(), like
+// GlRenderer::MakeCurrent() does.
+//
+class GpuMemory {
+public:
+    // Any pointer that tells the contexts apart, like their GLFWwindow.
+    void SetContext(const void* context) { currentContext = context; }
+
+    void AddTexture(GLuint texture, const char* category, GLenum format, int width, int height);
+    void RemoveTexture(GLuint texture);
+    void AddBuffer(GLuint buffer, const char* category, size_t size);
+    void RemoveBuffer(GLuint buffer);
+    void AddQueries(const char* category, int count);
+    void RemoveQueries(const char* category, int count);
+
+    // Bytes allocated in all categories.
+    size_t GetTotalBytes() const;
+
+    // Prints the totals per category, and what the driver says, if it can.
+    void Print() const;
+
+private:
+    struct Allocation {
+        std::string category;
+        std::string description; // like "GL_RGBA8UI 1497x1014"
+        size_t bytes;
+    };
+    struct Category {
+        int textureCount = 0;
+        int bufferCount = 0;
+        int queryCount = 0;
+        size_t bytes = 0;
+    };
+    typedef std::pair<const void*, GLuint> Key; // the context, and the name.
+    void Add(const Allocation& allocation, int textures, int buffers);
+    void Remove(const Allocation& allocation, int textures, int buffers);
+
+    const void* currentContext = NULL;
+    std::map<Key, Allocation> textures;
+    std::map<Key, Allocation> buffers;
+    std::map<std::string, Category> categories;
+};
+
+extern GpuMemory gpuMemory;
@@ -0,0 +1,169 @@
+#include "gpu_timer.h"
+#include "gl_util.h"
+#include "trace.h"
+#include "gpu_memory.h"
+
+// ARB_pipeline_statistics_query, which is core in 4.6. Our loader only has 4.2.
+#define GL_VERTICES_SUBMITTED_ARB                 0x82EE
+#define GL_PRIMITIVES_SUBMITTED_ARB               0x82EF
+#define GL_VERTEX_SHADER_INVOCATIONS_ARB          0x82F0
+#define GL_TESS_CONTROL_SHADER_PATCHES_ARB        0x82F1
+#define GL_TESS_EVALUATION_SHADER_INVOCATIONS_ARB 0x82F2
+#define GL_GEOMETRY_SHADER_PRIMITIVES_EMITTED_ARB 0x82F3
+#define GL_FRAGMENT_SHADER_INVOCATIONS_ARB        0x82F4
+#define GL_COMPUTE_SHADER_INVOCATIONS_ARB         0x82F5
+#define GL_CLIPPING_INPUT_PRIMITIVES_ARB          0x82F6
+#define GL_CLIPPING_OUTPUT_PRIMITIVES_ARB         0x82F7
+
+// the query targets of GpuTimer::Statistic. Queries of different targets can be active at the
+// same time, so these run alongside the GL_TIME_ELAPSED query of the pass.
+static const GLenum STATISTIC_TARGETS[GpuTimer::STATISTIC_COUNT] = {
+    GL_VERTEX_SHADER_INVOCATIONS_ARB,
+    GL_FRAGMENT_SHADER_INVOCATIONS_ARB,
+    GL_COMPUTE_SHADER_INVOCATIONS_ARB,
+};
+
+void GpuTimer::Init(int passCount_) {
+    passCount = passCount_;
+    frame = 0;
+    resultCount = 0;
+    passMs.assign(passCount, 0.0f);
+    passNames.resize(passCount);
+    passStatistics.assign(passCount * STATISTIC_COUNT, 0);
+    bool hasStatistics = HasGlFeature(46, "GL_ARB_pipeline_statistics_query");
+
+    for (int i = 0; i < FRAME_COUNT; i++) {
+        gpuMemory.AddQueries("gpu timer", passCount);
+        queries[i].resize(passCount);
+        issued[i].assign(passCount, false);
+        GL_C(glGenQueries(passCount, queries[i].data()));
+        if (hasStatistics) {
+            statistics[i].resize(passCount * STATISTIC_COUNT);
+            GL_C(glGenQueries(passCount * STATISTIC_COUNT, statistics[i].data()));
+            gpuMemory.AddQueries("gpu timer", passCount * STATISTIC_COUNT);
+        }
+        if (trace.IsEnabled()) {
+            timestamps[i].resize(2 * passCount);
+            stamped[i].assign(passCount, false);
+            GL_C(glGenQueries(2 * passCount, timestamps[i].data()));
+            gpuMemory.AddQueries("gpu timer", 2 * passCount);
+        }
+    }
+    calibrationCpuUs = 0.0;
+}
+
+void GpuTimer::Destroy() {
+    for (int i = 0; i < FRAME_COUNT; i++) {
+        if (!queries[i].empty()) {
+            GL_C(glDeleteQueries((GLsizei)queries[i].size(), queries[i].data()));
+            gpuMemory.RemoveQueries("gpu timer", (int)queries[i].size());
+        }
+        queries[i].clear();
+        issued[i].clear();
+        if (!timestamps[i].empty()) {
+            GL_C(glDeleteQueries((GLsizei)timestamps[i].size(), timestamps[i].data()));
+            gpuMemory.RemoveQueries("gpu timer", (int)timestamps[i].size());
+        }
+        timestamps[i].clear();
+        stamped[i].clear();
+        if (!statistics[i].empty()) {
+            GL_C(glDeleteQueries((GLsizei)statistics[i].size(), statistics[i].data()));
+            gpuMemory.RemoveQueries("gpu timer", (int)statistics[i].size());
+        }
+        statistics[i].clear();
+    }
+    passCount = 0;
+}
+
+void GpuTimer::BeginFrame() {
+    int slot = frame % FRAME_COUNT;
+
+    // the queries of this slot were issued FRAME_COUNT frames ago, so read them back now,
+    // before we overwrite them. By now the GPU has almost certainly finished those passes.
+    if (frame >= FRAME_COUNT) {
+        for (int pass = 0; pass < passCount; pass++) {
+            GLuint64 ns = 0;
+            if (issued[slot][pass]) {
+                GL_C(glGetQueryObjectui64v(queries[slot][pass], GL_QUERY_RESULT, &ns));
+            }
+            passMs[pass] = (float)((double)ns * 1e-6);
+
+            for (int s = 0; HasStatistics() && s < STATISTIC_COUNT; s++) {
+                GLuint64 count = 0;
+                if (issued[slot][pass]) {
+                    GL_C(glGetQueryObjectui64v(statistics[slot][pass * STATISTIC_COUNT + s], GL_QUERY_RESULT, &count));
+                }
+                passStatistics[pass * STATISTIC_COUNT + s] = count;
+            }
+        }
+        resultCount++;
+
+        for (int pass = 0; pass < (int)stamped[slot].size(); pass++) {
+            if (!stamped[slot][pass]) {
+                continue;
+            }
+            GLuint64 begin = 0, end = 0;
+            GL_C(glGetQueryObjectui64v(timestamps[slot][2 * pass + 0], GL_QUERY_RESULT, &begin));
+            GL_C(glGetQueryObjectui64v(timestamps[slot][2 * pass + 1], GL_QUERY_RESULT, &end));
+            double beginUs = calibrationCpuUs + (double)((GLint64)begin - calibrationGpuNs) * 1e-3;
+            double endUs = calibrationCpuUs + (double)((GLint64)end - calibrationGpuNs) * 1e-3;
+            trace.AddGpuZone(passNames[pass], beginUs, endUs);
+        }
+    }
+
+    issued[slot].assign(passCount, false);
+    if (!stamped[slot].empty()) {
+        stamped[slot].assign(passCount, false);
+        // the two clocks drift apart slowly, so once a second is plenty.
+        if (calibrationCpuUs == 0.0 || Trace::NowUs() - calibrationCpuUs > 1e6) {
+            Calibrate();
+        }
+    }
+}
+
+void GpuTimer::Calibrate() {
+    // this is the time at which the GPU has reached all the commands so far, without waiting for it.
+    GL_C(glGetInteger64v(GL_TIMESTAMP, &calibrationGpuNs));
+    calibrationCpuUs = Trace::NowUs();
+}
+
+void GpuTimer::BeginPass(int pass) {
+    int slot = frame % FRAME_COUNT;
+    GL_C(glBeginQuery(GL_TIME_ELAPSED, queries[slot][pass]));
+    issued[slot][pass] = true;
+    for (int s = 0; HasStatistics() && s < STATISTIC_COUNT; s++) {
+        GL_C(glBeginQuery(STATISTIC_TARGETS[s], statistics[slot][pass * STATISTIC_COUNT + s]));
+    }
+    if (!stamped[slot].empty()) {
+        GL_C(glQueryCounter(timestamps[slot][2 * pass + 0], GL_TIMESTAMP));
+        stamped[slot][pass] = true;
+    }
+    currentPass = pass;
+}
+
+void GpuTimer::EndPass() {
+    GL_C(glEndQuery(GL_TIME_ELAPSED));
+    int slot = frame % FRAME_COUNT;
+    for (int s = 0; HasStatistics() && s < STATISTIC_COUNT; s++) {
+        GL_C(glEndQuery(STATISTIC_TARGETS[s]));
+    }
+    if (!stamped[slot].empty()) {
+        GL_C(glQueryCounter(timestamps[slot][2 * currentPass + 1], GL_TIMESTAMP));
+    }
+}
+
+void GpuTimer::EndFrame() {
+    frame++;
+}
+
+float GpuTimer::GetPassMs(int pass) const {
+    return passMs[pass];
+}
+
+float GpuTimer::GetTotalMs() const {
+    float total = 0.0f;
+    for (int pass = 0; pass < passCount; pass++) {
+        total += passMs[pass];
+    }
+    return total;
+}
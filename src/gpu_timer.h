@@ -0,0 +1,90 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <string>
+#include <vector>
+
+//
+// Measures how long every pass of a frame takes on the GPU, using GL_TIME_ELAPSED queries.
+//
+// The result of a query is only available once the GPU has actually finished the pass,
+// and that is usually a frame or two after we submitted it. If we asked for the result
+// right away, the CPU would have to wait for the GPU. So instead we keep a ring of query
+// sets, one per frame, and only read back the results of a frame when we are about to
+// reuse its queries, FRAME_COUNT frames later. The timings we report are therefore
+// slightly old, but reading them never stalls the pipeline.
+//
+// When the trace is recording, see trace.h, every pass also gets a GL_TIMESTAMP query at its
+// start and end, which gives us where the pass was on the timeline of the GPU, and not just how
+// long it took. The GPU has its own clock, so we read both clocks at the same moment, now and
+// then, and use the difference to put the passes on the timeline of the CPU.
+//
+// With GL 4.6, or ARB_pipeline_statistics_query, we also count how many times the vertex, fragment
+// and compute shaders ran in every pass. The fractal pass, for example, should run the vertex
+// shader exactly once per pixel, and the fragment shader never, since it only draws points to
+// launch threads.
+//
+class GpuTimer {
+public:
+    // must be larger than the number of frames in flight, see FrameRing. 
+    static const int FRAME_COUNT = 4;
+
+    enum Statistic {
+        STATISTIC_VERTEX_SHADER,
+        STATISTIC_FRAGMENT_SHADER,
+        STATISTIC_COMPUTE_SHADER,
+        STATISTIC_COUNT
+    };
+
+    void Init(int passCount);
+    void Destroy();
+
+    // The name of a pass, in the trace.
+    void SetPassName(int pass, const std::string& name) { passNames[pass] = name; }
+
+    void BeginFrame();
+    // Only one pass can be timed at a time, since GL_TIME_ELAPSED queries can't be nested.
+    void BeginPass(int pass);
+    void EndPass();
+    void EndFrame();
+
+    // Latest timings that have been read back, in milliseconds.
+    // Passes that were not run in that frame report 0.
+    float GetPassMs(int pass) const;
+    float GetTotalMs() const;
+
+    // false if the driver can't count shader invocations.
+    bool HasStatistics() const { return !statistics[0].empty(); }
+    // The latest number of invocations of a shader stage in a pass, read back with the timings.
+    GLuint64 GetPassStatistic(int pass, Statistic statistic) const { return passStatistics[pass * STATISTIC_COUNT + statistic]; }
+
+    // true once the timings of at least one frame have been read back.
+    bool HasResults() const { return resultCount > 0; }
+    // Increases every time a new frame of timings has been read back.
+    int GetResultCount() const { return resultCount; }
+
+private:
+    // reads the clocks of the CPU and the GPU, so that we can convert timestamps.
+    void Calibrate();
+
+    int passCount = 0;
+    int frame = 0;
+    int resultCount = 0;
+    std::vector<GLuint> queries[FRAME_COUNT];
+    std::vector<bool> issued[FRAME_COUNT];
+    std::vector<float> passMs;
+    std::vector<std::string> passNames;
+    int currentPass = -1;
+
+    // STATISTIC_COUNT per pass, if the driver has them.
+    std::vector<GLuint> statistics[FRAME_COUNT];
+    std::vector<GLuint64> passStatistics;
+
+    // two per pass, for the start and the end, only issued when the trace is recording.
+    std::vector<GLuint> timestamps[FRAME_COUNT];
+    std::vector<bool> stamped[FRAME_COUNT];
+    // a GPU time, in nanoseconds, and the CPU time, in microseconds, at the same moment.
+    GLint64 calibrationGpuNs = 0;
+    double calibrationCpuUs = 0.0;
+};
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "cpu_image.h"
+
+//
+// Images in CPU memory, that behave like the images of the shaders, so that the passes of the demo
+// can run as C++ kernels, without a GL context. See cpu_renderer.h.
+//
+// Load() and Store() do what imageLoad() and imageStore() do:
+//  - a load outside the image gives 0, and a store outside the image is dropped.
+//  - the format decides how a value is stored. RGBA8UI clamps every component to 255, like the GL
+//    does for the integer formats, so uvec4(256) is stored as 255, and not as 0.
+//  - a load gives what the last store wrote, but nothing orders the stores of different threads
+//    in a pass. So, like in the shaders, a kernel may only read the pixels that no one writes in the
+//    same pass, or its own.
+//
+// The texels are stored in tiles of TILE_SIZE x TILE_SIZE, and a tile is contiguous. A pass that reads
+// the pixels around its own, like a filter does, then mostly finds them in the few tiles it has
+// touched already, where row by row, every row it reads from would be another part of memory.
+//
+
+// uvec4 and vec4, the values the kernels load and store.
+struct UVec4 {
+    uint32_t v[4];
+};
+struct Vec4 {
+    float v[4];
+};
+
+// RGBA8UI, the format of the fractal and the filtered images.
+struct FormatRgba8ui {
+    typedef UVec4 Value;
+    struct Texel {
+        uint8_t c[4];
+    };
+    static Value Load(const Texel& t) {
+        Value r = { { t.c[0], t.c[1], t.c[2], t.c[3] } };
+        return r;
+    }
+    static Texel Store(const Value& v) {
+        Texel t;
+        for (int c = 0; c < 4; c++) {
+            t.c[c] = (uint8_t)(v.v[c] > 255u ? 255u : v.v[c]);
+        }
+        return t;
+    }
+};
+
+// RGBA32F, the format of the history.
+struct FormatRgba32f {
+    typedef Vec4 Value;
+    typedef Vec4 Texel;
+    static Value Load(const Texel& t) { return t; }
+    static Texel Store(const Value& v) { return v; }
+};
+
+template <typename Format>
+class Image2D {
+public:
+    typedef typename Format::Value Value;
+    typedef typename Format::Texel Texel;
+
+    static const int TILE_BITS = 3;
+    static const int TILE_SIZE = 1 << TILE_BITS;
+
+    // all the texels are 0 afterwards, like a new texture.
+    void Resize(int w, int h) {
+        width = w;
+        height = h;
+        tilesX = (w + TILE_SIZE - 1) / TILE_SIZE;
+        int tilesY = (h + TILE_SIZE - 1) / TILE_SIZE;
+        texels.assign((size_t)tilesX * tilesY * TILE_SIZE * TILE_SIZE, Texel());
+    }
+
+    int GetWidth() const { return width; }
+    int GetHeight() const { return height; }
+
+    Value Load(int x, int y) const {
+        if (!Inside(x, y)) {
+            return Format::Load(Texel());
+        }
+        return Format::Load(texels[Index(x, y)]);
+    }
+
+    // the texel nearest to (x, y) inside the image: csample() of the shaders, clamp to edge.
+    Value LoadClamped(int x, int y) const {
+        x = x < 0 ? 0 : x >= width ? width - 1 : x;
+        y = y < 0 ? 0 : y >= height ? height - 1 : y;
+        return Format::Load(texels[Index(x, y)]);
+    }
+
+    void Store(int x, int y, const Value& value) {
+        if (Inside(x, y)) {
+            texels[Index(x, y)] = Format::Store(value);
+        }
+    }
+
+private:
+    // negative coordinates become large unsigned ones, so one compare per axis is enough.
+    bool Inside(int x, int y) const {
+        return (unsigned)x < (unsigned)width && (unsigned)y < (unsigned)height;
+    }
+
+    size_t Index(int x, int y) const {
+        size_t tile = (size_t)(y >> TILE_BITS) * tilesX + (x >> TILE_BITS);
+        return (tile << (2 * TILE_BITS)) + ((y & (TILE_SIZE - 1)) << TILE_BITS) + (x & (TILE_SIZE - 1));
+    }
+
+    int width = 0;
+    int height = 0;
+    int tilesX = 0;
+    std::vector<Texel> texels;
+};
+
+// Reads an RGBA8UI image back, like glGetTexImage() does for a texture.
+inline void ReadImage(const Image2D<FormatRgba8ui>& image, CpuImage* out) {
+    out->Resize(image.GetWidth(), image.GetHeight());
+    for (int y = 0; y < image.GetHeight(); y++) {
+        for (int x = 0; x < image.GetWidth(); x++) {
+            UVec4 v = image.Load(x, y);
+            unsigned char* p = out->At(x, y);
+            for (int c = 0; c < 4; c++) {
+                p[c] = (unsigned char)v.v[c];
+            }
+        }
+    }
+}
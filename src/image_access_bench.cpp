@@ -0,0 +1,411 @@
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdlib>
+
+#include "gl_util.h"
+#include "gl_state.h"
+#include "gl_textures.h"
+#include "gpu_memory.h"
+
+//
+// A microbenchmark of the ways a shader can read and write a 2D array of data: imageLoad() and
+// imageStore(), which the whole demo is built on, in a few formats, against texelFetch() and a
+// shader storage buffer. Every method is measured with three access patterns, and for reads,
+// writes, read-modify-writes, and the latency of a chain of dependent reads.
+//
+// The bandwidth tests launch one thread per element, like the passes of the demo, and time the
+// draw with a GL_TIME_ELAPSED query. The latency test launches a few threads that each follow a
+// chain through the data, where every element holds the index of the next, so every load has to
+// wait for the one before. The chains visit the elements in the order of the pattern.
+//
+// The kernels are in shaders/image_access_bench.vert.
+//
+
+// ARB_shader_storage_buffer_object, which is core in 4.3. Our loader only has 4.2.
+#define GL_SHADER_STORAGE_BUFFER 0x90D2
+#define GL_MAX_VERTEX_SHADER_STORAGE_BLOCKS 0x90D6
+
+#ifdef SHADER_DIR
+std::string shaderDirectory = SHADER_DIR;
+#else
+std::string shaderDirectory = "shaders";
+#endif
+
+int log2Width = 11; // the data is 2048x2048 elements of 4 bytes, 16 MB, by default.
+int repeats = 5; // every test runs this many times, and we report the fastest.
+const int LATENCY_THREADS = 256;
+const int CHAIN_LENGTH = 1024;
+
+// Must match the defines in image_access_bench.vert.
+enum Method {
+    METHOD_IMAGE_RGBA8UI,
+    METHOD_IMAGE_RGBA8,
+    METHOD_IMAGE_R32UI,
+    METHOD_TEXEL_FETCH,
+    METHOD_SSBO,
+    METHOD_COUNT
+};
+enum Pattern {
+    PATTERN_LINEAR,
+    PATTERN_TILED,
+    PATTERN_RANDOM,
+    PATTERN_COUNT
+};
+enum Op {
+    OP_READ,
+    OP_WRITE,
+    OP_READ_MODIFY_WRITE,
+    OP_LATENCY,
+    OP_COUNT
+};
+
+const char* METHOD_NAMES[METHOD_COUNT] = { "imageLoad rgba8ui", "imageLoad rgba8", "imageLoad r32ui", "texelFetch", "ssbo" };
+const char* PATTERN_NAMES[PATTERN_COUNT] = { "linear", "tiled", "random" };
+
+int GetWidth() { return 1 << log2Width; }
+int GetHeight() { return 1 << log2Width; }
+int GetElementCount() { return GetWidth() * GetHeight(); }
+
+// The k-th element in the order of a pattern, like Element() in the shader.
+int Element(Pattern pattern, int k) {
+    switch (pattern) {
+    case PATTERN_TILED: {
+        int tilesPerRow = GetWidth() / 8;
+        int tile = k / 64;
+        int inside = k % 64;
+        int x = (tile % tilesPerRow) * 8 + inside % 8;
+        int y = (tile / tilesPerRow) * 8 + inside / 8;
+        return (y << log2Width) + x;
+    }
+    case PATTERN_RANDOM:
+        return (int)(((unsigned int)k * 2654435761u) & (unsigned int)(GetElementCount() - 1));
+    default:
+        return k;
+    }
+}
+
+bool ReadFile(const std::string& path, std::string* contents) {
+    std::ifstream file(path.c_str());
+    if (!file) {
+        return false;
+    }
+    std::stringstream ss;
+    ss << file.rdbuf();
+    *contents = ss.str();
+    return true;
+}
+
+GLuint LoadKernel(Method method, Pattern pattern, Op op) {
+    std::string vs, fs;
+    if (!ReadFile(shaderDirectory + "/image_access_bench.vert", &vs) || !ReadFile(shaderDirectory + "/empty.frag", &fs)) {
+        printf("Could not read image_access_bench.vert or empty.frag from %s\n", shaderDirectory.c_str());
+        exit(1);
+    }
+    // after the #version line, which must come first.
+    size_t lineEnd = vs.find('\n') + 1;
+    char defines[128];
+    snprintf(defines, sizeof(defines), "#define METHOD %d\n#define PATTERN %d\n#define OP %d\n", method, pattern, op);
+    vs.insert(lineEnd, defines);
+    return LoadNormalShader(vs, fs);
+}
+
+//
+// The data of one method: an image, a texture or a buffer, of GetElementCount() uints.
+//
+struct Data {
+    GLuint texture = 0;
+    GLuint buffer = 0;
+};
+
+void CreateData(Method method, Data* data) {
+    if (method == METHOD_SSBO) {
+        GL_C(glGenBuffers(1, &data->buffer));
+        GL_C(glBindBuffer(GL_SHADER_STORAGE_BUFFER, data->buffer));
+        GL_C(glBufferData(GL_SHADER_STORAGE_BUFFER, (GLsizeiptr)GetElementCount() * 4, NULL, GL_DYNAMIC_COPY));
+        GL_C(glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0));
+        gpuMemory.AddBuffer(data->buffer, "ssbo", (size_t)GetElementCount() * 4);
+        return;
+    }
+    GLenum format = method == METHOD_IMAGE_RGBA8 ? GL_RGBA8 : method == METHOD_IMAGE_R32UI ? GL_R32UI : GL_RGBA8UI;
+    data->texture = CreateTexture2D(format, GetWidth(), GetHeight(), METHOD_NAMES[method]);
+    if (method == METHOD_TEXEL_FETCH) {
+        // texelFetch() ignores the filter, but an integer texture with a linear filter is incomplete,
+        // and reads as 0.
+        GL_C(glBindTexture(GL_TEXTURE_2D, data->texture));
+        GL_C(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST));
+        GL_C(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST));
+        GL_C(glBindTexture(GL_TEXTURE_2D, 0));
+    }
+}
+
+// Every element holds 'values[e]'.
+void UploadData(Method method, const Data& data, const std::vector<unsigned int>& values) {
+    if (method == METHOD_SSBO) {
+        GL_C(glBindBuffer(GL_SHADER_STORAGE_BUFFER, data.buffer));
+        GL_C(glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, (GLsizeiptr)values.size() * 4, &values[0]));
+        GL_C(glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0));
+    } else if (method == METHOD_IMAGE_R32UI) {
+        UploadTexture2D(data.texture, GetWidth(), GetHeight(), GL_RED_INTEGER, GL_UNSIGNED_INT, &values[0]);
+    } else {
+        // on a little endian machine, the bytes of a uint are already lowest first, which is what the shader expects.
+        GLenum format = method == METHOD_IMAGE_RGBA8 ? GL_RGBA : GL_RGBA_INTEGER;
+        UploadTexture2D(data.texture, GetWidth(), GetHeight(), format, GL_UNSIGNED_BYTE, &values[0]);
+    }
+}
+
+// Reads every element back into 'values'.
+void ReadData(Method method, const Data& data, std::vector<unsigned int>* values) {
+    GL_C(glMemoryBarrier(GL_ALL_BARRIER_BITS));
+    int size = (int)values->size() * 4;
+    if (method == METHOD_SSBO) {
+        GL_C(glBindBuffer(GL_SHADER_STORAGE_BUFFER, data.buffer));
+        GL_C(glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, size, &(*values)[0]));
+        GL_C(glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0));
+    } else if (method == METHOD_IMAGE_R32UI) {
+        ReadTexture2D(data.texture, GL_RED_INTEGER, GL_UNSIGNED_INT, size, &(*values)[0]);
+    } else {
+        ReadTexture2D(data.texture, method == METHOD_IMAGE_RGBA8 ? GL_RGBA : GL_RGBA_INTEGER, GL_UNSIGNED_BYTE, size, &(*values)[0]);
+    }
+}
+
+// Fast kernels that do nothing are easy to write by mistake. So we check that thread k of the write
+// kernel wrote 'k + offset' to the k-th element of the pattern, and that every run of the
+// read-modify-write kernel added one to it.
+void CheckData(Method method, const Data& data, Pattern pattern, unsigned int offset, const char* kernel) {
+    std::vector<unsigned int> values(GetElementCount());
+    ReadData(method, data, &values);
+    for (int k = 0; k < GetElementCount(); k++) {
+        unsigned int expected = (unsigned int)k + offset;
+        if (values[Element(pattern, k)] != expected) {
+            printf("\nelement %d is %u, but the %s kernel should have made it %u\n", Element(pattern, k), values[Element(pattern, k)], kernel, expected);
+            exit(1);
+        }
+    }
+}
+
+void BindData(Method method, const Data& data, GLuint sink) {
+    switch (method) {
+    case METHOD_IMAGE_RGBA8UI:
+        glState.BindImageTexture(0, data.texture, 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA8UI);
+        break;
+    case METHOD_IMAGE_RGBA8:
+        glState.BindImageTexture(0, data.texture, 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA8);
+        break;
+    case METHOD_IMAGE_R32UI:
+        glState.BindImageTexture(0, data.texture, 0, GL_FALSE, 0, GL_READ_WRITE, GL_R32UI);
+        break;
+    case METHOD_TEXEL_FETCH:
+        GL_C(glActiveTexture(GL_TEXTURE0));
+        GL_C(glBindTexture(GL_TEXTURE_2D, data.texture));
+        break;
+    default:
+        GL_C(glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, data.buffer));
+        break;
+    }
+    glState.BindImageTexture(1, sink, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32UI);
+}
+
+// Set when a kernel had to be timed on the CPU, see TimeKernel().
+bool cpuTimed = false;
+
+// Runs a kernel 'repeats' times, and returns the fastest, in milliseconds.
+//
+// It is timed with a GL_TIME_ELAPSED query. But some drivers don't time vertex shaders that way:
+// llvmpipe runs them inside glDrawArrays(), and its queries only cover the rasterizer, so they say
+// the kernel took almost no time. So we also time it with the clock of the CPU, from before the
+// draw to after glFinish(), which is always a bit more than the query, and use that instead if the
+// query says less than a tenth of it.
+double TimeKernel(GLuint program, int threadCount) {
+    glState.UseProgram(program);
+    GL_C(glUniform1i(glGetUniformLocation(program, "uLog2Width"), log2Width));
+    GL_C(glUniform1i(glGetUniformLocation(program, "uHeight"), GetHeight()));
+    GL_C(glUniform1i(glGetUniformLocation(program, "uChainLength"), CHAIN_LENGTH));
+    GL_C(glUniform1i(glGetUniformLocation(program, "uThreadCount"), threadCount));
+    GL_C(glUniform1i(glGetUniformLocation(program, "uProbe"), threadCount - 1));
+
+    GLuint query;
+    GL_C(glGenQueries(1, &query));
+    double best = 1e30;
+    // the first run is a warmup: the driver may only finish compiling the program when it is first used.
+    for (int i = 0; i <= repeats; i++) {
+        GL_C(glMemoryBarrier(GL_ALL_BARRIER_BITS));
+        GL_C(glFinish());
+        std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+        GL_C(glBeginQuery(GL_TIME_ELAPSED, query));
+        GL_C(glDrawArrays(GL_POINTS, 0, threadCount));
+        GL_C(glEndQuery(GL_TIME_ELAPSED));
+        GLuint64 ns = 0;
+        GL_C(glGetQueryObjectui64v(query, GL_QUERY_RESULT, &ns));
+        GL_C(glFinish());
+        double ms = (double)ns * 1e-6;
+        double cpuMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+        if (ms < 0.1 * cpuMs) {
+            ms = cpuMs;
+            cpuTimed = true;
+        }
+        if (i > 0) {
+            best = std::min(best, ms);
+        }
+    }
+    GL_C(glDeleteQueries(1, &query));
+    return best;
+}
+
+void PrintUsage() {
+    printf(
+        "usage: image_access_bench [options]\n"
+        "  --size N           the data is 2^N x 2^N elements of 4 bytes (default %d)\n"
+        "  --repeats N        run every test N times, and report the fastest (default %d)\n"
+        "  --shader-dir DIR   where to load the shaders from (default %s)\n",
+        log2Width, repeats, shaderDirectory.c_str());
+}
+
+void ParseArgs(int argc, char** argv) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--size") == 0 && i + 1 < argc) {
+            log2Width = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--repeats") == 0 && i + 1 < argc) {
+            repeats = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--shader-dir") == 0 && i + 1 < argc) {
+            shaderDirectory = argv[++i];
+        } else {
+            PrintUsage();
+            exit(strcmp(argv[i], "--help") == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+        }
+    }
+    // 2^14 x 2^14 elements is a 1 GB buffer, and the indices must fit in an int.
+    if (log2Width < 4 || log2Width > 14 || repeats < 1) {
+        printf("--size must be between 4 and 14, and --repeats at least 1\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+int main(int argc, char** argv) {
+    ParseArgs(argc, argv);
+
+    if (!glfwInit()) {
+        exit(EXIT_FAILURE);
+    }
+    // we never draw to the window, we only need its context.
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 2);
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+    GLFWwindow* window = glfwCreateWindow(64, 64, "image_access_bench", NULL, NULL);
+    if (!window) {
+        glfwTerminate();
+        exit(EXIT_FAILURE);
+    }
+    glfwMakeContextCurrent(window);
+    gladLoadGLLoader((GLADloadproc)glfwGetProcAddress);
+    InitTextureFunctions(true);
+
+    GLuint vao;
+    GL_C(glGenVertexArrays(1, &vao));
+    GL_C(glBindVertexArray(vao));
+    // only the vertex shaders do anything, so don't even try to rasterize the points.
+    GL_C(glEnable(GL_RASTERIZER_DISCARD));
+
+    bool hasSsbo = false;
+    if (HasGlFeature(43, "GL_ARB_shader_storage_buffer_object")) {
+        GLint blocks = 0;
+        GL_C(glGetIntegerv(GL_MAX_VERTEX_SHADER_STORAGE_BLOCKS, &blocks));
+        hasSsbo = blocks > 0;
+    }
+
+    GLuint sink = CreateTexture2D(GL_R32UI, 1, 1, "sink");
+
+    printf("%s, %dx%d elements of 4 bytes, fastest of %d runs\n", (const char*)glGetString(GL_RENDERER), GetWidth(), GetHeight(), repeats);
+    printf("  %-18s %-7s %10s %10s %10s %12s\n", "method", "pattern", "read", "write", "rmw", "latency");
+    printf("  %-18s %-7s %10s %10s %10s %12s\n", "", "", "GB/s", "GB/s", "GB/s", "ns per load");
+
+    std::vector<unsigned int> values(GetElementCount());
+    double bytes = (double)GetElementCount() * 4.0;
+    for (int m = 0; m < METHOD_COUNT; m++) {
+        Method method = (Method)m;
+        if (method == METHOD_SSBO && !hasSsbo) {
+            printf("  %-18s the driver has no shader storage buffers in vertex shaders\n", METHOD_NAMES[m]);
+            continue;
+        }
+        Data data;
+        CreateData(method, &data);
+
+        for (int p = 0; p < PATTERN_COUNT; p++) {
+            Pattern pattern = (Pattern)p;
+            printf("  %-18s %-7s", METHOD_NAMES[m], PATTERN_NAMES[p]);
+            fflush(stdout);
+
+            // every element holds one more than its index, so that none is 0, like the sink before the reads.
+            for (int e = 0; e < GetElementCount(); e++) {
+                values[e] = (unsigned int)e + 1;
+            }
+            UploadData(method, data, values);
+            unsigned int zero = 0;
+            UploadTexture2D(sink, 1, 1, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+            BindData(method, data, sink);
+            for (int o = OP_READ; o <= OP_READ_MODIFY_WRITE; o++) {
+                if (method == METHOD_TEXEL_FETCH && o != OP_READ) {
+                    printf(" %10s", "-"); // texelFetch() can only read.
+                    continue;
+                }
+                GLuint program = LoadKernel(method, pattern, (Op)o);
+                double ms = TimeKernel(program, GetElementCount());
+                glState.DeleteProgram(program);
+                if (o == OP_READ) {
+                    // the last thread wrote what it read to the sink.
+                    int e = Element(pattern, GetElementCount() - 1);
+                    unsigned int read = 0;
+                    GL_C(glMemoryBarrier(GL_TEXTURE_UPDATE_BARRIER_BIT));
+                    ReadTexture2D(sink, GL_RED_INTEGER, GL_UNSIGNED_INT, 4, &read);
+                    if (read != values[e]) {
+                        printf("\nthe read kernel read %u from element %d, which is %u\n", read, e, values[e]);
+                        exit(1);
+                    }
+                } else if (o == OP_WRITE) {
+                    CheckData(method, data, pattern, 0, "write");
+                } else {
+                    // TimeKernel() runs it once more than 'repeats', for the warmup.
+                    CheckData(method, data, pattern, (unsigned int)repeats + 1, "read-modify-write");
+                }
+                // a read-modify-write moves every element twice.
+                double moved = o == OP_READ_MODIFY_WRITE ? 2.0 * bytes : bytes;
+                printf(" %10.2f", moved / (ms * 1e-3) * 1e-9);
+                fflush(stdout);
+            }
+
+            // every element points to the next one in the order of the pattern, and the last to the first.
+            for (int k = 0; k < GetElementCount(); k++) {
+                values[Element(pattern, k)] = (unsigned int)Element(pattern, (k + 1) % GetElementCount());
+            }
+            UploadData(method, data, values);
+            GLuint program = LoadKernel(method, pattern, OP_LATENCY);
+            double ms = TimeKernel(program, LATENCY_THREADS);
+            glState.DeleteProgram(program);
+            printf(" %12.1f\n", ms * 1e6 / CHAIN_LENGTH);
+        }
+
+        if (data.texture) {
+            DeleteTextures2D(1, &data.texture);
+        }
+        if (data.buffer) {
+            GL_C(glDeleteBuffers(1, &data.buffer));
+            gpuMemory.RemoveBuffer(data.buffer);
+        }
+    }
+
+    if (cpuTimed) {
+        printf("the driver's timer queries missed some kernels, so they were timed on the CPU, see TimeKernel()\n");
+    }
+
+    glfwTerminate();
+    return 0;
+}
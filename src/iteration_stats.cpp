@@ -0,0 +1,153 @@
+#include "iteration_stats.h"
+#include "cpu_image.h"
+#include "gl_state.h"
+#include "gl_textures.h"
+#include "gl_util.h"
+
+#include <algorithm>
+
+static const int GROUP_WIDTHS[GROUP_COUNT] = { 8, 32 };
+static const int GROUP_HEIGHTS[GROUP_COUNT] = { 8, 1 };
+static const char* GROUP_NAMES[GROUP_COUNT] = { "8x8", "32x1" };
+
+static int GetGroupsX(IterationGroup group, int width) { return (width + GROUP_WIDTHS[group] - 1) / GROUP_WIDTHS[group]; }
+static int GetGroupsY(IterationGroup group, int height) { return (height + GROUP_HEIGHTS[group] - 1) / GROUP_HEIGHTS[group]; }
+
+void IterationStats::Init(ShaderPermutations* permutations_, int texWidth_, int texHeight_) {
+    permutations = permutations_;
+    texWidth = texWidth_;
+    texHeight = texHeight_;
+    iterationTexture = CreateTexture2D(GL_R32UI, texWidth, texHeight, "iteration stats");
+    for (int g = 0; g < GROUP_COUNT; g++) {
+        IterationGroup group = (IterationGroup)g;
+        statsTextures[g] = CreateTexture2D(GL_RGBA32F, GetGroupsX(group, texWidth), GetGroupsY(group, texHeight), "iteration stats");
+    }
+}
+
+GLuint IterationStats::GetProgram(IterationGroup group) {
+    ShaderConstants constants;
+    constants["GROUP_WIDTH"] = GROUP_WIDTHS[group];
+    constants["GROUP_HEIGHT"] = GROUP_HEIGHTS[group];
+    return permutations->Get("iteration_stats.vert", "empty.frag", constants);
+}
+
+bool IterationStats::IsReady() {
+    // ask for both, so that they are compiled at the same time.
+    bool ready = true;
+    for (int g = 0; g < GROUP_COUNT; g++) {
+        ready = GetProgram((IterationGroup)g) != 0 && ready;
+    }
+    return ready;
+}
+
+void IterationStats::RunPass(IterationGroup group, int width, int height) {
+    glState.DepthMask(false);
+    glState.ColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+
+    glState.BindImageTexture(0, iterationTexture, 0, GL_FALSE, 0, GL_READ_ONLY, GL_R32UI);
+    glState.BindImageTexture(2, statsTextures[group], 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA32F);
+
+    GLuint shader = GetProgram(group);
+    glState.UseProgram(shader);
+    GL_C((glUniform1i(glGetUniformLocation(shader, "uWidth"), width)));
+    GL_C((glUniform1i(glGetUniformLocation(shader, "uHeight"), height)));
+    GL_C(glDrawArrays(GL_POINTS, 0, GetGroupsX(group, width) * GetGroupsY(group, height))); // one thread per group.
+}
+
+void IterationStats::AddToGraph(RenderGraph* graph, ImageHandle iterations, const int* width, const int* height) {
+    // the statistics are read back long after the frame, so they live outside the graph. That also
+    // keeps the graph from culling the pass, since nothing in the frame reads them.
+    for (int g = 0; g < GROUP_COUNT; g++) {
+        IterationGroup group = (IterationGroup)g;
+        ImageHandle stats = graph->ImportImage(std::string("stats ") + GROUP_NAMES[g], GL_RGBA32F);
+        graph->SetImportedTexture(stats, statsTextures[g]);
+        graph->AddPass(std::string("iteration stats ") + GROUP_NAMES[g], [this, group, width, height]() {
+            RunPass(group, *width, *height);
+        })
+            .Read(iterations, ACCESS_IMAGE_LOAD)
+            .Write(stats, ACCESS_IMAGE_STORE);
+    }
+}
+
+// Reads back the statistics of the groups of the width x height corner, four floats per group, row by row.
+void IterationStats::ReadStats(IterationGroup group, int width, int height, std::vector<float>* stats) {
+    int statsWidth = GetGroupsX(group, texWidth);
+    std::vector<float> all((size_t)statsWidth * GetGroupsY(group, texHeight) * 4);
+    GL_C(glMemoryBarrier(GL_TEXTURE_UPDATE_BARRIER_BIT));
+    ReadTexture2D(statsTextures[group], GL_RGBA, GL_FLOAT, (int)(all.size() * sizeof(float)), &all[0]);
+
+    int groupsX = GetGroupsX(group, width);
+    int groupsY = GetGroupsY(group, height);
+    stats->resize((size_t)groupsX * groupsY * 4);
+    for (int y = 0; y < groupsY; y++) {
+        std::copy(all.begin() + (size_t)y * statsWidth * 4, all.begin() + ((size_t)y * statsWidth + groupsX) * 4,
+            stats->begin() + (size_t)y * groupsX * 4);
+    }
+}
+
+void IterationStats::Summarize(int width, int height, IterationSummary* summary) {
+    *summary = IterationSummary();
+    for (int g = 0; g < GROUP_COUNT; g++) {
+        std::vector<float> stats;
+        ReadStats((IterationGroup)g, width, height, &stats);
+
+        double sum = 0.0, work = 0.0, pixels = 0.0;
+        int maxN = 0;
+        for (size_t i = 0; i < stats.size(); i += 4) {
+            float mean = stats[i], groupMax = stats[i + 1], count = stats[i + 3];
+            sum += (double)mean * count;
+            work += (double)groupMax * count;
+            pixels += count;
+            maxN = std::max(maxN, (int)groupMax);
+        }
+        // every grouping covers the same pixels, so the mean and max are the same for both.
+        summary->meanIterations = pixels > 0.0 ? sum / pixels : 0.0;
+        summary->maxIterations = maxN;
+        summary->laneEfficiency[g] = work > 0.0 ? sum / work : 1.0;
+    }
+}
+
+// 0 is black, then red, yellow, and 1 is white.
+static void HeatColor(float t, unsigned char* rgba) {
+    t = std::min(std::max(t, 0.0f), 1.0f) * 3.0f;
+    rgba[0] = (unsigned char)(255.0f * std::min(t, 1.0f) + 0.5f);
+    rgba[1] = (unsigned char)(255.0f * std::min(std::max(t - 1.0f, 0.0f), 1.0f) + 0.5f);
+    rgba[2] = (unsigned char)(255.0f * std::max(t - 2.0f, 0.0f) + 0.5f);
+    rgba[3] = 255;
+}
+
+bool IterationStats::WriteHeatmaps(const std::string& prefix, int width, int height, int maxIterations) {
+    std::vector<unsigned int> iterations((size_t)texWidth * texHeight);
+    GL_C(glMemoryBarrier(GL_TEXTURE_UPDATE_BARRIER_BIT));
+    ReadTexture2D(iterationTexture, GL_RED_INTEGER, GL_UNSIGNED_INT, (int)(iterations.size() * sizeof(unsigned int)), &iterations[0]);
+
+    CpuImage image;
+    image.Resize(width, height);
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            HeatColor((float)iterations[(size_t)y * texWidth + x] / (float)maxIterations, image.At(x, y));
+        }
+    }
+    bool written = image.WritePpm(prefix + ".iterations.ppm");
+
+    // every pixel of a group gets the color of the fraction of the lanes of the group that idle: 1 - mean / max.
+    for (int g = 0; g < GROUP_COUNT; g++) {
+        IterationGroup group = (IterationGroup)g;
+        std::vector<float> stats;
+        ReadStats(group, width, height, &stats);
+        int groupsX = GetGroupsX(group, width);
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x++) {
+                const float* s = &stats[((size_t)(y / GROUP_HEIGHTS[g]) * groupsX + x / GROUP_WIDTHS[g]) * 4];
+                HeatColor(s[1] > 0.0f ? 1.0f - s[0] / s[1] : 0.0f, image.At(x, y));
+            }
+        }
+        written = image.WritePpm(prefix + ".waste-" + GROUP_NAMES[g] + ".ppm") && written;
+    }
+    return written;
+}
+
+void IterationStats::Destroy() {
+    DeleteTextures2D(1, &iterationTexture);
+    DeleteTextures2D(GROUP_COUNT, statsTextures);
+}
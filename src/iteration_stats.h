@@ -0,0 +1,74 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <string>
+#include <vector>
+
+#include "render_graph.h"
+#include "shader_permutations.h"
+
+//
+// A diagnostic mode that shows where the escape time loop of the fractal wastes SIMD lanes.
+//
+// The fractal pass also writes the number of iterations of every pixel to a side image, and passes
+// of their own reduce that, on the GPU, to statistics per group of pixels: the mean, max and min.
+// The lanes of a SIMD group run until the slowest pixel of the group has escaped, so a group
+// costs its max for every pixel, while only the mean is useful work. Their ratio, the lane
+// efficiency, tells us how much a different grouping, or scheduling, of the pixels could win.
+//
+// We look at two groupings: 8x8 tiles, and runs of 32 pixels in a row. The fractal pass runs a
+// thread for every pixel in row order, so the second is about how it is split into SIMD groups
+// now, at least when the width is a multiple of 32.
+//
+
+// The reduction sums the iterations of a group of at most 64 pixels in a uint, which holds them
+// exactly for up to this many iterations per pixel.
+const int MAX_STATS_ITERATIONS = 1 << 26;
+
+enum IterationGroup {
+    GROUP_8X8,
+    GROUP_32X1,
+    GROUP_COUNT
+};
+
+struct IterationSummary {
+    double meanIterations = 0.0;
+    int maxIterations = 0;
+    // the useful work over the work done, for every grouping: the sum of the iterations, over the
+    // sum of the max of every group times the number of pixels in it.
+    double laneEfficiency[GROUP_COUNT] = { 1.0, 1.0 };
+};
+
+class IterationStats {
+public:
+    // The textures are texWidth x texHeight, like the other textures of the graph, and the
+    // statistics are for the width x height in the bottom left corner.
+    void Init(ShaderPermutations* permutations, int texWidth, int texHeight);
+    // true once the programs of the reduction have been compiled.
+    bool IsReady();
+
+    // The image the fractal pass writes the iterations to, as R32UI.
+    GLuint GetIterationTexture() const { return iterationTexture; }
+    // Adds the pass that reduces 'iterations', which must be GetIterationTexture(), to the statistics.
+    void AddToGraph(RenderGraph* graph, ImageHandle iterations, const int* width, const int* height);
+
+    // Reads back the statistics of the last frame. This waits for the GPU.
+    void Summarize(int width, int height, IterationSummary* summary);
+    // Writes heatmaps of the last frame, as PPMs: prefix + ".iterations.ppm", of the iterations of
+    // every pixel, up to 'maxIterations', and prefix + ".waste-8x8.ppm" and ".waste-32x1.ppm", of the
+    // lanes wasted in every group. Returns false if they couldn't be written. This waits for the GPU.
+    bool WriteHeatmaps(const std::string& prefix, int width, int height, int maxIterations);
+
+    void Destroy();
+
+private:
+    GLuint GetProgram(IterationGroup group);
+    void RunPass(IterationGroup group, int width, int height);
+    void ReadStats(IterationGroup group, int width, int height, std::vector<float>* stats);
+
+    ShaderPermutations* permutations = NULL;
+    GLuint iterationTexture = 0;
+    GLuint statsTextures[GROUP_COUNT] = { 0, 0 }; // RGBA32F: mean, max, min, pixel count per group.
+    int texWidth = 0, texHeight = 0;
+};
@@ -4,370 +4,1160 @@
 #include <chrono>
 #include <thread>
 #include <string>
+#include <vector>
+#include <cstring>
+#include <cmath>
+#include <cstdlib>
+
+#include "gl_renderer.h"
+#include "clock.h"
+#include "filter_library.h"
+#include "fractal_variant.h"
+#include "pixel_order.h"
+#include "cpu_fractal.h"
+#include "renderer.h"
+#include "vulkan_renderer.h"
+#include "cpu_renderer.h"
+#include "render_farm.h"
+#include "trace.h"
+#include "gpu_memory.h"
+
+// The passes live in gl_renderer.cpp, and the other backends next to it, so here is just the demo
+// around them: the command line, the window, the animation, and the modes that check and time them.
 
-//
-// Begin Utility functions
-//
+const int WINDOW_WIDTH = 1497;
+const int WINDOW_HEIGHT = 1014;
 
-inline void CheckOpenGLError(const char* stmt, const char* fname, int line)
-{
-    GLenum err = glGetError();
-    //  const GLubyte* sError = gluErrorString(err);
+GLFWwindow* window;
+// the variant we want to render. Change the formula with F, the power with P, and the iterations with + and -.
+FractalVariant fractalVariant;
+// the variant of the last frame. While a new variant is being compiled, the GL backend keeps rendering the old one.
+FractalVariant renderedVariant;
+// How the fractal pass spreads the pixels over the threads, see gl_renderer.h. Cycle through them with S.
+FractalSchedule fractalSchedule = SCHEDULE_PER_PIXEL;
+int persistentThreadCount = 65536;
+int workItemSize = 32;
+bool benchmarkSchedules = false; // time the fractal pass with every schedule, and exit.
+// compute only the rows that aren't the mirror image of others, see GlRenderer::FindMirrorRows().
+bool mirrorEnabled = true;
+// the order in which the fractal and the filter passes map their threads to pixels, see pixel_order.h.
+PixelOrder pixelOrder = PIXEL_ORDER_ROWS;
+bool benchmarkPixelOrders = false; // time the passes with every pixel order, and exit.
+#ifdef SHADER_DIR
+std::string shaderDirectory = SHADER_DIR;
+#else
+std::string shaderDirectory = "shaders";
+#endif
+std::string shaderCacheDirectory = ".shader_cache";
+bool shaderCacheEnabled = true;
+float totalTime = 0.0f; // keep track of time for the animation.
+int FRAME_RATE = 60;
+bool paused = false; // when paused, the view stands still, and the samples keep accumulating.
+
+// which backend renders the frames: "gl", the one this demo is about, "vulkan" or "cpu". See renderer.h.
+std::string backendName = "gl";
+Renderer* renderer;
+GlRenderer glRenderer;
+VulkanRenderer vulkanRenderer;
+CpuRenderer cpuRenderer;
+#ifdef SPIRV_DIR
+std::string spirvDirectory = SPIRV_DIR;
+#else
+std::string spirvDirectory = "spirv";
+#endif
+bool headless = false; // render offscreen, without a window. Only the Vulkan and the CPU backend can do that.
+int maxFrames = 0; // exit after this many frames. 0 means run until the window is closed.
+std::string dumpFile; // if set, the last frame is written to this file, as a PPM, when we exit.
+std::string traceFile; // if set, we record a trace, see trace.h, and write it to this file when we exit.
+// with --view, we render this view, instead of the animation.
+bool fixedViewEnabled = false;
+View fixedView;
+
+// The render farm renders one large image in tiles, with several worker processes, see render_farm.h.
+std::string farmFile; // if set, we render one image with the farm, to this file, and exit.
+RenderFarmConfig farmConfig;
+
+DynamicResolutionConfig dynamicResolutionConfig;
+bool dynamicResolutionEnabled = true;
+int framesInFlight = 2;
+
+// the filters between the fractal and the screen. See filter_library.h for what is available.
+std::string filterSpec = "box";
+std::vector<FilterInstance> filterChain;
+bool checkFilters = false; // run the filters against their CPU reference, and exit.
+bool checkViews = false; // render the golden views with GL and the CPU, compare them, and exit.
+bool checkCpuBackend = false; // render the golden views with the GL passes and the CPU backend, compare them, and exit.
+bool checkVulkanBackend = false; // render the golden views with the Vulkan and the CPU backend, compare them, and exit.
+// render the golden views with the CPU backend, compare them with the images in cpuReferenceDirectory, and exit.
+bool checkCpuReferences = false;
+bool updateCpuReferences = false; // write those images instead.
+#ifdef CPU_REFERENCE_DIR
+std::string cpuReferenceDirectory = CPU_REFERENCE_DIR;
+#else
+std::string cpuReferenceDirectory = "tests/cpu_backend";
+#endif
+std::string checkViewsDirectory = "."; // where the images of the views that fail the check go.
+bool directStateAccessEnabled = true; // use GL 4.5 direct state access for textures, if we have it.
+
+// the iteration statistics, see iteration_stats.h. Press H to write the heatmaps of the last frame.
+bool iterationStatsEnabled = false;
+std::string heatmapPrefix = "heatmap";
+bool heatmapOnExit = false; // also write them when we exit.
+
+// The GL backend, with the settings of the command line, in a window of width x height.
+GlRendererConfig GetGlConfig(int width, int height) {
+    GlRendererConfig config;
+    config.width = width;
+    config.height = height;
+    config.shaderDirectory = shaderDirectory;
+    config.shaderCacheDirectory = shaderCacheDirectory;
+    config.shaderCacheEnabled = shaderCacheEnabled;
+    config.directStateAccessEnabled = directStateAccessEnabled;
+    config.filterChain = filterChain;
+    config.dynamicResolution = dynamicResolutionConfig;
+    config.dynamicResolutionEnabled = dynamicResolutionEnabled;
+    config.framesInFlight = framesInFlight;
+    config.schedule = fractalSchedule;
+    config.persistentThreadCount = persistentThreadCount;
+    config.workItemSize = workItemSize;
+    config.mirrorEnabled = mirrorEnabled;
+    config.pixelOrder = pixelOrder;
+    config.iterationStatsEnabled = iterationStatsEnabled;
+    config.timingInterval = FRAME_RATE; // once a second.
+    return config;
+}
 
-    if (err != GL_NO_ERROR){
-        printf("OpenGL error %08x, at %s:%i - for %s.\n", err, fname, line, stmt);
-        exit(1);
+void InitGl(const GlRendererConfig& config) {
+    if (!glRenderer.Init(config)) {
+        glfwTerminate();
+        exit(EXIT_FAILURE);
     }
 }
 
-// GL Check Macro. Will terminate the program if a GL error is detected. 
-#define GL_C(stmt) do {					\
-	stmt;						\
-	CheckOpenGLError(#stmt, __FILE__, __LINE__);	\
-    } while (0)
+View GetView() {
+    if (fixedViewEnabled) {
+        return fixedView;
+    }
+    View view;
+    renderedVariant.GetCenter(&view.centerX, &view.centerY);
+    view.scale = 2.0f + 1.7f * cosf(1.8f * totalTime);
+    return view;
+}
 
-inline char* GetShaderLogInfo(GLuint shader) {
-    GLint len;
-    GLsizei actualLen;
+// Writes the heatmaps of the iterations of the last frame, see GlRenderer::WriteHeatmaps().
+void WriteHeatmaps() {
+    if (glRenderer.WriteHeatmaps(heatmapPrefix)) {
+        printf("wrote %s.iterations.ppm, %s.waste-8x8.ppm and %s.waste-32x1.ppm\n", heatmapPrefix.c_str(), heatmapPrefix.c_str(), heatmapPrefix.c_str());
+    } else {
+        printf("Could not write the heatmaps to %s.*.ppm\n", heatmapPrefix.c_str());
+    }
+}
 
-    GL_C(glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &len));
-    char* infoLog = new char[len];
+void KeyCallback(GLFWwindow*, int key, int, int action, int) {
+    if (key == GLFW_KEY_SPACE && action == GLFW_PRESS) {
+        paused = !paused;
+    }
+    if (key == GLFW_KEY_F && action == GLFW_PRESS) {
+        fractalVariant.formula = (FractalFormula)((fractalVariant.formula + 1) % FORMULA_COUNT);
+        printf("fractal: %s\n", fractalVariant.GetName().c_str());
+    }
+    if (key == GLFW_KEY_P && action == GLFW_PRESS) {
+        fractalVariant.power = fractalVariant.power == MAX_FRACTAL_POWER ? MIN_FRACTAL_POWER : fractalVariant.power + 1;
+        printf("fractal: %s\n", fractalVariant.GetName().c_str());
+    }
+    if ((key == GLFW_KEY_EQUAL || key == GLFW_KEY_KP_ADD) && action == GLFW_PRESS && fractalVariant.iterations < 8192) {
+        fractalVariant.iterations *= 2;
+        printf("fractal: %s\n", fractalVariant.GetName().c_str());
+    }
+    if ((key == GLFW_KEY_MINUS || key == GLFW_KEY_KP_SUBTRACT) && action == GLFW_PRESS && fractalVariant.iterations >= 8) {
+        fractalVariant.iterations /= 2;
+        printf("fractal: %s\n", fractalVariant.GetName().c_str());
+    }
+    if (key == GLFW_KEY_M && action == GLFW_PRESS && backendName == "gl") {
+        gpuMemory.Print();
+    }
+    if (key == GLFW_KEY_H && action == GLFW_PRESS && iterationStatsEnabled) {
+        WriteHeatmaps();
+    }
+    if (key == GLFW_KEY_S && action == GLFW_PRESS && backendName == "gl") {
+        FractalSchedule next = (FractalSchedule)((glRenderer.GetSchedule() + 1) % SCHEDULE_COUNT);
+        // Mariani-Silver may be off in a few pixels, so it only takes its turn when it was asked for.
+        if (next == SCHEDULE_MARIANI_SILVER && fractalSchedule != SCHEDULE_MARIANI_SILVER) {
+            next = (FractalSchedule)((next + 1) % SCHEDULE_COUNT);
+        }
+        glRenderer.SetSchedule(next);
+        printf("fractal pass: %s\n", SCHEDULE_NAMES[glRenderer.GetSchedule()]);
+    }
+}
 
-    GL_C(glGetShaderInfoLog(shader, len, &actualLen, infoLog));
+// The Vulkan and the CPU backend only have the box filter. Returns its radius.
+int GetBoxFilterRadius(const char* backend) {
+    if (filterChain.size() != 1 || strcmp(filterChain[0].def->name, "box") != 0) {
+        printf("The %s backend can only run the box filter, not \"%s\".\n", backend, filterSpec.c_str());
+        exit(EXIT_FAILURE);
+    }
+    return (int)filterChain[0].params["radius"];
+}
 
-    return  infoLog;
+//
+// The Vulkan backend needs a window without a GL context, or no window at all, when it runs headless.
+//
+void InitVulkan() {
+    VulkanRendererConfig config;
+    config.width = WINDOW_WIDTH;
+    config.height = WINDOW_HEIGHT;
+    if (!headless) {
+        if (!glfwInit())
+            exit(EXIT_FAILURE);
+        if (!glfwVulkanSupported()) {
+            printf("GLFW found no Vulkan driver. Try --headless, or --backend gl.\n");
+            exit(EXIT_FAILURE);
+        }
+        glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+        glfwWindowHint(GLFW_RESIZABLE, GL_FALSE);
+        window = glfwCreateWindow(WINDOW_WIDTH, WINDOW_HEIGHT, "Image Load Store Demo (Vulkan)", NULL, NULL);
+        if (!window) {
+            glfwTerminate();
+            exit(EXIT_FAILURE);
+        }
+        config.window = window;
+    }
+    config.framesInFlight = framesInFlight;
+    config.spirvDirectory = spirvDirectory;
+    config.variant = fractalVariant;
+    config.blurRadius = GetBoxFilterRadius("Vulkan");
+    if (!vulkanRenderer.Init(config)) {
+        vulkanRenderer.Destroy();
+        exit(EXIT_FAILURE);
+    }
 }
 
-inline GLuint CreateShaderFromString(const std::string& shaderSource, const GLenum shaderType) {
-    std::string src = shaderSource;
+//
+// The CPU backend always renders offscreen. There is no dynamic resolution, so it renders at the
+// highest render resolution, and the display pass scales that to the size of the window.
+//
+void InitCpu(int width, int height) {
+    CpuRendererConfig config;
+    config.width = width;
+    config.height = height;
+    config.renderWidth = std::max(1, (int)(width * dynamicResolutionConfig.maxScale + 0.5f));
+    config.renderHeight = std::max(1, (int)(height * dynamicResolutionConfig.maxScale + 0.5f));
+    config.variant = fractalVariant;
+    config.blurRadius = GetBoxFilterRadius("CPU");
+    cpuRenderer.Init(config);
+}
 
-    GLuint shader;
+//
+// For the modes that render a few images, and exit, instead of running the demo: a hidden window,
+// of exactly the size we render at, with all the shaders compiled.
+//
+void InitOffscreenGl(int width, int height) {
+    GlRendererConfig config = GetGlConfig(width, height);
+    config.visible = false;
+    // always render at the full resolution of the window, so that the textures are exactly that large.
+    config.dynamicResolutionEnabled = false;
+    config.dynamicResolution.maxScale = 1.0f;
+    InitGl(config);
+    glRenderer.WaitForShaders(fractalVariant);
+}
 
-    GL_C(shader = glCreateShader(shaderType));
-    const char *c_str = src.c_str();
-    GL_C(glShaderSource(shader, 1, &c_str, NULL));
-    GL_C(glCompileShader(shader));
+//
+// Renders a tile of the render farm, in a worker process. The worker has its own hidden window,
+// just large enough for a tile, and runs the fractal and the filter passes on it, like a frame,
+// see GlRenderer::SetRegion().
+//
+// The filters read the pixels around a pixel too, so we render the tile with a border as wide
+// as the reach of the filters, and only keep the middle. At the edges of the image there is
+// no border, and the filters clamp to the edge, just like they do for the whole image.
+// So the tiles put together are exactly the image we would get in one go.
+//
+void RenderFarmTile(const FarmTile& tile, CpuImage* pixels) {
+    int reach = FilterLibrary::GetReach(filterChain);
+
+    static bool initialized = false;
+    if (!initialized) {
+        // llvmpipe renders with a thread for every core. With a worker for every core that would be
+        // far too many threads, so every worker gets its share, unless LP_NUM_THREADS is set already.
+        int cores = (int)std::thread::hardware_concurrency();
+        int workers = farmConfig.workerCount > 0 ? farmConfig.workerCount : cores;
+        std::string threads = std::to_string(std::max(1, cores / std::max(1, workers)));
+        setenv("LP_NUM_THREADS", threads.c_str(), 0);
+
+        InitOffscreenGl(farmConfig.tileSize + 2 * reach, farmConfig.tileSize + 2 * reach);
+        initialized = true;
+    }
 
-    GLint compileStatus;
-    GL_C(glGetShaderiv(shader, GL_COMPILE_STATUS, &compileStatus));
+    int originX = std::max(tile.x - reach, 0);
+    int originY = std::max(tile.y - reach, 0);
+    glRenderer.SetRegion(farmConfig.width, farmConfig.height, originX, originY,
+        std::min(tile.x + tile.width + reach, farmConfig.width) - originX,
+        std::min(tile.y + tile.height + reach, farmConfig.height) - originY);
 
-    if (compileStatus != GL_TRUE) {
-        printf("Could not compile shader\n\n%s \n\n%s\n", src.c_str(),
-            GetShaderLogInfo(shader));
-        exit(1);
-    }
+    CpuImage region;
+    FrameParams params = { GetView(), fractalVariant };
+    glRenderer.RenderStill(params, &region);
 
-    return shader;
+    pixels->Resize(tile.width, tile.height);
+    for (int y = 0; y < tile.height; y++) {
+        memcpy(pixels->At(0, y), region.At(tile.x - originX, tile.y - originY + y), (size_t)tile.width * 4);
+    }
 }
 
-/*
-Load shader with only vertex and fragment shader.
-*/
-inline GLuint LoadNormalShader(const std::string& vsSource, const std::string& fsShader){
-    // Create the shaders
-    GLuint vs = CreateShaderFromString(vsSource, GL_VERTEX_SHADER);
-    GLuint fs = CreateShaderFromString(fsShader, GL_FRAGMENT_SHADER);
+//
+// The golden images of --check-views: views that cover every formula, a few powers, and a deep zoom,
+// where single precision starts to matter. The fractal pass is compared with the CPU reference,
+// cpu_fractal.h, and the filter chain with the CPU versions of the filters, run on the fractal of
+// the GL. So a pixel that the GL rounds differently is counted once, and not once for every pixel
+// the filters spread it to. That needs no GPU, so it runs anywhere llvmpipe does, and catches any
+// rewrite of the shaders that changes the image.
+//
+struct GoldenView {
+    const char* name;
+    FractalFormula formula;
+    int power;
+    int iterations;
+    View view;
+    // how many of the 320x240 pixels of the fractal may be off by any amount, see GOLDEN_TOLERANCE.
+    // About 1.5 times as many as llvmpipe is off by, which is in the comments.
+    int maxPixelsOff;
+};
+
+const GoldenView GOLDEN_VIEWS[] = {
+    { "mandelbrot", FORMULA_MANDELBROT, 2, 128, { -0.5f, 0.0f, 3.0f }, 80 }, // 52
+    // deep in the chaotic part, the CPU and the GPU disagree on 3% of the pixels.
+    { "seahorse-valley", FORMULA_MANDELBROT, 2, 256, { -0.745f, 0.186f, 0.01f }, 3400 }, // 2237
+    { "multibrot3", FORMULA_MANDELBROT, 3, 128, { 0.0f, 0.0f, 3.0f }, 150 }, // 98
+    { "multibrot8", FORMULA_MANDELBROT, 8, 64, { 0.0f, 0.0f, 2.5f }, 120 }, // 75
+    { "julia", FORMULA_JULIA, 2, 128, { 0.0f, 0.0f, 3.0f }, 120 }, // 76
+    // the noisy part under the ship is just as chaotic.
+    { "burning-ship", FORMULA_BURNING_SHIP, 2, 128, { -0.4f, -0.5f, 3.5f }, 900 }, // 599
+    // so far out that the tile of Mariani-Silver around c = 0 holds all of the set, see TileStatus() in fractal.vert.
+    { "zoomed-out", FORMULA_MANDELBROT, 2, 128, { -2.0f, 2.1f, 40.0f }, 20 }, // 0
+};
+
+const int GOLDEN_WIDTH = 320;
+const int GOLDEN_HEIGHT = 240;
+
+// The GPU may round differently in the last bit, so a pixel right on the edge of an iteration band
+// can land in the next band, which moves the color by a few steps. And near the boundary of the set,
+// where the orbits are chaotic, the iteration count can be completely different. So we allow every
+// channel to be off by a little, and a few pixels, GoldenView::maxPixelsOff, to be off by any amount.
+const int GOLDEN_TOLERANCE[4] = { 2, 2, 2, 0 };
+
+// Compares an image with its reference, and prints how they differ. If they differ by more than the
+// tolerance in more than 'maxPixelsOff' pixels, the image, the reference and the differences go to
+// checkViewsDirectory, as 'name'.ppm, 'name'.reference.ppm and 'name'.diff.ppm, so that we can see
+// what went wrong.
+bool CheckImage(const std::string& name, const CpuImage& image, const CpuImage& reference, const int tolerance[4], int maxPixelsOff) {
+    CpuImage diffImage;
+    ImageDiff diff = CompareImages(image, reference, tolerance, &diffImage);
+    bool passed = diff.pixelsOff <= maxPixelsOff;
+
+    char maxDiff[32];
+    snprintf(maxDiff, sizeof(maxDiff), "%d %d %d %d", diff.maxDiff[0], diff.maxDiff[1], diff.maxDiff[2], diff.maxDiff[3]);
+    printf(" %16s %6d/%-5d", maxDiff, diff.pixelsOff, maxPixelsOff);
+    if (!diff.sameSize) {
+        printf(" (the image is %dx%d, not %dx%d)", image.width, image.height, reference.width, reference.height);
+    }
+    if (!passed) {
+        std::string prefix = checkViewsDirectory + "/" + name;
+        if (!image.WritePpm(prefix + ".ppm") || !reference.WritePpm(prefix + ".reference.ppm") || !diffImage.WritePpm(prefix + ".diff.ppm")) {
+            printf(" (could not write %s.*.ppm)", prefix.c_str());
+        } else {
+            printf(" (wrote %s.ppm, .reference.ppm and .diff.ppm)", prefix.c_str());
+        }
+    }
+    return passed;
+}
 
-    // Link the program
-    GLuint shader = glCreateProgram();
-    glAttachShader(shader, vs);
-    glAttachShader(shader, fs);
-    glLinkProgram(shader);
+bool CheckViews() {
+    InitOffscreenGl(GOLDEN_WIDTH, GOLDEN_HEIGHT);
 
+    // the filters get the same input on both sides, so only their own rounding is left: every filter
+    // pass rounds to 8 bits, and may be off by one, see FilterLibrary::Check(). But never by more.
+    int tolerance[4];
+    int passCount = 0;
+    for (const FilterInstance& f : filterChain) {
+        passCount += (int)f.def->stages.size();
+    }
+    for (int c = 0; c < 4; c++) {
+        tolerance[c] = c < 3 ? passCount : 0;
+    }
 
-    GLint Result;
-    glGetProgramiv(shader, GL_LINK_STATUS, &Result);
-    if (Result == GL_FALSE) {
-        printf("Could not link shader \n\n%s\n", GetShaderLogInfo(shader));
-        exit(1);
+    printf("checking the GL passes against the CPU reference, on %dx%d images, with the filters %s:\n",
+        GOLDEN_WIDTH, GOLDEN_HEIGHT, filterSpec.c_str());
+    printf("  %-16s %-22s %16s %12s %16s %12s %10s\n", "view", "variant", "fractal diff", "pixels off", "filters diff", "pixels off", "");
+
+    bool allPassed = true;
+    for (const GoldenView& golden : GOLDEN_VIEWS) {
+        fractalVariant.formula = golden.formula;
+        fractalVariant.power = golden.power;
+        fractalVariant.iterations = golden.iterations;
+
+        CpuImage glFractal, gl;
+        FrameParams params = { golden.view, fractalVariant };
+        glRenderer.RenderFractalStill(params, &glFractal);
+        glRenderer.RenderStill(params, &gl);
+
+        CpuImage fractal, cpu;
+        fractal.Resize(GOLDEN_WIDTH, GOLDEN_HEIGHT);
+        CpuFractalView cpuView = { golden.view.centerX, golden.view.centerY, golden.view.scale, 0.0f, 0.0f };
+        RenderFractalCpu(fractalVariant, cpuView, &fractal);
+        FilterLibrary::RunCpu(filterChain, glFractal, &cpu);
+
+        printf("  %-16s %-22s", golden.name, fractalVariant.GetName().c_str());
+        bool passed = CheckImage(std::string(golden.name) + ".fractal", glFractal, fractal, GOLDEN_TOLERANCE, golden.maxPixelsOff);
+        passed = CheckImage(std::string(golden.name) + ".filters", gl, cpu, tolerance, 0) && passed;
+        printf(" %10s\n", passed ? "ok" : "FAILED");
+        allPassed = allPassed && passed;
     }
 
-    glDetachShader(shader, vs);
-    glDetachShader(shader, fs);
+    glRenderer.Destroy();
+    glfwTerminate();
+    return allPassed;
+}
 
-    glDeleteShader(vs);
-    glDeleteShader(fs);
+//
+// --check-cpu-backend: renders the golden views with the GL passes, and with the kernels of the CPU
+// backend, and compares the fractals. The kernels do the same math as the shaders, so most of the pixels
+// must be exactly the same. The rest are where llvmpipe rounds differently, and the GL mirrors the rows,
+// see FindMirrorRows(), so they get the same tolerance as --check-views. The box filter of the backend
+// is compared with the CPU version of the filter, on the fractal of the backend, which --check-views
+// compares with the GL, so that a pixel of the fractal that is off isn't counted again for every pixel
+// the filter spreads it to.
+//
+bool CheckCpuBackend() {
+    InitOffscreenGl(GOLDEN_WIDTH, GOLDEN_HEIGHT);
+    int radius = GetBoxFilterRadius("CPU");
+    const int tolerance[4] = { 2, 2, 2, 0 }; // the two passes of the box filter.
+
+    printf("checking the CPU backend against the GL passes, on %dx%d images, with the filters %s:\n",
+        GOLDEN_WIDTH, GOLDEN_HEIGHT, filterSpec.c_str());
+    printf("  %-16s %-22s %16s %12s %16s %12s %10s\n", "view", "variant", "fractal diff", "pixels off", "filters diff", "pixels off", "");
+
+    bool allPassed = true;
+    for (const GoldenView& golden : GOLDEN_VIEWS) {
+        fractalVariant.formula = golden.formula;
+        fractalVariant.power = golden.power;
+        fractalVariant.iterations = golden.iterations;
+
+        CpuImage glFractal;
+        FrameParams params = { golden.view, fractalVariant };
+        glRenderer.RenderFractalStill(params, &glFractal);
+
+        // a new renderer for every view, so that the frame is the first sample, like GlRenderer::RenderStill().
+        CpuRenderer cpuPasses;
+        CpuRendererConfig config;
+        config.width = config.renderWidth = GOLDEN_WIDTH;
+        config.height = config.renderHeight = GOLDEN_HEIGHT;
+        config.variant = fractalVariant;
+        config.blurRadius = radius;
+        cpuPasses.Init(config);
+        cpuPasses.RenderFrame(params);
+        CpuImage cpuFractal, cpu, reference;
+        cpuPasses.ReadFractalImage(&cpuFractal);
+        cpuPasses.ReadFilteredImage(&cpu);
+        FilterLibrary::RunCpu(filterChain, cpuFractal, &reference);
+
+        printf("  %-16s %-22s", golden.name, fractalVariant.GetName().c_str());
+        std::string prefix = std::string(golden.name) + ".cpu-backend";
+        bool passed = CheckImage(prefix + ".fractal", glFractal, cpuFractal, GOLDEN_TOLERANCE, golden.maxPixelsOff);
+        passed = CheckImage(prefix + ".filters", cpu, reference, tolerance, 0) && passed;
+        printf(" %10s\n", passed ? "ok" : "FAILED");
+        allPassed = allPassed && passed;
+    }
 
-    return shader;
+    glRenderer.Destroy();
+    glfwTerminate();
+    return allPassed;
 }
 
 //
-// End Utility functions
+// --check-vulkan-backend: renders the golden views with the Vulkan backend, headless, and with the CPU
+// backend, and compares the frames they present. That needs no display and no GL, so it also runs
+// on a software Vulkan driver like lavapipe. Both run the same box filter, so they only differ where
+// the fractals do, by GoldenView::maxPixelsOff pixels. The filter spreads every such pixel over its
+// neighbours, but it averages (2r+1)^2 pixels, so one pixel moves them by less than one step. Where a
+// few are off together, they move it by a few. With a radius of 8, on llvmpipe, the chaotic views
+// are off by up to 9 in the blue channel, in 1004 and 1278 pixels by more than 2, and in 99 and 185
+// by more than 4. On SwiftShader, only burning-ship is off by more than 4, in 269 pixels.
 //
-// Now the actual demo starts. 
-
+bool CheckVulkanBackend() {
+    int radius = GetBoxFilterRadius("Vulkan");
+    const int tolerance[4] = { 4, 4, 4, 0 };
+
+    VulkanRendererConfig vulkanConfig;
+    vulkanConfig.width = GOLDEN_WIDTH;
+    vulkanConfig.height = GOLDEN_HEIGHT;
+    vulkanConfig.spirvDirectory = spirvDirectory;
+    vulkanConfig.variant = fractalVariant;
+    vulkanConfig.blurRadius = radius;
+    if (!vulkanRenderer.Init(vulkanConfig)) {
+        vulkanRenderer.Destroy();
+        return false;
+    }
 
-const int WINDOW_WIDTH = 1497;
-const int WINDOW_HEIGHT = 1014;
+    printf("checking the Vulkan backend against the CPU backend, on %dx%d images, with the filters %s:\n",
+        GOLDEN_WIDTH, GOLDEN_HEIGHT, filterSpec.c_str());
+    printf("  %-16s %-22s %16s %12s %10s\n", "view", "variant", "frame diff", "pixels off", "");
+
+    bool allPassed = true;
+    for (const GoldenView& golden : GOLDEN_VIEWS) {
+        fractalVariant.formula = golden.formula;
+        fractalVariant.power = golden.power;
+        fractalVariant.iterations = golden.iterations;
+        FrameParams params = { golden.view, fractalVariant };
+
+        CpuImage vulkan;
+        bool rendered = vulkanRenderer.RenderFrame(params) && vulkanRenderer.ReadLastFrame(&vulkan);
+
+        CpuRenderer cpuPasses;
+        CpuRendererConfig cpuConfig;
+        cpuConfig.width = cpuConfig.renderWidth = GOLDEN_WIDTH;
+        cpuConfig.height = cpuConfig.renderHeight = GOLDEN_HEIGHT;
+        cpuConfig.variant = fractalVariant;
+        cpuConfig.blurRadius = radius;
+        cpuPasses.Init(cpuConfig);
+        cpuPasses.RenderFrame(params);
+        CpuImage cpu;
+        cpuPasses.ReadLastFrame(&cpu);
+
+        printf("  %-16s %-22s", golden.name, fractalVariant.GetName().c_str());
+        bool passed = false;
+        if (!rendered) {
+            printf(" %16s %12s", "-", "-");
+        } else {
+            passed = CheckImage(std::string(golden.name) + ".vulkan-backend", vulkan, cpu, tolerance, golden.maxPixelsOff);
+        }
+        printf(" %10s\n", passed ? "ok" : "FAILED");
+        allPassed = allPassed && passed;
+    }
 
-GLFWwindow* window;
-GLuint displayShader;
-GLuint fractalShader;
-GLuint blurShader;
-GLuint fractalTexture; // we will be writing and loading from this texture with image/load feature. 
-int fbWidth, fbHeight; // frame buffer dimensions. 
-GLuint vao;
-float totalTime = 0.0f; // keep track of time for shader.
-int FRAME_RATE = 60;
+    vulkanRenderer.Destroy();
+    return allPassed;
+}
 
-void InitGlfw() {
-    if (!glfwInit())
-        exit(EXIT_FAILURE);
+//
+// --check-cpu-references: renders the golden views with the CPU backend alone, and compares the frames
+// with the images in cpuReferenceDirectory, 'name'.ppm, which --update-cpu-references writes. That needs
+// no GL and no display, so the kernels are checked even where the GL checks can't run. The kernels
+// only use plain float math, and fmaf() where the shaders get an fma, so they must match exactly, as
+// long as the compiler doesn't fuse other multiplies and adds, see -ffp-contract in CMakeLists.txt.
+// The references are small, so that they can live in the repository.
+//
+const int CPU_REFERENCE_WIDTH = 160;
+const int CPU_REFERENCE_HEIGHT = 120;
+
+bool CheckCpuReferences() {
+    int radius = GetBoxFilterRadius("CPU");
+    const int tolerance[4] = { 0, 0, 0, 255 }; // a PPM has no alpha.
+
+    printf("%s the CPU backend %s the references in %s, on %dx%d images, with the filters %s:\n",
+        updateCpuReferences ? "writing" : "checking", updateCpuReferences ? "to" : "against", cpuReferenceDirectory.c_str(),
+        CPU_REFERENCE_WIDTH, CPU_REFERENCE_HEIGHT, filterSpec.c_str());
+    if (!updateCpuReferences) {
+        printf("  %-16s %-22s %16s %12s %10s\n", "view", "variant", "frame diff", "pixels off", "");
+    }
 
-    glfwWindowHint(GLFW_RESIZABLE, GL_FALSE);
-    // we need opengl 4.2 for image load store. 
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 2);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+    bool allPassed = true;
+    for (const GoldenView& golden : GOLDEN_VIEWS) {
+        fractalVariant.formula = golden.formula;
+        fractalVariant.power = golden.power;
+        fractalVariant.iterations = golden.iterations;
+        FrameParams params = { golden.view, fractalVariant };
+
+        CpuRenderer cpuPasses;
+        CpuRendererConfig config;
+        config.width = config.renderWidth = CPU_REFERENCE_WIDTH;
+        config.height = config.renderHeight = CPU_REFERENCE_HEIGHT;
+        config.variant = fractalVariant;
+        config.blurRadius = radius;
+        cpuPasses.Init(config);
+        cpuPasses.RenderFrame(params);
+        CpuImage frame;
+        cpuPasses.ReadLastFrame(&frame);
+
+        std::string path = cpuReferenceDirectory + "/" + golden.name + ".ppm";
+        bool passed;
+        if (updateCpuReferences) {
+            passed = frame.WritePpm(path);
+            printf("  %s %s\n", passed ? "wrote" : "could not write", path.c_str());
+        } else {
+            printf("  %-16s %-22s", golden.name, fractalVariant.GetName().c_str());
+            CpuImage reference;
+            if (!reference.ReadPpm(path)) {
+                printf(" %16s %12s (could not read %s)", "-", "-", path.c_str());
+                passed = false;
+            } else {
+                passed = CheckImage(std::string(golden.name) + ".cpu-reference", frame, reference, tolerance, 0);
+            }
+            printf(" %10s\n", passed ? "ok" : "FAILED");
+        }
+        allPassed = allPassed && passed;
+    }
+    return allPassed;
+}
 
-    window = glfwCreateWindow(WINDOW_WIDTH, WINDOW_HEIGHT, "Image Load Store Demo", NULL, NULL);
-    if (!window) {
-        glfwTerminate();
+//
+// --benchmark-schedules: times the fractal pass on the golden views, at the size of the window, with
+// every schedule. They must all render the same pixels as one thread per pixel. Mariani-Silver is
+// only timed on the views of the Mandelbrot formula. Where a channel of the exterior, thinner than a
+// pixel, crosses the border of a tile between two pixels, it misses the pixels of the channel inside
+// the tile. So it may be off in a few isolated pixels, this fraction of them.
+//
+const float MARIANI_SILVER_MAX_PIXELS_OFF = 0.0001f;
+
+bool BenchmarkSchedules() {
+    InitOffscreenGl(WINDOW_WIDTH, WINDOW_HEIGHT);
+    printf("the fractal pass at %dx%d on %s, fastest of %d runs, persistent threads: %d threads, %d pixels per work item\n",
+        WINDOW_WIDTH, WINDOW_HEIGHT, (const char*)glGetString(GL_RENDERER), GlRenderer::TIMING_RUNS, persistentThreadCount, workItemSize);
+    printf("  %-16s %-22s %14s %14s %8s %14s %8s\n", "view", "variant", "per pixel ms", "persistent ms", "speedup",
+        "m-s ms", "speedup");
+
+    bool allSame = true;
+    for (const GoldenView& golden : GOLDEN_VIEWS) {
+        fractalVariant.formula = golden.formula;
+        fractalVariant.power = golden.power;
+        fractalVariant.iterations = golden.iterations;
+        FrameParams params = { golden.view, fractalVariant };
+
+        printf("  %-16s %-22s", golden.name, fractalVariant.GetName().c_str());
+        double perPixelMs = 0.0;
+        CpuImage perPixel;
+        std::string differences;
+        for (int s = 0; s < SCHEDULE_COUNT; s++) {
+            FractalSchedule schedule = (FractalSchedule)s;
+            glRenderer.SetSchedule(schedule);
+            if (glRenderer.GetFractalSchedule(fractalVariant) != schedule) {
+                printf(" %14s %8s", "-", "");
+                continue;
+            }
+            CpuImage image;
+            double ms = glRenderer.TimeFractalPass(params, &image);
+            if (schedule == SCHEDULE_PER_PIXEL) {
+                perPixelMs = ms;
+                perPixel = image;
+                printf(" %14.2f", ms);
+                continue;
+            }
+            printf(" %14.2f %7.2fx", ms, perPixelMs / ms);
+            int tolerance[4] = { 0, 0, 0, 0 };
+            ImageDiff diff = CompareImages(image, perPixel, tolerance, NULL);
+            if (diff.pixelsOff != 0) {
+                differences += "  " + std::to_string(diff.pixelsOff) + " pixels differ with " + SCHEDULE_NAMES[s];
+                int maxPixelsOff = schedule == SCHEDULE_MARIANI_SILVER ? (int)(MARIANI_SILVER_MAX_PIXELS_OFF * WINDOW_WIDTH * WINDOW_HEIGHT) : 0;
+                allSame = allSame && diff.pixelsOff <= maxPixelsOff;
+            }
+        }
+        printf("%s\n", differences.c_str());
     }
-    glfwMakeContextCurrent(window);
 
-    // load GLAD.
-    gladLoadGLLoader((GLADloadproc)glfwGetProcAddress);
+    glRenderer.Destroy();
+    glfwTerminate();
+    return allSame;
+}
 
-    // Bind and create VAO, otherwise, we can't do anything in OpenGL.
-    glGenVertexArrays(1, &vao);
-    glBindVertexArray(vao);
+//
+// --benchmark-pixel-orders: times the fractal pass, and the whole frame, with the fractal, the filter
+// chain and the display pass, on the golden views, at the size of the window, with every pixel order.
+// The filters are the passes that read the pixels around their own, so they are where the order
+// should matter. Every order must render the same pixels as row by row.
+//
+bool BenchmarkPixelOrders() {
+    InitOffscreenGl(WINDOW_WIDTH, WINDOW_HEIGHT);
+    printf("the passes at %dx%d on %s, with the filters %s, fastest of %d runs%s\n",
+        WINDOW_WIDTH, WINDOW_HEIGHT, (const char*)glGetString(GL_RENDERER), filterSpec.c_str(), GlRenderer::TIMING_RUNS,
+        fractalSchedule != SCHEDULE_PER_PIXEL ? (std::string(", with ") + SCHEDULE_NAMES[fractalSchedule]).c_str() : "");
+    printf("  %-16s %-8s %12s %12s %12s\n", "view", "order", "fractal ms", "frame ms", "the rest ms");
+
+    bool allSame = true;
+    for (const GoldenView& golden : GOLDEN_VIEWS) {
+        fractalVariant.formula = golden.formula;
+        fractalVariant.power = golden.power;
+        fractalVariant.iterations = golden.iterations;
+        FrameParams params = { golden.view, fractalVariant };
+
+        CpuImage rowsFractal, rowsFrame;
+        for (int o = 0; o < PIXEL_ORDER_COUNT; o++) {
+            pixelOrder = (PixelOrder)o;
+            glRenderer.SetPixelOrder(pixelOrder);
+
+            CpuImage fractal, frame;
+            double fractalMs = glRenderer.TimeFractalPass(params, &fractal);
+            double frameMs = glRenderer.TimeFrame(params, &frame);
+
+            printf("  %-16s %-8s %12.2f %12.2f %12.2f", o == 0 ? golden.name : "", GetPixelOrderName(pixelOrder),
+                fractalMs, frameMs, frameMs - fractalMs);
+            if (pixelOrder == PIXEL_ORDER_ROWS) {
+                rowsFractal = fractal;
+                rowsFrame = frame;
+            } else {
+                int tolerance[4] = { 0, 0, 0, 0 };
+                int fractalOff = CompareImages(fractal, rowsFractal, tolerance, NULL).pixelsOff;
+                int frameOff = CompareImages(frame, rowsFrame, tolerance, NULL).pixelsOff;
+                if (fractalOff != 0 || frameOff != 0) {
+                    printf("  %d fractal and %d frame pixels differ from rows", fractalOff, frameOff);
+                    allSame = false;
+                }
+            }
+            printf("\n");
+        }
+    }
 
-    glfwGetFramebufferSize(window, &fbWidth, &fbHeight);
+    glRenderer.Destroy();
+    glfwTerminate();
+    return allSame;
+}
 
-    //
-    // create for image load/store usage.
-    //
-    GL_C(glGenTextures(1, &fractalTexture));
-    GL_C(glBindTexture(GL_TEXTURE_2D, fractalTexture));
-    // We must appearently use glTexStorage2D to set texture format, when using image load/store.
-    // The traditional 'glTexImage2D' absolutely won't work for some reason.
-    // We specify GL_RGBA8UI, so we get RGBA, with every channel an unsigned byte. 
-    // so every color fits in an unsigned byte. 
-    GL_C(glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8UI, fbWidth, fbHeight));
-    GL_C(glBindTexture(GL_TEXTURE_2D, 0));
+void PrintUsage() {
+    printf("usage: image_load_store_demo [options]\n"
+        "  --min-scale S      lowest render resolution, as a fraction of the window size (default %.2f)\n"
+        "  --max-scale S      highest render resolution, as a fraction of the window size (default %.2f)\n"
+        "  --no-dynamic-res   always render at the highest render resolution\n"
+        "  --paused           start with the animation paused (toggle with space)\n"
+        "  --frames-in-flight N  how many frames the CPU may submit ahead of the GPU, 1 to %d (default %d)\n"
+        "  --shader-dir DIR   where to load the shaders from (default %s)\n"
+        "  --filters SPEC     the filters to run on the fractal, like \"gaussian:sigma=3,sobel\" (default %s)\n"
+        "  --list-filters     list the filters, and their parameters\n"
+        "  --check-filters    check the filters against their CPU reference implementations, and exit\n"
+        "  --check-views      render a set of views with the GL passes and on the CPU, compare them, and exit\n"
+        "  --check-views-dir DIR  where --check-views and --check-*-backend write the images of the views that fail (default .)\n"
+        "  --check-cpu-backend  render a set of views with the GL passes and the CPU backend, compare them, and exit\n"
+        "  --check-vulkan-backend  render a set of views with the Vulkan backend, headless, and the CPU backend,\n"
+        "                     compare them, and exit. Needs no display\n"
+        "  --check-cpu-references  render a set of views with the CPU backend, compare them with the images in\n"
+        "                     --cpu-references-dir, and exit. Needs no display\n"
+        "  --update-cpu-references  write those images instead, after the CPU backend changed on purpose\n"
+        "  --cpu-references-dir DIR  where they are (default %s)\n"
+        "  --fractal NAME     mandelbrot, julia, burning-ship or multibrot (default mandelbrot)\n"
+        "  --power N          the power of z in the formula, %d to %d (default 2, or 3 for multibrot)\n"
+        "  --iterations M     the maximum number of iterations (default %d)\n"
+        "  --render-cpu FILE  render the first frame on the CPU, write it to FILE as a PPM, and exit\n"
+        "  --render-fixed FILE  like --render-cpu, in fixed point, for zooms too deep for a float. Give the\n"
+        "                     center of --view with as many digits as it takes\n"
+        "  --fixed-bits N     the bits of --render-fixed, 128 or 256 (default 128)\n"
+        "  --render-size WxH  the size of the --render-cpu and --render-fixed images (default %dx%d)\n"
+        "  --shader-cache DIR where to keep the compiled shaders between runs (default %s)\n"
+        "  --no-shader-cache  always compile the shaders\n"
+        "  --no-dsa           don't use GL 4.5 direct state access, even if it is available\n"
+        "  --backend NAME     gl, vulkan or cpu (default %s). cpu always renders offscreen, so it needs --frames\n"
+        "  --spirv-dir DIR    where to load the compiled Vulkan shaders from (default %s)\n"
+        "  --headless         render offscreen, without a window. Only with --backend vulkan or cpu, and --frames\n"
+        "  --frames N         exit after N frames\n"
+        "  --dump FILE        when exiting, write the last frame to FILE as a PPM\n"
+        "  --view X,Y,SCALE   render this region of the complex plane, instead of the animation\n"
+        "  --farm FILE        render one image in tiles, on several processes, write it to FILE as a PPM, and exit\n"
+        "  --farm-size WxH    the size of the --farm image (default %dx%d)\n"
+        "  --farm-tile N      the size of the tiles (default %d)\n"
+        "  --farm-workers N   the number of worker processes (default one per core)\n"
+        "  --trace FILE       record what the CPU and the GPU do, and write it to FILE as a Chrome trace when exiting\n"
+        "  --iteration-stats  gather statistics of the iterations of every pixel, and print them every second.\n"
+        "                     Press H to write heatmaps of them\n"
+        "  --heatmap PREFIX   like --iteration-stats, and write the heatmaps to PREFIX.*.ppm when exiting (default %s)\n"
+        "  --persistent-threads  launch a fixed number of threads for the fractal, that take the pixels from a queue\n"
+        "                     (switch schedules with S)\n"
+        "  --thread-count N   the number of persistent threads (default %d)\n"
+        "  --work-item N      how many pixels a persistent thread takes from the queue at a time (default %d)\n"
+        "  --mariani-silver   compute the borders of tiles first, and fill the tiles whose border has one iteration\n"
+        "                     count, for the Mandelbrot formula. Unlike the other schedules, it may differ from one\n"
+        "                     thread per pixel in a few isolated pixels (switch schedules with S, which only\n"
+        "                     includes this one with this option)\n"
+        "  --benchmark-schedules  time the fractal pass with every schedule, and exit\n"
+        "  --no-mirror        compute every row of the fractal, even where the view is symmetric about the real axis\n"
+        "  --pixel-order NAME the order the passes visit the pixels in: rows, tiles, morton or hilbert (default rows)\n"
+        "  --benchmark-pixel-orders  time the passes with every pixel order, and exit\n",
+        dynamicResolutionConfig.minScale, dynamicResolutionConfig.maxScale,
+        FrameRing::MAX_FRAMES_IN_FLIGHT, framesInFlight, shaderDirectory.c_str(), filterSpec.c_str(), cpuReferenceDirectory.c_str(),
+        MIN_FRACTAL_POWER, MAX_FRACTAL_POWER, fractalVariant.iterations, WINDOW_WIDTH, WINDOW_HEIGHT, shaderCacheDirectory.c_str(),
+        backendName.c_str(), spirvDirectory.c_str(), WINDOW_WIDTH, WINDOW_HEIGHT, farmConfig.tileSize, heatmapPrefix.c_str(),
+        persistentThreadCount, workItemSize);
 }
 
-void Render() {
-    // we will only be writing to 'fractalTexture' for the next two shaders, and not to the screen framebuffer,
-    // so turn of color write and depth write for good measure. 
-    GL_C(glDepthMask(false));
-    GL_C(glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE));
-
-    // bind our texture to binding point 3. This means we can access it in our shaders using
-    // "layout(binding=3)"
-    // and we can both read and write from it. 
-    GL_C(glBindImageTexture(3, fractalTexture, 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA8UI));
-
-    //
-    // Pass 1: Render a fractal to the texture.
-    // We are using attribute-less rendering to do this.
-    // This means that we call
-    // glDrawArrays(GL_POINTS, 0, N)
-    // without actually sending any vertices.
-    // The effect of this is that the vertex shader is launched N times.
-    // So basically, we launch N threads on the GPU by doing this.
-    // An alternative would be to use a compute shader, but that means we have to use 
-    // OpenGL 4.3. With attribute-less rendering we can get away with using only 4.2!
-    //
-    // And note that the fragment shader is just kept empty, and all the computations
-    // are done in the vertex shader.
-    GLuint shader = fractalShader;
-    GL_C(glUseProgram(shader));
-    GL_C((glUniform1f(glGetUniformLocation(shader, "uTime"), totalTime)));
-    GL_C((glUniform1i(glGetUniformLocation(shader, "uWidth"), fbWidth)));
-    GL_C((glUniform1i(glGetUniformLocation(shader, "uHeight"), fbHeight)));
-
-    GL_C(glDrawArrays(GL_POINTS, 0, fbWidth*fbHeight)); // launch one thread for each pixel. 
-    // make sure all computations are done, before we do the next pass, with a barrier. 
-    GL_C(glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT));
-
-    //
-    // Pass 2: Do box filter blur on the texture. 
-    // Again, we use attribute-less rendering for this. 
-    //
-    shader = blurShader;
-    GL_C(glUseProgram(shader));
-    GL_C((glUniform1i(glGetUniformLocation(shader, "uWidth"), fbWidth)));
-    GL_C((glUniform1i(glGetUniformLocation(shader, "uHeight"), fbHeight)));
-
-    GL_C(glDrawArrays(GL_POINTS, 0, fbWidth*fbHeight));
-    GL_C(glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT));
-
-    //
-    // Pass 3: Finally, we display the blurred fractal texture. 
-    // So we do a fullscreen pass where we sample from the texture for every fragment.
-    //
-
-    // setup rendering to screen. re-enable color write and depth write. 
-    GL_C(glViewport(0, 0, fbWidth, fbHeight));
-    GL_C(glClearColor(0.0f, 0.0f, 0.3f, 1.0f));
-    GL_C(glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT));
-    GL_C(glDepthMask(true));
-    GL_C(glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE));
-
-    shader = displayShader;
-    GL_C(glUseProgram(shader));
-    GL_C((glUniform1i(glGetUniformLocation(shader, "uWidth"), fbWidth)));
-    GL_C((glUniform1i(glGetUniformLocation(shader, "uHeight"), fbHeight)));
-    // we draw one big triangle that covers the screen. And the vertices are stored
-    // in the vertex shader, so we don't send any vertices. so no VBO.
-    GL_C(glDrawArrays(GL_TRIANGLES, 0, 3)); 
+std::string cpuRenderFile; // if set, we only render on the CPU, to this file.
+std::string fixedRenderFile; // like cpuRenderFile, in fixed point, see RenderFractalFixedPoint().
+int fixedBits = 128;
+int cpuRenderWidth = WINDOW_WIDTH, cpuRenderHeight = WINDOW_HEIGHT; // the size of those images.
+// --view with all the digits it was given, for the fixed-point renderer. A float keeps about 7.
+CpuDeepView deepView;
+
+void ParseArgs(int argc, char** argv) {
+    int power = 0;
+    bool multibrot = false;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--min-scale") == 0 && i + 1 < argc) {
+            dynamicResolutionConfig.minScale = (float)atof(argv[++i]);
+        } else if (strcmp(argv[i], "--max-scale") == 0 && i + 1 < argc) {
+            dynamicResolutionConfig.maxScale = (float)atof(argv[++i]);
+        } else if (strcmp(argv[i], "--no-dynamic-res") == 0) {
+            dynamicResolutionEnabled = false;
+        } else if (strcmp(argv[i], "--paused") == 0) {
+            paused = true;
+        } else if (strcmp(argv[i], "--frames-in-flight") == 0 && i + 1 < argc) {
+            framesInFlight = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--shader-dir") == 0 && i + 1 < argc) {
+            shaderDirectory = argv[++i];
+        } else if (strcmp(argv[i], "--filters") == 0 && i + 1 < argc) {
+            filterSpec = argv[++i];
+        } else if (strcmp(argv[i], "--list-filters") == 0) {
+            FilterLibrary::PrintFilters();
+            exit(EXIT_SUCCESS);
+        } else if (strcmp(argv[i], "--check-filters") == 0) {
+            checkFilters = true;
+        } else if (strcmp(argv[i], "--check-views") == 0) {
+            checkViews = true;
+        } else if (strcmp(argv[i], "--check-cpu-backend") == 0) {
+            checkCpuBackend = true;
+        } else if (strcmp(argv[i], "--check-vulkan-backend") == 0) {
+            checkVulkanBackend = true;
+        } else if (strcmp(argv[i], "--check-cpu-references") == 0) {
+            checkCpuReferences = true;
+        } else if (strcmp(argv[i], "--update-cpu-references") == 0) {
+            checkCpuReferences = true;
+            updateCpuReferences = true;
+        } else if (strcmp(argv[i], "--cpu-references-dir") == 0 && i + 1 < argc) {
+            cpuReferenceDirectory = argv[++i];
+        } else if (strcmp(argv[i], "--check-views-dir") == 0 && i + 1 < argc) {
+            checkViewsDirectory = argv[++i];
+        } else if (strcmp(argv[i], "--fractal") == 0 && i + 1 < argc) {
+            if (!ParseFormula(argv[++i], &fractalVariant.formula)) {
+                printf("Unknown fractal '%s'.\n", argv[i]);
+                exit(EXIT_FAILURE);
+            }
+            multibrot = strcmp(argv[i], "multibrot") == 0;
+        } else if (strcmp(argv[i], "--power") == 0 && i + 1 < argc) {
+            power = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) {
+            fractalVariant.iterations = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--render-cpu") == 0 && i + 1 < argc) {
+            cpuRenderFile = argv[++i];
+        } else if (strcmp(argv[i], "--render-fixed") == 0 && i + 1 < argc) {
+            fixedRenderFile = argv[++i];
+        } else if (strcmp(argv[i], "--fixed-bits") == 0 && i + 1 < argc) {
+            fixedBits = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--render-size") == 0 && i + 1 < argc) {
+            if (sscanf(argv[++i], "%dx%d", &cpuRenderWidth, &cpuRenderHeight) != 2 || cpuRenderWidth <= 0 || cpuRenderHeight <= 0) {
+                printf("--render-size must be like 640x480\n");
+                exit(EXIT_FAILURE);
+            }
+        } else if (strcmp(argv[i], "--shader-cache") == 0 && i + 1 < argc) {
+            shaderCacheDirectory = argv[++i];
+        } else if (strcmp(argv[i], "--no-shader-cache") == 0) {
+            shaderCacheEnabled = false;
+        } else if (strcmp(argv[i], "--no-dsa") == 0) {
+            directStateAccessEnabled = false;
+        } else if (strcmp(argv[i], "--backend") == 0 && i + 1 < argc) {
+            backendName = argv[++i];
+        } else if (strcmp(argv[i], "--spirv-dir") == 0 && i + 1 < argc) {
+            spirvDirectory = argv[++i];
+        } else if (strcmp(argv[i], "--headless") == 0) {
+            headless = true;
+        } else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            maxFrames = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--dump") == 0 && i + 1 < argc) {
+            dumpFile = argv[++i];
+        } else if (strcmp(argv[i], "--view") == 0 && i + 1 < argc) {
+            if (sscanf(argv[++i], "%f,%f,%f", &fixedView.centerX, &fixedView.centerY, &fixedView.scale) != 3) {
+                printf("--view must be like -0.745,0.186,0.01\n");
+                exit(EXIT_FAILURE);
+            }
+            fixedViewEnabled = true;
+            std::string spec = argv[i];
+            size_t comma1 = spec.find(','), comma2 = spec.find(',', comma1 + 1);
+            deepView.centerX = spec.substr(0, comma1);
+            deepView.centerY = spec.substr(comma1 + 1, comma2 - comma1 - 1);
+            deepView.scale = atof(spec.substr(comma2 + 1).c_str());
+        } else if (strcmp(argv[i], "--farm") == 0 && i + 1 < argc) {
+            farmFile = argv[++i];
+        } else if (strcmp(argv[i], "--farm-size") == 0 && i + 1 < argc) {
+            if (sscanf(argv[++i], "%dx%d", &farmConfig.width, &farmConfig.height) != 2) {
+                printf("--farm-size must be like 4096x4096\n");
+                exit(EXIT_FAILURE);
+            }
+        } else if (strcmp(argv[i], "--farm-tile") == 0 && i + 1 < argc) {
+            farmConfig.tileSize = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--farm-workers") == 0 && i + 1 < argc) {
+            farmConfig.workerCount = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            traceFile = argv[++i];
+        } else if (strcmp(argv[i], "--iteration-stats") == 0) {
+            iterationStatsEnabled = true;
+        } else if (strcmp(argv[i], "--heatmap") == 0 && i + 1 < argc) {
+            heatmapPrefix = argv[++i];
+            iterationStatsEnabled = true;
+            heatmapOnExit = true;
+        } else if (strcmp(argv[i], "--persistent-threads") == 0) {
+            fractalSchedule = SCHEDULE_PERSISTENT_THREADS;
+        } else if (strcmp(argv[i], "--mariani-silver") == 0) {
+            fractalSchedule = SCHEDULE_MARIANI_SILVER;
+        } else if (strcmp(argv[i], "--thread-count") == 0 && i + 1 < argc) {
+            persistentThreadCount = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--work-item") == 0 && i + 1 < argc) {
+            workItemSize = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--benchmark-schedules") == 0) {
+            benchmarkSchedules = true;
+        } else if (strcmp(argv[i], "--no-mirror") == 0) {
+            mirrorEnabled = false;
+        } else if (strcmp(argv[i], "--pixel-order") == 0 && i + 1 < argc) {
+            if (!ParsePixelOrder(argv[++i], &pixelOrder)) {
+                printf("Unknown pixel order '%s'.\n", argv[i]);
+                exit(EXIT_FAILURE);
+            }
+        } else if (strcmp(argv[i], "--benchmark-pixel-orders") == 0) {
+            benchmarkPixelOrders = true;
+        } else {
+            PrintUsage();
+            exit(strcmp(argv[i], "--help") == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+        }
+    }
+
+    if (dynamicResolutionConfig.maxScale <= 0.0f || dynamicResolutionConfig.minScale <= 0.0f) {
+        printf("The render resolution scales must be positive.\n");
+        exit(EXIT_FAILURE);
+    }
+    if (framesInFlight < 1 || framesInFlight > FrameRing::MAX_FRAMES_IN_FLIGHT) {
+        printf("--frames-in-flight must be between 1 and %d.\n", FrameRing::MAX_FRAMES_IN_FLIGHT);
+        exit(EXIT_FAILURE);
+    }
+    fractalVariant.power = power != 0 ? power : multibrot ? 3 : 2;
+    if (fractalVariant.power < MIN_FRACTAL_POWER || fractalVariant.power > MAX_FRACTAL_POWER) {
+        printf("--power must be between %d and %d.\n", MIN_FRACTAL_POWER, MAX_FRACTAL_POWER);
+        exit(EXIT_FAILURE);
+    }
+    // the coloring divides by M/2-1.
+    if (fractalVariant.iterations < 4) {
+        printf("--iterations must be at least 4.\n");
+        exit(EXIT_FAILURE);
+    }
+    if (backendName != "gl" && backendName != "vulkan" && backendName != "cpu") {
+        printf("Unknown backend '%s'.\n", backendName.c_str());
+        exit(EXIT_FAILURE);
+    }
+    if (backendName == "cpu" && maxFrames <= 0) {
+        printf("--backend cpu renders offscreen, so it needs --frames.\n");
+        exit(EXIT_FAILURE);
+    }
+    if (headless && (backendName == "gl" || maxFrames <= 0)) {
+        printf("--headless needs --backend vulkan or cpu, and --frames.\n");
+        exit(EXIT_FAILURE);
+    }
+    if (farmConfig.width == 0) {
+        farmConfig.width = WINDOW_WIDTH;
+        farmConfig.height = WINDOW_HEIGHT;
+    }
+    if (farmConfig.width <= 0 || farmConfig.height <= 0 || farmConfig.tileSize <= 0 || farmConfig.workerCount < 0) {
+        printf("--farm-size, --farm-tile and --farm-workers must be positive.\n");
+        exit(EXIT_FAILURE);
+    }
+    if ((checkFilters || checkViews || checkCpuBackend) && backendName != "gl") {
+        printf("--check-filters, --check-views and --check-cpu-backend check the GL passes, so they need --backend gl.\n");
+        exit(EXIT_FAILURE);
+    }
+    if (iterationStatsEnabled && backendName != "gl") {
+        printf("--iteration-stats and --heatmap need --backend gl.\n");
+        exit(EXIT_FAILURE);
+    }
+    if (iterationStatsEnabled && fractalVariant.iterations > MAX_STATS_ITERATIONS) {
+        printf("--iteration-stats and --heatmap can count at most %d iterations.\n", MAX_STATS_ITERATIONS);
+        exit(EXIT_FAILURE);
+    }
+    if ((fractalSchedule != SCHEDULE_PER_PIXEL || benchmarkSchedules) && backendName != "gl") {
+        printf("--persistent-threads, --mariani-silver and --benchmark-schedules need --backend gl.\n");
+        exit(EXIT_FAILURE);
+    }
+    if ((pixelOrder != PIXEL_ORDER_ROWS || benchmarkPixelOrders) && backendName != "gl") {
+        printf("--pixel-order and --benchmark-pixel-orders need --backend gl.\n");
+        exit(EXIT_FAILURE);
+    }
+    if (persistentThreadCount <= 0 || workItemSize <= 0) {
+        printf("--thread-count and --work-item must be positive.\n");
+        exit(EXIT_FAILURE);
+    }
+    renderedVariant = fractalVariant;
+    std::string error;
+    if (!FilterLibrary::ParseChain(filterSpec, &filterChain, &error)) {
+        printf("Invalid --filters: %s\n", error.c_str());
+        FilterLibrary::PrintFilters();
+        exit(EXIT_FAILURE);
+    }
+    // we only get one frame every 1/FRAME_RATE seconds anyway, so that is all the GPU time we have.
+    dynamicResolutionConfig.budgetMs = 1000.0f / (float)FRAME_RATE;
 }
 
 int main(int argc, char** argv)
 {
-    InitGlfw();
-
-
-    //
-    // This shader renders the Mandelbrot set to the texture. 
-    //
-    fractalShader = LoadNormalShader(
-        "#version 420\n"
-
-        "uniform int uWidth;"
-        "uniform int uHeight;"
-        "uniform float uTime;"
-        "uniform layout(binding=3, rgba8ui) writeonly uimage2D uFractalTexture;"
-
-        "void main() {"
-        // first vertex will have id 0, the second 1, and so on. And the final one has id N-1,
-        // if the shader was launched with 
-        // glDrawArrays(GL_POINTS, 0, N);
-
-        // And we convert this vertex id to 2D:
-        "  ivec2 i = ivec2(gl_VertexID % uWidth, gl_VertexID / uWidth);"
-        "  vec2 uv = vec2(i) * vec2(1.0 / float(uWidth), 1.0 / float(uHeight));"
-
-        // BEGIN FRACTAL RENDERING CODE
-        "  float n = 0.0;"
-        "  vec2 c = vec2(-.745, .186) +  (uv - 0.5)*(2.0+ 1.7*cos(1.8*uTime)  ), "
-        "  z = vec2(0.0);"
-        "  const int M =128;\n"
-        "  for (int i = 0; i<M; i++)"
-        "  {"
-        "    z = vec2(z.x*z.x - z.y*z.y, 2.*z.x*z.y) + c;"
-        "    if (dot(z, z) > 2) break;"
-
-        "    n++;"
-        "  }"
-        "  vec3 bla = vec3(0,0,0.0);"
-        "  vec3 blu = vec3(0,0,0.8);"
-        "  vec4 color;"
-        "  if( n >= 0 && n <= M/2-1 ) { color = vec4( mix( vec3(0.2, 0.1, 0.4), blu, n / float(M/2-1) ), 1.0) ;  }"
-        "  if( n >= M/2 && n <= M ) { color = vec4( mix( blu, bla, float(n - M/2 ) / float(M/2) ), 1.0) ;  }"
-        // END FRACTAL RENDERING CODE
-
-        // Now we write the computed color to the texture.
-        // Note that we must use integer texture coordinates for image load/store. 
-        // Also, texture format is RGBA8UI, so we convert the color channels to  
-        // unsigned byte. So convert from range [0,1] to range [0,255].
-        "  imageStore(uFractalTexture, i , uvec4(color * 255.0f));"
-        "}",
-
-        "#version 420\n"
-        "void main() {}" // empty fragment shader.
-        );
-
-    //
-    // This shader does a box-filter blur on the texture. 
-    //
-    blurShader = LoadNormalShader(
-        "#version 420\n"
-
-        "uniform int uWidth;"
-        "uniform int uHeight;"
-        "uniform layout(binding=3, rgba8ui) uimage2D uFractalTexture;"
-
-        // sample with clamping from the texture. 
-        "vec4 csample(ivec2 i) {"
-        "  i = ivec2(clamp(i.x, 0, uWidth-1), clamp(i.y, 0, uHeight-1));"
-        "  return imageLoad(uFractalTexture, i);"
-        "}\n"
-
-        "#define R 8\n" // filter radius
-        "#define W (1.0 / ((1.0+2.0*float(R)) * (1.0+2.0*float(R))))\n" // this macro computes the filter weights. 
-        "void main() {"
-        "  ivec2 i = ivec2(gl_VertexID % uWidth, gl_VertexID / uWidth);"
-
-        "  vec4 sum = vec4(0.0);"
-        // first compute the blurred color. 
-        "  for(int x = -R; x <= +R; x++ )"
-        "    for(int y = -R; y <= +R; y++ )"
-        "      sum += W * csample(i + ivec2(x,y));"
-
-        // now store the blurred color.
-        "  imageStore(uFractalTexture,  i, uvec4(sum) );"
-
-        "}",
-
-        "#version 420\n"
-        "void main() {}" // empty fragment shader.
-        );
-
-
-    //
-    // This shader displays the texture to the screen.
-    //
-    displayShader = LoadNormalShader(
-        "#version 420\n"
-
-        "out vec2 uv;"
-
-        // From the vertex shader, we output vertices that form a big triangle that covers the screen. 
-        "const vec2 verts[3] = vec2[](vec2(-1, -1), vec2(3, -1), vec2(-1, 3));"
-        "const vec2 uvs[3] = vec2[](vec2(0, 0), vec2(2, 0), vec2(0, 2));"
-
-        "void main() {"
-        "  uv = uvs[gl_VertexID];"
-        "  gl_Position =  vec4( verts[gl_VertexID] , 0.0, 1.0);"
-        "}",
-
-        "#version 420\n"
-
-        "out vec4 color;"
-        "in vec2 uv;"
-
-        "uniform layout(binding=3, rgba8ui) readonly uimage2D uFractalTexture;"
-        "uniform int uWidth;"
-        "uniform int uHeight;"
-
-        "void main() {"
-        "  vec4 s = imageLoad(uFractalTexture, ivec2(float(uWidth) * uv.x, float(uHeight) * uv.y)) ;"
-
-        // RGBA8UI is in range [0,255], so scale down. 
-        "  color = (1.0 / 255.0) * s;"
-        "}"
-        );
-
-    while (!glfwWindowShouldClose(window)) {
-        float frameStartTime = (float)glfwGetTime();
-
-        glfwPollEvents();
-
-        // handle input
-        if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS) {
-            glfwSetWindowShouldClose(window, GLFW_TRUE);
+    ParseArgs(argc, argv);
+    if (!traceFile.empty()) {
+        trace.Start(traceFile);
+        trace.SetThreadName("main");
+    }
+
+    if (!cpuRenderFile.empty()) {
+        // the same pixels as the first frame of the fractal pass, before any filtering.
+        View view = GetView();
+        CpuFractalView cpuView = { view.centerX, view.centerY, view.scale, 0.0f, 0.0f };
+        CpuImage image;
+        image.Resize(cpuRenderWidth, cpuRenderHeight);
+        // GLFW isn't initialized, so we can't use glfwGetTime() here.
+        auto start = std::chrono::steady_clock::now();
+        RenderFractalCpu(fractalVariant, cpuView, &image);
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        printf("rendered %s on the CPU in %.1f ms\n", fractalVariant.GetName().c_str(), ms);
+        if (!image.WritePpm(cpuRenderFile)) {
+            printf("Could not write %s\n", cpuRenderFile.c_str());
+            exit(EXIT_FAILURE);
+        }
+        exit(EXIT_SUCCESS);
+    }
+
+    if (!fixedRenderFile.empty()) {
+        if (!fixedViewEnabled) {
+            View view = GetView();
+            char digits[32];
+            snprintf(digits, sizeof(digits), "%.9g", view.centerX);
+            deepView.centerX = digits;
+            snprintf(digits, sizeof(digits), "%.9g", view.centerY);
+            deepView.centerY = digits;
+            deepView.scale = view.scale;
+        }
+        CpuImage image;
+        image.Resize(cpuRenderWidth, cpuRenderHeight);
+        auto start = std::chrono::steady_clock::now();
+        std::string error;
+        if (!RenderFractalFixedPoint(fractalVariant, deepView, fixedBits, &image, &error)) {
+            printf("Could not render in fixed point: %s.\n", error.c_str());
+            exit(EXIT_FAILURE);
+        }
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        printf("rendered %s on the CPU, in %d-bit fixed point, in %.1f ms\n", fractalVariant.GetName().c_str(), fixedBits, ms);
+        if (!image.WritePpm(fixedRenderFile)) {
+            printf("Could not write %s\n", fixedRenderFile.c_str());
+            exit(EXIT_FAILURE);
+        }
+        exit(EXIT_SUCCESS);
+    }
+
+    if (checkVulkanBackend) {
+        exit(CheckVulkanBackend() ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
+    if (checkCpuReferences) {
+        exit(CheckCpuReferences() ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
+    if (checkViews) {
+        exit(CheckViews() ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
+    if (checkCpuBackend) {
+        exit(CheckCpuBackend() ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
+    if (benchmarkSchedules) {
+        exit(BenchmarkSchedules() ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
+    if (benchmarkPixelOrders) {
+        exit(BenchmarkPixelOrders() ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
+
+    if (!farmFile.empty()) {
+        // the workers are forked from here, before this process has a GL context.
+        RenderFarm farm;
+        CpuImage image;
+        double start = GetSeconds();
+        if (!farm.Render(farmConfig, RenderFarmTile, &image)) {
+            exit(EXIT_FAILURE);
+        }
+        printf("rendered %dx%d in %.1f ms, with %d workers (", image.width, image.height, (GetSeconds() - start) * 1000.0, farm.GetWorkerCount());
+        for (int i = 0; i < farm.GetWorkerCount(); i++) {
+            printf("%s%d", i == 0 ? "" : " ", farm.GetTilesDone(i));
+        }
+        printf(" tiles), %d slow tiles handed out again, %d of them were rendered in vain\n", farm.GetReissuedCount(), farm.GetDiscardedCount());
+        if (!image.WritePpm(farmFile)) {
+            printf("Could not write %s\n", farmFile.c_str());
+            exit(EXIT_FAILURE);
+        }
+        exit(EXIT_SUCCESS);
+    }
+
+    if (backendName == "vulkan") {
+        InitVulkan();
+        renderer = &vulkanRenderer;
+    } else if (backendName == "cpu") {
+        InitCpu(WINDOW_WIDTH, WINDOW_HEIGHT);
+        renderer = &cpuRenderer;
+    } else {
+        InitGl(GetGlConfig(WINDOW_WIDTH, WINDOW_HEIGHT));
+        window = glRenderer.GetWindow();
+        renderer = &glRenderer;
+        gpuMemory.Print(); // press M to print it again.
+    }
+    if (window) {
+        glfwSetKeyCallback(window, KeyCallback);
+    }
+
+    // with --check-filters, we wait for the programs of all the filters.
+    std::vector<FilterInstance> allFilters;
+    for (const FilterDef& def : FilterLibrary::GetFilters()) {
+        allFilters.push_back(FilterLibrary::GetDefaultInstance(def));
+    }
+
+    // without a window, there is no GLFW, so we keep time with std::chrono.
+    int frameCount = 0;
+    while (!(window && glfwWindowShouldClose(window)) && (maxFrames == 0 || frameCount < maxFrames)) {
+        float frameStartTime = (float)GetSeconds();
+
+        if (window) {
+            glfwPollEvents();
+
+            // handle input
+            if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS) {
+                glfwSetWindowShouldClose(window, GLFW_TRUE);
+            }
         }
 
-        Render();
+        if (checkFilters && glRenderer.GetFilterLibrary()->IsReady(allFilters)) {
+            bool passed = glRenderer.GetFilterLibrary()->Check(256, 192);
+            glRenderer.Destroy();
+            glfwTerminate();
+            exit(passed ? EXIT_SUCCESS : EXIT_FAILURE);
+        }
 
-        glfwSwapBuffers(window);
+        // only the frames that were actually rendered count, not the ones that waited for the shaders.
+        {
+            TraceZone zone("RenderFrame");
+            FrameParams params = { GetView(), fractalVariant };
+            if (renderer->RenderFrame(params)) {
+                frameCount++;
+            }
+            renderedVariant = renderer->GetRenderedVariant();
+        }
 
         //
         // frame rate regulation code:
         //
-        float frameEndTime = (float)glfwGetTime();
+        float frameEndTime = (float)GetSeconds();
         float frameDuration = frameEndTime - frameStartTime;
         float sleepDuration = 1.0f / (float)FRAME_RATE - frameDuration;
         if (sleepDuration > 0.0) {
+            TraceZone zone("sleep");
             std::this_thread::sleep_for(std::chrono::milliseconds((int)sleepDuration));
         }
-        totalTime += 1.0f / (float)FRAME_RATE;
+        if (!paused) {
+            totalTime += 1.0f / (float)FRAME_RATE;
+        }
     }
 
-    glfwTerminate();
+    if (!dumpFile.empty()) {
+        CpuImage image;
+        if (!renderer->ReadLastFrame(&image) || !image.WritePpm(dumpFile)) {
+            printf("Could not write the last frame to %s\n", dumpFile.c_str());
+        }
+    }
+
+    if (heatmapOnExit && frameCount > 0) {
+        WriteHeatmaps();
+    }
+
+    renderer->Destroy();
+    if (window) {
+        glfwTerminate();
+    }
+    trace.Write();
     exit(EXIT_SUCCESS);
 }
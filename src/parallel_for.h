@@ -0,0 +1,49 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+//
+// Runs kernel(id) for every id from 0 to count - 1, on all the CPU cores. That is what
+// glDrawArrays(GL_POINTS, 0, count) does with the vertex shader of a pass, with gl_VertexID as the id,
+// so a pass written as a kernel for Image2D, see image2d.h, runs just like the shader.
+//
+// The ids are handed out PARALLEL_FOR_CHUNK at a time, from a counter, so the threads whose ids are
+// done quickly, like the pixels outside the fractal, take more of them. Like the threads of a draw, the
+// kernels run in no particular order, and they are all done when ParallelFor() returns, which is
+// the glMemoryBarrier() before the next pass.
+//
+
+const int PARALLEL_FOR_CHUNK = 256;
+
+template <typename Kernel>
+void ParallelFor(int count, const Kernel& kernel) {
+    int threadCount = std::max(1, (int)std::thread::hardware_concurrency());
+    threadCount = std::min(threadCount, (count + PARALLEL_FOR_CHUNK - 1) / PARALLEL_FOR_CHUNK);
+
+    std::atomic<int> next(0);
+    auto run = [&]() {
+        for (;;) {
+            int begin = next.fetch_add(PARALLEL_FOR_CHUNK);
+            if (begin >= count) {
+                return;
+            }
+            int end = std::min(begin + PARALLEL_FOR_CHUNK, count);
+            for (int id = begin; id < end; id++) {
+                kernel(id);
+            }
+        }
+    };
+
+    // the calling thread is one of the workers.
+    std::vector<std::thread> threads;
+    for (int t = 1; t < threadCount; t++) {
+        threads.push_back(std::thread(run));
+    }
+    run();
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+}
@@ -0,0 +1,28 @@
+#include "pixel_order.h"
+
+static const char* PIXEL_ORDER_NAMES[PIXEL_ORDER_COUNT] = { "rows", "tiles", "morton", "hilbert" };
+
+const char* GetPixelOrderName(PixelOrder order) {
+    return PIXEL_ORDER_NAMES[order];
+}
+
+bool ParsePixelOrder(const std::string& name, PixelOrder* order) {
+    for (int o = 0; o < PIXEL_ORDER_COUNT; o++) {
+        if (name == PIXEL_ORDER_NAMES[o]) {
+            *order = (PixelOrder)o;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Must match PixelThreadCount() in pixel_order.glsl.
+int GetPixelThreadCount(PixelOrder order, int width, int height) {
+    if (order == PIXEL_ORDER_ROWS) {
+        return width * height;
+    }
+    int blockSize = order == PIXEL_ORDER_TILES ? 8 : 32;
+    int blocksX = (width + blockSize - 1) / blockSize;
+    int blocksY = (height + blockSize - 1) / blockSize;
+    return blocksX * blocksY * blockSize * blockSize;
+}
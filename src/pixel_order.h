@@ -0,0 +1,30 @@
+#pragma once
+
+#include <string>
+
+//
+// The order in which the passes that launch one thread per pixel, with
+// glDrawArrays(GL_POINTS, 0, N), map the thread ids to pixels. See shaders/pixel_order.glsl,
+// which does the mapping, and is compiled with the order as the PIXEL_ORDER constant.
+//
+// Row by row, the threads that run at the same time cover one or two long rows. The other orders
+// walk the image in small square blocks, so that they also read and write pixels that are close
+// together in 2D, which suits a texture cache that holds blocks of texels.
+//
+
+// Must match the PIXEL_ORDER_* defines in pixel_order.glsl.
+enum PixelOrder {
+    PIXEL_ORDER_ROWS = 0,    // row by row.
+    PIXEL_ORDER_TILES = 1,   // 8x8 tiles.
+    PIXEL_ORDER_MORTON = 2,  // 32x32 blocks, along a Z-order curve inside a block.
+    PIXEL_ORDER_HILBERT = 3, // 32x32 blocks, along a Hilbert curve inside a block.
+    PIXEL_ORDER_COUNT
+};
+
+const char* GetPixelOrderName(PixelOrder order);
+// Returns false if there is no such order.
+bool ParsePixelOrder(const std::string& name, PixelOrder* order);
+
+// The number of threads to launch for a width x height image. Except row by row, the image is
+// padded to whole blocks, and the threads of the padding do nothing.
+int GetPixelThreadCount(PixelOrder order, int width, int height);
@@ -0,0 +1,117 @@
+#include "program_binary_cache.h"
+#include "gl_util.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+// 64 bit FNV-1a. Not cryptographic, but we only need to tell shaders apart.
+static unsigned long long Hash(const std::string& s, unsigned long long h = 14695981039346656037ull) {
+    for (unsigned char c : s) {
+        h ^= c;
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+bool ProgramBinaryCache::Init(const std::string& directory_) {
+    directory = directory_;
+
+    GLint formatCount = 0;
+    GL_C(glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount));
+    if (formatCount == 0) {
+        printf("The driver can't save program binaries, so the shaders are compiled on every run\n");
+        return false;
+    }
+
+    if (mkdir(directory.c_str(), 0755) != 0 && errno != EEXIST) {
+        printf("Could not create the program binary cache in %s\n", directory.c_str());
+        return false;
+    }
+
+    driver = std::string((const char*)glGetString(GL_VENDOR)) + "\n" + (const char*)glGetString(GL_RENDERER) + "\n" +
+        (const char*)glGetString(GL_VERSION);
+    enabled = true;
+    return true;
+}
+
+std::string ProgramBinaryCache::GetKey(const std::string& vsSource, const std::string& fsSource) const {
+    unsigned long long h = Hash(driver);
+    h = Hash(std::string(1, '\0') + vsSource, h);
+    h = Hash(std::string(1, '\0') + fsSource, h);
+    char key[17];
+    snprintf(key, sizeof(key), "%016llx", h);
+    return key;
+}
+
+std::string ProgramBinaryCache::GetPath(const std::string& key) const {
+    return directory + "/" + key + ".bin";
+}
+
+GLuint ProgramBinaryCache::Load(const std::string& key) {
+    std::ifstream file(GetPath(key).c_str(), std::ios::in | std::ios::binary);
+    if (!file) {
+        misses++;
+        return 0;
+    }
+    std::stringstream ss;
+    ss << file.rdbuf();
+    std::string contents = ss.str();
+
+    // the file is the binary format, followed by the binary.
+    GLenum format;
+    if (contents.size() <= sizeof(format)) {
+        misses++;
+        return 0;
+    }
+    memcpy(&format, contents.data(), sizeof(format));
+
+    GLuint program;
+    GL_C(program = glCreateProgram());
+    GL_C(glProgramBinary(program, format, contents.data() + sizeof(format), (GLsizei)(contents.size() - sizeof(format))));
+
+    // a driver may reject the binaries of another version, even with the same version string.
+    GLint linked;
+    GL_C(glGetProgramiv(program, GL_LINK_STATUS, &linked));
+    if (linked == GL_FALSE) {
+        GL_C(glDeleteProgram(program));
+        misses++;
+        return 0;
+    }
+
+    hits++;
+    return program;
+}
+
+void ProgramBinaryCache::Store(const std::string& key, GLuint program) {
+    GLint length = 0;
+    GL_C(glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length));
+    if (length == 0) {
+        return;
+    }
+
+    GLenum format;
+    std::vector<char> binary(length);
+    GL_C(glGetProgramBinary(program, length, NULL, &format, &binary[0]));
+
+    // write to a temporary file, and rename it, so that another instance of the demo never
+    // sees a half-written file.
+    std::string path = GetPath(key);
+    // the workers of the render farm share the cache, so every process writes its own temporary file.
+    std::string tmpPath = path + "." + std::to_string((long long)getpid()) + ".tmp";
+    FILE* f = fopen(tmpPath.c_str(), "wb");
+    if (!f) {
+        return;
+    }
+    bool ok = fwrite(&format, sizeof(format), 1, f) == 1 && fwrite(&binary[0], 1, binary.size(), f) == binary.size();
+    ok = fclose(f) == 0 && ok;
+    if (!ok || rename(tmpPath.c_str(), path.c_str()) != 0) {
+        remove(tmpPath.c_str());
+    }
+}
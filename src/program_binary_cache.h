@@ -0,0 +1,45 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <atomic>
+#include <string>
+
+//
+// Saves linked programs to disk with glGetProgramBinary(), and loads them back with glProgramBinary(),
+// so that the next run of the demo doesn't have to compile them again.
+//
+// The file name is a hash of the full source of the shaders, including the inserted #defines, and of
+// the GL vendor, renderer and version strings. So editing a shader, or updating the driver, gives a
+// new file, instead of loading a stale binary. The driver may still reject a binary, and then we just
+// compile the program as usual, and overwrite the file.
+//
+// Old files are never deleted. Delete the directory to clear the cache.
+//
+class ProgramBinaryCache {
+public:
+    // Call with a GL context current. Returns false if the driver can't save program binaries,
+    // and then the cache stays disabled.
+    bool Init(const std::string& directory);
+    bool IsEnabled() const { return enabled; }
+
+    // The key of a program, for Load() and Store().
+    std::string GetKey(const std::string& vsSource, const std::string& fsSource) const;
+
+    // Returns 0 if the program isn't in the cache, or if the driver rejected it.
+    GLuint Load(const std::string& key);
+    // The program should have been linked with GL_PROGRAM_BINARY_RETRIEVABLE_HINT.
+    void Store(const std::string& key, GLuint program);
+
+    int GetHits() const { return hits; }
+    int GetMisses() const { return misses; }
+
+private:
+    std::string GetPath(const std::string& key) const;
+
+    bool enabled = false;
+    std::string directory;
+    std::string driver; // vendor, renderer and version.
+    std::atomic<int> hits{0};
+    std::atomic<int> misses{0};
+};
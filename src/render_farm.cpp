@@ -0,0 +1,284 @@
+#include "render_farm.h"
+#include "clock.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <thread>
+
+#ifndef _WIN32
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdint.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#ifndef _WIN32
+
+// The messages. A request is a tile, and the reply is the tile followed by its RGBA pixels.
+struct TileMessage {
+    int32_t index; // of the tile, so that a reply can be matched to its request.
+    int32_t x, y;
+    int32_t width, height;
+};
+
+// read() and write() may transfer less than we asked for, with sockets.
+static bool ReadAll(int fd, void* data, size_t size) {
+    char* p = (char*)data;
+    while (size > 0) {
+        ssize_t n = read(fd, p, size);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        p += n;
+        size -= (size_t)n;
+    }
+    return true;
+}
+
+static bool WriteAll(int fd, const void* data, size_t size) {
+    const char* p = (const char*)data;
+    while (size > 0) {
+        ssize_t n = write(fd, p, size);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        p += n;
+        size -= (size_t)n;
+    }
+    return true;
+}
+
+// The main loop of a worker process: render tiles until the coordinator closes the socket.
+static void WorkerMain(int fd, const FarmTileFunction& renderTile) {
+    // if the coordinator is gone, we want an error from write(), and not to be killed.
+    signal(SIGPIPE, SIG_IGN);
+
+    TileMessage request;
+    CpuImage pixels;
+    while (ReadAll(fd, &request, sizeof(request))) {
+        FarmTile tile = { request.x, request.y, request.width, request.height };
+        renderTile(tile, &pixels);
+        if (pixels.width != tile.width || pixels.height != tile.height) {
+            printf("farm worker %d: the tile function returned a %dx%d image for a %dx%d tile\n",
+                (int)getpid(), pixels.width, pixels.height, tile.width, tile.height);
+            break;
+        }
+        if (!WriteAll(fd, &request, sizeof(request)) || !WriteAll(fd, &pixels.pixels[0], pixels.pixels.size())) {
+            break;
+        }
+    }
+    close(fd);
+}
+
+bool RenderFarm::Render(const RenderFarmConfig& config, const FarmTileFunction& renderTile, CpuImage* image) {
+    int workerCount = config.workerCount > 0 ? config.workerCount : (int)std::thread::hardware_concurrency();
+    workerCount = workerCount > 0 ? workerCount : 1;
+
+    // the tiles, row by row.
+    std::vector<FarmTile> tiles;
+    for (int y = 0; y < config.height; y += config.tileSize) {
+        for (int x = 0; x < config.width; x += config.tileSize) {
+            FarmTile tile = { x, y, std::min(config.tileSize, config.width - x), std::min(config.tileSize, config.height - y) };
+            tiles.push_back(tile);
+        }
+    }
+    image->Resize(config.width, config.height);
+
+    struct Worker {
+        pid_t pid;
+        int fd;
+        int tile = -1; // the tile it is rendering, or -1 when it is idle.
+        double startTime = 0.0;
+        bool alive = true;
+    };
+    std::vector<Worker> workers(workerCount);
+    tilesPerWorker.assign(workerCount, 0);
+    reissuedCount = 0;
+    discardedCount = 0;
+
+    // anything still in the stdio buffers would otherwise be printed by every worker, too.
+    fflush(stdout);
+    for (int i = 0; i < workerCount; i++) {
+        int fds[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+            printf("Could not create a socket for farm worker %d: %s\n", i, strerror(errno));
+            exit(1);
+        }
+        pid_t pid = fork();
+        if (pid < 0) {
+            printf("Could not fork farm worker %d: %s\n", i, strerror(errno));
+            exit(1);
+        }
+        if (pid == 0) {
+            // the worker only keeps its own end of its own socket.
+            close(fds[0]);
+            for (int j = 0; j < i; j++) {
+                close(workers[j].fd);
+            }
+            WorkerMain(fds[1], renderTile);
+            fflush(stdout);
+            _exit(0);
+        }
+        close(fds[1]);
+        workers[i].pid = pid;
+        workers[i].fd = fds[0];
+    }
+    // a worker that dies shouldn't kill us when we write to it.
+    void (*oldSigpipe)(int) = signal(SIGPIPE, SIG_IGN);
+
+    std::deque<int> pending;
+    for (int i = 0; i < (int)tiles.size(); i++) {
+        pending.push_back(i);
+    }
+    std::vector<bool> done(tiles.size(), false);
+    std::vector<int> copies(tiles.size(), 0); // how many workers are rendering a tile right now.
+    int doneCount = 0;
+    double totalTileSeconds = 0.0;
+    int timedTiles = 0;
+    bool failed = false;
+
+    while (doneCount < (int)tiles.size()) {
+        // hand out work to the idle workers.
+        double now = GetSeconds();
+        for (Worker& w : workers) {
+            if (!w.alive || w.tile != -1) {
+                continue;
+            }
+            int next = -1;
+            if (!pending.empty()) {
+                next = pending.front();
+                pending.pop_front();
+            } else if (timedTiles > 0) {
+                // nothing left, so steal the slowest tile from the others, if it is late.
+                double average = totalTileSeconds / timedTiles;
+                double oldest = 0.0;
+                for (const Worker& o : workers) {
+                    double elapsed = now - o.startTime;
+                    if (o.alive && o.tile != -1 && !done[o.tile] && copies[o.tile] == 1 &&
+                        elapsed > config.speculateAfter * average && elapsed > oldest) {
+                        next = o.tile;
+                        oldest = elapsed;
+                    }
+                }
+                if (next != -1) {
+                    reissuedCount++;
+                }
+            }
+            if (next == -1) {
+                continue;
+            }
+
+            const FarmTile& t = tiles[next];
+            TileMessage request = { next, t.x, t.y, t.width, t.height };
+            if (!WriteAll(w.fd, &request, sizeof(request))) {
+                // it died while it was idle. The tile goes back, and the next loop gives it to someone else.
+                w.alive = false;
+                pending.push_front(next);
+                continue;
+            }
+            w.tile = next;
+            w.startTime = now;
+            copies[next]++;
+        }
+
+        // wait for replies. With a timeout, so that we notice late tiles even when nothing arrives.
+        std::vector<pollfd> pfds;
+        std::vector<int> polled;
+        int aliveCount = 0;
+        for (int i = 0; i < workerCount; i++) {
+            aliveCount += workers[i].alive ? 1 : 0;
+            if (workers[i].alive && workers[i].tile != -1) {
+                pollfd pfd = { workers[i].fd, POLLIN, 0 };
+                pfds.push_back(pfd);
+                polled.push_back(i);
+            }
+        }
+        if (aliveCount == 0) {
+            printf("All farm workers died, with %d of %d tiles done\n", doneCount, (int)tiles.size());
+            failed = true;
+            break;
+        }
+        if (pfds.empty()) {
+            continue; // a worker died before it got its tile, which the next round hands out again.
+        }
+        if (poll(&pfds[0], pfds.size(), 50) < 0 && errno != EINTR) {
+            printf("poll() failed in the render farm: %s\n", strerror(errno));
+            failed = true;
+            break;
+        }
+
+        for (size_t p = 0; p < pfds.size(); p++) {
+            if (!(pfds[p].revents & (POLLIN | POLLHUP | POLLERR))) {
+                continue;
+            }
+            Worker& w = workers[polled[p]];
+            int index = w.tile;
+            const FarmTile& t = tiles[index];
+            copies[index]--;
+            w.tile = -1;
+
+            // the worker writes the whole reply at once, so we can block until we have it.
+            TileMessage reply;
+            std::vector<unsigned char> pixels((size_t)t.width * t.height * 4);
+            if (!ReadAll(w.fd, &reply, sizeof(reply)) || reply.index != index ||
+                !ReadAll(w.fd, &pixels[0], pixels.size())) {
+                printf("farm worker %d died, while rendering tile %d\n", polled[p], index);
+                w.alive = false;
+                if (!done[index] && copies[index] == 0) {
+                    pending.push_front(index);
+                }
+                continue;
+            }
+
+            if (done[index]) {
+                discardedCount++; // another worker was faster.
+                continue;
+            }
+            for (int row = 0; row < t.height; row++) {
+                memcpy(image->At(t.x, t.y + row), &pixels[(size_t)row * t.width * 4], (size_t)t.width * 4);
+            }
+            done[index] = true;
+            doneCount++;
+            tilesPerWorker[polled[p]]++;
+            totalTileSeconds += GetSeconds() - w.startTime;
+            timedTiles++;
+        }
+    }
+
+    // the idle workers exit when their socket is closed. The ones that are still rendering a
+    // tile that someone else already finished, we don't wait for.
+    for (Worker& w : workers) {
+        if (w.alive && w.tile != -1) {
+            kill(w.pid, SIGKILL);
+        }
+        close(w.fd);
+    }
+    for (Worker& w : workers) {
+        waitpid(w.pid, NULL, 0);
+    }
+    signal(SIGPIPE, oldSigpipe);
+
+    return !failed;
+}
+
+#else
+
+bool RenderFarm::Render(const RenderFarmConfig&, const FarmTileFunction&, CpuImage*) {
+    printf("The render farm needs fork() and Unix domain sockets, which this platform doesn't have\n");
+    return false;
+}
+
+#endif
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <functional>
+#include <vector>
+
+#include "cpu_image.h"
+
+// A rectangle of the image, in pixels.
+struct FarmTile {
+    int x, y;
+    int width, height;
+};
+
+struct RenderFarmConfig {
+    int workerCount = 0; // 0 means one for every core.
+    int tileSize = 256;
+    int width = 0, height = 0; // of the whole image.
+    // a tile that is still running when there is nothing else left to do, and has taken this many
+    // times longer than the average tile, is given to an idle worker as well.
+    float speculateAfter = 2.0f;
+};
+
+// Renders one tile, in a worker process. 'pixels' must be resized to the size of the tile.
+typedef std::function<void(const FarmTile& tile, CpuImage* pixels)> FarmTileFunction;
+
+//
+// Renders an image that is too large, or too slow, for one GL context, by splitting it into tiles,
+// and handing them out to a pool of worker processes, that each have their own context. With a
+// software renderer like llvmpipe, that is the way to use all the cores of a machine for one image.
+//
+// The workers are forks of the coordinator, and they talk over Unix domain sockets: the coordinator
+// sends the rectangle of a tile, and the worker sends back its pixels, which are copied into the image
+// as they arrive. Scheduling is pull-based: a worker only gets a new tile when it has returned the
+// previous one, so fast workers simply do more tiles.
+//
+// When all tiles have been handed out, the idle workers steal work from the slow ones: a tile that
+// has taken much longer than the average is handed out again, and whichever copy comes back first
+// wins. The same happens to the tile of a worker that dies.
+//
+// The tile function runs in the worker, so it must create its GL context itself, on the first tile.
+// And Render() must be called before this process has created any GL context, or any threads, since
+// those don't survive a fork. The demo's workers create theirs with a hidden GLFW window, so they
+// need a display, if only a virtual one like Xvfb.
+//
+class RenderFarm {
+public:
+    // Returns false if the image couldn't be completed, because all workers died.
+    bool Render(const RenderFarmConfig& config, const FarmTileFunction& renderTile, CpuImage* image);
+
+    // statistics of the last Render().
+    int GetWorkerCount() const { return (int)tilesPerWorker.size(); }
+    int GetTilesDone(int worker) const { return tilesPerWorker[worker]; }
+    int GetReissuedCount() const { return reissuedCount; }
+    int GetDiscardedCount() const { return discardedCount; }
+
+private:
+    std::vector<int> tilesPerWorker;
+    int reissuedCount = 0;
+    int discardedCount = 0; // tiles that were rendered twice, and came back second.
+};
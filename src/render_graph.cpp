@@ -0,0 +1,384 @@
+#include "render_graph.h"
+#include "gl_util.h"
+#include "gl_state.h"
+#include "gl_textures.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <functional>
+#include <queue>
+
+// all the barrier bits a later reader might need, after an image store.
+static const GLbitfield ALL_READ_BARRIER_BITS =
+    GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT |
+    GL_FRAMEBUFFER_BARRIER_BIT | GL_TEXTURE_UPDATE_BARRIER_BIT;
+
+// the barrier bit that makes image stores visible to a given kind of read.
+static GLbitfield BarrierBitForRead(ImageAccess access) {
+    switch (access) {
+    case ACCESS_IMAGE_LOAD:
+    case ACCESS_IMAGE_STORE:
+    case ACCESS_IMAGE_LOAD_STORE:
+        return GL_SHADER_IMAGE_ACCESS_BARRIER_BIT;
+    case ACCESS_TEXTURE_FETCH:
+        return GL_TEXTURE_FETCH_BARRIER_BIT;
+    case ACCESS_FRAMEBUFFER:
+        return GL_FRAMEBUFFER_BARRIER_BIT;
+    case ACCESS_READBACK:
+        return GL_TEXTURE_UPDATE_BARRIER_BIT;
+    }
+    return 0;
+}
+
+static bool IsImageAccess(ImageAccess access) {
+    return access == ACCESS_IMAGE_LOAD || access == ACCESS_IMAGE_STORE || access == ACCESS_IMAGE_LOAD_STORE;
+}
+
+static std::string BarrierBitsToString(GLbitfield bits) {
+    if (bits == 0) {
+        return "none";
+    }
+    std::string s;
+    if (bits & GL_SHADER_IMAGE_ACCESS_BARRIER_BIT) s += "|SHADER_IMAGE_ACCESS";
+    if (bits & GL_TEXTURE_FETCH_BARRIER_BIT) s += "|TEXTURE_FETCH";
+    if (bits & GL_FRAMEBUFFER_BARRIER_BIT) s += "|FRAMEBUFFER";
+    if (bits & GL_TEXTURE_UPDATE_BARRIER_BIT) s += "|TEXTURE_UPDATE";
+    return s.substr(1);
+}
+
+RenderGraph::Pass& RenderGraph::Pass::Read(ImageHandle image, ImageAccess access) {
+    Use use = { image, access, true, false };
+    uses.push_back(use);
+    return *this;
+}
+
+RenderGraph::Pass& RenderGraph::Pass::Write(ImageHandle image, ImageAccess access) {
+    Use use = { image, access, false, true };
+    uses.push_back(use);
+    return *this;
+}
+
+RenderGraph::Pass& RenderGraph::Pass::ReadWrite(ImageHandle image, ImageAccess access) {
+    Use use = { image, access, true, true };
+    uses.push_back(use);
+    return *this;
+}
+
+ImageHandle RenderGraph::ImportImage(const std::string& name, GLenum format) {
+    Image image;
+    image.name = name;
+    image.format = format;
+    image.imported = true;
+    image.desc.format = format;
+    image.desc.width = image.desc.height = 0;
+    image.texture = 0;
+    image.physical = -1;
+    images.push_back(image);
+    compiled = false;
+    return (ImageHandle)images.size() - 1;
+}
+
+void RenderGraph::SetImportedTexture(ImageHandle image, GLuint texture) {
+    images[image].texture = texture;
+}
+
+ImageHandle RenderGraph::CreateImage(const std::string& name, const ImageDesc& desc) {
+    Image image;
+    image.name = name;
+    image.format = desc.format;
+    image.imported = false;
+    image.desc = desc;
+    image.texture = 0;
+    image.physical = -1;
+    images.push_back(image);
+    compiled = false;
+    return (ImageHandle)images.size() - 1;
+}
+
+RenderGraph::Pass& RenderGraph::AddPass(const std::string& name, ExecuteFunc execute) {
+    Pass pass;
+    pass.name = name;
+    pass.execute = execute;
+    passes.push_back(pass);
+    compiled = false;
+    return passes.back();
+}
+
+GLuint RenderGraph::GetTexture(ImageHandle image) const {
+    return images[image].texture;
+}
+
+void RenderGraph::Compile() {
+    int passCount = (int)passes.size();
+
+    //
+    // find the writer of every image.
+    //
+    std::vector<int> writer(images.size(), -1);
+    for (int p = 0; p < passCount; p++) {
+        for (const Pass::Use& use : passes[p].uses) {
+            if (!use.write) {
+                continue;
+            }
+            if (writer[use.image] != -1 && writer[use.image] != p) {
+                printf("Render graph: image '%s' is written by both '%s' and '%s'\n", images[use.image].name.c_str(),
+                    passes[writer[use.image]].name.c_str(), passes[p].name.c_str());
+                exit(1);
+            }
+            writer[use.image] = p;
+        }
+    }
+
+    //
+    // a pass depends on the writers of the images it reads.
+    //
+    std::vector<std::vector<int>> dependencies(passCount);
+    for (int p = 0; p < passCount; p++) {
+        for (const Pass::Use& use : passes[p].uses) {
+            int w = writer[use.image];
+            if (use.read && w != -1 && w != p) {
+                dependencies[p].push_back(w);
+            }
+        }
+    }
+
+    //
+    // cull the passes that don't contribute to any imported image.
+    //
+    std::vector<bool> live(passCount, false);
+    std::vector<int> stack;
+    for (int p = 0; p < passCount; p++) {
+        for (const Pass::Use& use : passes[p].uses) {
+            if (use.write && images[use.image].imported && !live[p]) {
+                live[p] = true;
+                stack.push_back(p);
+            }
+        }
+    }
+    while (!stack.empty()) {
+        int p = stack.back();
+        stack.pop_back();
+        for (int d : dependencies[p]) {
+            if (!live[d]) {
+                live[d] = true;
+                stack.push_back(d);
+            }
+        }
+    }
+
+    //
+    // order the live passes topologically. When several passes are ready, we pick the one
+    // that was added first, so the order is deterministic, and follows the order of AddPass()
+    // whenever the dependencies allow it.
+    //
+    std::vector<int> remaining(passCount, 0);
+    std::vector<std::vector<int>> dependents(passCount);
+    for (int p = 0; p < passCount; p++) {
+        if (!live[p]) {
+            continue;
+        }
+        for (int d : dependencies[p]) {
+            remaining[p]++;
+            dependents[d].push_back(p);
+        }
+    }
+    std::priority_queue<int, std::vector<int>, std::greater<int>> ready;
+    for (int p = 0; p < passCount; p++) {
+        if (live[p] && remaining[p] == 0) {
+            ready.push(p);
+        }
+    }
+    order.clear();
+    while (!ready.empty()) {
+        int p = ready.top();
+        ready.pop();
+        order.push_back(p);
+        for (int d : dependents[p]) {
+            if (--remaining[d] == 0) {
+                ready.push(d);
+            }
+        }
+    }
+    int liveCount = (int)std::count(live.begin(), live.end(), true);
+    if ((int)order.size() != liveCount) {
+        printf("Render graph: the passes have a dependency cycle\n");
+        exit(1);
+    }
+
+    //
+    // the lifetime of every transient image, as the range of positions in 'order' that use it.
+    //
+    std::vector<int> firstUse(images.size(), -1), lastUse(images.size(), -1);
+    for (int i = 0; i < (int)order.size(); i++) {
+        for (const Pass::Use& use : passes[order[i]].uses) {
+            if (firstUse[use.image] == -1) {
+                firstUse[use.image] = i;
+            }
+            lastUse[use.image] = i;
+        }
+    }
+
+    //
+    // allocate the transient images. We go through them in the order they come alive, and give each
+    // one the first texture of the same format and size that is no longer used at that point.
+    // The textures are kept from the previous Compile(), if there was one.
+    //
+    std::vector<ImageHandle> transients;
+    for (ImageHandle h = 0; h < (ImageHandle)images.size(); h++) {
+        images[h].physical = -1;
+        if (!images[h].imported && firstUse[h] != -1) {
+            transients.push_back(h);
+        }
+    }
+    std::sort(transients.begin(), transients.end(), [&](ImageHandle a, ImageHandle b) {
+        return firstUse[a] < firstUse[b];
+    });
+    for (Physical& physical : physicals) {
+        physical.busyUntil = -1;
+    }
+    for (ImageHandle h : transients) {
+        Image& image = images[h];
+        int found = -1;
+        for (int i = 0; i < (int)physicals.size() && found == -1; i++) {
+            const Physical& physical = physicals[i];
+            if (physical.busyUntil < firstUse[h] && physical.desc.format == image.desc.format &&
+                physical.desc.width == image.desc.width && physical.desc.height == image.desc.height) {
+                found = i;
+            }
+        }
+        if (found == -1) {
+            Physical physical;
+            physical.desc = image.desc;
+            physical.texture = CreateTexture2D(image.desc.format, image.desc.width, image.desc.height, "render graph");
+            physicals.push_back(physical);
+            found = (int)physicals.size() - 1;
+        }
+        physicals[found].busyUntil = lastUse[h];
+        image.physical = found;
+        image.texture = physicals[found].texture;
+    }
+
+    compiled = true;
+}
+
+// which barriers does this pass need, given what the passes before it did?
+GLbitfield RenderGraph::GetBarrierBits(const Pass& pass) {
+    GLbitfield bits = 0;
+    for (const Pass::Use& use : pass.uses) {
+        TextureState& state = textureStates[images[use.image].texture];
+        if (use.read) {
+            // read after an incoherent write. 
+            bits |= state.pendingBits & BarrierBitForRead(use.access);
+        }
+        if (use.write && state.imageAccessed) {
+            // write after an image load or store that may still be in flight. This happens when
+            // a transient image reuses the texture of another one.
+            bits |= GL_SHADER_IMAGE_ACCESS_BARRIER_BIT;
+        }
+    }
+    return bits;
+}
+
+void RenderGraph::IssueBarrier(GLbitfield bits) {
+    if (bits == 0) {
+        return;
+    }
+
+    GL_C(glMemoryBarrier(bits));
+    // barriers are global, so they apply to all textures.
+    for (auto& it : textureStates) {
+        it.second.pendingBits &= ~bits;
+        if (bits & GL_SHADER_IMAGE_ACCESS_BARRIER_BIT) {
+            it.second.imageAccessed = false;
+        }
+    }
+}
+
+// remember what a pass left behind.
+void RenderGraph::UpdateTextureStates(const Pass& pass) {
+    for (const Pass::Use& use : pass.uses) {
+        TextureState& state = textureStates[images[use.image].texture];
+        if (IsImageAccess(use.access)) {
+            state.imageAccessed = true;
+        }
+        // image stores are incoherent, so until there is a barrier, nobody may read them.
+        // Other writes, like rendering to a framebuffer, are visible to all later GL commands.
+        if (use.write && IsImageAccess(use.access)) {
+            state.pendingBits = ALL_READ_BARRIER_BITS;
+        }
+    }
+}
+
+void RenderGraph::Execute() {
+    if (!compiled) {
+        Compile();
+    }
+    if (order.empty()) {
+        return;
+    }
+
+    // the barrier that a pass needs is issued at the end of the previous pass, so that the
+    // timings of a pass include waiting for its own results.
+    // Only the first pass needs a barrier from the previous frame.
+    Pass& first = passes[order[0]];
+    first.lastBarrier = GetBarrierBits(first);
+    IssueBarrier(first.lastBarrier);
+
+    for (int i = 0; i < (int)order.size(); i++) {
+        Pass& pass = passes[order[i]];
+
+        // how long the CPU takes to issue the pass. The GPU runs it later, see GpuTimer.
+        TraceZone zone(pass.name.c_str());
+        if (timer) {
+            timer->BeginPass(order[i]);
+        }
+
+        pass.execute();
+        UpdateTextureStates(pass);
+
+        if (i + 1 < (int)order.size()) {
+            Pass& next = passes[order[i + 1]];
+            next.lastBarrier = GetBarrierBits(next);
+            IssueBarrier(next.lastBarrier);
+        }
+
+        if (timer) {
+            timer->EndPass();
+        }
+    }
+}
+
+void RenderGraph::Print() const {
+    printf("Render graph:\n");
+    for (int p : order) {
+        const Pass& pass = passes[p];
+        printf("  pass '%s' (barrier before: %s)\n", pass.name.c_str(), BarrierBitsToString(pass.lastBarrier).c_str());
+        for (const Pass::Use& use : pass.uses) {
+            const Image& image = images[use.image];
+            printf("    %s %s", use.read && use.write ? "read-write" : (use.read ? "read" : "write"), image.name.c_str());
+            if (image.imported) {
+                printf(" (imported)\n");
+            } else {
+                printf(" (transient, texture %d)\n", image.physical);
+            }
+        }
+    }
+    for (int p = 0; p < (int)passes.size(); p++) {
+        if (std::find(order.begin(), order.end(), p) == order.end()) {
+            printf("  pass '%s' is culled, since nothing uses its output\n", passes[p].name.c_str());
+        }
+    }
+    printf("  %d transient texture(s)\n", (int)physicals.size());
+}
+
+void RenderGraph::Destroy() {
+    for (Physical& physical : physicals) {
+        DeleteTextures2D(1, &physical.texture);
+    }
+    physicals.clear();
+    images.clear();
+    passes.clear();
+    order.clear();
+    textureStates.clear();
+    compiled = false;
+}
@@ -0,0 +1,145 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include "gpu_timer.h"
+
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+//
+// A small render graph.
+//
+// Instead of hand-writing the sequence of passes, and the barriers between them, every pass
+// declares which images it reads and writes, and how. From that, the graph:
+//
+// - orders the passes, so that every pass runs after the passes that produce its inputs.
+//   Passes whose output nobody uses are culled.
+// - inserts a glMemoryBarrier() before a pass, only when the pass reads something that was written
+//   with incoherent image stores, and only with the bits needed for how the pass reads it.
+//   For instance, a pass that samples an image with texelFetch needs GL_TEXTURE_FETCH_BARRIER_BIT,
+//   and not GL_SHADER_IMAGE_ACCESS_BARRIER_BIT.
+// - allocates the transient images, the images that only live within a frame. Transient images whose
+//   lifetimes don't overlap, and that have the same format and size, share the same texture.
+//
+// Every image has at most one writer per frame. A pass that reads an image that is written in the
+// same frame runs after the writer, and sees what it wrote. Imported images, the ones that live
+// outside the graph, can also be read without a writer, and then the pass sees their old contents.
+//
+// The graph is built once, at startup, and compiled once. Every frame, we just point the imported
+// images at this frame's textures, and execute it.
+//
+
+enum ImageAccess {
+    ACCESS_IMAGE_LOAD,       // imageLoad() in a shader.
+    ACCESS_IMAGE_STORE,      // imageStore() in a shader.
+    ACCESS_IMAGE_LOAD_STORE, // both.
+    ACCESS_TEXTURE_FETCH,    // texelFetch() or texture() through a sampler.
+    ACCESS_FRAMEBUFFER,      // attached to the framebuffer, or the default framebuffer itself.
+    ACCESS_READBACK,         // glGetTexImage() or glReadPixels().
+};
+
+struct ImageDesc {
+    GLenum format;
+    int width;
+    int height;
+};
+
+typedef int ImageHandle;
+
+class RenderGraph {
+public:
+    typedef std::function<void()> ExecuteFunc;
+
+    class Pass {
+    public:
+        Pass& Read(ImageHandle image, ImageAccess access);
+        Pass& Write(ImageHandle image, ImageAccess access);
+        // Both reads the old contents, and writes new ones, like a blur done in place.
+        Pass& ReadWrite(ImageHandle image, ImageAccess access);
+
+    private:
+        friend class RenderGraph;
+        struct Use {
+            ImageHandle image;
+            ImageAccess access;
+            bool read;
+            bool write;
+        };
+
+        std::string name;
+        ExecuteFunc execute;
+        std::vector<Use> uses;
+        GLbitfield lastBarrier = 0; // what we issued before this pass, last frame.
+    };
+
+    // An image that lives outside the graph, and survives across frames. 
+    // Passes that write imported images are never culled.
+    ImageHandle ImportImage(const std::string& name, GLenum format);
+    // The texture an imported image refers to. Can be changed every frame. 
+    // Use 0 for the default framebuffer.
+    void SetImportedTexture(ImageHandle image, GLuint texture);
+
+    // An image that only lives during the frame, and is allocated by the graph.
+    ImageHandle CreateImage(const std::string& name, const ImageDesc& desc);
+
+    // The returned reference is only valid until the next AddPass().
+    Pass& AddPass(const std::string& name, ExecuteFunc execute);
+
+    // Orders the passes, and allocates the transient images. Exits with a message if the graph is invalid.
+    void Compile();
+    // Runs the passes, with the barriers they need.
+    void Execute();
+
+    // The texture of an image. For transient images, this is only valid after Compile().
+    GLuint GetTexture(ImageHandle image) const;
+
+    // Time every pass with 'timer', which must have been initialized with GetPassCount() passes.
+    // The time of a pass includes the barrier after it, so that waiting for the pass to finish
+    // is counted against the pass itself, and not against the next one.
+    void SetTimer(GpuTimer* timer_) { timer = timer_; }
+    int GetPassCount() const { return (int)passes.size(); }
+    const std::string& GetPassName(int pass) const { return passes[pass].name; }
+
+    // Prints the pass order, the barriers issued in the last frame, and the transient image allocations.
+    void Print() const;
+
+    void Destroy();
+
+private:
+    struct Image {
+        std::string name;
+        GLenum format;
+        bool imported;
+        ImageDesc desc;     // only for transient images.
+        GLuint texture;     // for imported images, set every frame. For transient images, set by Compile().
+        int physical;       // for transient images, index into 'physicals'.
+    };
+
+    // a texture that backs one or more transient images.
+    struct Physical {
+        ImageDesc desc;
+        GLuint texture;
+        int busyUntil; // index into 'order' of the last pass that uses it. only used during Compile().
+    };
+
+    // what we know about a texture, to decide which barriers are needed before it is used again.
+    struct TextureState {
+        GLbitfield pendingBits = 0;  // barrier bits a reader still needs, after an incoherent write.
+        bool imageAccessed = false;  // accessed with image load/store since the last image access barrier.
+    };
+
+    GLbitfield GetBarrierBits(const Pass& pass);
+    void IssueBarrier(GLbitfield bits);
+    void UpdateTextureStates(const Pass& pass);
+
+    std::vector<Image> images;
+    std::vector<Pass> passes;
+    std::vector<int> order; // indices of the passes to run, in execution order.
+    std::vector<Physical> physicals;
+    std::map<GLuint, TextureState> textureStates;
+    bool compiled = false;
+    GpuTimer* timer = NULL;
+};
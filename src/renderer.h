@@ -0,0 +1,94 @@
+#pragma once
+
+#include <utility>
+
+#include "cpu_image.h"
+#include "fractal_variant.h"
+
+// The region of the complex plane that we render.
+struct View {
+    float centerX, centerY;
+    float scale; // width and height of the region.
+
+    bool operator==(const View& o) const { return centerX == o.centerX && centerY == o.centerY && scale == o.scale; }
+};
+
+// What a frame shows. Everything else is fixed when the renderer is created.
+struct FrameParams {
+    View view;
+    FractalVariant variant;
+};
+
+// Temporal accumulation, in the backends that do it: every frame samples the pixels at another
+// position inside them, Halton(samples, 2) and Halton(samples, 3), and averages that with the samples
+// of the frames before, as long as the view stays the same.
+// After this many samples, we keep a running average instead, so that the weight of a new
+// sample doesn't get so small that it vanishes in float precision.
+const int MAX_HISTORY_SAMPLES = 256;
+
+// Element 'index' of the Halton sequence with base 'base'. The sequence is in [0,1), and covers
+// it evenly, even for short prefixes. And the first element is 0.
+inline float Halton(int index, int base) {
+    float f = 1.0f;
+    float r = 0.0f;
+    while (index > 0) {
+        f = f / (float)base;
+        r = r + f * (float)(index % base);
+        index = index / base;
+    }
+    return r;
+}
+
+//
+// A backend that renders the frames of the demo: the fractal, the filters, and the pass that
+// presents the result. The demo picks one with --backend, and the main loop only talks to it
+// through this interface. So can any other program, with the library the backends are built
+// into, see CMakeLists.txt.
+//
+// The OpenGL backend is the one the demo is about, see gl_renderer.h. The Vulkan backend in
+// vulkan_renderer.h does the same with compute shaders, for comparison, and the CPU backend in
+// cpu_renderer.h with C++ kernels.
+//
+class Renderer {
+public:
+    virtual ~Renderer() {}
+
+    virtual const char* GetName() const = 0;
+
+    // Renders and presents one frame. Returns false if the frame was skipped, because the shaders
+    // aren't ready yet.
+    virtual bool RenderFrame(const FrameParams& params) = 0;
+
+    // The variant of the last frame. That is the variant of its params, unless the backend renders
+    // the last variant it had while it builds the new one.
+    virtual const FractalVariant& GetRenderedVariant() const = 0;
+
+    // Reads back the last frame that was presented, at the window resolution. Waits for the GPU.
+    // Returns false if there is no frame yet.
+    virtual bool ReadLastFrame(CpuImage* image) = 0;
+
+    // The same, without waiting: BeginReadLastFrame() starts copying the last frame, and returns, so
+    // that the next frames can be rendered while the GPU copies. FinishReadLastFrame() then waits for
+    // the copy, if IsReadLastFrameDone() says it isn't done yet, and hands over the pixels.
+    // There is one readback at a time, a new one replaces the last. Returns false if there is no
+    // frame, or no readback. The backends that can't copy in the background copy right away.
+    virtual bool BeginReadLastFrame() {
+        readbackPending = ReadLastFrame(&readbackImage);
+        return readbackPending;
+    }
+    virtual bool IsReadLastFrameDone() { return true; }
+    virtual bool FinishReadLastFrame(CpuImage* image) {
+        if (!readbackPending) {
+            return false;
+        }
+        std::swap(*image, readbackImage);
+        readbackPending = false;
+        return true;
+    }
+
+    virtual void Destroy() = 0;
+
+private:
+    CpuImage readbackImage; // what BeginReadLastFrame() read.
+    bool readbackPending = false;
+};
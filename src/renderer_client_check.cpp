@@ -0,0 +1,168 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "gl_renderer.h"
+#include "gpu_memory.h"
+
+//
+// A program that renders through the shared library, like any client of it would, see CMakeLists.txt,
+// and checks the readback that doesn't wait, BeginReadLastFrame() and FinishReadLastFrame(), against
+// ReadLastFrame().
+//
+// It runs two GL renderers, in two hidden windows, and renders frames on the second while the first
+// copies its last frame. So it also checks that the renderers keep out of each other's way, and that
+// gpuMemory has nothing left when both are destroyed, though they use the same GL names.
+// And it renders a still with a third, whose textures are larger than its window, since it may
+// render at twice the resolution. It needs a display with GL 4.2, like --check-views.
+//
+
+#ifdef SHADER_DIR
+std::string shaderDirectory = SHADER_DIR;
+#else
+std::string shaderDirectory = "shaders";
+#endif
+
+const int WIDTH = 320;
+const int HEIGHT = 240;
+int frameCount = 8;
+
+bool InitRenderer(GlRenderer* renderer, float maxScale) {
+    GlRendererConfig config;
+    std::string error;
+    if (!FilterLibrary::ParseChain("box", &config.filterChain, &error)) {
+        printf("%s\n", error.c_str());
+        return false;
+    }
+    config.width = WIDTH;
+    config.height = HEIGHT;
+    config.visible = false;
+    config.shaderDirectory = shaderDirectory;
+    config.shaderCacheEnabled = false;
+    config.waitForShaders = true;
+    config.timingInterval = 0;
+    config.dynamicResolution.maxScale = maxScale;
+    // so that it always renders at maxScale.
+    config.dynamicResolutionEnabled = false;
+    return renderer->Init(config);
+}
+
+// Renders frameCount frames of the view, which accumulate samples, like the demo does when it's paused.
+bool RenderFrames(Renderer* renderer, const FrameParams& params) {
+    for (int i = 0; i < frameCount; i++) {
+        if (!renderer->RenderFrame(params)) {
+            printf("%s: frame %d was skipped\n", renderer->GetName(), i);
+            return false;
+        }
+    }
+    return true;
+}
+
+// a fractal is never one color, so an image that is, is one the readback didn't write.
+bool IsBlank(const CpuImage& image) {
+    for (size_t i = 4; i < image.pixels.size(); i++) {
+        if (image.pixels[i] != image.pixels[i % 4]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool CheckReadback(Renderer* renderer, Renderer* other, const FrameParams& params, const FrameParams& otherParams) {
+    if (!RenderFrames(renderer, params)) {
+        return false;
+    }
+    if (!renderer->BeginReadLastFrame()) {
+        printf("BeginReadLastFrame() found no frame\n");
+        return false;
+    }
+    // while that copies, the other renderer renders.
+    if (!RenderFrames(other, otherParams)) {
+        return false;
+    }
+    bool doneEarly = renderer->IsReadLastFrameDone();
+
+    CpuImage async, sync;
+    if (!renderer->FinishReadLastFrame(&async)) {
+        printf("FinishReadLastFrame() returned no frame\n");
+        return false;
+    }
+    if (renderer->FinishReadLastFrame(&async)) {
+        printf("FinishReadLastFrame() returned a frame twice\n");
+        return false;
+    }
+    if (!renderer->ReadLastFrame(&sync)) {
+        printf("ReadLastFrame() found no frame\n");
+        return false;
+    }
+
+    if (async.width != WIDTH || async.height != HEIGHT) {
+        printf("the readback is %dx%d, not %dx%d\n", async.width, async.height, WIDTH, HEIGHT);
+        return false;
+    }
+    const int tolerance[4] = { 0, 0, 0, 0 };
+    ImageDiff diff = CompareImages(async, sync, tolerance, NULL);
+    bool blank = IsBlank(sync);
+    printf("  %-22s %10s %12d %10s\n", params.variant.GetName().c_str(), doneEarly ? "yes" : "no", diff.pixelsOff,
+        diff.pixelsOff == 0 && !blank ? "ok" : "FAILED");
+    return diff.pixelsOff == 0 && !blank;
+}
+
+// The stills are the render resolution, not the window, nor the texture.
+bool CheckStills(GlRenderer* renderer, const FrameParams& params, int scale) {
+    CpuImage fractal, still;
+    renderer->RenderFractalStill(params, &fractal);
+    renderer->RenderStill(params, &still);
+    bool passed = true;
+    for (const CpuImage* image : { &fractal, &still }) {
+        if (image->width != scale * WIDTH || image->height != scale * HEIGHT || IsBlank(*image)) {
+            printf("a still of a renderer at %dx the window is %dx%d, not %dx%d, or blank\n", scale,
+                image->width, image->height, scale * WIDTH, scale * HEIGHT);
+            passed = false;
+        }
+    }
+    return passed;
+}
+
+int main(int argc, char** argv) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--shader-dir") == 0 && i + 1 < argc) {
+            shaderDirectory = argv[++i];
+        } else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            frameCount = atoi(argv[++i]);
+        } else {
+            printf("usage: renderer_client_check [--shader-dir DIR] [--frames N]\n");
+            exit(strcmp(argv[i], "--help") == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+        }
+    }
+
+    GlRenderer first, second, large;
+    if (!InitRenderer(&first, 1.0f) || !InitRenderer(&second, 1.0f) || !InitRenderer(&large, 2.0f)) {
+        glfwTerminate();
+        exit(EXIT_FAILURE);
+    }
+
+    FrameParams mandelbrot, julia;
+    mandelbrot.variant.formula = FORMULA_MANDELBROT;
+    julia.variant.formula = FORMULA_JULIA;
+    mandelbrot.variant.GetCenter(&mandelbrot.view.centerX, &mandelbrot.view.centerY);
+    julia.variant.GetCenter(&julia.view.centerX, &julia.view.centerY);
+    mandelbrot.view.scale = julia.view.scale = 2.5f;
+
+    printf("checking the readback that doesn't wait against ReadLastFrame(), after %d frames at %dx%d:\n", frameCount, WIDTH, HEIGHT);
+    printf("  %-22s %10s %12s %10s\n", "variant", "done early", "pixels off", "");
+    bool passed = CheckReadback(&first, &second, mandelbrot, julia);
+    passed = CheckReadback(&second, &first, julia, mandelbrot) && passed;
+    passed = CheckStills(&large, mandelbrot, 2) && passed;
+
+    first.Destroy();
+    second.Destroy();
+    large.Destroy();
+    glfwTerminate();
+
+    if (gpuMemory.GetTotalBytes() != 0) {
+        printf("gpuMemory still has %zu bytes, after the renderers are destroyed\n", gpuMemory.GetTotalBytes());
+        passed = false;
+    }
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <cmath>
+
+//
+// The GLSL built-ins that the CPU versions of the shaders need, rounded like the shaders are, so that
+// they give the very same bytes as often as they can. See cpu_fractal.h and cpu_renderer.h.
+//
+
+// mix(), as llvmpipe compiles it: the last multiply and the add are fused into an fma. That rounds
+// once less than a * (1 - t) + b * t, and so it gives the very same bytes as the shader far more often.
+inline float Mix(float a, float b, float t) {
+    return fmaf(a, 1.0f - t, b * t);
+}
@@ -0,0 +1,58 @@
+#include "shader_permutations.h"
+
+#include <cstdio>
+
+void ShaderPermutations::Init(ShaderReloader* reloader_, int capacity_) {
+    reloader = reloader_;
+    capacity = capacity_;
+}
+
+GLuint ShaderPermutations::Get(const std::string& vsFile, const std::string& fsFile, const ShaderConstants& constants) {
+    std::string defines;
+    for (const auto& it : constants) {
+        defines += "#define " + it.first + " " + std::to_string(it.second) + "\n";
+    }
+    std::string key = vsFile + "\n" + fsFile + "\n" + defines;
+
+    auto it = entries.find(key);
+    if (it == entries.end()) {
+        Entry entry;
+        entry.id = reloader->AddProgram(vsFile, fsFile, defines);
+        entry.ready = false;
+        entry.requested = std::chrono::steady_clock::now();
+        it = entries.insert(std::make_pair(key, entry)).first;
+    }
+
+    Entry& entry = it->second;
+    entry.lastUsedFrame = frame;
+
+    GLuint program = reloader->GetProgram(entry.id);
+    if (program && !entry.ready) {
+        entry.ready = true;
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - entry.requested).count();
+        std::string name = vsFile;
+        for (const auto& c : constants) {
+            name += " " + c.first + "=" + std::to_string(c.second);
+        }
+        printf("shader permutation %s ready after %.0f ms\n", name.c_str(), ms);
+    }
+    return program;
+}
+
+void ShaderPermutations::Update() {
+    while ((int)entries.size() > capacity) {
+        auto oldest = entries.end();
+        for (auto it = entries.begin(); it != entries.end(); ++it) {
+            if (oldest == entries.end() || it->second.lastUsedFrame < oldest->second.lastUsedFrame) {
+                oldest = it;
+            }
+        }
+        // everything left was used in this frame.
+        if (oldest->second.lastUsedFrame == frame) {
+            break;
+        }
+        reloader->RemoveProgram(oldest->second.id);
+        entries.erase(oldest);
+    }
+    frame++;
+}
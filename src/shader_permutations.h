@@ -0,0 +1,52 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <chrono>
+#include <map>
+#include <string>
+
+#include "shader_reloader.h"
+
+// Compile-time constants of a shader, like { "M", 128 }. Each becomes "#define M 128".
+typedef std::map<std::string, int> ShaderConstants;
+
+//
+// Programs for every combination of constants, compiled when they are first asked for.
+//
+// Some values, like the number of iterations of the fractal, or the radius of a filter, are loop
+// bounds, and the shaders are much faster when they are constants, because the compiler can unroll
+// the loops. But then there is a program for every value, far too many to compile up front. So we
+// compile a program the first time a combination of constants is used, on the shader reloader thread,
+// and keep the most recently used ones around. The others are deleted, and when they are needed
+// again, they usually come straight back from the program binary cache.
+//
+class ShaderPermutations {
+public:
+    // Keep at most 'capacity' programs, apart from the ones that are used in the current frame.
+    void Init(ShaderReloader* reloader, int capacity);
+
+    // The program for these shaders and constants, or 0 if it isn't compiled yet. The first call for a
+    // combination starts compiling it. Like the programs of the reloader, it may change from frame to
+    // frame, when the shaders are reloaded, so don't keep it around.
+    GLuint Get(const std::string& vsFile, const std::string& fsFile, const ShaderConstants& constants);
+
+    // Call once a frame, at the end of the frame. Deletes the least recently used programs, until we
+    // are within the capacity.
+    void Update();
+
+    int GetCount() const { return (int)entries.size(); }
+
+private:
+    struct Entry {
+        int id;           // in the reloader.
+        int lastUsedFrame;
+        bool ready;
+        std::chrono::steady_clock::time_point requested;
+    };
+
+    ShaderReloader* reloader = NULL;
+    int capacity = 0;
+    int frame = 0;
+    std::map<std::string, Entry> entries; // by the files and the #defines.
+};
@@ -0,0 +1,390 @@
+#include "shader_reloader.h"
+#include "gl_util.h"
+#include "gl_state.h"
+#include "trace.h"
+
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+
+#include <sys/stat.h>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+static bool ReadFile(const std::string& path, std::string* contents) {
+    std::ifstream file(path.c_str(), std::ios::in | std::ios::binary);
+    if (!file) {
+        return false;
+    }
+    std::stringstream ss;
+    ss << file.rdbuf();
+    *contents = ss.str();
+    return true;
+}
+
+// Replaces every line like
+//   #include "pixel_order.glsl"
+// with the contents of that file, from the shader directory, and adds the file to 'includes'.
+// Included files can't include other files. The #line directives keep the line numbers of the errors
+// right, at least in the including file. Returns false, and prints why, if a file couldn't be read.
+static bool ResolveIncludes(const std::string& directory, const std::string& source, std::string* result,
+    std::vector<std::string>* includes) {
+    result->clear();
+    int lineNumber = 1;
+    size_t begin = 0;
+    while (begin < source.size()) {
+        size_t end = source.find('\n', begin);
+        end = end == std::string::npos ? source.size() : end + 1;
+        std::string line = source.substr(begin, end - begin);
+        if (line.compare(0, 10, "#include \"") == 0) {
+            size_t nameEnd = line.find('"', 10);
+            std::string name = line.substr(10, nameEnd == std::string::npos ? std::string::npos : nameEnd - 10);
+            includes->push_back(name);
+            std::string contents;
+            if (nameEnd == std::string::npos || !ReadFile(directory + "/" + name, &contents)) {
+                printf("Could not include '%s' from %s\n", name.c_str(), directory.c_str());
+                return false;
+            }
+            *result += "#line 1\n" + contents + "\n#line " + std::to_string(lineNumber + 1) + "\n";
+        } else {
+            *result += line;
+        }
+        lineNumber++;
+        begin = end;
+    }
+    return true;
+}
+
+// GLSL wants the #version line before anything else, so the defines go right after it. The #line
+// directive makes the compiler report the line numbers of the file, and not of the modified source.
+static std::string InsertDefines(const std::string& source, const std::string& defines) {
+    if (defines.empty()) {
+        return source;
+    }
+    size_t versionEnd = 0;
+    if (source.compare(0, 8, "#version") == 0) {
+        versionEnd = source.find('\n');
+        versionEnd = versionEnd == std::string::npos ? source.size() : versionEnd + 1;
+    }
+    std::string lineDirective = versionEnd == 0 ? "#line 1\n" : "#line 2\n";
+    return source.substr(0, versionEnd) + defines + lineDirective + source.substr(versionEnd);
+}
+
+// the defines on one line, for messages.
+static std::string DescribeDefines(const std::string& defines) {
+    std::string s = defines;
+    std::replace(s.begin(), s.end(), '\n', ' ');
+    return s.empty() ? s : " (" + s.substr(0, s.size() - 1) + ")";
+}
+
+static long long GetModificationTime(const std::string& path) {
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) {
+        return 0;
+    }
+    return (long long)st.st_mtime;
+}
+
+void ShaderReloader::Init(GLFWwindow* mainWindow, const std::string& directory_) {
+    directory = directory_;
+    stop = false;
+
+    // GLFW can only create windows on the main thread, so we create the context of the
+    // worker here, and make it current on the worker thread later.
+    // It shares all objects with the main context, so the main thread can use the programs
+    // that are linked by the worker.
+    glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+    workerWindow = glfwCreateWindow(1, 1, "shader compiler", NULL, mainWindow);
+    glfwWindowHint(GLFW_VISIBLE, GL_TRUE);
+    if (!workerWindow) {
+        printf("Could not create the context for the shader compiler thread\n");
+        exit(1);
+    }
+    glfwMakeContextCurrent(mainWindow);
+}
+
+// must be called with programsMutex locked.
+void ShaderReloader::WatchFile(const std::string& file) {
+    if (std::find(watchedFiles.begin(), watchedFiles.end(), file) == watchedFiles.end()) {
+        watchedFiles.push_back(file);
+        modificationTimes.push_back(GetModificationTime(directory + "/" + file));
+    }
+}
+
+int ShaderReloader::AddProgram(const std::string& vsFile, const std::string& fsFile, const std::string& defines) {
+    Program p;
+    p.vsFile = vsFile;
+    p.fsFile = fsFile;
+    p.defines = defines;
+
+    int id;
+    {
+        std::lock_guard<std::mutex> lock(programsMutex);
+        programs.push_back(p);
+        id = (int)programs.size() - 1;
+        pending.push_back(id);
+        WatchFile(vsFile);
+        WatchFile(fsFile);
+    }
+    pendingCondition.notify_one();
+
+    return id;
+}
+
+void ShaderReloader::RemoveProgram(int id) {
+    std::lock_guard<std::mutex> lock(programsMutex);
+    programs[id].removed = true;
+    // if the worker is compiling it right now, Update() deletes the result.
+    if (programs[id].program) {
+        glState.DeleteProgram(programs[id].program);
+        programs[id].program = 0;
+    }
+}
+
+void ShaderReloader::Start() {
+#ifdef __linux__
+    inotifyFd = inotify_init1(IN_NONBLOCK);
+    // editors either write the file in place, or write a new file and rename it over the old one.
+    if (inotifyFd < 0 || inotify_add_watch(inotifyFd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE) < 0) {
+        printf("Could not watch %s for changes with inotify, polling instead\n", directory.c_str());
+        if (inotifyFd >= 0) {
+            close(inotifyFd);
+        }
+        inotifyFd = -1;
+    }
+#endif
+    worker = std::thread(&ShaderReloader::WorkerMain, this);
+}
+
+void ShaderReloader::Destroy() {
+    stop = true;
+    pendingCondition.notify_one();
+    if (worker.joinable()) {
+        worker.join();
+    }
+#ifdef __linux__
+    if (inotifyFd >= 0) {
+        close(inotifyFd);
+        inotifyFd = -1;
+    }
+#endif
+    // programs that were linked, but never swapped in.
+    Update();
+    for (Program& p : programs) {
+        if (p.program) {
+            glState.DeleteProgram(p.program);
+            p.program = 0;
+        }
+    }
+    if (workerWindow) {
+        glfwDestroyWindow(workerWindow);
+        workerWindow = NULL;
+    }
+}
+
+bool ShaderReloader::Update() {
+    std::vector<LinkedProgram> newPrograms;
+    {
+        std::lock_guard<std::mutex> lock(linkedMutex);
+        newPrograms.swap(linked);
+    }
+
+    for (const LinkedProgram& l : newPrograms) {
+        if (programs[l.id].removed) {
+            glState.DeleteProgram(l.program);
+            continue;
+        }
+        GLuint old = programs[l.id].program;
+        if (old) {
+            glState.DeleteProgram(old);
+        }
+        programs[l.id].program = l.program;
+    }
+
+    return !newPrograms.empty();
+}
+
+void ShaderReloader::Compile(int id) {
+    // copy what we need, because the main thread may add programs, and move them, while we compile.
+    // Program::program belongs to the main thread, so we leave it alone.
+    Program p;
+    {
+        std::lock_guard<std::mutex> lock(programsMutex);
+        if (programs[id].removed) {
+            return;
+        }
+        p.vsFile = programs[id].vsFile;
+        p.fsFile = programs[id].fsFile;
+        p.defines = programs[id].defines;
+    }
+
+    std::string vsSource, fsSource;
+    if (!ReadFile(directory + "/" + p.vsFile, &vsSource) || !ReadFile(directory + "/" + p.fsFile, &fsSource)) {
+        printf("Could not read %s or %s from %s\n", p.vsFile.c_str(), p.fsFile.c_str(), directory.c_str());
+        return;
+    }
+    std::vector<std::string> includes;
+    std::string vsResolved, fsResolved;
+    bool resolved = ResolveIncludes(directory, vsSource, &vsResolved, &includes) &&
+        ResolveIncludes(directory, fsSource, &fsResolved, &includes);
+    {
+        // watch the included files too, even if one is missing, so that we try again when it appears.
+        std::lock_guard<std::mutex> lock(programsMutex);
+        programs[id].includes = includes;
+        for (const std::string& file : includes) {
+            WatchFile(file);
+        }
+    }
+    if (!resolved) {
+        return;
+    }
+    vsSource = vsResolved;
+    fsSource = fsResolved;
+
+    TraceZone zone("compile " + p.vsFile + DescribeDefines(p.defines));
+    vsSource = InsertDefines(vsSource, p.defines);
+    fsSource = InsertDefines(fsSource, p.defines);
+
+    // the binary cache is keyed by the source, so an edited shader is never loaded from it.
+    std::string key;
+    GLuint program = 0;
+    bool useCache = binaryCache && binaryCache->IsEnabled();
+    if (useCache) {
+        key = binaryCache->GetKey(vsSource, fsSource);
+        program = binaryCache->Load(key);
+    }
+
+    if (program == 0) {
+        std::string log;
+        program = TryLoadNormalShader(vsSource, fsSource, &log, useCache);
+        if (program == 0) {
+            printf("Could not build %s + %s%s, keeping the previous version:\n%s\n", p.vsFile.c_str(), p.fsFile.c_str(),
+                DescribeDefines(p.defines).c_str(), log.c_str());
+            return;
+        }
+        if (useCache) {
+            binaryCache->Store(key, program);
+        }
+    }
+
+    // the program is used from another context, so we must make sure the GPU is completely
+    // done with it, before we hand it over.
+    GL_C(glFinish());
+
+    std::lock_guard<std::mutex> lock(linkedMutex);
+    LinkedProgram l;
+    l.id = id;
+    l.program = program;
+    linked.push_back(l);
+}
+
+// Blocks for a short while, and returns true if any of the watched files changed. Returns false
+// right away when a new program is added, so that it doesn't have to wait.
+bool ShaderReloader::WaitForChanges(std::vector<std::string>* changedFiles) {
+    changedFiles->clear();
+
+    {
+        std::unique_lock<std::mutex> lock(programsMutex);
+        int waitMs = inotifyFd >= 0 ? 100 : 250;
+        if (pendingCondition.wait_for(lock, std::chrono::milliseconds(waitMs), [this] { return !pending.empty() || stop; })) {
+            return false;
+        }
+    }
+
+#ifdef __linux__
+    if (inotifyFd >= 0) {
+        pollfd pfd;
+        pfd.fd = inotifyFd;
+        pfd.events = POLLIN;
+        if (poll(&pfd, 1, 0) <= 0) {
+            return false;
+        }
+
+        // an editor often touches a file several times when it saves it, so wait a little, and
+        // handle all of those events at once.
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+        alignas(inotify_event) char buffer[4096];
+        ssize_t len;
+        while ((len = read(inotifyFd, buffer, sizeof(buffer))) > 0) {
+            for (char* ptr = buffer; ptr < buffer + len; ) {
+                const inotify_event* event = (const inotify_event*)ptr;
+                if (event->len > 0) {
+                    std::string name = event->name;
+                    std::lock_guard<std::mutex> lock(programsMutex);
+                    if (std::find(watchedFiles.begin(), watchedFiles.end(), name) != watchedFiles.end() &&
+                        std::find(changedFiles->begin(), changedFiles->end(), name) == changedFiles->end()) {
+                        changedFiles->push_back(name);
+                    }
+                }
+                ptr += sizeof(inotify_event) + event->len;
+            }
+        }
+        return !changedFiles->empty();
+    }
+#endif
+
+    std::lock_guard<std::mutex> lock(programsMutex);
+    for (size_t i = 0; i < watchedFiles.size(); i++) {
+        long long t = GetModificationTime(directory + "/" + watchedFiles[i]);
+        if (t != modificationTimes[i]) {
+            modificationTimes[i] = t;
+            changedFiles->push_back(watchedFiles[i]);
+        }
+    }
+    return !changedFiles->empty();
+}
+
+void ShaderReloader::WorkerMain() {
+    glfwMakeContextCurrent(workerWindow);
+    trace.SetThreadName("shader compiler");
+
+    std::vector<std::string> changedFiles;
+    while (!stop) {
+        // first the new programs, one at a time, so that a program that is added while we compile
+        // doesn't wait for the others.
+        int id = -1;
+        {
+            std::lock_guard<std::mutex> lock(programsMutex);
+            if (!pending.empty()) {
+                id = pending.front();
+                pending.erase(pending.begin());
+            }
+        }
+        if (id != -1) {
+            Compile(id);
+            continue;
+        }
+
+        if (!WaitForChanges(&changedFiles)) {
+            continue;
+        }
+
+        std::vector<int> changedPrograms;
+        {
+            std::lock_guard<std::mutex> lock(programsMutex);
+            for (int id = 0; id < (int)programs.size(); id++) {
+                const Program& p = programs[id];
+                bool changed = false;
+                for (const std::string& file : changedFiles) {
+                    changed = changed || file == p.vsFile || file == p.fsFile ||
+                        std::find(p.includes.begin(), p.includes.end(), file) != p.includes.end();
+                }
+                if (changed && !p.removed) {
+                    printf("Reloading %s + %s%s\n", p.vsFile.c_str(), p.fsFile.c_str(), DescribeDefines(p.defines).c_str());
+                    changedPrograms.push_back(id);
+                }
+            }
+        }
+        for (int id : changedPrograms) {
+            Compile(id);
+        }
+    }
+
+    glfwMakeContextCurrent(NULL);
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "program_binary_cache.h"
+
+//
+// Loads the shader programs from files, and reloads them whenever a file changes.
+//
+// All the compiling and linking happens on a background thread, that has its own GL context,
+// which shares objects with the context of the main window. So the render loop never waits for
+// the shader compiler, not even for the first frame. Until a program has been linked for the first
+// time, GetProgram() returns 0, and the caller is expected to skip the passes that need it.
+//
+// When a reloaded program fails to compile or link, we print the errors and keep using the old
+// program. A new program is only handed to the main thread once it has successfully linked, and
+// the main thread swaps it in, in Update(), between two frames.
+//
+// On Linux, we are notified of changed files with inotify. Elsewhere, we poll the modification times.
+//
+// Programs can also be added and removed while the demo runs, for the shader permutations that are
+// only compiled when they are first needed, see shader_permutations.h.
+//
+class ShaderReloader {
+public:
+    // 'mainWindow' must be the window whose context is current on the calling thread.
+    void Init(GLFWwindow* mainWindow, const std::string& directory);
+    void Destroy();
+
+    // Add a program made from a vertex and a fragment shader. The file names are relative to the
+    // shader directory. 'defines' is inserted into both shaders, right after the #version line, so
+    // the same files can be built into several variants of a program. The shaders can also
+    // #include "file" other files of the shader directory, and are reloaded when those change.
+    // Returns the id of the program. Can be called at any time, from the main thread. Programs are
+    // compiled in the order they are added.
+    int AddProgram(const std::string& vsFile, const std::string& fsFile, const std::string& defines = "");
+    // Deletes a program, and stops reloading it. The id must not be used anymore.
+    void RemoveProgram(int id);
+
+    // Load and store the linked programs in 'cache'. Must be called before Start().
+    void SetBinaryCache(ProgramBinaryCache* cache) { binaryCache = cache; }
+
+    // Start the background thread. It compiles the programs, and then waits for changes, and for new programs.
+    void Start();
+
+    // Call once a frame, from the main thread. Swaps in the programs that have been linked since
+    // the last call, and deletes the old ones. Returns true if any program changed.
+    bool Update();
+
+    // The latest successfully linked version of a program, or 0 if it hasn't been linked yet.
+    GLuint GetProgram(int id) const { return programs[id].program; }
+
+private:
+    struct Program {
+        std::string vsFile;
+        std::string fsFile;
+        std::string defines;
+        std::vector<std::string> includes; // the files the shaders #include, set by the worker when it compiles them.
+        bool removed = false;
+        GLuint program = 0; // only accessed from the main thread.
+    };
+    struct LinkedProgram {
+        int id;
+        GLuint program;
+    };
+
+    void WorkerMain();
+    void Compile(int id);
+    bool WaitForChanges(std::vector<std::string>* changedFiles);
+    void WatchFile(const std::string& file);
+
+    std::string directory;
+    ProgramBinaryCache* binaryCache = NULL;
+
+    // the main thread adds to 'programs', and the worker reads them, so both lock programsMutex.
+    // But only the main thread touches Program::program, so it doesn't need the lock for that.
+    std::mutex programsMutex;
+    std::vector<Program> programs;
+    std::vector<int> pending; // programs to compile, in order.
+    std::condition_variable pendingCondition; // wakes up the worker when there are new programs.
+
+    GLFWwindow* workerWindow = NULL; // invisible window, only used for its GL context.
+    std::thread worker;
+    std::atomic<bool> stop;
+
+    std::mutex linkedMutex;
+    std::vector<LinkedProgram> linked; // programs the worker has linked, that the main thread hasn't swapped in yet.
+
+    int inotifyFd = -1;
+    std::vector<std::string> watchedFiles; // also protected by programsMutex.
+    std::vector<long long> modificationTimes; // one for every watched file, if we poll.
+};
@@ -0,0 +1,115 @@
+#include "trace.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+
+Trace trace;
+
+// at 60 frames per second, with a dozen zones per frame, that is over 20 minutes.
+static const size_t MAX_EVENTS = 1 << 20;
+
+// the GPU is thread 0, and every CPU thread gets its own number, the first time it records a zone.
+static const int GPU_THREAD = 0;
+static std::atomic<int> threadCount(1);
+
+static int GetThreadId() {
+    static thread_local int id = threadCount++;
+    return id;
+}
+
+void Trace::Start(const std::string& path_) {
+    path = path_;
+    enabled = true;
+    Event gpu = { "GPU", GPU_THREAD, 0.0, 0.0, true };
+    Add(gpu);
+}
+
+double Trace::NowUs() {
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void Trace::AddZone(const std::string& name, double beginUs, double endUs) {
+    Event e = { name, GetThreadId(), beginUs, endUs, false };
+    Add(e);
+}
+
+void Trace::AddGpuZone(const std::string& name, double beginUs, double endUs) {
+    Event e = { name, GPU_THREAD, beginUs, endUs, false };
+    Add(e);
+}
+
+void Trace::SetThreadName(const std::string& name) {
+    Event e = { name, GetThreadId(), 0.0, 0.0, true };
+    Add(e);
+}
+
+void Trace::Add(const Event& event) {
+    if (!enabled) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    if (events.size() >= MAX_EVENTS) {
+        if (!full) {
+            printf("The trace is full, so the rest of the run isn't recorded\n");
+            full = true;
+        }
+        return;
+    }
+    events.push_back(event);
+}
+
+// the names are file and pass names, but a quote would still break the JSON.
+static std::string Escape(const std::string& s) {
+    std::string out;
+    for (char c : s) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+        }
+        out += c;
+    }
+    return out;
+}
+
+bool Trace::Write() {
+    if (!enabled) {
+        return true;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    FILE* f = fopen(path.c_str(), "w");
+    if (!f) {
+        printf("Could not write the trace to %s\n", path.c_str());
+        return false;
+    }
+
+    // the viewer starts at the earliest event anyway, but small numbers are easier to read.
+    double startUs = 0.0;
+    for (const Event& e : events) {
+        if (!e.metadata && (startUs == 0.0 || e.beginUs < startUs)) {
+            startUs = e.beginUs;
+        }
+    }
+
+    fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    for (size_t i = 0; i < events.size(); i++) {
+        const Event& e = events[i];
+        if (e.metadata) {
+            fprintf(f, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                e.thread, Escape(e.name).c_str());
+        } else {
+            fprintf(f, "{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                Escape(e.name).c_str(), e.thread == GPU_THREAD ? "gpu" : "cpu", e.thread, e.beginUs - startUs, e.endUs - e.beginUs);
+        }
+        fprintf(f, i + 1 < events.size() ? ",\n" : "\n");
+    }
+    fprintf(f, "]}\n");
+
+    bool ok = ferror(f) == 0;
+    fclose(f);
+    if (ok) {
+        printf("wrote %d trace events to %s\n", (int)events.size(), path.c_str());
+    } else {
+        printf("Could not write the trace to %s\n", path.c_str());
+    }
+    return ok;
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+//
+// Records a timeline of what the CPU threads and the GPU are doing, and writes it as a Chrome trace:
+// a JSON file that chrome://tracing, or https://ui.perfetto.dev, shows with one row per thread, and
+// one for the GPU. That shows what the timings printed once a second can't: where the GPU sits idle
+// waiting for the CPU, and how far the CPU runs ahead of it.
+//
+// The CPU zones are recorded with TraceZone. The GPU zones come from timestamp queries, see GpuTimer,
+// which converts them to the clock of the CPU before they are added.
+//
+// Nothing is recorded until Start() is called, and then the zones are kept in memory until Write().
+//
+class Trace {
+public:
+    void Start(const std::string& path);
+    bool IsEnabled() const { return enabled; }
+
+    // The clock of the trace, in microseconds.
+    static double NowUs();
+
+    // A zone of the calling thread.
+    void AddZone(const std::string& name, double beginUs, double endUs);
+    // A zone of the GPU, in the clock of the CPU.
+    void AddGpuZone(const std::string& name, double beginUs, double endUs);
+    // The name of the calling thread, in the viewer.
+    void SetThreadName(const std::string& name);
+
+    // Returns false, and prints why, if the file couldn't be written.
+    bool Write();
+
+private:
+    // a "complete" event, with a begin and a duration. Or, if 'metadata' is set, the name of a thread.
+    struct Event {
+        std::string name;
+        int thread;
+        double beginUs;
+        double endUs;
+        bool metadata;
+    };
+    void Add(const Event& event);
+
+    bool enabled = false;
+    std::string path;
+    std::mutex mutex; // the shader compiler thread records zones too.
+    std::vector<Event> events;
+    bool full = false;
+};
+
+extern Trace trace;
+
+// Records the time from its construction to the end of its scope as a zone of the trace. There are
+// zones around every pass of every frame, so when the trace is off, they only cost a branch.
+class TraceZone {
+public:
+    // 'name_' must outlive the zone, like a string literal, or the name of a pass of the render graph.
+    explicit TraceZone(const char* name_) : name(trace.IsEnabled() ? name_ : NULL), beginUs(name ? Trace::NowUs() : 0.0) {}
+    // a name that is built for the zone. It is only copied when the trace is on.
+    explicit TraceZone(const std::string& name_) : TraceZone(name_.c_str()) {
+        if (name) {
+            nameCopy = name_;
+            name = nameCopy.c_str();
+        }
+    }
+    ~TraceZone() {
+        // a zone that began before Start() isn't recorded.
+        if (name && trace.IsEnabled()) {
+            trace.AddZone(name, beginUs, Trace::NowUs());
+        }
+    }
+
+private:
+    const char* name; // NULL when the trace is off.
+    std::string nameCopy;
+    double beginUs;
+};
@@ -0,0 +1,987 @@
+#include "vulkan_renderer.h"
+#include "clock.h"
+
+#define GLFW_INCLUDE_NONE
+#include <GLFW/glfw3.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dlfcn.h>
+#endif
+
+// Vulkan Check Macro. Just like GL_C, terminates the program if the call fails.
+#define VK_C(stmt) do {						\
+	VkResult vkResult = (stmt);				\
+	if (vkResult != VK_SUCCESS) {				\
+	    printf("Vulkan error %d, at %s:%i - for %s.\n", vkResult, __FILE__, __LINE__, #stmt); \
+	    exit(1);						\
+	}							\
+    } while (0)
+
+//
+// We load the Vulkan functions ourselves, from the library, the instance and the device, like glad
+// does for GL. The lists are X macros, so that the declarations and the loading can't get out of sync.
+//
+#define VK_GLOBAL_FUNCTIONS(X) \
+    X(vkCreateInstance) \
+    X(vkEnumerateInstanceExtensionProperties)
+
+#define VK_INSTANCE_FUNCTIONS(X) \
+    X(vkDestroyInstance) \
+    X(vkEnumeratePhysicalDevices) \
+    X(vkGetPhysicalDeviceProperties) \
+    X(vkGetPhysicalDeviceQueueFamilyProperties) \
+    X(vkGetPhysicalDeviceMemoryProperties) \
+    X(vkGetPhysicalDeviceFormatProperties) \
+    X(vkCreateDevice) \
+    X(vkGetDeviceProcAddr) \
+    X(vkDestroySurfaceKHR) \
+    X(vkGetPhysicalDeviceSurfaceSupportKHR) \
+    X(vkGetPhysicalDeviceSurfaceCapabilitiesKHR) \
+    X(vkGetPhysicalDeviceSurfaceFormatsKHR)
+
+#define VK_DEVICE_FUNCTIONS(X) \
+    X(vkDestroyDevice) \
+    X(vkGetDeviceQueue) \
+    X(vkDeviceWaitIdle) \
+    X(vkQueueSubmit) \
+    X(vkQueueWaitIdle) \
+    X(vkCreateImage) \
+    X(vkDestroyImage) \
+    X(vkGetImageMemoryRequirements) \
+    X(vkBindImageMemory) \
+    X(vkCreateImageView) \
+    X(vkDestroyImageView) \
+    X(vkCreateBuffer) \
+    X(vkDestroyBuffer) \
+    X(vkGetBufferMemoryRequirements) \
+    X(vkBindBufferMemory) \
+    X(vkAllocateMemory) \
+    X(vkFreeMemory) \
+    X(vkMapMemory) \
+    X(vkUnmapMemory) \
+    X(vkCreateShaderModule) \
+    X(vkDestroyShaderModule) \
+    X(vkCreateDescriptorSetLayout) \
+    X(vkDestroyDescriptorSetLayout) \
+    X(vkCreatePipelineLayout) \
+    X(vkDestroyPipelineLayout) \
+    X(vkCreateComputePipelines) \
+    X(vkDestroyPipeline) \
+    X(vkCreateDescriptorPool) \
+    X(vkDestroyDescriptorPool) \
+    X(vkAllocateDescriptorSets) \
+    X(vkUpdateDescriptorSets) \
+    X(vkCreateCommandPool) \
+    X(vkDestroyCommandPool) \
+    X(vkAllocateCommandBuffers) \
+    X(vkFreeCommandBuffers) \
+    X(vkBeginCommandBuffer) \
+    X(vkEndCommandBuffer) \
+    X(vkResetCommandBuffer) \
+    X(vkCmdBindPipeline) \
+    X(vkCmdBindDescriptorSets) \
+    X(vkCmdPushConstants) \
+    X(vkCmdDispatch) \
+    X(vkCmdPipelineBarrier) \
+    X(vkCmdBlitImage) \
+    X(vkCmdCopyImageToBuffer) \
+    X(vkCmdResetQueryPool) \
+    X(vkCmdWriteTimestamp) \
+    X(vkCreateQueryPool) \
+    X(vkDestroyQueryPool) \
+    X(vkGetQueryPoolResults) \
+    X(vkCreateFence) \
+    X(vkDestroyFence) \
+    X(vkWaitForFences) \
+    X(vkResetFences) \
+    X(vkCreateSemaphore) \
+    X(vkDestroySemaphore) \
+    X(vkCreateSwapchainKHR) \
+    X(vkDestroySwapchainKHR) \
+    X(vkGetSwapchainImagesKHR) \
+    X(vkAcquireNextImageKHR) \
+    X(vkQueuePresentKHR)
+
+#define VK_DECLARE_FUNCTION(name) static PFN_##name name;
+static PFN_vkGetInstanceProcAddr vkGetInstanceProcAddr;
+VK_GLOBAL_FUNCTIONS(VK_DECLARE_FUNCTION)
+VK_INSTANCE_FUNCTIONS(VK_DECLARE_FUNCTION)
+VK_DEVICE_FUNCTIONS(VK_DECLARE_FUNCTION)
+
+// the uniforms of all the compute shaders. They are small, and change every frame, so we
+// send them as push constants, instead of creating uniform buffers.
+// Must match the push_constant block in the shaders.
+struct PushConstants {
+    int width, height; // the size of the image that is written.
+    int inputWidth, inputHeight; // the size of the image that is read.
+    float centerX, centerY;
+    float juliaCX, juliaCY;
+    float scale;
+    int directionX, directionY; // of the filter pass.
+};
+
+static const int WORKGROUP_SIZE = 8; // local_size_x and local_size_y of the shaders.
+static const VkFormat FRACTAL_FORMAT = VK_FORMAT_R8G8B8A8_UINT; // like GL_RGBA8UI.
+static const VkFormat PRESENT_FORMAT = VK_FORMAT_R8G8B8A8_UNORM;
+
+static const char* PASS_NAMES[] = { "fractal", "box.h", "box.v", "present" };
+
+static void* LoadVulkanLibrary() {
+#if defined(_WIN32)
+    return (void*)LoadLibraryA("vulkan-1.dll");
+#elif defined(__APPLE__)
+    return dlopen("libvulkan.1.dylib", RTLD_NOW | RTLD_LOCAL);
+#else
+    return dlopen("libvulkan.so.1", RTLD_NOW | RTLD_LOCAL);
+#endif
+}
+
+static void* GetLibraryFunction(void* library, const char* name) {
+#ifdef _WIN32
+    return (void*)GetProcAddress((HMODULE)library, name);
+#else
+    return dlsym(library, name);
+#endif
+}
+
+static void CloseVulkanLibrary(void* library) {
+#ifdef _WIN32
+    FreeLibrary((HMODULE)library);
+#else
+    dlclose(library);
+#endif
+}
+
+// A barrier between two passes, for one image. See RecordFrame().
+static VkImageMemoryBarrier ImageBarrier(VkImage image, VkAccessFlags srcAccess, VkAccessFlags dstAccess,
+    VkImageLayout oldLayout, VkImageLayout newLayout) {
+    VkImageMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcAccessMask = srcAccess;
+    barrier.dstAccessMask = dstAccess;
+    barrier.oldLayout = oldLayout;
+    barrier.newLayout = newLayout;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = image;
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.levelCount = 1;
+    barrier.subresourceRange.layerCount = 1;
+    return barrier;
+}
+
+static void PipelineBarrier(VkCommandBuffer cmd, VkPipelineStageFlags srcStage, VkPipelineStageFlags dstStage,
+    const VkImageMemoryBarrier* barriers, int count) {
+    vkCmdPipelineBarrier(cmd, srcStage, dstStage, 0, 0, NULL, 0, NULL, count, barriers);
+}
+
+bool VulkanRenderer::Init(const VulkanRendererConfig& config_) {
+    config = config_;
+
+    library = LoadVulkanLibrary();
+    if (!library) {
+        printf("Could not load the Vulkan library. Is a Vulkan driver installed?\n");
+        return false;
+    }
+    vkGetInstanceProcAddr = (PFN_vkGetInstanceProcAddr)GetLibraryFunction(library, "vkGetInstanceProcAddr");
+    if (!vkGetInstanceProcAddr) {
+        printf("The Vulkan library has no vkGetInstanceProcAddr\n");
+        return false;
+    }
+#define VK_LOAD_GLOBAL_FUNCTION(name) name = (PFN_##name)vkGetInstanceProcAddr(VK_NULL_HANDLE, #name);
+    VK_GLOBAL_FUNCTIONS(VK_LOAD_GLOBAL_FUNCTION)
+    if (!vkCreateInstance) {
+        printf("The Vulkan library has no vkCreateInstance\n");
+        return false;
+    }
+
+    if (!CreateInstance() || !PickDevice()) {
+        return false;
+    }
+
+    // one queue, that does everything: compute, transfers, and presenting.
+    float priority = 1.0f;
+    VkDeviceQueueCreateInfo queueInfo = {};
+    queueInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+    queueInfo.queueFamilyIndex = queueFamily;
+    queueInfo.queueCount = 1;
+    queueInfo.pQueuePriorities = &priority;
+    const char* swapchainExtension = VK_KHR_SWAPCHAIN_EXTENSION_NAME;
+    VkDeviceCreateInfo deviceInfo = {};
+    deviceInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+    deviceInfo.queueCreateInfoCount = 1;
+    deviceInfo.pQueueCreateInfos = &queueInfo;
+    deviceInfo.enabledExtensionCount = config.window ? 1 : 0;
+    deviceInfo.ppEnabledExtensionNames = &swapchainExtension;
+    VK_C(vkCreateDevice(physicalDevice, &deviceInfo, NULL, &device));
+#define VK_LOAD_DEVICE_FUNCTION(name) name = (PFN_##name)vkGetDeviceProcAddr(device, #name);
+    VK_DEVICE_FUNCTIONS(VK_LOAD_DEVICE_FUNCTION)
+    vkGetDeviceQueue(device, queueFamily, 0, &queue);
+
+    if (config.window) {
+        CreateSwapchain();
+    } else {
+        presentWidth = config.width;
+        presentHeight = config.height;
+    }
+    // there is no dynamic resolution in this backend, so we always render at the window resolution.
+    renderWidth = presentWidth;
+    renderHeight = presentHeight;
+
+    if (!LoadShader("fractal.comp", &fractalShader) || !LoadShader("box.comp", &boxShader) ||
+        !LoadShader("present.comp", &presentShader)) {
+        return false;
+    }
+
+    //
+    // The images. They are always in VK_IMAGE_LAYOUT_GENERAL while a shader uses them, because
+    // that is the only layout storage images can be in. Only the presented images move to
+    // another layout, to be copied.
+    //
+    VkImageUsageFlags storage = VK_IMAGE_USAGE_STORAGE_BIT;
+    CreateImage(FRACTAL_FORMAT, renderWidth, renderHeight, storage, &fractalImage);
+    CreateImage(FRACTAL_FORMAT, renderWidth, renderHeight, storage, &tempImage);
+    for (int i = 0; i < config.framesInFlight; i++) {
+        CreateImage(FRACTAL_FORMAT, renderWidth, renderHeight, storage, &blurredImages[i]);
+        CreateImage(PRESENT_FORMAT, presentWidth, presentHeight, storage | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, &presentImages[i]);
+    }
+
+    CreateDescriptors();
+
+    int boxConstants[] = { config.blurRadius };
+    boxPipeline = CreatePipeline(boxShader, boxConstants, 1);
+    presentPipeline = CreatePipeline(presentShader, NULL, 0);
+    SetFractalVariant(config.variant);
+
+    VkCommandPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    poolInfo.queueFamilyIndex = queueFamily;
+    VK_C(vkCreateCommandPool(device, &poolInfo, NULL, &commandPool));
+
+    VkCommandBufferAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.commandPool = commandPool;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandBufferCount = config.framesInFlight;
+    VK_C(vkAllocateCommandBuffers(device, &allocInfo, commandBuffers));
+
+    for (int i = 0; i < config.framesInFlight; i++) {
+        VkFenceCreateInfo fenceInfo = {};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        VK_C(vkCreateFence(device, &fenceInfo, NULL, &fences[i]));
+        VkSemaphoreCreateInfo semaphoreInfo = {};
+        semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+        VK_C(vkCreateSemaphore(device, &semaphoreInfo, NULL, &imageAvailable[i]));
+        VK_C(vkCreateSemaphore(device, &semaphoreInfo, NULL, &renderFinished[i]));
+        submitted[i] = false;
+    }
+
+    if (timestampPeriod > 0.0f) {
+        VkQueryPoolCreateInfo queryInfo = {};
+        queryInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        queryInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        queryInfo.queryCount = MAX_FRAMES_IN_FLIGHT * (PASS_COUNT + 1);
+        VK_C(vkCreateQueryPool(device, &queryInfo, NULL, &queryPool));
+    }
+    for (int pass = 0; pass < PASS_COUNT; pass++) {
+        passMs[pass] = 0.0f;
+    }
+    lastPrintTime = GetSeconds();
+
+    return true;
+}
+
+bool VulkanRenderer::CreateInstance() {
+    std::vector<const char*> extensions;
+    if (config.window) {
+        // the surface extensions of the platform.
+        uint32_t count = 0;
+        const char** glfwExtensions = glfwGetRequiredInstanceExtensions(&count);
+        if (!glfwExtensions) {
+            printf("GLFW can't create Vulkan surfaces on this platform\n");
+            return false;
+        }
+        extensions.assign(glfwExtensions, glfwExtensions + count);
+    }
+
+    VkApplicationInfo appInfo = {};
+    appInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+    appInfo.pApplicationName = "Image Load Store Demo";
+    appInfo.apiVersion = VK_API_VERSION_1_0;
+    VkInstanceCreateInfo instanceInfo = {};
+    instanceInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+    instanceInfo.pApplicationInfo = &appInfo;
+    instanceInfo.enabledExtensionCount = (uint32_t)extensions.size();
+    instanceInfo.ppEnabledExtensionNames = extensions.empty() ? NULL : &extensions[0];
+    VkResult result = vkCreateInstance(&instanceInfo, NULL, &instance);
+    if (result != VK_SUCCESS) {
+        printf("Could not create a Vulkan instance (error %d)\n", result);
+        return false;
+    }
+#define VK_LOAD_INSTANCE_FUNCTION(name) name = (PFN_##name)vkGetInstanceProcAddr(instance, #name);
+    VK_INSTANCE_FUNCTIONS(VK_LOAD_INSTANCE_FUNCTION)
+
+    if (config.window) {
+        VK_C(glfwCreateWindowSurface(instance, config.window, NULL, &surface));
+    }
+    return true;
+}
+
+// The first device with a queue that can do compute, and present to the window, if we have one.
+bool VulkanRenderer::PickDevice() {
+    uint32_t deviceCount = 0;
+    VK_C(vkEnumeratePhysicalDevices(instance, &deviceCount, NULL));
+    std::vector<VkPhysicalDevice> devices(deviceCount);
+    if (deviceCount > 0) {
+        VK_C(vkEnumeratePhysicalDevices(instance, &deviceCount, &devices[0]));
+    }
+
+    for (VkPhysicalDevice d : devices) {
+        uint32_t familyCount = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(d, &familyCount, NULL);
+        std::vector<VkQueueFamilyProperties> families(familyCount);
+        if (familyCount > 0) {
+            vkGetPhysicalDeviceQueueFamilyProperties(d, &familyCount, &families[0]);
+        }
+
+        for (uint32_t f = 0; f < familyCount; f++) {
+            if (!(families[f].queueFlags & VK_QUEUE_COMPUTE_BIT)) {
+                continue;
+            }
+            VkBool32 canPresent = VK_TRUE;
+            if (surface) {
+                VK_C(vkGetPhysicalDeviceSurfaceSupportKHR(d, f, surface, &canPresent));
+            }
+            if (!canPresent) {
+                continue;
+            }
+
+            physicalDevice = d;
+            queueFamily = f;
+            VkPhysicalDeviceProperties properties;
+            vkGetPhysicalDeviceProperties(d, &properties);
+            vkGetPhysicalDeviceMemoryProperties(d, &memoryProperties);
+            timestampPeriod = families[f].timestampValidBits > 0 ? properties.limits.timestampPeriod : 0.0f;
+            printf("rendering with Vulkan on %s\n", properties.deviceName);
+            return true;
+        }
+    }
+    printf("Found no Vulkan device with a compute queue%s\n", surface ? " that can present to the window" : "");
+    return false;
+}
+
+void VulkanRenderer::CreateSwapchain() {
+    VkSurfaceCapabilitiesKHR caps;
+    VK_C(vkGetPhysicalDeviceSurfaceCapabilitiesKHR(physicalDevice, surface, &caps));
+    // we copy the presented image into the swapchain images.
+    if (!(caps.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT)) {
+        printf("The swapchain images can't be copied to\n");
+        exit(1);
+    }
+
+    uint32_t formatCount = 0;
+    VK_C(vkGetPhysicalDeviceSurfaceFormatsKHR(physicalDevice, surface, &formatCount, NULL));
+    if (formatCount == 0) {
+        printf("The window has no surface formats\n");
+        exit(1);
+    }
+    std::vector<VkSurfaceFormatKHR> formats(formatCount);
+    VK_C(vkGetPhysicalDeviceSurfaceFormatsKHR(physicalDevice, surface, &formatCount, &formats[0]));
+    // the GL version doesn't do any sRGB conversion, so for the same colors we want a UNORM format.
+    VkSurfaceFormatKHR format = formats[0];
+    for (const VkSurfaceFormatKHR& f : formats) {
+        if (f.format == VK_FORMAT_B8G8R8A8_UNORM || f.format == VK_FORMAT_R8G8B8A8_UNORM) {
+            format = f;
+            break;
+        }
+    }
+    if (format.format == VK_FORMAT_UNDEFINED) {
+        format.format = VK_FORMAT_B8G8R8A8_UNORM; // the surface takes any format.
+    }
+
+    if (caps.currentExtent.width != 0xFFFFFFFF) {
+        presentWidth = (int)caps.currentExtent.width;
+        presentHeight = (int)caps.currentExtent.height;
+    } else {
+        glfwGetFramebufferSize(config.window, &presentWidth, &presentHeight);
+    }
+
+    VkSwapchainCreateInfoKHR swapchainInfo = {};
+    swapchainInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
+    swapchainInfo.surface = surface;
+    swapchainInfo.minImageCount = caps.minImageCount + 1;
+    if (caps.maxImageCount != 0 && swapchainInfo.minImageCount > caps.maxImageCount) {
+        swapchainInfo.minImageCount = caps.maxImageCount;
+    }
+    swapchainInfo.imageFormat = format.format;
+    swapchainInfo.imageColorSpace = format.colorSpace;
+    swapchainInfo.imageExtent.width = (uint32_t)presentWidth;
+    swapchainInfo.imageExtent.height = (uint32_t)presentHeight;
+    swapchainInfo.imageArrayLayers = 1;
+    swapchainInfo.imageUsage = VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    swapchainInfo.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    swapchainInfo.preTransform = caps.currentTransform;
+    swapchainInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
+    swapchainInfo.presentMode = VK_PRESENT_MODE_FIFO_KHR; // vsync, like glfwSwapBuffers(). Always supported.
+    swapchainInfo.clipped = VK_TRUE;
+    VK_C(vkCreateSwapchainKHR(device, &swapchainInfo, NULL, &swapchain));
+
+    swapchainImageCount = 0;
+    VK_C(vkGetSwapchainImagesKHR(device, swapchain, &swapchainImageCount, NULL));
+    if (swapchainImageCount > sizeof(swapchainImages) / sizeof(swapchainImages[0])) {
+        printf("The swapchain has too many images: %u\n", swapchainImageCount);
+        exit(1);
+    }
+    VK_C(vkGetSwapchainImagesKHR(device, swapchain, &swapchainImageCount, swapchainImages));
+}
+
+uint32_t VulkanRenderer::FindMemoryType(uint32_t typeBits, VkMemoryPropertyFlags properties) const {
+    for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+        if ((typeBits & (1u << i)) && (memoryProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+            return i;
+        }
+    }
+    printf("Found no Vulkan memory type with properties %x\n", properties);
+    exit(1);
+}
+
+// Every image gets its own allocation. There are only a handful of them, and they live as long as the renderer.
+void VulkanRenderer::CreateImage(VkFormat format, int w, int h, VkImageUsageFlags usage, Image* image) {
+    VkImageCreateInfo imageInfo = {};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.format = format;
+    imageInfo.extent.width = (uint32_t)w;
+    imageInfo.extent.height = (uint32_t)h;
+    imageInfo.extent.depth = 1;
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = 1;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.usage = usage;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    VK_C(vkCreateImage(device, &imageInfo, NULL, &image->image));
+
+    VkMemoryRequirements requirements;
+    vkGetImageMemoryRequirements(device, image->image, &requirements);
+    VkMemoryAllocateInfo memoryInfo = {};
+    memoryInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    memoryInfo.allocationSize = requirements.size;
+    memoryInfo.memoryTypeIndex = FindMemoryType(requirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    VK_C(vkAllocateMemory(device, &memoryInfo, NULL, &image->memory));
+    VK_C(vkBindImageMemory(device, image->image, image->memory, 0));
+
+    VkImageViewCreateInfo viewInfo = {};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = image->image;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = format;
+    viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    viewInfo.subresourceRange.levelCount = 1;
+    viewInfo.subresourceRange.layerCount = 1;
+    VK_C(vkCreateImageView(device, &viewInfo, NULL, &image->view));
+}
+
+void VulkanRenderer::DestroyImage(Image* image) {
+    vkDestroyImageView(device, image->view, NULL);
+    vkDestroyImage(device, image->image, NULL);
+    vkFreeMemory(device, image->memory, NULL);
+    *image = Image();
+}
+
+// The shaders are compiled to SPIR-V when the demo is built, see CMakeLists.txt. So unlike the
+// GL shaders, they can't be edited while the demo runs.
+bool VulkanRenderer::LoadShader(const std::string& name, VkShaderModule* module) {
+    std::string path = config.spirvDirectory + "/" + name + ".spv";
+    std::ifstream file(path.c_str(), std::ios::in | std::ios::binary);
+    std::vector<char> code((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    if (!file || code.empty() || code.size() % 4 != 0) {
+        printf("Could not read the SPIR-V shader %s. Was the demo built with glslangValidator?\n", path.c_str());
+        return false;
+    }
+
+    VkShaderModuleCreateInfo moduleInfo = {};
+    moduleInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    moduleInfo.codeSize = code.size();
+    moduleInfo.pCode = (const uint32_t*)&code[0];
+    VK_C(vkCreateShaderModule(device, &moduleInfo, NULL, module));
+    return true;
+}
+
+// 'constants' are the values of the specialization constants with constant_id 0, 1, 2 and so on.
+VkPipeline VulkanRenderer::CreatePipeline(VkShaderModule module, const int* constants, int constantCount) {
+    std::vector<VkSpecializationMapEntry> entries(constantCount);
+    for (int i = 0; i < constantCount; i++) {
+        entries[i].constantID = (uint32_t)i;
+        entries[i].offset = (uint32_t)(i * sizeof(int));
+        entries[i].size = sizeof(int);
+    }
+    VkSpecializationInfo specialization = {};
+    specialization.mapEntryCount = (uint32_t)constantCount;
+    specialization.pMapEntries = constantCount > 0 ? &entries[0] : NULL;
+    specialization.dataSize = constantCount * sizeof(int);
+    specialization.pData = constants;
+
+    VkComputePipelineCreateInfo pipelineInfo = {};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineInfo.stage.module = module;
+    pipelineInfo.stage.pName = "main";
+    pipelineInfo.stage.pSpecializationInfo = &specialization;
+    pipelineInfo.layout = pipelineLayout;
+    VkPipeline pipeline;
+    VK_C(vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, NULL, &pipeline));
+    return pipeline;
+}
+
+//
+// All the passes read one image, at binding 0, and write one, at binding 1. So they share one
+// layout, and every pass gets a descriptor set with its two images. The sets of the passes that
+// use the ring are duplicated for every slot.
+//
+void VulkanRenderer::CreateDescriptors() {
+    VkDescriptorSetLayoutBinding bindings[2] = {};
+    for (int i = 0; i < 2; i++) {
+        bindings[i].binding = (uint32_t)i;
+        bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+        bindings[i].descriptorCount = 1;
+        bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+    VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = 2;
+    layoutInfo.pBindings = bindings;
+    VK_C(vkCreateDescriptorSetLayout(device, &layoutInfo, NULL, &descriptorSetLayout));
+
+    VkPushConstantRange pushRange = {};
+    pushRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushRange.size = sizeof(PushConstants);
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushRange;
+    VK_C(vkCreatePipelineLayout(device, &pipelineLayoutInfo, NULL, &pipelineLayout));
+
+    int setCount = 2 + 2 * MAX_FRAMES_IN_FLIGHT;
+    VkDescriptorPoolSize poolSize = {};
+    poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    poolSize.descriptorCount = 2 * setCount;
+    VkDescriptorPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.maxSets = setCount;
+    poolInfo.poolSizeCount = 1;
+    poolInfo.pPoolSizes = &poolSize;
+    VK_C(vkCreateDescriptorPool(device, &poolInfo, NULL, &descriptorPool));
+
+    // the fractal pass doesn't read anything, but the binding must still be valid.
+    fractalSet = CreateDescriptorSet(fractalImage.view, fractalImage.view);
+    boxHSet = CreateDescriptorSet(fractalImage.view, tempImage.view);
+    for (int i = 0; i < config.framesInFlight; i++) {
+        boxVSets[i] = CreateDescriptorSet(tempImage.view, blurredImages[i].view);
+        presentSets[i] = CreateDescriptorSet(blurredImages[i].view, presentImages[i].view);
+    }
+}
+
+VkDescriptorSet VulkanRenderer::CreateDescriptorSet(VkImageView input, VkImageView output) {
+    VkDescriptorSetAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = descriptorPool;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &descriptorSetLayout;
+    VkDescriptorSet set;
+    VK_C(vkAllocateDescriptorSets(device, &allocInfo, &set));
+
+    VkDescriptorImageInfo imageInfos[2] = {};
+    imageInfos[0].imageView = input;
+    imageInfos[0].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+    imageInfos[1].imageView = output;
+    imageInfos[1].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+    VkWriteDescriptorSet writes[2] = {};
+    for (int i = 0; i < 2; i++) {
+        writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writes[i].dstSet = set;
+        writes[i].dstBinding = (uint32_t)i;
+        writes[i].descriptorCount = 1;
+        writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+        writes[i].pImageInfo = &imageInfos[i];
+    }
+    vkUpdateDescriptorSets(device, 2, writes, 0, NULL);
+    return set;
+}
+
+void VulkanRenderer::SetFractalVariant(const FractalVariant& variant) {
+    if (fractalPipeline && variant == pipelineVariant) {
+        return;
+    }
+    // the old pipeline may still be used by the frames in flight.
+    if (fractalPipeline) {
+        VK_C(vkDeviceWaitIdle(device));
+        vkDestroyPipeline(device, fractalPipeline, NULL);
+    }
+    int constants[] = { (int)variant.formula, variant.power, variant.iterations };
+    fractalPipeline = CreatePipeline(fractalShader, constants, 3);
+    pipelineVariant = variant;
+}
+
+//
+// The commands of one frame. The fractal and the filters run at the render resolution, in workgroups
+// of 8x8 pixels, and the present pass at the window resolution.
+//
+// Between the passes, a barrier makes the writes of one pass visible to the reads of the next.
+// Without them, the next dispatch could start while the previous one is still running, and
+// read pixels that haven't been written yet.
+//
+void VulkanRenderer::RecordFrame(VkCommandBuffer cmd, const View& view, uint32_t swapchainIndex) {
+    const VkPipelineStageFlags COMPUTE = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    const VkPipelineStageFlags TRANSFER = VK_PIPELINE_STAGE_TRANSFER_BIT;
+    uint32_t firstQuery = (uint32_t)(slot * (PASS_COUNT + 1));
+
+    VkCommandBufferBeginInfo beginInfo = {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    VK_C(vkBeginCommandBuffer(cmd, &beginInfo));
+    if (queryPool) {
+        vkCmdResetQueryPool(cmd, queryPool, firstQuery, PASS_COUNT + 1);
+        vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, firstQuery);
+    }
+
+    PushConstants pc = {};
+    pc.width = renderWidth;
+    pc.height = renderHeight;
+    pc.inputWidth = renderWidth;
+    pc.inputHeight = renderHeight;
+    pc.centerX = view.centerX;
+    pc.centerY = view.centerY;
+    pc.juliaCX = JULIA_C_X;
+    pc.juliaCY = JULIA_C_Y;
+    pc.scale = view.scale;
+    uint32_t groupsX = (uint32_t)((renderWidth + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE);
+    uint32_t groupsY = (uint32_t)((renderHeight + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE);
+
+    // The images that are only used within a frame, were read by the previous frame, which may still
+    // be running. Waiting for those reads is enough; there are no writes to make visible, and we
+    // overwrite all of the old contents, so the old layout doesn't matter either.
+    VkImageMemoryBarrier barriers[2];
+    barriers[0] = ImageBarrier(fractalImage.image, 0, VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+    barriers[1] = ImageBarrier(tempImage.image, 0, VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+    PipelineBarrier(cmd, COMPUTE, COMPUTE, barriers, 2);
+
+    // Pass 1: the fractal.
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, fractalPipeline);
+    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &fractalSet, 0, NULL);
+    vkCmdPushConstants(cmd, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pc), &pc);
+    vkCmdDispatch(cmd, groupsX, groupsY, 1);
+    if (queryPool) {
+        vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, firstQuery + 1);
+    }
+
+    // Pass 2: the box filter, horizontally into the temporary image, and then vertically into the ring.
+    // The ring image was last read by the present pass of the frame that used this slot before, and
+    // we waited on its fence, so it only needs a layout.
+    barriers[0] = ImageBarrier(fractalImage.image, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_GENERAL);
+    PipelineBarrier(cmd, COMPUTE, COMPUTE, barriers, 1);
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, boxPipeline);
+    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &boxHSet, 0, NULL);
+    pc.directionX = 1;
+    pc.directionY = 0;
+    vkCmdPushConstants(cmd, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pc), &pc);
+    vkCmdDispatch(cmd, groupsX, groupsY, 1);
+    if (queryPool) {
+        vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, firstQuery + 2);
+    }
+
+    barriers[0] = ImageBarrier(tempImage.image, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_GENERAL);
+    barriers[1] = ImageBarrier(blurredImages[slot].image, 0, VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+    PipelineBarrier(cmd, COMPUTE, COMPUTE, barriers, 2);
+    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &boxVSets[slot], 0, NULL);
+    pc.directionX = 0;
+    pc.directionY = 1;
+    vkCmdPushConstants(cmd, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pc), &pc);
+    vkCmdDispatch(cmd, groupsX, groupsY, 1);
+    if (queryPool) {
+        vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, firstQuery + 3);
+    }
+
+    // Pass 3: upscale to the window, into the presented image of this slot.
+    barriers[0] = ImageBarrier(blurredImages[slot].image, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_GENERAL);
+    barriers[1] = ImageBarrier(presentImages[slot].image, 0, VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+    PipelineBarrier(cmd, COMPUTE, COMPUTE, barriers, 2);
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, presentPipeline);
+    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &presentSets[slot], 0, NULL);
+    pc.width = presentWidth;
+    pc.height = presentHeight;
+    vkCmdPushConstants(cmd, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pc), &pc);
+    vkCmdDispatch(cmd, (uint32_t)((presentWidth + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE),
+        (uint32_t)((presentHeight + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE), 1);
+
+    // the presented image stays in the transfer layout, so that ReadLastFrame() can copy it.
+    barriers[0] = ImageBarrier(presentImages[slot].image, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+        VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+    PipelineBarrier(cmd, COMPUTE, TRANSFER, barriers, 1);
+
+    if (swapchain) {
+        // the swapchain image is ours once the imageAvailable semaphore is signaled, and the
+        // submit waits for that at the transfer stage.
+        VkImage target = swapchainImages[swapchainIndex];
+        barriers[0] = ImageBarrier(target, 0, VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+        PipelineBarrier(cmd, TRANSFER, TRANSFER, barriers, 1);
+
+        // a blit, and not a copy, because the swapchain usually has a BGRA format. It also flips
+        // the image, because y = 0 is at the bottom in our images, and at the top in Vulkan.
+        VkImageBlit blit = {};
+        blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        blit.srcSubresource.layerCount = 1;
+        blit.srcOffsets[1].x = presentWidth;
+        blit.srcOffsets[1].y = presentHeight;
+        blit.srcOffsets[1].z = 1;
+        blit.dstSubresource = blit.srcSubresource;
+        blit.dstOffsets[0].y = presentHeight;
+        blit.dstOffsets[1].x = presentWidth;
+        blit.dstOffsets[1].y = 0;
+        blit.dstOffsets[1].z = 1;
+        vkCmdBlitImage(cmd, presentImages[slot].image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            target, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_NEAREST);
+
+        barriers[0] = ImageBarrier(target, VK_ACCESS_TRANSFER_WRITE_BIT, 0, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+        PipelineBarrier(cmd, TRANSFER, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, barriers, 1);
+    }
+    if (queryPool) {
+        vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, firstQuery + 4);
+    }
+
+    VK_C(vkEndCommandBuffer(cmd));
+}
+
+// The timestamps of the frame that last used this slot. We just waited on its fence, so they
+// are available, and reading them doesn't stall.
+void VulkanRenderer::ReadTimestamps() {
+    if (!queryPool || !submitted[slot]) {
+        return;
+    }
+    uint64_t timestamps[PASS_COUNT + 1];
+    VK_C(vkGetQueryPoolResults(device, queryPool, (uint32_t)(slot * (PASS_COUNT + 1)), PASS_COUNT + 1,
+        sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT));
+    for (int pass = 0; pass < PASS_COUNT; pass++) {
+        passMs[pass] = (float)((double)(timestamps[pass + 1] - timestamps[pass]) * timestampPeriod * 1e-6);
+    }
+}
+
+bool VulkanRenderer::RenderFrame(const FrameParams& params) {
+    SetFractalVariant(params.variant);
+
+    // wait until the GPU is done with the slot we are about to reuse. Normally it finished long
+    // ago, so this doesn't wait at all.
+    if (submitted[slot]) {
+        double start = GetSeconds();
+        VK_C(vkWaitForFences(device, 1, &fences[slot], VK_TRUE, UINT64_MAX));
+        waitMs += (GetSeconds() - start) * 1000.0;
+        VK_C(vkResetFences(device, 1, &fences[slot]));
+        ReadTimestamps();
+    }
+
+    uint32_t swapchainIndex = 0;
+    if (swapchain) {
+        VkResult result = vkAcquireNextImageKHR(device, swapchain, UINT64_MAX, imageAvailable[slot], VK_NULL_HANDLE, &swapchainIndex);
+        // the window can't be resized, so an out of date swapchain is still good enough to present.
+        if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
+            VK_C(result);
+        }
+    }
+
+    VkCommandBuffer cmd = commandBuffers[slot];
+    VK_C(vkResetCommandBuffer(cmd, 0));
+    RecordFrame(cmd, params.view, swapchainIndex);
+
+    VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+    VkSubmitInfo submitInfo = {};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.waitSemaphoreCount = swapchain ? 1 : 0;
+    submitInfo.pWaitSemaphores = &imageAvailable[slot];
+    submitInfo.pWaitDstStageMask = &waitStage;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &cmd;
+    submitInfo.signalSemaphoreCount = swapchain ? 1 : 0;
+    submitInfo.pSignalSemaphores = &renderFinished[slot];
+    VK_C(vkQueueSubmit(queue, 1, &submitInfo, fences[slot]));
+    submitted[slot] = true;
+
+    if (swapchain) {
+        VkPresentInfoKHR presentInfo = {};
+        presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+        presentInfo.waitSemaphoreCount = 1;
+        presentInfo.pWaitSemaphores = &renderFinished[slot];
+        presentInfo.swapchainCount = 1;
+        presentInfo.pSwapchains = &swapchain;
+        presentInfo.pImageIndices = &swapchainIndex;
+        VkResult result = vkQueuePresentKHR(queue, &presentInfo);
+        if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR && result != VK_ERROR_OUT_OF_DATE_KHR) {
+            VK_C(result);
+        }
+    }
+
+    lastSlot = slot;
+    slot = (slot + 1) % config.framesInFlight;
+
+    // the timings, once a second, like the GL version.
+    double now = GetSeconds();
+    if (now - lastPrintTime >= 1.0) {
+        if (queryPool) {
+            float totalMs = 0.0f;
+            for (int pass = 0; pass < PASS_COUNT; pass++) {
+                totalMs += passMs[pass];
+            }
+            printf("vulkan gpu %.2f ms (", totalMs);
+            for (int pass = 0; pass < PASS_COUNT; pass++) {
+                printf("%s%s %.2f", pass == 0 ? "" : ", ", PASS_NAMES[pass], passMs[pass]);
+            }
+            printf("), ");
+        } else {
+            printf("vulkan, ");
+        }
+        printf("render resolution %dx%d, cpu waited %.2f ms for %d frames in flight\n",
+            renderWidth, renderHeight, waitMs, config.framesInFlight);
+        waitMs = 0.0;
+        lastPrintTime = now;
+    }
+    return true;
+}
+
+bool VulkanRenderer::ReadLastFrame(CpuImage* image) {
+    if (lastSlot < 0) {
+        return false;
+    }
+    VK_C(vkDeviceWaitIdle(device));
+
+    // a buffer the CPU can read, that the image is copied to.
+    VkDeviceSize size = (VkDeviceSize)presentWidth * presentHeight * 4;
+    VkBufferCreateInfo bufferInfo = {};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = size;
+    bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    VkBuffer buffer;
+    VK_C(vkCreateBuffer(device, &bufferInfo, NULL, &buffer));
+    VkMemoryRequirements requirements;
+    vkGetBufferMemoryRequirements(device, buffer, &requirements);
+    VkMemoryAllocateInfo memoryInfo = {};
+    memoryInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    memoryInfo.allocationSize = requirements.size;
+    memoryInfo.memoryTypeIndex = FindMemoryType(requirements.memoryTypeBits,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    VkDeviceMemory memory;
+    VK_C(vkAllocateMemory(device, &memoryInfo, NULL, &memory));
+    VK_C(vkBindBufferMemory(device, buffer, memory, 0));
+
+    VkCommandBufferAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.commandPool = commandPool;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandBufferCount = 1;
+    VkCommandBuffer cmd;
+    VK_C(vkAllocateCommandBuffers(device, &allocInfo, &cmd));
+    VkCommandBufferBeginInfo beginInfo = {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    VK_C(vkBeginCommandBuffer(cmd, &beginInfo));
+    VkBufferImageCopy region = {};
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.layerCount = 1;
+    region.imageExtent.width = (uint32_t)presentWidth;
+    region.imageExtent.height = (uint32_t)presentHeight;
+    region.imageExtent.depth = 1;
+    vkCmdCopyImageToBuffer(cmd, presentImages[lastSlot].image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, buffer, 1, &region);
+    VK_C(vkEndCommandBuffer(cmd));
+
+    VkSubmitInfo submitInfo = {};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &cmd;
+    VK_C(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+    VK_C(vkQueueWaitIdle(queue));
+
+    // the rows are in the same order as in CpuImage, with y = 0 first.
+    void* data;
+    VK_C(vkMapMemory(device, memory, 0, size, 0, &data));
+    image->Resize(presentWidth, presentHeight);
+    memcpy(&image->pixels[0], data, (size_t)size);
+    vkUnmapMemory(device, memory);
+
+    vkFreeCommandBuffers(device, commandPool, 1, &cmd);
+    vkDestroyBuffer(device, buffer, NULL);
+    vkFreeMemory(device, memory, NULL);
+    return true;
+}
+
+void VulkanRenderer::Destroy() {
+    if (device) {
+        VK_C(vkDeviceWaitIdle(device));
+
+        if (queryPool) {
+            vkDestroyQueryPool(device, queryPool, NULL);
+        }
+        if (commandPool) {
+            for (int i = 0; i < config.framesInFlight; i++) {
+                vkDestroyFence(device, fences[i], NULL);
+                vkDestroySemaphore(device, imageAvailable[i], NULL);
+                vkDestroySemaphore(device, renderFinished[i], NULL);
+            }
+            vkDestroyCommandPool(device, commandPool, NULL);
+        }
+
+        VkPipeline pipelines[] = { fractalPipeline, boxPipeline, presentPipeline };
+        for (VkPipeline pipeline : pipelines) {
+            if (pipeline) {
+                vkDestroyPipeline(device, pipeline, NULL);
+            }
+        }
+        VkShaderModule modules[] = { fractalShader, boxShader, presentShader };
+        for (VkShaderModule module : modules) {
+            if (module) {
+                vkDestroyShaderModule(device, module, NULL);
+            }
+        }
+        if (descriptorPool) {
+            vkDestroyDescriptorPool(device, descriptorPool, NULL);
+            vkDestroyPipelineLayout(device, pipelineLayout, NULL);
+            vkDestroyDescriptorSetLayout(device, descriptorSetLayout, NULL);
+        }
+
+        if (fractalImage.image) {
+            DestroyImage(&fractalImage);
+            DestroyImage(&tempImage);
+            for (int i = 0; i < config.framesInFlight; i++) {
+                DestroyImage(&blurredImages[i]);
+                DestroyImage(&presentImages[i]);
+            }
+        }
+        if (swapchain) {
+            vkDestroySwapchainKHR(device, swapchain, NULL);
+        }
+        vkDestroyDevice(device, NULL);
+        device = VK_NULL_HANDLE;
+    }
+    if (instance) {
+        if (surface) {
+            vkDestroySurfaceKHR(instance, surface, NULL);
+        }
+        vkDestroyInstance(instance, NULL);
+        instance = VK_NULL_HANDLE;
+    }
+    if (library) {
+        CloseVulkanLibrary(library);
+        library = NULL;
+    }
+}
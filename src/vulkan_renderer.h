@@ -0,0 +1,143 @@
+#pragma once
+
+#define VK_NO_PROTOTYPES
+#include <vulkan/vulkan.h>
+
+#include <string>
+
+#include "renderer.h"
+#include "fractal_variant.h"
+
+struct GLFWwindow;
+
+struct VulkanRendererConfig {
+    // must have been created with GLFW_NO_API. If it is NULL, we render offscreen, at width x height,
+    // and the frames can only be seen with ReadLastFrame(). That needs no display, and no GPU either,
+    // with a software driver like Mesa's lavapipe.
+    GLFWwindow* window = NULL;
+    int width = 0;
+    int height = 0;
+    int framesInFlight = 2;
+    std::string spirvDirectory; // where the compiled compute shaders are, see shaders/vulkan.
+    FractalVariant variant;
+    int blurRadius = 8; // the radius of the box filter, the only filter we have.
+};
+
+//
+// The passes of the demo, written with Vulkan compute shaders instead of GL image load/store:
+// the fractal, the two passes of the box filter, and a present pass that upscales the result to
+// the window, and converts it to a format that can be copied to the swapchain.
+//
+// With Vulkan, nothing synchronizes the passes for us, so every dispatch is followed by an
+// explicit vkCmdPipelineBarrier(), that makes the images it wrote visible to the next one, and moves
+// them to the layout the next one needs. That is what glMemoryBarrier() and the render graph do in the
+// GL version.
+//
+// The images that a frame still needs after it has been submitted, the filtered fractal and the
+// presented image, form a ring with one copy per frame in flight, like the frame textures of the
+// GL version. Every frame has its own command buffer and fence, and we wait on the fence of a
+// frame before we record into its slot again. The fractal, and the image between the two filter
+// passes, are only used within a frame, so one copy is enough: the barrier at the start of the
+// next frame makes sure it isn't overwritten before the previous frame is done with it.
+//
+// The Vulkan library is loaded at runtime, so the demo still starts without it.
+//
+class VulkanRenderer : public Renderer {
+public:
+    static const int MAX_FRAMES_IN_FLIGHT = 3;
+
+    // Returns false, and prints why, if there is no Vulkan driver, no device that can run the
+    // demo, or the compiled shaders are missing.
+    bool Init(const VulkanRendererConfig& config);
+
+    // Rebuilds the fractal pipeline if the variant changed. Waits for the GPU when it does.
+    // RenderFrame() calls it with the variant of the frame, so it never renders an old one.
+    void SetFractalVariant(const FractalVariant& variant);
+
+    const char* GetName() const override { return "Vulkan"; }
+    bool RenderFrame(const FrameParams& params) override;
+    const FractalVariant& GetRenderedVariant() const override { return pipelineVariant; }
+    bool ReadLastFrame(CpuImage* image) override;
+    void Destroy() override;
+
+private:
+    struct Image {
+        VkImage image = VK_NULL_HANDLE;
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VkImageView view = VK_NULL_HANDLE;
+    };
+    enum Pass {
+        PASS_FRACTAL,
+        PASS_BOX_H,
+        PASS_BOX_V,
+        PASS_PRESENT,
+        PASS_COUNT
+    };
+
+    bool CreateInstance();
+    bool PickDevice();
+    void CreateSwapchain();
+    void CreateImage(VkFormat format, int w, int h, VkImageUsageFlags usage, Image* image);
+    void DestroyImage(Image* image);
+    uint32_t FindMemoryType(uint32_t typeBits, VkMemoryPropertyFlags properties) const;
+    bool LoadShader(const std::string& name, VkShaderModule* module);
+    VkPipeline CreatePipeline(VkShaderModule module, const int* constants, int constantCount);
+    void CreateDescriptors();
+    VkDescriptorSet CreateDescriptorSet(VkImageView input, VkImageView output);
+    void RecordFrame(VkCommandBuffer cmd, const View& view, uint32_t swapchainIndex);
+    void ReadTimestamps();
+
+    VulkanRendererConfig config;
+    void* library = NULL;
+
+    VkInstance instance = VK_NULL_HANDLE;
+    VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+    VkPhysicalDeviceMemoryProperties memoryProperties;
+    VkDevice device = VK_NULL_HANDLE;
+    uint32_t queueFamily = 0;
+    VkQueue queue = VK_NULL_HANDLE;
+    float timestampPeriod = 0.0f; // nanoseconds per tick. 0 if the queue can't do timestamps.
+
+    VkSurfaceKHR surface = VK_NULL_HANDLE;
+    VkSwapchainKHR swapchain = VK_NULL_HANDLE;
+    VkImage swapchainImages[8];
+    uint32_t swapchainImageCount = 0;
+    int presentWidth = 0, presentHeight = 0; // the window resolution.
+    int renderWidth = 0, renderHeight = 0; // the resolution of the fractal and the filters.
+
+    Image fractalImage;
+    Image tempImage; // between the horizontal and the vertical filter pass.
+    Image blurredImages[MAX_FRAMES_IN_FLIGHT];
+    Image presentImages[MAX_FRAMES_IN_FLIGHT];
+
+    VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+    VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+    VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+    VkDescriptorSet fractalSet = VK_NULL_HANDLE;
+    VkDescriptorSet boxHSet = VK_NULL_HANDLE;
+    VkDescriptorSet boxVSets[MAX_FRAMES_IN_FLIGHT];
+    VkDescriptorSet presentSets[MAX_FRAMES_IN_FLIGHT];
+
+    VkShaderModule fractalShader = VK_NULL_HANDLE;
+    VkShaderModule boxShader = VK_NULL_HANDLE;
+    VkShaderModule presentShader = VK_NULL_HANDLE;
+    VkPipeline fractalPipeline = VK_NULL_HANDLE;
+    VkPipeline boxPipeline = VK_NULL_HANDLE;
+    VkPipeline presentPipeline = VK_NULL_HANDLE;
+    FractalVariant pipelineVariant; // the variant of fractalPipeline.
+
+    VkCommandPool commandPool = VK_NULL_HANDLE;
+    VkCommandBuffer commandBuffers[MAX_FRAMES_IN_FLIGHT];
+    VkFence fences[MAX_FRAMES_IN_FLIGHT];
+    VkSemaphore imageAvailable[MAX_FRAMES_IN_FLIGHT];
+    VkSemaphore renderFinished[MAX_FRAMES_IN_FLIGHT];
+    bool submitted[MAX_FRAMES_IN_FLIGHT];
+    int slot = 0;
+    int lastSlot = -1; // the slot of the last frame, for ReadLastFrame().
+
+    // PASS_COUNT + 1 timestamps per slot, read back when the slot is reused, like GpuTimer does.
+    VkQueryPool queryPool = VK_NULL_HANDLE;
+    float passMs[PASS_COUNT];
+    double waitMs = 0.0; // time spent waiting on fences, since the last print.
+    double lastPrintTime = 0.0;
+};